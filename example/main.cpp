@@ -2,9 +2,23 @@
 #include "Adafruit_TinyUSB.h"
 #include <ArduinoJson.h>
 #include "meshsolar.h"
+#include "meshsolar_json.h"
+#include "meshsolar_stream.h"
+#include "meshsolar_aggregate.h"
+#include "meshsolar_history.h"
+#include "meshsolar_rollup.h"
+#include "meshsolar_store.h"
+#include "meshsolar_capture.h"
+#include "meshsolar_image.h"
 #include "SoftwareWire.h"
 #include "bq4050.h"
 #include "logger.h"
+#include "sysclock.h"
+#include "timer_wheel.h"
+#include "line_assembler.h"
+#include "tx_queue.h"
+#include "frame_sync.h"
+#include "flash_device.h"
 #include <Adafruit_NeoPixel.h>
 
 #define MESHSOLAR_VERSION  "v1.1"
@@ -42,9 +56,11 @@
  *    - Ensure sufficient RAM on target platform
  * 
  * 6. TIMING CONSIDERATIONS:
- *    - Main loop runs every 1ms
- *    - Status updates every 1000 iterations (1 second)
+ *    - Main loop sleeps between timer wheel deadlines and wakes on serial RX
+ *    - Status updates at an adaptive rate (1 s active, up to 1 min idle),
+ *      idle polls read only the BatteryStatus word
  *    - BQ4050 I2C operations require delay(10-100ms) between calls
+ *    - Responses and telemetry are queued and drained from loop(), no post-write delays
  * 
  * 7. DEPENDENCIES:
  *    - ArduinoJson library (version 6.x)
@@ -64,11 +80,18 @@
 #define SCL_PIN                         32          // I2C clock line pin
 #define RGB_LED_PIN                     47          // RGB LED data line pin
 #define EMERGENCY_SHUTDOWN_PIN          35          // Emergency shutdown pin
+#define GAUGE_UNSEAL_KEY                0           // BQ4050 unseal key (TI default 0x36720414), 0 = never unseal
 // Common pin assignments:
 // ESP32: GPIO 21 (SDA), GPIO 22 (SCL)
 // Arduino Uno: A4 (SDA), A5 (SCL)
 // nRF52840: Any GPIO pin
 
+// Flash log region - MODIFY FOR YOUR MEMORY MAP
+// The 8 pages just below InternalFS (0xED000) on the Adafruit S140 layout.
+// VERIFY: the application image must end below FLASH_LOG_BASE (see the .map file)
+#define FLASH_LOG_BASE                  0xE5000     // First page, 4 KB aligned
+#define FLASH_LOG_PAGES                 8           // 32 KB, about 5 days of records at the default interval
+
 // Global object declarations - INITIALIZATION ORDER IS CRITICAL!
 // For nRF52840: Uses g_ADigitalPinMap[] for pin mapping
 // For other platforms: Use direct pin numbers like SoftwareWire Wire(SDA_PIN, SCL_PIN);
@@ -79,328 +102,279 @@ MeshSolar    meshsolar;            // Main MeshSolar controller object
 
 /*
  * ============================================================================
- * UTILITY FUNCTIONS - Required for system operation
+ * JSON SERIALIZATION FUNCTIONS - Example-only replies
  * ============================================================================
+ * 
+ * Command parsing and the status/config/rsp serializers are table-driven and
+ * shared with the application, see meshsolar_json.h.
  */
 
 /**
- * @brief Listen for incoming string data on serial port
- * @param input Reference to string buffer for received data
- * @param terminator Character that indicates end of message (default: '\n')
- * @return true if complete message received, false otherwise
+ * @brief Convert command port receive counters to JSON format
+ * @param stats Pointer to receive counters
+ * @param output Reference to output string
+ * @return Size of serialized JSON
  * 
- * PORTING NOTES:
- * - Uses comSerial.available() and comSerial.read()
- * - Ensure your platform's Serial implementation supports these methods
- * - For non-blocking operation, this function should be called frequently
+ * OUTPUT FORMAT:
+ * {"command":"diag","rx_bytes":1234,"overflow_bytes":0,"lines":12,"oversize_lines":0,"overflow_lines":0}
  */
-static bool listenString(String& input, char terminator = '\n') {
-    while (comSerial.available() > 0) {
-        char c = comSerial.read();
-        if (c == terminator) return true;   
-         else input += c;                   
-    }
-    return false; 
+size_t meshsolar_rx_stats_to_json(const line_stats_t *stats, String& output) {
+    output = "";
+    StaticJsonDocument<192> doc;
+    doc["command"]        = "diag";
+    doc["rx_bytes"]       = stats->rx_bytes;
+    doc["overflow_bytes"] = stats->overflow_bytes;
+    doc["lines"]          = stats->lines;
+    doc["oversize_lines"] = stats->oversize_lines;
+    doc["overflow_lines"] = stats->overflow_lines;
+    return serializeJson(doc, output);
 }
 
+/*
+ * ============================================================================
+ * EVENT LOOP - Timer wheel jobs and wake-up sources
+ * ============================================================================
+ * 
+ * The loop does not spin: it handles pending commands, fires every expired job
+ * on the timer wheel and then blocks until the next job deadline or until the
+ * USB CDC driver reports received bytes. While blocked the FreeRTOS idle task
+ * puts the nRF52840 to sleep.
+ * 
+ * Periodic jobs reload from their own deadline, so a command that keeps the
+ * loop busy for seconds delays a job once instead of shifting its schedule.
+ */
+#define SETTINGS_RENEW_INTERVAL         60000       // Basic/advance settings re-read interval (ms)
+
+static TimerWheel        wheel;                     // Deadline timer wheel for periodic jobs
+static timer_node_t      statusRefreshTimer;        // Status snapshot, adaptive period
+static timer_node_t      telemetryTimer;            // JSON status output, one-shot armed by the status refresh
+static timer_node_t      settingsRenewTimer;        // Configuration read-back, fixed period
+static SemaphoreHandle_t wakeSem = nullptr;         // Given on UART RX to end the idle sleep
+static LineAssembler     cmdRx;                     // Command port RX ring, fed by tud_cdc_rx_cb()
+static TxQueue           cmdTx;                     // Command port TX queue, drained by loop()
+static MeshSolarStream   stream;                    // Field subscription, replaces the full status while active
+static SyncSession       syncFrames;                // Sequenced "sync" frames awaiting the host ack
+static timer_node_t      syncRetryTimer;            // Resends unacknowledged sync frames
+static MeshSolarAggregate aggregate;                // Windowed statistics, replace the full status while active
+static timer_node_t      aggregateTimer;            // Closes the aggregation window
+static MeshSolarHistory  history;                   // Delta-compressed status history for "history"
+static MeshSolarRollup   rollup;                    // Minute/hour/day buckets for "trend"
+static Nrf52Flash        flashRegion(FLASH_LOG_BASE, FLASH_LOG_PAGES);
+static MeshSolarStore    store;                     // Status and protection records kept across resets, for "log"
+static MeshSolarCapture  capture;                   // Burst capture buffer for "capture"
+static MeshSolarImage    image;                     // DataFlash image staging for "import"
+
+#define TX_DRAIN_INTERVAL               2           // Max idle sleep while TX bytes are queued (ms)
+#define TX_BACKPRESSURE_TIMEOUT         1000        // Give up on a response the host does not read (ms)
+
 /**
- * @brief Parse incoming JSON command and populate command structure
- * @param json JSON string to parse
- * @param cmd Pointer to command structure to populate
- * @return true if parsing successful, false otherwise
- * 
- * SUPPORTED COMMANDS:
- * - "config": Basic battery configuration
- * - "advance": Advanced battery settings
- * - "switch": FET control
- * - "reset": Battery gauge reset
- * - "sync": Synchronize settings
- * - "status": Get current status (no parameters)
+ * @brief USB CDC receive callback, moves received bytes into cmdRx and wakes the event loop
+ * 
+ * Draining here instead of in loop() keeps the CDC FIFO empty while a long
+ * command (DataFlash writes take seconds) blocks the loop.
  * 
  * PORTING NOTES:
- * - Requires ArduinoJson library (version 6.x)
- * - Uses StaticJsonDocument<1024> - ensure sufficient RAM
- * - All string operations use safe strlcpy() for buffer protection
+ * - TinyUSB calls this from the USB task when new bytes arrive
+ * - On other platforms call cmdRx.push() and xSemaphoreGiveFromISR(wakeSem) from the UART RX interrupt
+ * - cmdRx is single-producer: push() must only be called from this one context
  */
-static bool parseJsonCommand(const char* json, meshsolar_config_t* cmd) {
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, json);
-    if (error) {
-        LOG_E("Failed to parse JSON: %s", error.c_str());
-        return false;
+extern "C" void tud_cdc_rx_cb(uint8_t itf) {
+    (void)itf;
+    uint8_t buf[64];
+    while (comSerial.available() > 0) {
+        size_t n = comSerial.read(buf, sizeof(buf));
+        if (n == 0) {
+            break;
+        }
+        cmdRx.push(buf, n);
     }
+    if (wakeSem != nullptr) {
+        xSemaphoreGive(wakeSem);
+    }
+}
 
-    // clear the command structure
-    memset(cmd, 0, sizeof(meshsolar_config_t));
-
-    if (!doc.containsKey("command")) {
-        // dbgSerial.println("Missing 'command' field");
-        LOG_E("Missing 'command' field");
-        return false;
+/**
+ * @brief USB CDC transmit complete callback, wakes the event loop to queue more bytes
+ */
+extern "C" void tud_cdc_tx_complete_cb(uint8_t itf) {
+    (void)itf;
+    if (wakeSem != nullptr) {
+        xSemaphoreGive(wakeSem);
     }
-    strlcpy(cmd->command, doc["command"] | "", sizeof(cmd->command));
+}
 
-    if (strcmp(cmd->command, "config") == 0) {
-        if (!doc.containsKey("battery") || !doc.containsKey("temperature_protection")) {
-            // dbgSerial.println("Missing 'battery' or 'temperature_protection' field for 'config' command");
-            LOG_E("Missing 'battery' or 'temperature_protection' field for 'config' command");
-            return false;
-        }
-        JsonObject battery = doc["battery"];
-        JsonObject tp = doc["temperature_protection"];
-        if (!battery.containsKey("type") ||
-            !battery.containsKey("cell_number") ||
-            !battery.containsKey("design_capacity") ||
-            !battery.containsKey("cutoff_voltage") ||
-            !tp.containsKey("charge_high_temp_c") ||
-            !tp.containsKey("charge_low_temp_c") ||
-            !tp.containsKey("discharge_high_temp_c") ||
-            !tp.containsKey("discharge_low_temp_c") ||
-            !tp.containsKey("temp_enabled")) {
-            LOG_E("Missing fields in 'battery' or 'temperature_protection'");
-            return false;
-        }
-        strlcpy(cmd->basic.type, battery["type"] | "", sizeof(cmd->basic.type));
-        cmd->basic.cell_number = battery["cell_number"] | 0;
-        cmd->basic.design_capacity = battery["design_capacity"] | 0;
-        cmd->basic.discharge_cutoff_voltage = battery["cutoff_voltage"] | 0;
-
-        cmd->basic.protection.charge_high_temp_c = tp["charge_high_temp_c"] | 0;
-        cmd->basic.protection.charge_low_temp_c = tp["charge_low_temp_c"] | 0;
-        cmd->basic.protection.discharge_high_temp_c = tp["discharge_high_temp_c"] | 0;
-        cmd->basic.protection.discharge_low_temp_c = tp["discharge_low_temp_c"] | 0;
-        cmd->basic.protection.enabled = tp["temp_enabled"] | false;
-    } 
-    else if (strcmp(cmd->command, "switch") == 0) {
-        if (!doc.containsKey("fet_en")) {
-            LOG_E("Missing 'fet_en' field for 'switch' command");
-            return false;
-        }
-        cmd->fet_en.enable = doc["fet_en"] | false;
-    } 
-    else if (strcmp(cmd->command, "advance") == 0) {
-        if(doc["battery"].isNull() || doc["cedv"].isNull()) {
-            LOG_E("Missing 'battery' or 'cedv' field for 'advance' command");
-            return false;
-        }
-        JsonObject battery = doc["battery"];
-        JsonObject cedv = doc["cedv"];
-        if (!battery.containsKey("cuv") ||
-            !battery.containsKey("eoc") ||
-            !battery.containsKey("eoc_protect") ||
-            !cedv.containsKey("cedv0") ||
-            !cedv.containsKey("cedv1") ||
-            !cedv.containsKey("cedv2") ||
-            !cedv.containsKey("discharge_cedv0") ||
-            !cedv.containsKey("discharge_cedv10") ||
-            !cedv.containsKey("discharge_cedv20") ||
-            !cedv.containsKey("discharge_cedv30") ||
-            !cedv.containsKey("discharge_cedv40") ||
-            !cedv.containsKey("discharge_cedv50") ||
-            !cedv.containsKey("discharge_cedv60") ||
-            !cedv.containsKey("discharge_cedv70") ||
-            !cedv.containsKey("discharge_cedv80") ||
-            !cedv.containsKey("discharge_cedv90") ||
-            !cedv.containsKey("discharge_cedv100")) {
-                LOG_E("Missing fields in 'battery' or 'cedv'");
-                return false;
-        }
-        cmd->advance.battery.cuv            = battery["cuv"] | 0;
-        cmd->advance.battery.eoc            = battery["eoc"] | 0;
-        cmd->advance.battery.eoc_protect    = battery["eoc_protect"] | 0;
-        cmd->advance.cedv.cedv0             = cedv["cedv0"] | 0;
-        cmd->advance.cedv.cedv1             = cedv["cedv1"] | 0;
-        cmd->advance.cedv.cedv2             = cedv["cedv2"] | 0;
-        cmd->advance.cedv.discharge_cedv0   = cedv["discharge_cedv0"]  | 0;
-        cmd->advance.cedv.discharge_cedv10  = cedv["discharge_cedv10"] | 0;
-        cmd->advance.cedv.discharge_cedv20  = cedv["discharge_cedv20"] | 0;
-        cmd->advance.cedv.discharge_cedv30  = cedv["discharge_cedv30"] | 0;
-        cmd->advance.cedv.discharge_cedv40  = cedv["discharge_cedv40"] | 0;
-        cmd->advance.cedv.discharge_cedv50  = cedv["discharge_cedv50"] | 0;
-        cmd->advance.cedv.discharge_cedv60  = cedv["discharge_cedv60"] | 0;
-        cmd->advance.cedv.discharge_cedv70  = cedv["discharge_cedv70"] | 0;
-        cmd->advance.cedv.discharge_cedv80  = cedv["discharge_cedv80"] | 0;
-        cmd->advance.cedv.discharge_cedv90  = cedv["discharge_cedv90"] | 0;
-        cmd->advance.cedv.discharge_cedv100 = cedv["discharge_cedv100"]| 0;
-    } 
-    else if (strcmp(cmd->command, "reset") == 0) {
-
-    } 
-    else if (strcmp(cmd->command, "sync") == 0) {
-        if (!doc.containsKey("times")) {
-            LOG_E("Missing 'times' field for 'sync' command");
-            return false;
-        }
-        cmd->sync.times = doc["times"] | 1; // Default to 1 if not specified
-        if (cmd->sync.times < 1 || cmd->sync.times > 10) {
-            LOG_E("'times' must be between 1 and 10");
-            cmd->sync.times = 10; // Reset to default if out of range
-            return false;
+/**
+ * @brief Queue a command response, waiting for room instead of dropping it
+ * 
+ * Backpressure: when the TX ring is full the command handler drains and waits
+ * here. Only a host that stops reading for TX_BACKPRESSURE_TIMEOUT loses the line.
+ */
+static void sendResponse(const String &json) {
+    uint32_t start = sysclk::millis();
+    while (!cmdTx.send(json, TX_RESPONSE)) {
+        cmdTx.drain();
+        if ((sysclk::millis() - start) >= TX_BACKPRESSURE_TIMEOUT) {
+            LOG_E("TX queue full, response dropped");
+            return;
         }
-    } 
-    else if (strcmp(cmd->command, "status") == 0) {
-        // No additional fields required for status command
+        sysclk::delay(1);
     }
-    else {
-        LOG_E("Unknown command '%s'", cmd->command);
-        return false;
-    }
-
-    return true;
+    cmdTx.drain();
 }
 
-/*
- * ============================================================================
- * JSON SERIALIZATION FUNCTIONS - Data output formatting (snake_case naming)
- * ============================================================================
+/**
+ * @brief Queue the sync frames in mask
  */
+static void sendSyncFrames(uint8_t mask) {
+    for (uint8_t seq = 0; seq < SYNC_FRAMES_MAX; seq++) {
+        if ((mask & (1 << seq)) && syncFrames.frame(seq) != nullptr) {
+            sendResponse(syncFrames.frame(seq));
+        }
+    }
+    syncFrames.sent(sysclk::millis());
+}
 
 /**
- * @brief Convert battery status to JSON format
- * @param status Pointer to battery status structure
- * @param output Reference to output string
- * @return Size of serialized JSON
+ * @brief Sync retry job: resend the frames the host did not acknowledge in time
  * 
- * OUTPUT FORMAT:
- * {
- *   "command": "status",
- *   "soc_gauge": 85,
- *   "charge_current": -1200,
- *   "total_voltage": "12.345",
- *   "learned_capacity": "3.200",
- *   "pack_voltage": "12345",
- *   "fet_enable": true,
- *   "protection_sta": "CUV,COV",
- *   "emergency_shutdown": false,
- *   "cells": [
- *     {"cell_num": 1, "temperature": 25.123, "voltage": 3.234},
- *     ...
- *   ]
- * }
- * 
- * PORTING NOTES:
- * - Uses StaticJsonDocument<512> - ensure sufficient RAM
- * - Voltage/temperature values rounded to 3 decimal places
- * - Always outputs 4 cells regardless of actual cell count
- * - Function name follows snake_case convention for better readability
+ * Stops itself once the session is acknowledged or abandoned.
  */
-size_t meshsolar_status_to_json(const meshsolar_status_t* status, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"]          = "status";
-    doc["soc_gauge"]        = status->soc_gauge;
-    doc["charge_current"]   = status->charge_current;
-    doc["total_voltage"]    = String(status->total_voltage/1000.0f, 3);
-    doc["learned_capacity"] = String(status->learned_capacity /1000.0f, 3);
-    doc["pack_voltage"]     = String(status->pack_voltage);
-    doc["fet_enable"]       = status->fet_enable;
-    doc["protection_sta"]   = String(status->protection_sta) + String((status->emergency_shutdown) ? ",EMSHUT" : "");
-    // doc["emergency_shutdown"] = status->emergency_shutdown;
-    
-    JsonArray cells = doc.createNestedArray("cells");
-    for (int i = 0; i < 4; ++i) {
-        JsonObject cell     = cells.createNestedObject();
-        cell["cell_num"]    = status->cells[i].cell_num;
-        cell["temperature"] = round(status->cells[i].temperature * 1000)/1000.0f; // Round to 3 decimal places
-        cell["voltage"]     = round((status->cells[i].voltage / 1000.0f) * 1000) / 1000.0f; // Round to 3 decimal places
+static void syncRetryJob(void *arg) {
+    (void)arg;
+    uint8_t mask = syncFrames.due(sysclk::millis());
+    if (mask != 0) {
+        LOG_W("Sync session %u: resending frames 0x%02X", syncFrames.id(), mask);
+        sendSyncFrames(mask);
+    }
+    if (!syncFrames.active()) {
+        wheel.stop(&syncRetryTimer);
     }
-    output = "";
-    return serializeJson(doc, output);
 }
 
-
 /**
- * @brief Convert basic battery configuration to JSON format
- * @param basic Pointer to basic configuration structure
- * @param output Reference to output string
- * @return Size of serialized JSON
+ * @brief Push the protection edges found by the last read as "event" frames
  * 
- * FUNCTION: meshsolar_basic_config_to_json
- * - Serializes basic battery settings into JSON format
- * - Includes battery type, cell count, capacity, and temperature protection
- * - Used for configuration synchronization and validation
+ * Sent as responses, so a slow host never loses them to a newer status line.
+ * A frame that does not fit in the TX queue is pushed again after the next read.
  */
-size_t meshsolar_basic_config_to_json(const basic_config_t *basic, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"] = "config";
-    doc["battery"]["type"] = String(basic->type);
-    doc["battery"]["cell_number"] = basic->cell_number;
-    doc["battery"]["design_capacity"] = basic->design_capacity;
-    doc["battery"]["cutoff_voltage"] = basic->discharge_cutoff_voltage;
-
-    JsonObject protection = doc.createNestedObject("temperature_protection");
-    protection["discharge_high_temp_c"] = basic->protection.discharge_high_temp_c;
-    protection["discharge_low_temp_c"]  = basic->protection.discharge_low_temp_c;
-    protection["charge_high_temp_c"]    = basic->protection.charge_high_temp_c;
-    protection["charge_low_temp_c"]     = basic->protection.charge_low_temp_c;
-    protection["temp_enabled"]          = basic->protection.enabled;
-
-    output = "";
-    return serializeJson(doc, output);
+static void pushEvents() {
+    uint32_t seq  = meshsolar.events.push_from();
+    String   json = "";
+    while (meshsolar_events_to_json(&meshsolar.events, &seq, sysclk::millis(), json) > 0) {
+        if (!cmdTx.send(json, TX_RESPONSE)) {
+            break;
+        }
+        meshsolar.events.pushed_to(seq);
+    }
+    cmdTx.drain();
 }
 
+/**
+ * @brief Aggregate job: send the statistics of the window that just ended
+ * 
+ * Periodic with the "aggregate" window, stopped when aggregation is turned off.
+ */
+static void aggregateJob(void *arg) {
+    (void)arg;
+    String json = "";
+    if (aggregate.report(sysclk::millis(), json) > 0) {
+        cmdTx.send(json, TX_RESPONSE);              // One line per window, not replaced like the status
+        cmdTx.drain();
+    }
+}
 
 /**
- * @brief Convert advanced battery configuration to JSON format
- * @param config Pointer to advanced configuration structure  
- * @param output Reference to output string
- * @return Size of serialized JSON
+ * @brief Telemetry job: send the latest status snapshot as JSON
  * 
- * FUNCTION: meshsolar_advance_config_to_json
- * - Serializes advanced battery settings including CEDV curves
- * - Contains cutoff voltages and discharge curve data points
- * - Critical for battery gauge calibration and performance tuning
+ * INTEGRATION NOTES:
+ * - External systems can parse this JSON for monitoring
+ * - Sent once per status refresh, so idle packs also talk less
+ * - After a "subscribe" only the subscribed fields that are due are sent,
+ *   as a "delta" frame; nothing is sent when no field is due
+ * - While an "aggregate" window is set the per-sample status is not sent,
+ *   aggregateJob() reports once per window instead
  */
-size_t meshsolar_advance_config_to_json(const advance_config_t *config, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"] = "advance";
-
-    JsonObject battery = doc.createNestedObject("battery");
-    battery["cuv"] = config->battery.cuv;
-    battery["eoc"] = config->battery.eoc;
-    battery["eoc_protect"] = config->battery.eoc_protect;
-
-    JsonObject cedv = doc.createNestedObject("cedv");
-    cedv["cedv0"] = config->cedv.cedv0;
-    cedv["cedv1"] = config->cedv.cedv1;
-    cedv["cedv2"] = config->cedv.cedv2;
-    cedv["discharge_cedv0"] = config->cedv.discharge_cedv0;
-    cedv["discharge_cedv10"] = config->cedv.discharge_cedv10;
-    cedv["discharge_cedv20"] = config->cedv.discharge_cedv20;
-    cedv["discharge_cedv30"] = config->cedv.discharge_cedv30;
-    cedv["discharge_cedv40"] = config->cedv.discharge_cedv40;
-    cedv["discharge_cedv50"] = config->cedv.discharge_cedv50;
-    cedv["discharge_cedv60"] = config->cedv.discharge_cedv60;
-    cedv["discharge_cedv70"] = config->cedv.discharge_cedv70;
-    cedv["discharge_cedv80"] = config->cedv.discharge_cedv80;
-    cedv["discharge_cedv90"] = config->cedv.discharge_cedv90;
-    cedv["discharge_cedv100"] = config->cedv.discharge_cedv100;
-    output = "";
-    return serializeJson(doc, output);
+static void telemetryJob(void *arg) {
+    (void)arg;
+    String json = "";
+    if (stream.active()) {
+        if (stream.poll(&meshsolar.sta, sysclk::millis(), json) > 0 && !cmdTx.send(json, TX_RESPONSE)) {
+            stream.resync();                        // Frame lost to a slow host, resend every field next time
+        }
+        cmdTx.drain();
+        return;
+    }
+    if (aggregate.active()) {
+        return;
+    }
+    meshsolar_status_to_json(&meshsolar.sta, json);
+    LOG_L("Status JSON: %s", json.c_str());
+    cmdTx.send(json, TX_TELEMETRY);                 // Replaces an older unsent status if the host is slow
+    cmdTx.drain();
 }
 
+/**
+ * @brief Status refresh job: read the real-time snapshot and reschedule adaptively
+ * 
+ * STATUS UPDATE SEQUENCE:
+ * 1. Read the BatteryStatus word; the full snapshot (SOC, voltage, current,
+ *    temperature, protection status) only when an alarm or state bit moved,
+ *    while active, or once the last one is full_refresh_ms old
+ * 2. Re-arm itself with MeshSolar::next_poll_interval_ms()
+ *    1 s while active, backing off to 1 min while idle
+ * 3. After a full snapshot, feed the statistics and arm the telemetry job
+ * 
+ * CUSTOMIZATION:
+ * - Change the thresholds with meshsolar.set_poll_policy()
+ * - Change the gauge alarms with the "alarm" command
+ * - Add/remove monitoring parameters as needed
+ */
+static void statusRefreshJob(void *arg) {
+    (void)arg;
+    bool     full   = false;
+    uint32_t period = stream.min_period();          // Subscribed fields must not be older than their period
+    meshsolar.refresh_bat_status(&full, period);
+    uint32_t interval = meshsolar.next_poll_interval_ms();
+    if (period > 0 && period < interval) {
+        interval = period;                          // Honour the fastest subscribed period
+    }
+    wheel.restart(&statusRefreshTimer, sysclk::millis(), interval);
+    if (!full) {
+        return;                                     // Nothing changed since the last snapshot
+    }
+    if (meshsolar.events.unpushed() > 0) {
+        pushEvents();                               // Protection edges go out before anything else
+    }
+    aggregate.add(&meshsolar.sta, sysclk::millis());
+    history.add(&meshsolar.sta, sysclk::millis());
+    rollup.add(&meshsolar.sta, sysclk::millis());
+    store.add(&meshsolar.sta, sysclk::millis());
+    wheel.start(&telemetryTimer, sysclk::millis(), 0, 0, telemetryJob, nullptr); // Publish the new snapshot on this loop pass
+
+    // Human-readable status output to debug port
+    LOG_I("================================================");
+    LOG_I("Status soc_gauge       : %d%%", meshsolar.sta.soc_gauge);
+    LOG_I("Status pack_voltage    : %d mV", meshsolar.sta.pack_voltage);
+    LOG_I("Status charge_current  : %d mA", meshsolar.sta.charge_current);
+    LOG_I("Status total_voltage   : %.0f mV", meshsolar.sta.total_voltage);
+    LOG_I("Status learned_capacity: %.0f mAh", meshsolar.sta.learned_capacity);
+    LOG_I("Status fet enable      : %s", meshsolar.sta.fet_enable ? "On" : "Off");
+    LOG_I("Protect Status         : %s", meshsolar_protection_str(&meshsolar.sta).c_str());
+    LOG_I("Emergency Shutdown     : %s", meshsolar.sta.emergency_shutdown ? "Enabled" : "Disabled");
+}
 
 /**
- * @brief Create standardized command response JSON
- * @param status Boolean indicating command success/failure
- * @param output Reference to output string  
- * @return Size of serialized JSON
+ * @brief Settings renew job: re-read basic and advanced configuration
  * 
- * FUNCTION: meshsolar_cmd_rsp_to_json
- * - Generates consistent response format for all commands
- * - Simple true/false status indication
- * - Used for acknowledgment of configuration changes
+ * Keeps sync_rsp current for the "sync" command. Configuration only changes
+ * through commands, which read it back themselves, so a slow period is enough.
+ * The gauge alarms live in volatile SBS registers and are re-asserted here.
  */
-size_t meshsolar_cmd_rsp_to_json(bool status, String& output) {
-    output = "";
-    StaticJsonDocument<64> doc;
-    doc["command"] = "rsp";
-    doc["status"] = status;
-    output = "";
-    // Serialize the JSON document to the output string
-    return serializeJson(doc, output);
+static void settingsRenewJob(void *arg) {
+    (void)arg;
+    meshsolar.update_alarm_setting();               // Rewrites the alarms only if a gauge reset restored the defaults
+    meshsolar.get_basic_bat_realtime_setting();     // Read: Battery type, cells, capacity, protection settings
+    meshsolar.get_advance_bat_realtime_setting();   // Read: CEDV curves, advanced protection thresholds
 }
 
 /*
@@ -450,6 +424,8 @@ void setup() {
     
     // Initialize MeshSolar controller (REQUIRED)
     meshsolar.begin(&bq4050);           
+    meshsolar.set_unseal_key(GAUGE_UNSEAL_KEY); // A SEALED gauge refuses DataFlash commands without it
+    meshsolar.update_alarm_setting();   // Gauge-side alarms, so idle polls read one status word
     
     // INITIALIZE NeoPixel strip object (REQUIRED)
     strip.begin();     
@@ -465,6 +441,18 @@ void setup() {
         strip.setPixelColor(i, strip.Color(0, 0, 0, 0)); // Set pixel to black
     }
 
+    // Command port TX queue, drained from loop()
+    cmdTx.begin(&comSerial);
+
+    // Flash log: recover the write position, record why we (re)started
+    store.begin(&flashRegion, readResetReason(), sysclk::millis());
+
+    // Event loop: wake-up semaphore and periodic jobs
+    wakeSem = xSemaphoreCreateBinary();
+    wheel.begin(sysclk::millis());
+    wheel.start(&statusRefreshTimer, sysclk::millis(), 0, 0, statusRefreshJob, nullptr);   // Re-armed adaptively by the job
+    wheel.start(&settingsRenewTimer, sysclk::millis(), 0, SETTINGS_RENEW_INTERVAL, settingsRenewJob, nullptr);
+
     LOG_I("MeshSolar %s initialized successfully", MESHSOLAR_VERSION);
 }
 
@@ -473,20 +461,17 @@ void setup() {
  * 
  * LOOP STRUCTURE:
  * - Command processing: Handles incoming JSON commands via serial
- * - Status monitoring: Updates battery status every 1000 iterations (~1 second)
- * - JSON output: Sends status updates via serial every 1000 iterations
+ * - Timer wheel: Runs the status refresh, telemetry and settings renew jobs
+ * - Idle: Sleeps until the next job deadline or received serial data
  * 
  * TIMING BEHAVIOR:
- * - Loop frequency: ~1000 Hz (1ms delay)
- * - Status update: 1 Hz (every 1000 iterations)
+ * - No fixed loop frequency, the CPU sleeps between events
+ * - Status update: 1 s when active, backing off to 1 min when idle
+ *   (BatteryStatus word only, full snapshot on change or every 5 min)
  * - Command response: Immediate when received
  * 
  * THREAD SAFETY NOTES:
- * - This is a single-threaded implementation
- * - For RTOS environments, consider separating:
- *   * Command processing thread
- *   * Status monitoring thread
- *   * I2C communication thread
+ * - Jobs run in the loop task, never concurrently with command handling
  * 
  * PERFORMANCE CONSIDERATIONS:
  * - I2C operations are blocking and may take 10-100ms
@@ -494,9 +479,8 @@ void setup() {
  * - JSON serialization requires temporary buffers
  * 
  * CUSTOMIZATION POINTS:
- * - Modify update frequency by changing (cnt % 1000) condition
- * - Add additional periodic tasks in the main loop
- * - Implement command queuing for better responsiveness
+ * - Modify update frequency with meshsolar.set_poll_policy()
+ * - Add periodic tasks as timer_node_t jobs on the wheel in setup()
  */
 void loop() {
     static uint32_t cnt = 0;
@@ -515,10 +499,11 @@ void loop() {
     // COMMAND PROCESSING SECTION
     // Handles incoming JSON commands from serial port
     // ========================================================================
-    if(listenString(json, '\n')) {
-        LOG_D("%s", json.c_str());
-        bool res = parseJsonCommand(json.c_str(), &meshsolar.cmd);
-        if (res) {
+    const char *line = cmdRx.poll();
+    if(line != nullptr) {
+        LOG_D("%s", line);
+        meshsolar_cmd_t command = meshsolar_parse_command(line, &meshsolar.cmd);
+        if (command != MESHSOLAR_CMD_INVALID) {
             /*
              * COMMAND HANDLERS
              * Each command type has specific processing requirements:
@@ -527,7 +512,14 @@ void loop() {
              * "advance": Updates advanced settings (CEDV, protection thresholds)
              * "switch": Controls FET enable/disable
              * "reset": Resets battery gauge learning data
-             * "sync": Sends current configuration data multiple times
+             * "sync": Sends status and configuration as sequenced frames ("times": legacy repetition)
+             * "ack": Host acknowledgement of sync frames, missing frames are resent
+             * "batch": Runs config/advance/switch/reset/sync steps with one DataFlash pass
+             * "subscribe": Streams only the named status fields, as deltas
+             * 
+             * DataFlash commands on a SEALED gauge are answered at once with
+             * "error":"sealed"; with GAUGE_UNSEAL_KEY set the gauge is
+             * unsealed for the command and sealed again afterwards.
              * 
              * PORTING NOTES:
              * - All configuration changes are immediately written to BQ4050
@@ -535,7 +527,12 @@ void loop() {
              * - Responses are sent immediately after completion
              * - Consider implementing timeout mechanisms for production use
              */
-            if (0 == strcmp(meshsolar.cmd.command, "config")) {
+            if (meshsolar_cmd_uses_dataflash(command, &meshsolar.cmd) && !meshsolar.dataflash_unlock()) {
+                LOG_E("'%s' rejected, gauge SEALED", meshsolar.cmd.command);
+                meshsolar_cmd_rsp_to_json(false, json, nullptr, "sealed"); // Nothing written, nothing to retry
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_CONFIG) {
                 bool results[5] = {false};
                 log_i("\r\n");
                 LOG_W("Updating basic battery configuration...");
@@ -565,18 +562,16 @@ void loop() {
                 //sync the basic battery configuration immediately
                 meshsolar.get_basic_bat_realtime_setting();     
                 meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json); // Get the basic battery settings
-                comSerial.println(json); // Send the configuration back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the configuration for the serial port
                 LOG_I("Basic configuration sync completed");
 
                 bool allSuccess = results[0] && results[1] && results[2] && results[3] && results[4];
                 // Respond with the updated basic configuration
                 meshsolar_cmd_rsp_to_json(allSuccess, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the response for the serial port
                 LOG_I("Basic configuration response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "advance")) {
+            else if (command == MESHSOLAR_CMD_ADVANCE) {
                 bool results[2] = {false};
                 log_i("\r\n");
                 LOG_W("Updating advanced battery configuration...");
@@ -598,135 +593,306 @@ void loop() {
                 //respond with the updated advanced configuration
                 meshsolar.get_advance_bat_realtime_setting();
                 meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json); // Get the advanced battery settings
-                comSerial.println(json); // Send the configuration back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the configuration for the serial port
                 LOG_I("Advanced configuration sync");
 
                 // Respond with the updated advanced configuration
                 bool allSuccess = results[0] && results[1];
                 meshsolar_cmd_rsp_to_json(allSuccess, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the response for the serial port
                 LOG_I("Advanced configuration response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "switch")) {
-                res = meshsolar.toggle_fet(); 
+            else if (command == MESHSOLAR_CMD_SWITCH) {
+                bool res = meshsolar.toggle_fet();
                 LOG_I("FET Toggle...");
 
                 // Respond with the FET toggle result
                 meshsolar_cmd_rsp_to_json(res, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the response for the serial port
                 LOG_I("FET toggle response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "reset")) {
-                res =  meshsolar.reset_bat_gauge();      
+            else if (command == MESHSOLAR_CMD_RESET) {
+                bool res = meshsolar.reset_bat_gauge();
                 LOG_I("Resetting BQ4050...");
 
                 // Respond with the reset result
                 meshsolar_cmd_rsp_to_json(res, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the response for the serial port
                 LOG_I("Reset response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "sync")) {
-                size_t len = 0;
+            else if (command == MESHSOLAR_CMD_SYNC && meshsolar.cmd.sync.times == 0) {
+                // Each frame is sent once, the host acks and names missing frames.
+                // Same frame set as src/meshSolarApp.cpp: status, basic, advance
+                syncFrames.begin(3);
+                meshsolar_status_to_json(&meshsolar.sta, json);
+                syncFrames.add(json.c_str());
+                meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json);
+                syncFrames.add(json.c_str());
+                meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json);
+                syncFrames.add(json.c_str());
+                sendSyncFrames(syncFrames.all());
+                wheel.start(&syncRetryTimer, sysclk::millis(), SYNC_RETRY_TIMEOUT, SYNC_RETRY_TIMEOUT, syncRetryJob, nullptr);
+                LOG_I("Sync session %u sent", syncFrames.id());
+            }
+            else if (command == MESHSOLAR_CMD_ACK) {
+                if (syncFrames.ack(meshsolar.cmd.ack.session, meshsolar.cmd.ack.missing)) {
+                    sendSyncFrames(meshsolar.cmd.ack.missing); // Selective retransmit
+                }
+                else {
+                    meshsolar_cmd_rsp_to_json(false, json); // Stale session, the host starts a new sync
+                    sendResponse(json);
+                }
+            }
+            else if (command == MESHSOLAR_CMD_SYNC) {
+                size_t len = meshsolar_status_to_json(&meshsolar.sta, json);
+                if(len > 0) {
+                    sendResponse(json); // Queue the status for the serial port
+                    LOG_D("%s", json.c_str());
+                }
                 for(uint8_t i = 0; i < meshsolar.cmd.sync.times; i++) {
                     len = meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json); // Get the basic battery settings
                     if(len > 0) {
-                        comSerial.println(json); // Send the configuration back to the serial port
-                        delay(10); // Small delay to avoid flooding the serial output
+                        sendResponse(json); // Queue the configuration for the serial port
                         LOG_D("%s", json.c_str());
                     }
 
                     len = meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json); // Get the advanced battery settings
                     if(len > 0) {
-                        comSerial.println(json); // Send the configuration back to the serial port
-                        delay(10); // Small delay to avoid flooding the serial output
+                        sendResponse(json); // Queue the configuration for the serial port
                         LOG_D("%s", json.c_str());
                     }
                 }
                 LOG_I("Sync data sent %d times.", meshsolar.cmd.sync.times);
             }
+            else if (command == MESHSOLAR_CMD_BATCH) {
+                const batch_config_t *batch = &meshsolar.cmd.batch;
+                bool results[MESHSOLAR_BATCH_MAX] = {false};
+                bool settings = false;      // Settings are read back and sent once
+                bool sync = false;
+                log_i("\r\n");
+                LOG_W("Executing %d step batch...", batch->count);
+
+                // Plan the DataFlash writes of every step, each address is written once
+                meshsolar.df_plan_begin();
+                for (uint8_t i = 0; i < batch->count; i++) {
+                    meshsolar.df_plan_step(i);
+                    if (batch->steps[i] == MESHSOLAR_CMD_CONFIG) {
+                        results[i] = meshsolar.plan_basic_settings();
+                    }
+                    else if (batch->steps[i] == MESHSOLAR_CMD_ADVANCE) {
+                        results[i] = meshsolar.plan_advance_settings();
+                    }
+                }
+                meshsolar.df_plan_apply();
+
+                // FET and gauge commands run after the writes, in request order
+                for (uint8_t i = 0; i < batch->count; i++) {
+                    switch (batch->steps[i]) {
+                        case MESHSOLAR_CMD_CONFIG:
+                        case MESHSOLAR_CMD_ADVANCE:
+                            results[i] = results[i] && meshsolar.df_plan_step_ok(i);
+                            settings = true;
+                            break;
+                        case MESHSOLAR_CMD_SWITCH:
+                            results[i] = meshsolar.toggle_fet();
+                            break;
+                        case MESHSOLAR_CMD_RESET:
+                            results[i] = meshsolar.reset_bat_gauge();
+                            break;
+                        case MESHSOLAR_CMD_SYNC:
+                            results[i] = true;
+                            settings = sync = true;
+                            break;
+                        default:
+                            break;
+                    }
+                    LOG_I("Step %d %-8s | %s", i, meshsolar_cmd_names[batch->steps[i]], results[i] ? "Success" : "Failed");
+                }
+
+                // Read back once, send the settings once (sync repeats them)
+                if (settings) {
+                    meshsolar.get_basic_bat_realtime_setting();
+                    meshsolar.get_advance_bat_realtime_setting();
+                    uint16_t times = (sync && meshsolar.cmd.sync.times > 1) ? meshsolar.cmd.sync.times : 1;
+                    for (uint16_t t = 0; t < times; t++) {
+                        if (meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json) > 0) {
+                            sendResponse(json); // Queue the configuration for the serial port
+                        }
+                        if (meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json) > 0) {
+                            sendResponse(json); // Queue the configuration for the serial port
+                        }
+                    }
+                }
+
+                meshsolar_batch_rsp_to_json(batch, results, json); // One response for the whole batch
+                sendResponse(json); // Queue the response for the serial port
+                LOG_I("Batch response sent");
+            }
+            else if (command == MESHSOLAR_CMD_SUBSCRIBE) {
+                stream.subscribe(&meshsolar.cmd.subscribe);
+                meshsolar_cmd_rsp_to_json(true, json); // Create a response JSON
+                sendResponse(json); // Queue the response for the serial port
+                wheel.restart(&statusRefreshTimer, sysclk::millis(), 0); // First frame from a fresh snapshot
+                LOG_I("Subscription response sent");
+            }
+            else if (command == MESHSOLAR_CMD_AGGREGATE) {
+                aggregate.set_window((uint32_t)meshsolar.cmd.aggregate.window_ms, sysclk::millis());
+                if (aggregate.active()) {
+                    wheel.start(&aggregateTimer, sysclk::millis(), aggregate.window(), aggregate.window(), aggregateJob, nullptr);
+                    wheel.restart(&statusRefreshTimer, sysclk::millis(), 0); // Seed the window with a fresh snapshot
+                }
+                else {
+                    wheel.stop(&aggregateTimer);
+                }
+                meshsolar_cmd_rsp_to_json(true, json); // Create a response JSON
+                sendResponse(json); // Queue the response for the serial port
+                LOG_I("Aggregation response sent");
+            }
+            else if (command == MESHSOLAR_CMD_HISTORY) {
+                const history_config_t *range = &meshsolar.cmd.history;
+                bool ok = range->from_s >= range->to_s;
+                if (ok) {
+                    uint32_t now = sysclk::millis();
+                    uint8_t  blocks[HISTORY_BLOCKS];
+                    uint8_t  n = history.find(now - (uint32_t)range->from_s * 1000, now - (uint32_t)range->to_s * 1000,
+                                              blocks, HISTORY_BLOCKS);
+                    for (uint8_t i = 0; i < n; i++) {
+                        history.block_to_json(blocks[i], i, n, now, json);
+                        sendResponse(json); // One frame per block, oldest first
+                    }
+                    LOG_I("History: %d blocks sent", n);
+                }
+                meshsolar_cmd_rsp_to_json(ok, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_TREND) {
+                const trend_config_t *query = &meshsolar.cmd.trend;
+                rollup_series_t series = rollup_find_series(query->series);
+                bool per_cell = (series == ROLLUP_SERIES_VOLTAGE || series == ROLLUP_SERIES_TEMPERATURE);
+                int  cells    = (series == ROLLUP_SERIES_VOLTAGE) ? meshsolar.sta.cell_count : 4;
+                bool ok = (series != ROLLUP_SERIES_COUNT) && (query->from_s >= query->to_s);
+                for (int cell = 1; ok && cell <= (per_cell ? cells : 1); cell++) {
+                    if (per_cell && query->cell != 0 && query->cell != cell) {
+                        continue;
+                    }
+                    if (rollup.to_json(series, cell, query->from_s, query->to_s, sysclk::millis(), json) > 0) {
+                        sendResponse(json); // One frame per series and cell
+                    }
+                }
+                meshsolar_cmd_rsp_to_json(ok, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_LOG) {
+                int      count = (meshsolar.cmd.log.count > 0) ? meshsolar.cmd.log.count : STORE_LOG_DEFAULT;
+                uint32_t total = store.select((uint32_t)count);
+                for (uint32_t i = 0; i < total && store.next_json(i, total, json) > 0; i++) {
+                    sendResponse(json); // One frame per record, oldest first
+                }
+                LOG_I("Log: %u records sent", (unsigned)total);
+                meshsolar_cmd_rsp_to_json(store.active(), json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_ALARM) {
+                meshsolar.set_alarm_config(meshsolar.cmd.alarm);
+                bool ok = meshsolar.update_alarm_setting();
+                meshsolar_cmd_rsp_to_json(ok, json); // Create a response JSON
+                sendResponse(json); // Queue the response for the serial port
+                LOG_I("Alarm response sent");
+            }
+            else if (command == MESHSOLAR_CMD_CAPTURE) {
+                // Blocks the bus for the window, the status poll catches up afterwards
+                bool ok = capture.run(&bq4050, (uint8_t)meshsolar.sta.cell_count, meshsolar.cmd.capture);
+                for (uint16_t seq = 0; ok && capture.chunk_json(seq, json) > 0; seq++) {
+                    sendResponse(json); // Waveform, CAPTURE_CHUNK_SAMPLES samples per frame
+                }
+                if (ok && capture.summary_json(json) > 0) {
+                    sendResponse(json); // Internal resistance estimate
+                }
+                meshsolar_cmd_rsp_to_json(ok, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_EXPORT) {
+                // Blocks the bus while the region is read, the status poll catches up afterwards
+                bool ok = image.export_begin(meshsolar.cmd.image.addr, meshsolar.cmd.image.len);
+                for (uint16_t seq = 0; ok && seq < image.chunks(); seq++) {
+                    ok = image.export_chunk_json(&bq4050, seq, json) > 0;
+                    if (ok) {
+                        sendResponse(json); // DF_IMAGE_CHUNK bytes per frame
+                    }
+                }
+                if (ok && image.export_summary_json(json) > 0) {
+                    sendResponse(json); // Length and CRC of the whole range
+                }
+                meshsolar_cmd_rsp_to_json(ok, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_IMPORT) {
+                const image_config_t *req = &meshsolar.cmd.image;
+                image_op_t op = image_find_op(req->op);
+                bool ok = true;
+                if (op == IMAGE_OP_BEGIN) {
+                    image.begin();
+                }
+                else if (op == IMAGE_OP_DATA) {
+                    ok = image.stage(req->addr, req->data, req->crc); // RAM only, the host resends on false
+                }
+                else {
+                    log_i("\r\n");
+                    LOG_W("Committing DataFlash image...");
+                    ok = image.commit(&bq4050, req->crc);
+                    if (image.commit_json(json) > 0) {
+                        sendResponse(json); // Block counts
+                    }
+                    meshsolar.get_basic_bat_realtime_setting();     // Cell count and chemistry follow the new image
+                }
+                meshsolar_cmd_rsp_to_json(ok, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_EVENTS) {
+                uint32_t seq = (uint32_t)meshsolar.cmd.events.from;
+                while (meshsolar_events_to_json(&meshsolar.events, &seq, sysclk::millis(), json) > 0) {
+                    sendResponse(json); // Journal from "from", oldest first
+                }
+                meshsolar_cmd_rsp_to_json(true, json); // Ends the reply
+                sendResponse(json); // Queue the response for the serial port
+            }
+            else if (command == MESHSOLAR_CMD_DIAG) {
+                line_stats_t stats;
+                cmdRx.get_stats(&stats);
+                meshsolar_rx_stats_to_json(&stats, json);
+                sendResponse(json); // Queue the counters for the serial port
+            }
             else{
                 LOG_E("Unknown command: %s", meshsolar.cmd.command);
             }
+            meshsolar.dataflash_relock();   // Seal the gauge again if the command unsealed it
         } else {
             LOG_E("Failed to parse command");
         }
     }
-    
+
     // ========================================================================
-    // PERIODIC STATUS MONITORING SECTION
-    // Updates battery status and configuration every 1 second
+    // TIMER WHEEL SECTION
+    // Fires status refresh, telemetry and settings renew jobs that are due
     // ========================================================================
-#if 1
-    if(0 == cnt % 1000) {
-        /*
-         * STATUS UPDATE SEQUENCE:
-         * 1. Read real-time battery data from BQ4050
-         * 2. Read current basic configuration
-         * 3. Read current advanced configuration
-         * 
-         * TIMING NOTES:
-         * - Each I2C operation takes 10-50ms
-         * - Total update cycle: ~200-500ms
-         * - Frequency: 1 Hz (every 1000 loop iterations)
-         * 
-         * CUSTOMIZATION:
-         * - Change frequency by modifying (cnt % 1000)
-         * - Add/remove monitoring parameters as needed
-         * - Consider separate threads for real-time systems
-         */
-        meshsolar.get_realtime_bat_status();            // Read: SOC, voltage, current, temperature, protection status
-        meshsolar.get_basic_bat_realtime_setting();     // Read: Battery type, cells, capacity, protection settings
-        meshsolar.get_advance_bat_realtime_setting();   // Read: CEDV curves, advanced protection thresholds
-        
-        // Human-readable status output to debug port
-        LOG_I("================================================");
-        LOG_I("Status soc_gauge       : %d%%", meshsolar.sta.soc_gauge);
-        LOG_I("Status pack_voltage    : %d mV", meshsolar.sta.pack_voltage);
-        LOG_I("Status charge_current  : %d mA", meshsolar.sta.charge_current);
-        LOG_I("Status total_voltage   : %.0f mV", meshsolar.sta.total_voltage);
-        LOG_I("Status learned_capacity: %.0f mAh", meshsolar.sta.learned_capacity);
-        LOG_I("Status fet enable      : %s", meshsolar.sta.fet_enable ? "On" : "Off");
-        LOG_I("Protect Status         : %s", meshsolar.sta.protection_sta);
-        LOG_I("Emergency Shutdown     : %s", meshsolar.sta.emergency_shutdown ? "Enabled" : "Disabled");
-    }
-#endif
+    uint32_t idle_ms = wheel.run(sysclk::millis());
 
     // ========================================================================
-    // JSON STATUS OUTPUT SECTION
-    // Sends structured status data via serial port every 1 second
-    // Uses snake_case function naming: meshsolar_status_to_json()
+    // TX SECTION
+    // Moves queued responses and telemetry to the port without blocking
     // ========================================================================
-#if 1
-    if(0 == cnt % 1000){
-        /*
-         * JSON STATUS OUTPUT:
-         * - Converts internal status structure to JSON format using meshsolar_status_to_json()
-         * - Sends via comSerial for external monitoring/logging
-         * - Includes all battery parameters in structured format
-         * 
-         * INTEGRATION NOTES:
-         * - External systems can parse this JSON for monitoring
-         * - Format is consistent and machine-readable
-         * - Consider adding timestamp for data logging
-         * - May want to implement data compression for large datasets
-         */
-        meshsolar_status_to_json(&meshsolar.sta, json);
-        LOG_L("Status JSON: %s", json.c_str());
-        comSerial.println(json);
-        delay(10); // Small delay to avoid flooding the serial output
+    if (cmdTx.drain() > 0 && idle_ms > TX_DRAIN_INTERVAL) {
+        idle_ms = TX_DRAIN_INTERVAL;                // Keep draining while the host is slow
     }
-#endif
 
-    // Main loop timing - CRITICAL FOR SYSTEM RESPONSIVENESS
-    // MODIFY: Adjust delay based on your system requirements
-    // - 1ms: Good for responsive command processing
-    // - 10ms: Reduces CPU load, still responsive
-    // - 100ms: Low power mode, slower response
-    delay(1);
+    // ========================================================================
+    // IDLE SECTION
+    // Sleep until the next job deadline or until serial data arrives
+    // ========================================================================
+    if (cmdRx.available() == 0) {
+        TickType_t ticks = (idle_ms == TIMER_WHEEL_IDLE_MS) ? portMAX_DELAY : pdMS_TO_TICKS(idle_ms);
+        xSemaphoreTake(wakeSem, ticks);
+    }
 }
 
 /*
@@ -0,0 +1,191 @@
+#include <Arduino.h>
+#include "Adafruit_TinyUSB.h"
+#include <ArduinoJson.h>
+#include "meshsolar.h"
+#include "meshsolar_json.h"
+#include "meshsolar_packs.h"
+#include "SoftwareWire.h"
+#include "bq4050.h"
+#include "logger.h"
+#include "sysclock.h"
+
+/*
+ * ============================================================================
+ * MULTI-PACK EXAMPLE - Several BQ4050 packs in parallel on one node
+ * ============================================================================
+ *
+ * Each pack has its own SoftwareWire bus (all gauges answer at 0x0B). The
+ * MeshSolarPacks manager owns the (SoftwareWire, BQ4050, MeshSolar) sets and
+ * polls them in turn, one pack per loop pass, so commands are served between
+ * two packs and a silent pack only delays itself.
+ *
+ * COMMANDS:
+ *   {"command":"packs"}                           Combined status: FCC weighted SOC,
+ *                                                 total current, worst cells
+ *   {"command":"status","pack":2}                 Status of pack 2, "pack" omitted = every pack
+ *   {"command":"switch","pack":1,"fet_en":false}  Per pack or broadcast
+ *   {"command":"reset"} / {"command":"alarm",...} Broadcast to every pack
+ *   {"command":"config",...} / {"command":"advance",...}
+ *
+ * Every command ends with {"command":"rsp","status":...}; a broadcast is true
+ * only if every pack succeeded. The single-pack commands of example/main.cpp
+ * (sync, history, log, ...) are not wired here.
+ *
+ * PORTING NOTES:
+ * - List the bus pins of each pack in packPins[]
+ * - nRF52840: pins go through g_ADigitalPinMap[] like the single-pack example
+ */
+
+#define comSerial           Serial      // Primary communication port
+
+typedef struct {
+    uint8_t sda;
+    uint8_t scl;
+} pack_pins_t;
+
+// Bus pins of each pack - MODIFY FOR YOUR HARDWARE
+static const pack_pins_t packPins[] = {
+    {33, 32},
+    {13, 15},
+    {17, 20},
+};
+
+static MeshSolarPacks packs;            // Owns every pack's bus, gauge and MeshSolar
+
+static bool listenString(String& input, char terminator = '\n') {
+    while (comSerial.available() > 0) {
+        char c = comSerial.read();
+        if (c == terminator) return true;
+        input += c;
+    }
+    return false;
+}
+
+static void sendResponse(const String &json) {
+    comSerial.println(json);
+}
+
+/*
+ * Per-pack command steps, run by MeshSolarPacks::for_each() on each
+ * targeted pack with the command already parsed into solar->cmd
+ */
+static bool packStatus(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)ctx;
+    String json;
+    meshsolar_status_to_json(&solar->sta, json, n);
+    sendResponse(json);
+    return packs.online(n);
+}
+
+static bool packSwitch(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)n; (void)ctx;
+    return solar->toggle_fet();
+}
+
+static bool packReset(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)n; (void)ctx;
+    return solar->reset_bat_gauge();
+}
+
+static bool packAlarm(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)n; (void)ctx;
+    solar->set_alarm_config(solar->cmd.alarm);
+    return solar->update_alarm_setting();
+}
+
+static bool packConfig(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)n; (void)ctx;
+    if (!solar->dataflash_unlock()) {
+        return false;                               // SEALED, nothing written
+    }
+    bool ok = solar->update_basic_bat_type_setting();
+    ok &= solar->update_basic_bat_cells_setting();
+    ok &= solar->update_basic_bat_design_capacity_setting();
+    ok &= solar->update_basic_bat_discharge_cutoff_voltage_setting();
+    ok &= solar->update_basic_bat_temp_protection_setting();
+    solar->dataflash_relock();
+    return ok;
+}
+
+static bool packAdvance(uint8_t n, MeshSolar *solar, void *ctx) {
+    (void)n; (void)ctx;
+    if (!solar->dataflash_unlock()) {
+        return false;                               // SEALED, nothing written
+    }
+    bool ok = solar->update_advance_bat_battery_setting() && solar->update_advance_bat_cedv_setting();
+    solar->dataflash_relock();
+    return ok;
+}
+
+static void handleCommand(const String &line) {
+    int             pack    = 0;
+    String          json;
+    bool            ok      = false;
+    meshsolar_cmd_t command = packs.parse_command(line.c_str(), &pack);
+
+    if (command == MESHSOLAR_CMD_PACKS) {
+        packs_status_t combined;
+        packs.status(&combined);
+        meshsolar_packs_to_json(&combined, json);
+        sendResponse(json);
+        ok = (combined.online == combined.packs);
+    }
+    else if (command == MESHSOLAR_CMD_STATUS) {
+        ok = packs.for_each(pack, packStatus, nullptr);
+    }
+    else if (command == MESHSOLAR_CMD_SWITCH) {
+        ok = packs.for_each(pack, packSwitch, nullptr);
+    }
+    else if (command == MESHSOLAR_CMD_RESET) {
+        ok = packs.for_each(pack, packReset, nullptr);
+    }
+    else if (command == MESHSOLAR_CMD_ALARM) {
+        ok = packs.for_each(pack, packAlarm, nullptr);
+    }
+    else if (command == MESHSOLAR_CMD_CONFIG) {
+        ok = packs.for_each(pack, packConfig, nullptr);
+    }
+    else if (command == MESHSOLAR_CMD_ADVANCE) {
+        ok = packs.for_each(pack, packAdvance, nullptr);
+    }
+    else if (command != MESHSOLAR_CMD_INVALID) {
+        LOG_W("Command not supported with several packs: %s", line.c_str());
+    }
+    meshsolar_cmd_rsp_to_json(ok, json);
+    sendResponse(json);
+}
+
+void setup() {
+    comSerial.begin(115200);
+    for (const pack_pins_t &p : packPins) {
+        packs.add(g_ADigitalPinMap[p.sda], g_ADigitalPinMap[p.scl], sysclk::millis());
+    }
+    for (uint8_t n = 1; n <= packs.size(); n++) {
+        packs.pack(n)->update_alarm_setting();  // Gauge-side alarms, so idle polls read one status word
+    }
+    LOG_I("MeshSolar multi-pack: %u packs", (unsigned)packs.size());
+}
+
+void loop() {
+    static String line = "";
+    if (listenString(line)) {
+        handleCommand(line);
+        line = "";
+    }
+
+    bool    full = false;
+    uint8_t n    = packs.poll(sysclk::millis(), &full);  // At most one pack per pass
+    if (n != 0 && full && packs.pack(n)->events.unpushed() > 0) {
+        MeshSolar *solar = packs.pack(n);
+        uint32_t   seq   = solar->events.push_from();
+        String     json;
+        while (meshsolar_events_to_json(&solar->events, &seq, sysclk::millis(), json, n) > 0) {
+            sendResponse(json);             // Protection edges of this pack
+            solar->events.pushed_to(seq);
+        }
+    }
+    if (n == 0 && comSerial.available() == 0) {
+        uint32_t wait = packs.next_due(sysclk::millis());
+        sysclk::delay((wait < 10) ? wait : 10);     // Stay responsive to commands
+    }
+}
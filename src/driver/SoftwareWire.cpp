@@ -60,6 +60,7 @@
 // #define ENABLE_I2C_SCANNER
 
 #include "SoftwareWire.h"
+#include "../utils/sysclock.h"
 
 // Set SDA low and drive output (for nRF52840/Arduino)
 #define i2c_sda_lo()              \
@@ -190,7 +191,7 @@ void SoftwareWire::begin(void)
   // When a I2C transmission would start immediate, it could fail when only the internal pullup resistors
   // are used, and the signals were just now turned high with i2c_init().
   if( _pullups)
-    delay(2);           // 1ms didn't always work.
+    sysclk::delay(2);           // 1ms didn't always work.
 }
 
 //
@@ -625,7 +626,7 @@ void SoftwareWire::i2c_writebit(uint8_t c)
   }
 
   if (_i2cdelay != 0)               // This delay is not needed, but it makes it safer
-    delayMicroseconds(_i2cdelay);   // This delay is not needed, but it makes it safer
+    sysclk::delay_us(_i2cdelay);   // This delay is not needed, but it makes it safer
 
   i2c_scl_hi();                     // clock high: the Slave will read the sda signal
 
@@ -634,23 +635,36 @@ void SoftwareWire::i2c_writebit(uint8_t c)
   {
     // If the Slave was stretching the clock pulse, the clock would not go high immediately.
     // For example if the Slave is an Arduino, that has other interrupts running (for example Serial data).
-    unsigned long prevMillis = millis();
-    while( i2c_scl_read() == 0)
-    {
-      if( millis() - prevMillis >= _timeout)
-        break;
-    };
+    i2c_wait_scl_high();
   }
 
   // After the clock stretching, the clock must be high for the normal duration.
   // That is why this delay has still to be done.
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   i2c_scl_lo();
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
+}
+
+
+//
+// Wait while the Slave stretches the clock, at most _timeout ms.
+// The wait polls SCL every SOFTWAREWIRE_STRETCH_POLL_US through sysclk, so it
+// also times out on a VirtualClock that nothing else advances (host runs with
+// a stuck or unconnected SCL would otherwise spin here forever).
+//
+void SoftwareWire::i2c_wait_scl_high(void)
+{
+  unsigned long prevMillis = sysclk::millis();
+  while( i2c_scl_read() == 0)
+  {
+    if( sysclk::millis() - prevMillis >= _timeout)
+      break;
+    sysclk::delay_us(SOFTWAREWIRE_STRETCH_POLL_US);
+  };
 }
 
 
@@ -664,24 +678,19 @@ uint8_t SoftwareWire::i2c_readbit(void)
   if( _stretch)
   {
     // Wait until the clock is high, the Slave could keep it low for clock stretching.
-    unsigned long prevMillis = millis();
-    while( i2c_scl_read() == 0)
-    {
-      if( millis() - prevMillis >= _timeout)
-        break;
-    };
+    i2c_wait_scl_high();
   }
 
   // After the clock stretching, this delay has still be done before reading sda.
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   uint8_t c = i2c_sda_read();
 
   i2c_scl_lo();
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   return(c);
 }
@@ -706,14 +715,14 @@ void SoftwareWire::i2c_init(void)
   i2c_scl_hi();
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   i2c_sda_hi();
 
   for( uint8_t i=0; i<4; i++)             // 4 times the normal delay, to claim the bus.
   {
     if (_i2cdelay != 0)
-      delayMicroseconds(_i2cdelay);
+      sysclk::delay_us(_i2cdelay);
   }
 }
 
@@ -736,7 +745,7 @@ boolean SoftwareWire::i2c_start(void)
   i2c_scl_hi();              // can perhaps be removed some day ? if the rest of the code is okay
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   // Both the sda and scl should be high.
   // If not, there might be a hardware problem with the i2c bus signal lines.
@@ -753,12 +762,12 @@ boolean SoftwareWire::i2c_start(void)
     i2c_sda_lo();
 
     if (_i2cdelay != 0)
-      delayMicroseconds(_i2cdelay);
+      sysclk::delay_us(_i2cdelay);
 
     i2c_scl_lo();
 
     if (_i2cdelay != 0)
-      delayMicroseconds(_i2cdelay);
+      sysclk::delay_us(_i2cdelay);
   }
   return(true);
 }
@@ -777,12 +786,12 @@ void SoftwareWire::i2c_repstart(void)
   i2c_scl_lo();                         // force SCL low
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   i2c_sda_hi();                        // release SDA
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   i2c_scl_hi();                        // release SCL
 
@@ -791,16 +800,11 @@ void SoftwareWire::i2c_repstart(void)
   {
     // If the Slave was stretching the clock pulse, the clock would not go high immediately.
     // For example if the Slave is an Arduino, that has other interrupts running (for example Serial data).
-    unsigned long prevMillis = millis();
-    while( i2c_scl_read() == 0)
-    {
-      if( millis() - prevMillis >= _timeout)
-        break;
-    };
+    i2c_wait_scl_high();
   }
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 }
 
 
@@ -816,7 +820,7 @@ void SoftwareWire::i2c_stop(void)
 
   // ADDED1, wait to be sure that the slave knows that both are low
   if (_i2cdelay != 0)              // ADDED1
-    delayMicroseconds(_i2cdelay);  // ADDED1
+    sysclk::delay_us(_i2cdelay);  // ADDED1
 
   // For a stop, make SCL high wile SDA is still low
   i2c_scl_hi();
@@ -827,16 +831,11 @@ void SoftwareWire::i2c_stop(void)
     // Wait until the clock is high, the Slave could keep it low for clock stretching.
     // Clock pulse stretching during a stop condition seems odd, but when
     // the Slave is an Arduino, it might happen.
-    unsigned long prevMillis = millis();
-    while( i2c_scl_read() == 0)
-    {
-      if( millis() - prevMillis >= _timeout)
-        break;
-    };
+    i2c_wait_scl_high();
   }
 
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   // complete the STOP by setting SDA high
   i2c_sda_hi();
@@ -844,7 +843,7 @@ void SoftwareWire::i2c_stop(void)
   // A delay after the STOP for safety.
   // It is not known how fast the next START will happen.
   if (_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 }
 
 
@@ -887,7 +886,7 @@ uint8_t SoftwareWire::i2c_read(boolean ack)
   }
 
   if(_i2cdelay != 0)
-    delayMicroseconds(_i2cdelay);
+    sysclk::delay_us(_i2cdelay);
 
   return(res);
 }
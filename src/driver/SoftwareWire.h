@@ -13,6 +13,7 @@
 #define SOFTWAREWIRE_OTHER          4
 
 #define SOFTWAREWIRE_BUFSIZE        64        // same as buffer size of Arduino Wire library
+#define SOFTWAREWIRE_STRETCH_POLL_US 10       // SCL poll interval while the Slave stretches the clock, one 100 kHz bit
 
 
 class SoftwareWire
@@ -76,6 +77,7 @@ private:
 
   void i2c_writebit( uint8_t c );
   uint8_t i2c_readbit(void);
+  void i2c_wait_scl_high(void);
   void i2c_init(void);
   boolean i2c_start(void);
   void i2c_repstart(void);
@@ -1,6 +1,35 @@
 
 #include "bq4050.h"
 #include "../utils/logger.h"
+#include "../utils/sysclock.h"
+
+#define BQ4050_DF_ENTRY(NAME, ADDR, KIND, TYPE, LEN, MIN, MAX, UNIT) df::NAME::reg(),
+
+constexpr df_reg_t bq4050_df_regs[] = {
+    BQ4050_DF_PARAMS(BQ4050_DF_ENTRY)
+};
+const size_t bq4050_df_reg_count = sizeof(bq4050_df_regs) / sizeof(bq4050_df_regs[0]);
+
+// True if parameter i overlaps none of the parameters after it, then the same for i + 1
+static constexpr bool df_no_overlap(size_t i, size_t j) {
+    return (j >= sizeof(bq4050_df_regs) / sizeof(bq4050_df_regs[0])) ||
+           (((bq4050_df_regs[i].addr + bq4050_df_regs[i].len <= bq4050_df_regs[j].addr) ||
+             (bq4050_df_regs[j].addr + bq4050_df_regs[j].len <= bq4050_df_regs[i].addr)) &&
+            df_no_overlap(i, j + 1));
+}
+static constexpr bool df_map_valid(size_t i) {
+    return (i >= sizeof(bq4050_df_regs) / sizeof(bq4050_df_regs[0])) ||
+           (df_no_overlap(i, i + 1) && df_map_valid(i + 1));
+}
+static_assert(df_map_valid(0), "two DataFlash parameters of bq4050_df.h share bytes");
+
+bool bq4050_df_check(const df_reg_t &reg, int32_t value) {
+    if (value < reg.min || value > reg.max) {
+        LOG_E("DataFlash %s = %ld %s, outside %ld..%ld", reg.name, (long)value, reg.unit, (long)reg.min, (long)reg.max);
+        return false;
+    }
+    return true;
+}
 
 
 void BQ4050::crc8_tab_init(){
@@ -155,7 +184,11 @@ bool BQ4050::_rd_mac_block(bq4050_block_t *block){
 
 bool BQ4050::_rd_df_block(bq4050_block_t *block) {
     uint8_t reqLen = (block->type == STRING) ? block->len + 4 : block->len + 3; 
-    static uint8_t buf[32];
+    static uint8_t buf[DF_BLOCK_MAX + 4];   // Length, address, up to a full block of data
+    if (block->len > DF_BLOCK_MAX) {
+        LOG_E("DataFlash read of %d bytes, at most %d", block->len, DF_BLOCK_MAX);
+        return false;
+    }
     memset(buf, 0, sizeof(buf)); // Clear the buffer to avoid garbage data
 
     this->wire->beginTransmission(this->devAddr);
@@ -201,6 +234,10 @@ bool BQ4050::write_dataflash_block(bq4050_block_t block) {
     // Prepare the command to write to the device
     // According to manual: block = starting address + DF data block
     // Total bytes = 2 bytes for starting address + arrLen bytes for data
+    if (block.len > DF_BLOCK_MAX) {
+        LOG_E("DataFlash write of %d bytes, at most %d", block.len, DF_BLOCK_MAX);
+        return false;
+    }
     uint8_t totalBytes = 2 + block.len;
     
     this->wire->beginTransmission(this->devAddr);
@@ -251,9 +288,67 @@ bool BQ4050::read_dataflash_block(bq4050_block_t *block) {
     return true; // Return true if data was read successfully and PEC matches
 }
 
+/**
+ * @brief Read a numeric DataFlash parameter described by reg
+ *
+ * @param value Receives the value, sign extended for DF_I2
+ * @return bool False for a string parameter or on a bus or PEC error
+ */
+bool BQ4050::df_read_value(const df_reg_t &reg, int32_t *value) {
+    if (reg.kind == DF_S) {
+        return false;
+    }
+    bq4050_block_t block = {reg.addr, reg.len, nullptr, NUMBER};
+    if (!this->read_dataflash_block(&block)) {
+        return false;
+    }
+    uint16_t raw = block.pvalue[0];
+    if (reg.len == 2) {
+        raw |= (uint16_t)(block.pvalue[1] << 8);
+    }
+    *value = (reg.kind == DF_I2) ? (int32_t)(int16_t)raw : (int32_t)raw;
+    return true;
+}
+
+/**
+ * @brief Write a numeric DataFlash parameter described by reg
+ *
+ * The value is checked against the range of reg first; an out of range value
+ * is rejected without any bus traffic.
+ *
+ * TIMING:
+ * - The gauge needs about 100 ms before the next DataFlash access, left to the caller
+ */
+bool BQ4050::df_write_value(const df_reg_t &reg, int32_t value) {
+    if (reg.kind == DF_S || !bq4050_df_check(reg, value)) {
+        return false;
+    }
+    uint8_t        data[2] = {(uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF)};
+    bq4050_block_t block   = {reg.addr, reg.len, data, NUMBER};
+    return this->write_dataflash_block(block);
+}
+
+/**
+ * @brief Read a string DataFlash parameter described by reg
+ *
+ * @param str  Receives the string, always terminated
+ * @param size Size of str
+ */
+bool BQ4050::df_read_string(const df_reg_t &reg, char *str, size_t size) {
+    bq4050_block_t block = {reg.addr, reg.len, nullptr, STRING};
+    if (reg.kind != DF_S || size == 0 || !this->read_dataflash_block(&block)) {
+        return false;
+    }
+    size_t n = strnlen((const char *)block.pvalue, reg.len - 1);
+    n = (n < size - 1) ? n : size - 1;
+    memcpy(str, block.pvalue, n);
+    str[n] = '\0';
+    return true;
+}
+
 bool BQ4050::fet_toggle(){
     if(this->_wd_mac_cmd(MAC_CMD_FET_CONTROL)) {
-        delay(100);  // Wait for the device to process the command
+        sysclk::delay(100);  // Wait for the device to process the command
         return true; // Return true if command was sent successfully
     }
     return false;    // Return false if there was an error sending the command
@@ -261,8 +356,33 @@ bool BQ4050::fet_toggle(){
 
 bool BQ4050::reset(){
     if(this->_wd_mac_cmd(MAC_CMD_DEV_RESET)) {
-        delay(100);  // Wait for the device to reset
+        sysclk::delay(100);  // Wait for the device to reset
         return true; // Return true if reset command was sent successfully
     }
     return false; // Return false if there was an error sending the reset command
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Send the unseal key, SEALED -> UNSEALED
+ *
+ * The two words go to ManufacturerAccess() back to back, low word first:
+ * key 0x36720414 (TI default) sends 0x0414, then 0x3672. A wrong key is
+ * ignored by the gauge, read OperationStatus SEC1:SEC0 to see the result.
+ */
+bool BQ4050::unseal(uint32_t key){
+    bq4050_reg_t first  = {BQ4050_REG_MANUFACTURER_ACCESS, (uint16_t)(key & 0xFFFF)};
+    bq4050_reg_t second = {BQ4050_REG_MANUFACTURER_ACCESS, (uint16_t)(key >> 16)};
+    if (this->write_reg_word(first) && this->write_reg_word(second)) {
+        sysclk::delay(10);  // Let the gauge change mode before OperationStatus is read
+        return true;
+    }
+    return false;
+}
+
+bool BQ4050::seal(){
+    if(this->_wd_mac_cmd(MAC_CMD_SEAL_DEVICE)) {
+        sysclk::delay(10);  // Let the gauge change mode before OperationStatus is read
+        return true;
+    }
+    return false;
+}
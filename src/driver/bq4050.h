@@ -1,11 +1,14 @@
 #ifndef BQ4050_H
 #define BQ4050_H
 #include "SoftwareWire.h"
+#include "bq4050_df.h"
 
 #define BQ4050ADDR          0x0B
 
 #define BLOCK_ACCESS_CMD            (0x44)
 
+#define BQ4050_REG_MANUFACTURER_ACCESS 0x00 // ManufacturerAccess, takes the unseal key words
+
 #define BQ4050_REG_CAPACITY_ALARM   0x01 // Remaining Capacity Alarm
 #define BQ4050_REG_TIME_ALARM       0x02 // Remaining Time Alarm
 #define BQ4050_REG_BAT_MODE         0x03 // Battery Mode
@@ -20,6 +23,11 @@
 #define BQ4050_REG_ATTE             0x12 // Average Time To Empty
 #define BQ4050_REG_ATTF             0x13 // Average Time To Full
 #define BQ4050_REG_RMC              0x0F // Remaining Capacity
+#define BQ4050_REG_BATTERY_STATUS   0x16 // Battery Status, alarm and state flags
+#define BQ4050_REG_CELL_VOLTAGE4    0x3C // Cell Voltage 4 (mV)
+#define BQ4050_REG_CELL_VOLTAGE3    0x3D
+#define BQ4050_REG_CELL_VOLTAGE2    0x3E
+#define BQ4050_REG_CELL_VOLTAGE1    0x3F
 
 #define BQ4050_CELL4_VOLTAGE        0x3C // Cell 4 Voltage
 #define BQ4050_CELL3_VOLTAGE        0x3D // Cell 3 Voltage
@@ -37,85 +45,38 @@
 #define MAC_CMD_FW_VER              0x0002
 #define MAC_CMD_HW_VER              0x0003
 #define MAC_CMD_FET_CONTROL         0x0022
+#define MAC_CMD_SEAL_DEVICE         0x0030
 #define MAC_CMD_DEV_RESET           0x0041
 #define MAC_CMD_SECURITY_KEYS       0x0035
 #define MAC_CMD_SAFETY_STATUS       0x0051
 #define MAC_CMD_OPERATION_STATUS    0x0054
 #define MAC_CMD_MANUFACTURER_STATUS 0x0057
+#define MFG_STATUS_FET_EN           0x0010  // ManufacturerStatus FET_EN, toggled by MAC_CMD_FET_CONTROL
 #define MAC_CMD_DA_STATUS1          0x0071
 #define MAC_CMD_DA_STATUS2          0x0072
 
-#define DF_CMD_DEVICE_NAME          0x4085
-#define DF_CMD_MANUFACTURER_NAME    0x4070
-#define DF_CMD_DA_CONFIGURATION     0x457b
-#define DF_CMD_LEARNED_CAPACITY     0x4100
-#define DF_CMD_SBS_DATA_CHEMISTRY   0x409a
-
-
-#define DF_CMD_GAS_GAUGE_FD_SET_VOLTAGE_THR   0x4458
-#define DF_CMD_GAS_GAUGE_FD_CLEAR_VOLTAGE_THR 0x445a
-
-#define DF_CMD_GAS_GAUGE_TD_SET_VOLTAGE_THR   0x4464
-#define DF_CMD_GAS_GAUGE_TD_CLEAR_VOLTAGE_THR 0x4466
-
-#define DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0  0x459d
-#define DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV1  0x45a0
-#define DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV2  0x45a3
-
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_0    0x45a6 // CEDV Profile 1 Voltage 0
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_10   0x45a8 // CEDV Profile 1 Voltage 10
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_20   0x45aa // CEDV Profile 1 Voltage 20
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_30   0x45ac // CEDV Profile 1 Voltage 30
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_40   0x45ae // CEDV Profile 1 Voltage 40
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_50   0x45b0 // CEDV Profile 1 Voltage 50
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_60   0x45b2 // CEDV Profile 1 Voltage 60
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_70   0x45b4 // CEDV Profile 1 Voltage 70
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_80   0x45b6 // CEDV Profile 1 Voltage 80
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_90   0x45b8 // CEDV Profile 1 Voltage 90
-#define DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_100  0x45ba // CEDV Profile 1 Voltage 100
-
-
-#define DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH  0x444d        // Design Capacity in mAh
-#define DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_CWH  0x444f        // Design Capacity in CWh
-#define DF_CMD_GAS_GAUGE_DESIGN_VOLTAGE_MV    0x4451        // Design Capacity in CWh per cell
-#define DF_CMD_GAS_GAUGE_STATE_LEARNED_FULL_CAPACITY 0x4100 // State Learned Full Capacity
-
-#define DF_CMD_PROTECTIONS_CUV_THR            0x4481
-#define DF_CMD_PROTECTIONS_CUV_RECOVERY       0x4484
-
-#define DF_CMD_PROTECTIONS_COV_THR            0x4481
-#define DF_CMD_PROTECTIONS_COV_RECOVERY       0x4484
-
-#define DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR   0x4486
-#define DF_CMD_PROTECTIONS_COV_STD_TEMP_THR   0x4488
-#define DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR  0x448a
-#define DF_CMD_PROTECTIONS_COV_REC_TEMP_THR   0x448c
-
-#define DF_CMD_PROTECTIONS_COV_LOW_TEMP_RECOVERY  0x448f // recovery low temperature threshold
-#define DF_CMD_PROTECTIONS_COV_STD_TEMP_RECOVERY  0x4491 // recovery standard temperature threshold
-#define DF_CMD_PROTECTIONS_COV_HIGH_TEMP_RECOVERY 0x4493 // recovery high temperature threshold
-#define DF_CMD_PROTECTIONS_COV_REC_TEMP_RECOVERY  0x4495 // recovery temperature threshold
-
-#define DF_CMD_PROTECTIONS_OTD_THR                     0x44ba //discharge over temperature threshold
-#define DF_CMD_PROTECTIONS_OTD_RECOVERY                0x44bd //discharge over temperature recovery
-#define DF_CMD_PROTECTIONS_OTC_THR                     0x44b5// charge over temperature threshold
-#define DF_CMD_PROTECTIONS_OTC_RECOVERY                0x44b8// charge over temperature recovery
+// DataFlash parameters are described in bq4050_df.h
 
-#define DF_CMD_PROTECTIONS_UTD_THR                     0x44c9 //discharge over temperature threshold
-#define DF_CMD_PROTECTIONS_UTD_RECOVERY                0x44cc //discharge over temperature recovery
-#define DF_CMD_PROTECTIONS_UTC_THR                     0x44c4 // charge over temperature threshold
-#define DF_CMD_PROTECTIONS_UTC_RECOVERY                0x44c7 // charge over temperature recovery
-
-#define DF_CMD_SETTINGS_PROTECTIONS_ENABLE_A           0x447d // Enable/Disable protections A
-#define DF_CMD_SETTINGS_PROTECTIONS_ENABLE_B           0x447e // Enable/Disable protections B
-#define DF_CMD_SETTINGS_PROTECTIONS_ENABLE_C           0x447f // Enable/Disable protections C
-#define DF_CMD_SETTINGS_PROTECTIONS_ENABLE_D           0x4480 // Enable/Disable protections D
-
-
-#define DF_CMD_ADVANCED_CHARGE_ALG_LOW_TEMP_CHARG_VOL         0x453c
-#define DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL         0x4544
-#define DF_CMD_ADVANCED_CHARGE_ALG_HIGH_TEMP_CHARG_VOL        0x454c
-#define DF_CMD_ADVANCED_CHARGE_ALG_REC_TEMP_CHARG_VOL         0x4554
+typedef struct {
+    union {
+        uint16_t bytes;                    // 16-bit raw data
+        struct {
+            uint16_t ec     : 4;           // bit 0-3: Error code of the last SMBus command
+            uint16_t fd     : 1;           // bit 4:  Fully Discharged
+            uint16_t fc     : 1;           // bit 5:  Fully Charged
+            uint16_t dsg    : 1;           // bit 6:  Discharging or relaxing (0 = charging)
+            uint16_t init   : 1;           // bit 7:  Initialization complete
+            uint16_t rta    : 1;           // bit 8:  Remaining Time Alarm
+            uint16_t rca    : 1;           // bit 9:  Remaining Capacity Alarm
+            uint16_t        : 1;           // bit 10: Reserved
+            uint16_t tda    : 1;           // bit 11: Terminate Discharge Alarm
+            uint16_t ota    : 1;           // bit 12: Overtemperature Alarm
+            uint16_t        : 1;           // bit 13: Reserved
+            uint16_t tca    : 1;           // bit 14: Terminate Charge Alarm
+            uint16_t oca    : 1;           // bit 15: Overcharged Alarm
+        } bits;
+    };
+} BatteryStatus_t;
 
 typedef struct {
     union {
@@ -286,6 +247,32 @@ public:
     bool read_dataflash_block (bq4050_block_t *block);
     bool fet_toggle();
     bool reset();
+    bool unseal(uint32_t key);
+    bool seal();
+
+    // DataFlash parameters of bq4050_df.h, values range checked before writing
+    bool df_read_value(const df_reg_t &reg, int32_t *value);
+    bool df_write_value(const df_reg_t &reg, int32_t value);
+    bool df_read_string(const df_reg_t &reg, char *str, size_t size);
+
+    // Typed forms, P is a df:: descriptor: df_read<df::cuv_threshold>(&mv)
+    template <class P, class T> bool df_read(T *value) {
+        static_assert(P::kind != DF_S, "df_read_string() reads strings");
+        int32_t raw;
+        if (!this->df_read_value(P::reg(), &raw)) {
+            return false;
+        }
+        *value = (T)raw;
+        return true;
+    }
+    template <class P> bool df_write(int32_t value) {
+        static_assert(P::kind != DF_S, "strings are written through a DataFlash plan");
+        return this->df_write_value(P::reg(), value);
+    }
+    template <class P> bool df_read_string(char *str, size_t size) {
+        static_assert(P::kind == DF_S, "df_read() reads numbers");
+        return this->df_read_string(P::reg(), str, size);
+    }
 };
 
 
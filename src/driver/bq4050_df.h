@@ -0,0 +1,139 @@
+/**
+ * @file bq4050_df.h
+ * @brief Typed map of the BQ4050 DataFlash parameters MeshSolar reads and writes.
+ *
+ * Each parameter is described once in BQ4050_DF_PARAMS: address, storage
+ * kind, C type, length on the bus, accepted range and unit. The list expands
+ * into:
+ *
+ *   df::<name>        a descriptor type for the typed accessors,
+ *                     BQ4050::df_read<df::cuv_threshold>(&mv),
+ *                     BQ4050::df_write<df::cuv_threshold>(mv)
+ *   bq4050_df_regs[]  the same descriptors as a table, for code that walks
+ *                     every parameter with BQ4050::df_read_value()
+ *
+ * Values are checked against the range before any bus traffic, and the
+ * little endian packing is done by the accessor, so callers never build a
+ * bq4050_block_t for DataFlash. Ranges are the ones the BQ4050 TRM gives, or
+ * tighter where MeshSolar never needs more (cell voltages up to 5000 mV).
+ *
+ * PORTING NOTES:
+ * - Addresses are from the BQ4050 TRM (SLUUAQ3); bq4050.cpp checks at compile
+ *   time that no two parameters overlap
+ * - DA Configuration is a 2-byte register, only its low byte (cell count and
+ *   cell balancing bits) is mapped
+ */
+
+#ifndef BQ4050_DF_H
+#define BQ4050_DF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    DF_U1 = 0,                              // uint8_t
+    DF_U2,                                  // uint16_t, little endian
+    DF_I2,                                  // int16_t, little endian
+    DF_S,                                   // Length-prefixed string, len counts the length byte
+} df_kind_t;
+
+typedef struct {
+    uint16_t    addr;                       // DataFlash address
+    uint8_t     kind;                       // df_kind_t
+    uint8_t     len;                        // Bytes on the bus
+    int32_t     min;                        // Accepted range, characters for DF_S
+    int32_t     max;
+    const char *unit;
+    const char *name;
+} df_reg_t;
+
+#define DF_BASE             0x4000          // DataFlash region, as seen through ManufacturerBlockAccess
+#define DF_SIZE             0x2000
+#define DF_BLOCK_MAX        32              // Data bytes of one DataFlash block read or write
+
+#define DF_CELL_MV_MAX      5000            // Highest per cell voltage accepted
+#define DF_I2_MAX           32767
+#define DF_TEMP_MIN         (-400)          // 0.1°C
+#define DF_TEMP_MAX         1500
+
+/*
+ * X(name, address, kind, C type, length, min, max, unit)
+ */
+#define BQ4050_DF_PARAMS(X)                                                                                  \
+    /* SBS Configuration */                                                                                  \
+    X(manufacturer_name,       0x4070, DF_S,  char,     21, 0,           20,             "")                 \
+    X(device_name,             0x4085, DF_S,  char,     21, 0,           20,             "")                 \
+    X(device_chemistry,        0x409a, DF_S,  char,     5,  0,           4,              "")                 \
+    /* Gas Gauging */                                                                                        \
+    X(learned_full_capacity,   0x4100, DF_U2, uint16_t, 2,  0,           DF_I2_MAX,      "mAh")              \
+    X(design_capacity_mah,     0x444d, DF_U2, uint16_t, 2,  0,           DF_I2_MAX,      "mAh")              \
+    X(design_capacity_cwh,     0x444f, DF_U2, uint16_t, 2,  0,           DF_I2_MAX,      "cWh")              \
+    X(design_voltage,          0x4451, DF_U2, uint16_t, 2,  0,           DF_I2_MAX,      "mV")               \
+    X(fd_set_voltage,          0x4458, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(fd_clear_voltage,        0x445a, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(td_set_voltage,          0x4464, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(td_clear_voltage,        0x4466, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    /* Settings */                                                                                           \
+    X(protection_enable_a,     0x447d, DF_U1, uint8_t,  1,  0,           0xFF,           "")                 \
+    X(protection_enable_b,     0x447e, DF_U1, uint8_t,  1,  0,           0xFF,           "")                 \
+    X(protection_enable_c,     0x447f, DF_U1, uint8_t,  1,  0,           0xFF,           "")                 \
+    X(protection_enable_d,     0x4480, DF_U1, uint8_t,  1,  0,           0xFF,           "")                 \
+    X(da_configuration,        0x457b, DF_U1, uint8_t,  1,  0,           0xFF,           "")                 \
+    /* Protections */                                                                                        \
+    X(cuv_threshold,           0x4481, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cuv_recovery,            0x4484, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_threshold_low,       0x4486, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_threshold_std,       0x4488, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_threshold_high,      0x448a, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_threshold_rec,       0x448c, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_recovery_low,        0x448f, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_recovery_std,        0x4491, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_recovery_high,       0x4493, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cov_recovery_rec,        0x4495, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(otc_threshold,           0x44b5, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(otc_recovery,            0x44b8, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(otd_threshold,           0x44ba, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(otd_recovery,            0x44bd, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(utc_threshold,           0x44c4, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(utc_recovery,            0x44c7, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(utd_threshold,           0x44c9, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    X(utd_recovery,            0x44cc, DF_I2, int16_t,  2,  DF_TEMP_MIN, DF_TEMP_MAX,    "0.1degC")          \
+    /* Advanced Charge Algorithm */                                                                          \
+    X(charge_voltage_low,      0x453c, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(charge_voltage_std,      0x4544, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(charge_voltage_high,     0x454c, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(charge_voltage_rec,      0x4554, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    /* CEDV */                                                                                               \
+    X(edv0,                    0x459d, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(edv1,                    0x45a0, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(edv2,                    0x45a3, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_0,          0x45a6, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_10,         0x45a8, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_20,         0x45aa, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_30,         0x45ac, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_40,         0x45ae, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_50,         0x45b0, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_60,         0x45b2, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_70,         0x45b4, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_80,         0x45b6, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_90,         0x45b8, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")               \
+    X(cedv_voltage_100,        0x45ba, DF_U2, uint16_t, 2,  0,           DF_CELL_MV_MAX, "mV")
+
+#define BQ4050_DF_DESCRIPTOR(NAME, ADDR, KIND, TYPE, LEN, MIN, MAX, UNIT)                \
+    struct NAME {                                                                         \
+        typedef TYPE type;                                                                \
+        static constexpr uint8_t kind = KIND;                                             \
+        static constexpr df_reg_t reg() { return {ADDR, KIND, LEN, MIN, MAX, UNIT, #NAME}; } \
+    };
+
+namespace df {
+BQ4050_DF_PARAMS(BQ4050_DF_DESCRIPTOR)
+}
+
+extern const df_reg_t bq4050_df_regs[];
+extern const size_t   bq4050_df_reg_count;
+
+// Range check of a value about to be written, logs the rejected value
+bool bq4050_df_check(const df_reg_t &reg, int32_t value);
+
+#endif // BQ4050_DF_H
@@ -1,6 +1,63 @@
 #include "bq4050.h"
 #include "meshsolar.h"
 #include "../utils/logger.h"
+#include "../utils/sysclock.h"
+
+// SafetyStatus bit names by bit number, nullptr = reserved
+static const char *const safety_bit_names[32] = {
+    "CUV",      // bit 0:  Cell Under Voltage
+    "COV",      // bit 1:  Cell Over Voltage
+    "OCC1",     // bit 2:  Overcurrent During Charge 1
+    "OCC2",     // bit 3:  Overcurrent During Charge 2
+    "OCD1",     // bit 4:  Overcurrent During Discharge 1
+    "OCD2",     // bit 5:  Overcurrent During Discharge 2
+    "AOLD",     // bit 6:  Overload During Discharge
+    "AOLDL",    // bit 7:  Overload During Discharge Latch
+    "ASCC",     // bit 8:  Short-circuit During Charge
+    "ASCL",     // bit 9:  Short-circuit During Charge Latch
+    "ASCD",     // bit 10: Short-circuit During Discharge
+    "ASCDL",    // bit 11: Short-circuit During Discharge Latch
+    "OTC",      // bit 12: Overtemperature During Charge
+    "OTD",      // bit 13: Overtemperature During Discharge
+    "CUVC",     // bit 14: Cell Undervoltage Compensated
+    nullptr,
+    "OTF",      // bit 16: Overtemperature FET
+    nullptr,
+    "PTO",      // bit 18: Precharge Timeout
+    nullptr,
+    "CTO",      // bit 20: Charge Timeout
+    nullptr,
+    "OC",       // bit 22: Overcharge
+    "CHGC",     // bit 23: Overcharging Current
+    "CHGV",     // bit 24: Overcharging Voltage
+    "PCHGC",    // bit 25: Over-Precharge Current
+    "UTC",      // bit 26: Undertemperature During Charge
+    "UTD",      // bit 27: Undertemperature During Discharge
+    nullptr, nullptr, nullptr, nullptr,
+};
+
+// OperationStatus bit names by bit number, only the bits of EVENT_OPERATION_MASK are named
+static const char *const operation_bit_names[32] = {
+    nullptr,
+    "DSG",      // bit 1:  DSG FET on
+    "CHG",      // bit 2:  CHG FET on
+    "PCHG",     // bit 3:  Precharge FET on
+    nullptr,
+    "FUSE",     // bit 5:  Fuse blown
+    nullptr, nullptr,
+    "SEC0",     // bit 8:  SECURITY mode bit 0
+    "SEC1",     // bit 9:  SECURITY mode bit 1
+    "SDV",      // bit 10: Shutdown by low pack voltage
+    "SS",       // bit 11: SAFETY mode
+    "PF",       // bit 12: PERMANENT FAILURE mode
+    "XDSG",     // bit 13: Discharging disabled
+    "XCHG",     // bit 14: Charging disabled
+    nullptr,
+    "SDM",      // bit 16: Shutdown by command
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+    "EMSHUT",   // bit 29: Emergency shutdown
+    nullptr, nullptr,
+};
 
 /**
  * @brief Parse BQ4050 SafetyStatus register and convert to human-readable string
@@ -27,52 +84,40 @@
  */
 String parseSafetyStatusBits(const SafetyStatus_t& safety_status) {
     String result = "";
-    bool first = true;
-    
-    // Helper lambda to add bit name to result if bit is set
-    auto addIfSet = [&](bool bit_value, const char* bit_name) {
-        if (bit_value) {
-            if (!first) {
+
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        if ((safety_status.bytes & (1UL << bit)) && safety_bit_names[bit] != nullptr) {
+            if (result.length() > 0) {
                 result += ",";
             }
-            result += bit_name;
-            first = false;
+            result += safety_bit_names[bit];
         }
-    };
-    
-    // Check all bits in SafetyStatus_t structure
-    // Bits 0-15 (Low word)
-    addIfSet(safety_status.bits.cuv,    "CUV");     // Cell Under Voltage
-    addIfSet(safety_status.bits.cov,    "COV");     // Cell Over Voltage
-    addIfSet(safety_status.bits.occ1,   "OCC1");    // Overcurrent During Charge 1
-    addIfSet(safety_status.bits.occ2,   "OCC2");    // Overcurrent During Charge 2
-    addIfSet(safety_status.bits.ocd1,   "OCD1");    // Overcurrent During Discharge 1
-    addIfSet(safety_status.bits.ocd2,   "OCD2");    // Overcurrent During Discharge 2
-    addIfSet(safety_status.bits.aold,   "AOLD");    // Overload During Discharge
-    addIfSet(safety_status.bits.aoldl,  "AOLDL");   // Overload During Discharge Latch
-    addIfSet(safety_status.bits.ascc,   "ASCC");    // Short-circuit During Charge
-    addIfSet(safety_status.bits.ascl,   "ASCL");    // Short-circuit During Charge Latch
-    addIfSet(safety_status.bits.ascd,   "ASCD");    // Short-circuit During Discharge
-    addIfSet(safety_status.bits.ascdl,  "ASCDL");   // Short-circuit During Discharge Latch
-    addIfSet(safety_status.bits.otc,    "OTC");     // Overtemperature During Charge
-    addIfSet(safety_status.bits.otd,    "OTD");     // Overtemperature During Discharge
-    addIfSet(safety_status.bits.cuvc,   "CUVC");    // Cell Undervoltage Compensated
-    
-    // Bits 16-31 (High word)
-    addIfSet(safety_status.bits.otf,    "OTF");     // Overtemperature FET
-    addIfSet(safety_status.bits.pto,    "PTO");     // Precharge Timeout
-    addIfSet(safety_status.bits.cto,    "CTO");     // Charge Timeout
-    addIfSet(safety_status.bits.oc,     "OC");      // Overcharge
-    addIfSet(safety_status.bits.chgc,   "CHGC");    // Overcharging Current
-    addIfSet(safety_status.bits.chgv,   "CHGV");    // Overcharging Voltage
-    addIfSet(safety_status.bits.pchgc,  "PCHGC");   // Over-Precharge Current
-    addIfSet(safety_status.bits.utc,    "UTC");     // Undertemperature During Charge
-    addIfSet(safety_status.bits.utd,    "UTD");     // Undertemperature During Discharge
-    
-    // Return "NONE" if no bits are set, otherwise return the comma-separated list
+    }
+
+    // Return "Normal" if no bits are set, otherwise return the comma-separated list
     return (result.length() == 0) ? "Normal" : result;
 }
 
+/**
+ * @brief Name of one SafetyStatus bit
+ *
+ * @param bit Bit number, 0 to 31
+ * @return const char* Short name as used by parseSafetyStatusBits(), nullptr for reserved bits
+ */
+const char *safetyStatusBitName(uint8_t bit) {
+    return (bit < 32) ? safety_bit_names[bit] : nullptr;
+}
+
+/**
+ * @brief Name of one OperationStatus bit tracked by the event journal
+ *
+ * @param bit Bit number, 0 to 31
+ * @return const char* Short name, nullptr for bits outside EVENT_OPERATION_MASK
+ */
+const char *operationStatusBitName(uint8_t bit) {
+    return (bit < 32) ? operation_bit_names[bit] : nullptr;
+}
+
 /**
  * @brief Default constructor for MeshSolar battery management system
  * 
@@ -105,12 +150,34 @@ String parseSafetyStatusBits(const SafetyStatus_t& safety_status) {
  */
 MeshSolar::MeshSolar(){
     this->_bq4050 = nullptr; // Initialize pointer to null
+    this->_cell_count = 0;   // Cell count is read lazily on the first status poll
+    this->_poll_policy.fast_interval_ms     = 1000;   // 1 s while something is happening
+    this->_poll_policy.normal_interval_ms   = 10000;  // 10 s while charging/discharging steadily
+    this->_poll_policy.idle_max_interval_ms = 60000;  // Back off to 1 min while idle, only BatteryStatus is read
+    this->_poll_policy.idle_current_ma      = 20;     // Below 20 mA the pack is idle
+    this->_poll_policy.current_step_ma      = 100;    // A 100 mA step between polls is a change
+    this->_poll_policy.low_soc              = 10;     // Poll fast at or below 10% SOC
+    this->_poll_policy.full_refresh_ms      = 300000; // Full snapshot at least every 5 min while steady
+    this->_poll_interval     = this->_poll_policy.fast_interval_ms;
+    this->_poll_last_current = 0;
+    this->_alarm.capacity_mah = 320;                  // 10% of the default design capacity
+    this->_alarm.time_min     = 10;                   // BQ4050 default
+    this->_full_ms            = 0;
+    this->_full_valid         = false;
+    this->_emshut_check       = false;
+    this->_security           = SECURITY_UNKNOWN; // Read with the first status snapshot or DataFlash access
+    this->_unseal_key         = 0;
+    this->_unsealed           = false;
+    this->_chemistry          = CHEMISTRY_COUNT;   // Unknown until read back or a config verifies
+    memset(&this->_plan, 0, sizeof(this->_plan)); // No DataFlash writes pending
+    this->_plan.chemistry     = CHEMISTRY_COUNT;
     memset(&this->sta, 0, sizeof(this->sta)); // Initialize status structure to zero
     memset(&this->cmd, 0, sizeof(this->cmd)); // Initialize command structure to zero
     this->cmd.basic.cell_number = 4; // Default to 4 cells
     this->cmd.basic.design_capacity = 3200; // Default design capacity in m
     this->cmd.basic.discharge_cutoff_voltage = 2800; // Default cutoff voltage in mV
     strlcpy(this->cmd.basic.type, "lifepo4", sizeof(this->cmd.basic.type)); // Default battery type
+    this->cmd.basic.chemistry = CHEMISTRY_LIFEPO4;
     this->cmd.basic.protection.charge_high_temp_c         = 60; // Default high temperature threshold
     this->cmd.basic.protection.charge_low_temp_c          = -10; // Default low temperature threshold
     this->cmd.basic.protection.discharge_high_temp_c      = 60; // Default discharge
@@ -195,40 +262,47 @@ void MeshSolar::begin(BQ4050 *device) {
  * @brief Read comprehensive real-time battery status from BQ4050
  * 
  * PLATFORM-INDEPENDENT STATUS READER
- * Performs a complete battery status update by reading all critical parameters
- * from the BQ4050 device. This function aggregates multiple I2C transactions
- * into a single comprehensive status update suitable for monitoring applications.
+ * Builds a time-coherent battery status snapshot from the smallest set of
+ * BQ4050 transactions. Each value is taken from the transaction that already
+ * carries it, so block reads replace separate SBS word reads wherever the
+ * data overlaps, and the blocks are read back-to-back without pacing delays.
  * 
  * @param None (updates internal sta structure)
  * @return bool True if all readings successful, false if any I2C operation failed
  * 
- * PARAMETERS READ:
- *   - Charge/discharge current (mA)
- *   - State of charge percentage (%)
- *   - Cell count configuration
- *   - Individual cell temperatures (°C)
- *   - Individual cell voltages (mV)
- *   - Total pack voltage (mV)
- *   - Pack voltage at terminals (mV)
- *   - Learned battery capacity (mAh)
- *   - FET enable status (boolean)
- *   - Safety/protection status (bit flags)
- *   - Emergency shutdown status (boolean)
- * 
- * I2C OPERATIONS PERFORMED:
- *   - Standard register reads (Current, RSOC, FCC)
- *   - DataFlash block reads (DA configuration)
- *   - MAC command reads (cell voltages, temperatures, status)
+ * SNAPSHOT PLAN (one bus transaction per line):
+ *   - DAStatus1 (MAC 0x0071): cell voltages, BAT voltage, PACK voltage and the
+ *     current sampled together with the cell voltages
+ *   - DAStatus2 (MAC 0x0072): TS1-TS4 temperatures
+ *   - OperationStatus (MAC 0x0054): emergency shutdown, SECURITY mode
+ *     (cached for dataflash_unlock())
+ *   - SafetyStatus (MAC 0x0051): protection bits
+ *   - RelativeStateOfCharge (SBS 0x0D): not carried by any block
+ *   - FullChargeCapacity (SBS 0x10): not carried by any block
+ *   - ManufacturerStatus (MAC 0x0057): FET_EN, the bit toggle_fet() flips.
+ *     OperationStatus CHG/DSG only tell whether the FETs are on right now,
+ *     protection turns them off with FET_EN still set
+ * 
+ * REMOVED FROM THE POLL PATH:
+ *   - Current (SBS 0x0A): taken from DAStatus1 instead
+ *   - DA Configuration (DataFlash): cell count is configuration, cached by
+ *     get_basic_bat_realtime_setting() and update_basic_bat_cells_setting()
  * 
  * ERROR HANDLING:
  *   - Continues reading even if individual operations fail
- *   - Preserves previous values on read failure
+ *   - Preserves previous values of every field whose transaction failed
+ *   - The snapshot is committed to sta in one step after all reads
  *   - Returns aggregate success status
  * 
+ * PROTECTION STATE:
+ *   - SafetyStatus and OperationStatus are kept raw; protection_sta is only
+ *     rendered by the JSON serializers, not on every poll
+ *   - Every read feeds events, which records the bits that changed since
+ *     the previous read (see meshsolar_events.h)
+ * 
  * TIMING CONSIDERATIONS:
- *   - Uses 10ms delays between I2C operations
- *   - Total execution time: ~100-200ms
- *   - Not suitable for high-frequency polling
+ *   - 7 transactions, no inter-transaction delays
+ *   - Total execution time: ~30-60ms depending on I2C speed
  * 
  * PLATFORM NOTES:
  *   - Uses only standard BQ4050 class methods
@@ -237,103 +311,232 @@ void MeshSolar::begin(BQ4050 *device) {
  */
 bool MeshSolar::get_realtime_bat_status(){
     bool res = true;
-    bq4050_reg_t reg = {0,0};             // Initialize register structure
-    bq4050_block_t block = {0,0,nullptr}; // Initialize block structure
-    /************************************************ get charge current ***********************************************/
-    reg.addr = BQ4050_REG_CURRENT; // Register address for charge current
-    res &= (int16_t)this->_bq4050->read_reg_word(&reg);
-    this->sta.charge_current = (res) ? reg.value : this->sta.charge_current; // Convert from mA to A
-    delay(10); 
-    LOG_L("Charge current: %d mA", this->sta.charge_current); // Log charge current
-    /*************************************************** get soc gauge ************************************************/
-    reg.addr = BQ4050_REG_RSOC; // Register address for state of charge
-    res &= this->_bq4050->read_reg_word(&reg); 
-    this->sta.soc_gauge = (res) ? reg.value : this->sta.soc_gauge; // Read state of charge
-    delay(10); 
-    LOG_L("State of charge: %d %%", this->sta.soc_gauge); // Log state of charge
-    /*************************************************** get bat cells ************************************************/
-    block.cmd = DF_CMD_DA_CONFIGURATION; // Command to access DA configuration
-    block.len = 1; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-
-    this->_bq4050->read_dataflash_block(&block); // Read current DA configuration again
-    block.pvalue[0] = (block.pvalue[0] & 0b00000011);        // Mask to get only the last 2 bits for DA configuration
-    block.pvalue[0] = (block.pvalue[0] > 3) ? 3 : block.pvalue[0];        // Ensure DA value is within valid range (0-3)
-    this->sta.cell_count = block.pvalue[0] + 1; // Set cell count based on DA configuration (0-3 corresponds to 1-4 cells)
-    LOG_L("Cell count: %d", this->sta.cell_count); // Log cell count
-    /**************************************************** get cell temp ***********************************************/
-    DAStatus2_t da2 = {0,};
-    block.cmd = MAC_CMD_DA_STATUS2; // Command to read cell temperatures
-    block.len = 14;                 // 14 bytes for cell temperatures
-    this->_bq4050->read_mac_block(&block); // Read the data block from the BQ4050
-    memcpy(&da2, block.pvalue, sizeof(DAStatus2_t)); // Copy the data into the da2 structure
-    delay(10); 
-
-    this->sta.cells[0].temperature =  da2.ts1_temp / 10.0f - 273.15f;// Convert from Kelvin to Celsius
-    this->sta.cells[1].temperature =  da2.ts2_temp / 10.0f - 273.15f;
-    this->sta.cells[2].temperature =  da2.ts3_temp / 10.0f - 273.15f;
-    this->sta.cells[3].temperature =  da2.ts4_temp / 10.0f - 273.15f;
-    for(int i = 0; i < this->sta.cell_count; i++) {
-        LOG_L("Cell %d temperature: %.2f °C", i + 1, this->sta.cells[i].temperature); // Log cell temperatures
+
+    DAStatus1_t       da1       = {0,};
+    DAStatus2_t       da2       = {0,};
+    OperationStatus_t operation = {0,};
+    SafetyStatus_t    safety    = {0,};
+    uint16_t          rsoc      = 0;
+    uint16_t          fcc       = 0;
+    uint16_t          mfg       = 0;
+
+    // Snapshot plan: {block read?, command/register, length, destination}
+    struct snapshot_read_t {
+        bool        block;      // true: ManufacturerBlockAccess read, false: SBS word read
+        uint16_t    cmd;        // MAC command or SBS register address
+        uint8_t     len;        // Expected payload length in bytes
+        void        *dst;       // Destination of the raw payload
+        const char  *name;
+        bool        ok;         // Set after the transaction
+    };
+
+    snapshot_read_t plan[] = {
+        {true,  MAC_CMD_DA_STATUS1,           sizeof(da1),        &da1,        "DAStatus1",          false},
+        {true,  MAC_CMD_DA_STATUS2,           sizeof(da2),        &da2,        "DAStatus2",          false},
+        {true,  MAC_CMD_OPERATION_STATUS,     sizeof(operation),  &operation,  "OperationStatus",    false},
+        {true,  MAC_CMD_SAFETY_STATUS,        sizeof(safety),     &safety,     "SafetyStatus",       false},
+        {false, BQ4050_REG_RSOC,              sizeof(rsoc),       &rsoc,       "RSOC",               false},
+        {false, BQ4050_REG_FCC,               sizeof(fcc),        &fcc,        "FCC",                false},
+        {true,  MAC_CMD_MANUFACTURER_STATUS,  sizeof(mfg),        &mfg,        "ManufacturerStatus", false},
+    };
+
+    /**************************************************** execute plan ***********************************************/
+    for (auto& entry : plan) {
+        if (entry.block) {
+            bq4050_block_t block = {entry.cmd, entry.len, nullptr, NUMBER};
+            entry.ok = this->_bq4050->read_mac_block(&block) && (block.len >= entry.len);
+            if (entry.ok) {
+                memcpy(entry.dst, block.pvalue, entry.len); // pvalue points to a shared driver buffer, copy now
+            }
+        }
+        else {
+            bq4050_reg_t reg = {(uint8_t)entry.cmd, 0};
+            entry.ok = this->_bq4050->read_reg_word(&reg);
+            if (entry.ok) {
+                memcpy(entry.dst, &reg.value, entry.len);
+            }
+        }
+        if (!entry.ok) {
+            LOG_E("Snapshot read %s failed", entry.name);
+        }
+        res &= entry.ok;
+    }
+
+    /**************************************************** decode snapshot ********************************************/
+    meshsolar_status_t snap = this->sta; // Fields of failed transactions keep their previous values
+
+    if (this->_cell_count == 0) {
+        this->_cell_count = this->read_cell_count();
     }
-    /**************************************************** get cell voltage *********************************************/
-    DAStatus1_t da1 = {0,};
-    block.cmd = MAC_CMD_DA_STATUS1; // Command to read cell temperatures
-    block.len = 32;                 // 14 bytes for cell temperatures
-    this->_bq4050->read_mac_block(&block); // Read the data block from the BQ4050
-    memcpy(&da1, block.pvalue, sizeof(DAStatus1_t)); // Copy the data into the da1 structure
-    delay(10); 
-    this->sta.cells[0].cell_num = 1;
-    this->sta.cells[0].voltage  = da1.cell_1_voltage; 
-    this->sta.cells[1].cell_num = 2;
-    this->sta.cells[1].voltage  = da1.cell_2_voltage; 
-    this->sta.cells[2].cell_num = 3;
-    this->sta.cells[2].voltage  = da1.cell_3_voltage; 
-    this->sta.cells[3].cell_num = 4;
-    this->sta.cells[3].voltage  = da1.cell_4_voltage; 
-    this->sta.total_voltage = da1.bat_voltage; // Use bat pin voltage as total voltage
+    snap.cell_count = (this->_cell_count > 0) ? this->_cell_count : snap.cell_count;
+
+    if (plan[0].ok) { // DAStatus1
+        const uint16_t cell_voltage[4] = {da1.cell_1_voltage, da1.cell_2_voltage, da1.cell_3_voltage, da1.cell_4_voltage};
+        for (int i = 0; i < 4; i++) {
+            snap.cells[i].cell_num = i + 1;
+            snap.cells[i].voltage  = cell_voltage[i];
+        }
+        snap.total_voltage  = da1.bat_voltage;              // Use bat pin voltage as total voltage
+        snap.pack_voltage   = da1.pack_voltage;             // Use pack voltage as charge voltage
+        snap.charge_current = (int16_t)da1.cell_1_current;  // Current sampled together with the cell voltages
+    }
+    if (plan[1].ok) { // DAStatus2
+        const int16_t ts[4] = {da2.ts1_temp, da2.ts2_temp, da2.ts3_temp, da2.ts4_temp};
+        for (int i = 0; i < 4; i++) {
+            snap.cells[i].temperature = ts[i] / 10.0f - 273.15f; // Convert from 0.1K to Celsius
+        }
+    }
+    if (plan[2].ok) { // OperationStatus
+        snap.emergency_shutdown = operation.bits.emshut;
+        snap.operation_status   = operation;
+        this->_security         = (security_mode_t)((operation.bits.sec1 << 1) | operation.bits.sec0);
+    }
+    if (plan[3].ok) { // SafetyStatus
+        snap.safety_status = safety;
+    }
+    if (plan[4].ok) { // RSOC
+        snap.soc_gauge = rsoc;
+    }
+    if (plan[5].ok) { // FCC
+        snap.learned_capacity = fcc;
+    }
+    if (plan[6].ok) { // ManufacturerStatus
+        snap.fet_enable = (mfg & MFG_STATUS_FET_EN) != 0;
+    }
+
+    this->sta = snap; // Commit the whole snapshot at once
+    this->events.update(this->sta.safety_status.bytes, this->sta.operation_status.bytes, sysclk::millis());
+    if (this->_emshut_check && plan[2].ok) {
+        if (this->sta.emergency_shutdown == this->sta.emshut_pin) {
+            LOG_I("EMSHUT %s confirmed by the gauge %u ms after the pin edge",
+                  this->sta.emshut_pin ? "set" : "clear", (unsigned)(sysclk::millis() - this->sta.emshut_pin_ms));
+        }
+        else {
+            LOG_W("EMSHUT pin %s but gauge EMSHUT %s", this->sta.emshut_pin ? "asserted" : "released",
+                  this->sta.emergency_shutdown ? "set" : "clear");
+        }
+        this->_emshut_check = false;
+    }
+
+    LOG_L("Charge current: %d mA", this->sta.charge_current);
+    LOG_L("State of charge: %d %%", this->sta.soc_gauge);
+    LOG_L("Cell count: %d", this->sta.cell_count);
     for(int i = 0; i < 4 ; i++) {
-        LOG_L("Cell %d voltage: %.2f V", this->sta.cells[i].cell_num, this->sta.cells[i].voltage / 1000.0f); // Log cell voltages
+        LOG_L("Cell %d voltage: %.2f V, temperature: %.2f °C", this->sta.cells[i].cell_num,
+              this->sta.cells[i].voltage / 1000.0f, this->sta.cells[i].temperature);
     }
-    LOG_L("Total voltage: %.2f V", this->sta.total_voltage / 1000.0f); // Log total voltage
-    /**************************************************** get charge voltage ********************************************/
-    this->sta.pack_voltage = da1.pack_voltage;    // Use pack voltage as charge voltage
-    LOG_L("Charge voltage: %d mV", this->sta.charge_voltage); // Log charge voltage
-    /**************************************************** get full charge capacity **************************************/
-    reg.addr = BQ4050_REG_FCC; 
-    res  &= this->_bq4050->read_reg_word(&reg);
-    this->sta.learned_capacity = (res) ? reg.value : this->sta.learned_capacity; 
-    delay(10); 
-    LOG_L("Learned capacity: %.2f Ah", this->sta.learned_capacity / 1000.0f); // Log learned capacity in Ah
-    /**************************************************** get fet enable state ******************************************/
-    block.cmd = MAC_CMD_MANUFACTURER_STATUS;        // Command to read manufacturer status
-    block.len = 2;                 
-    res &= this->_bq4050->read_mac_block(&block); 
-    this->sta.fet_enable = (res) ? (*(uint16_t*)block.pvalue & 0x0010) != 0 : this->sta.fet_enable; 
-    /**************************************************** get protection status **************************************/
-    SafetyStatus_t safety_status = {0,};
-    block.cmd = MAC_CMD_SAFETY_STATUS; // Command to read safety status
-    block.len = 4;                     // Length of the data block to read
-    res &= this->_bq4050->read_mac_block(&block); // Read the data block from the BQ4050
-    memcpy(&safety_status, block.pvalue, sizeof(SafetyStatus_t)); // Copy the data into the safety_status structure
-    
-    // Parse SafetyStatus bits and get human-readable string
-    String safety_bits_str = parseSafetyStatusBits(safety_status);
-    // Store the parsed bit names in protection_sta field (truncate if too long)
-    strncpy(this->sta.protection_sta, safety_bits_str.c_str(), sizeof(this->sta.protection_sta) - 1);
-    this->sta.protection_sta[sizeof(this->sta.protection_sta) - 1] = '\0'; // Ensure null termination
-    LOG_L("Protection status raw: %08X", (unsigned int)safety_status.bytes); // Log raw hex value
-    LOG_L("Protection status bits: %s", this->sta.protection_sta); // Log parsed bit names
-    /**************************************************** get operation status **************************************/
-    OperationStatus_t operation_status = {0,};
-    block.cmd = MAC_CMD_OPERATION_STATUS;   // Command to read operation status
-    block.len = 4;                          // Length of the data block to read
-    res &= this->_bq4050->read_mac_block(&block); // Read the data block from the BQ4050
-    memcpy(&operation_status, block.pvalue, sizeof(OperationStatus_t)); // Copy the data into the operation_status structure
-    this->sta.emergency_shutdown = operation_status.bits.emshut; // Get emergency shutdown status
-
-
-    return res; // Return true to indicate status update was successful
+    LOG_L("Total voltage: %.2f V", this->sta.total_voltage / 1000.0f);
+    LOG_L("Pack voltage: %d mV", this->sta.pack_voltage);
+    LOG_L("Learned capacity: %.2f Ah", this->sta.learned_capacity / 1000.0f);
+    LOG_L("Safety status raw: %08X", (unsigned int)this->sta.safety_status.bytes);
+    LOG_L("Operation status raw: %08X", (unsigned int)this->sta.operation_status.bytes);
+
+    return res;
+}
+
+/**
+ * @brief Refresh the status, reading the full snapshot only when needed
+ * 
+ * PLATFORM-INDEPENDENT FUNCTION
+ * Reads the BatteryStatus word (one SBS word, about 1 ms) and runs the full
+ * get_realtime_bat_status() plan (five MAC blocks and two words) only when
+ * something may have changed. The gauge raises the BatteryStatus alarms
+ * itself: RCA/RTA from the thresholds written by update_alarm_setting(),
+ * TCA/TDA/OTA/OCA from its safety alerts, DSG/FC/FD on state changes.
+ * 
+ * @param full       Set to true if a full snapshot was read into sta
+ * @param max_age_ms Oldest full snapshot to keep, 0 = poll policy full_refresh_ms
+ * @return bool True if the reads succeeded
+ * 
+ * FULL SNAPSHOT WHEN:
+ *   - No full snapshot yet, or the BatteryStatus read failed
+ *   - The last poll decision was the fast interval (protection, low SOC,
+ *     current changing), so values are expected to move
+ *   - A bit of BATTERY_STATUS_CHANGE_MASK changed
+ *   - An emergency shutdown pin edge waits for the gauge cross-check
+ *   - The last full snapshot is older than max_age_ms
+ * 
+ * An INIT edge means the gauge reset and reloaded its alarm defaults, so the
+ * thresholds of set_alarm_config() are written again.
+ * 
+ * USAGE:
+ *   Call instead of get_realtime_bat_status() from the poll loop; only feed
+ *   consumers of sta when full is true.
+ */
+bool MeshSolar::refresh_bat_status(bool *full, uint32_t max_age_ms){
+    bq4050_reg_t reg     = {BQ4050_REG_BATTERY_STATUS, 0};
+    bool         word_ok = this->_bq4050->read_reg_word(&reg);
+    uint32_t     now     = sysclk::millis();
+    uint32_t     age     = (max_age_ms > 0) ? max_age_ms : this->_poll_policy.full_refresh_ms;
+    uint16_t     changed = (reg.value ^ this->sta.battery_status.bytes) & BATTERY_STATUS_CHANGE_MASK;
+
+    *full = !word_ok || !this->_full_valid || changed != 0 || this->_emshut_check ||
+            (this->_poll_interval <= this->_poll_policy.fast_interval_ms) ||
+            (now - this->_full_ms) >= age;
+    if (word_ok) {
+        this->sta.battery_status.bytes = reg.value;
+    }
+    if (!*full) {
+        LOG_D("BatteryStatus %04X unchanged, full snapshot skipped", reg.value);
+        return true;
+    }
+    if (changed != 0) {
+        LOG_I("BatteryStatus changed: %04X (bits %04X)", reg.value, changed);
+    }
+    if (changed & BATTERY_STATUS_INIT) {
+        this->update_alarm_setting();   // The gauge re-initialized, its alarms are back at the defaults
+    }
+    bool ok = this->get_realtime_bat_status();
+    if (ok) {
+        this->_full_ms    = now;
+        this->_full_valid = true;
+    }
+    return ok;
+}
+
+/**
+ * @brief Publish an emergency shutdown pin edge ahead of the gauge
+ * 
+ * PLATFORM-INDEPENDENT FUNCTION
+ * The gauge only shows EMSHUT in OperationStatus on the next status read,
+ * up to a poll interval later. The pin interrupt timestamps the edge, the
+ * application journals it with events.pin() and pushes the event frame at
+ * once, then calls this with the command lock held (sta is not interrupt or
+ * task safe) to mirror the level in sta until the gauge confirms it.
+ * 
+ * @param asserted Pin level, true = emergency shutdown requested
+ * @param time_ms  Time taken in the interrupt (ms)
+ * @return None
+ * 
+ * CROSS-CHECK:
+ *   sta.emergency_shutdown follows the pin until the next full status read
+ *   overwrites it with the gauge EMSHUT bit; that read logs whether the two
+ *   agree. refresh_bat_status() forces the full read, and the protection
+ *   state keeps the poll interval fast meanwhile.
+ */
+void MeshSolar::emshut_pin_event(bool asserted, uint32_t time_ms){
+    if (asserted == this->sta.emshut_pin) {
+        return;                                 // Bounce, or the level was already seen
+    }
+    this->sta.emshut_pin         = asserted;
+    this->sta.emshut_pin_ms      = time_ms;
+    this->sta.emergency_shutdown = asserted;
+    this->_emshut_check          = true;
+    this->_poll_interval         = this->_poll_policy.fast_interval_ms;
+    LOG_W("EMSHUT pin %s at %u ms", asserted ? "asserted" : "released", (unsigned)time_ms);
+}
+
+/**
+ * @brief Read the configured cell count from the BQ4050 DA Configuration
+ * 
+ * @return int Number of series cells (1-4), or 0 if the DataFlash read failed
+ */
+int MeshSolar::read_cell_count(){
+    uint8_t da = 0;
+    if (!this->_bq4050->df_read<df::da_configuration>(&da)) {
+        return 0;
+    }
+    return (da & 0b00000011) + 1;               // Last 2 bits, 0-3 corresponds to 1-4 cells
 }
 
 /**
@@ -358,17 +561,15 @@ bool MeshSolar::get_realtime_bat_status(){
  *     * Protection enable status (boolean)
  * 
  * DATAFLASH COMMANDS USED:
- *   - DF_CMD_SBS_DATA_CHEMISTRY: Battery type string
- *   - DF_CMD_DA_CONFIGURATION: Cell count configuration
- *   - DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH: Design capacity
- *   - DF_CMD_GAS_GAUGE_FD_SET_VOLTAGE_THR: Cutoff voltage
- *   - DF_CMD_PROTECTIONS_*_THR: Temperature thresholds
- *   - DF_CMD_SETTINGS_PROTECTIONS_ENABLE_*: Protection enables
+ *   - df::device_chemistry: Battery type string
+ *   - df::da_configuration: Cell count configuration
+ *   - df::design_capacity_mah: Design capacity
+ *   - df::fd_set_voltage: Cutoff voltage
+ *   - df::otc/utc/otd/utd_threshold: Temperature thresholds
+ *   - df::protection_enable_b/d: Protection enables
  * 
  * CHEMISTRY MAPPING:
- *   - "LFE4" -> "lifepo4"
- *   - "LION" -> "liion"
- *   - "LIPO" -> "lipo"
+ *   - gauge_id -> name of the chemistry_profiles[] row ("LFE4" -> "lifepo4", ...)
  * 
  * ERROR HANDLING:
  *   - Returns false on unknown battery chemistry
@@ -381,110 +582,64 @@ bool MeshSolar::get_realtime_bat_status(){
  *   - Uses standard C string operations
  */
 bool MeshSolar::get_basic_bat_realtime_setting(){
-    bq4050_block_t block= {
-        .cmd = DF_CMD_SBS_DATA_CHEMISTRY,
-        .len = 5,
-        .pvalue =nullptr,
-        .type = STRING
-    };
-    /*****************************************   bat type   *************************************/
-    memset(this->sync_rsp.basic.type, 0, sizeof(this->sync_rsp.basic.type)); // Clear the battery type string
-    this->_bq4050->read_dataflash_block(&block); 
-    if(0 == strcasecmp((const char *)block.pvalue, "LFE4")) {
-        strlcpy(this->sync_rsp.basic.type, "lifepo4", sizeof(this->sync_rsp.basic.type)); // Copy battery type to sync response structure
-    }
-    else if(0 == strcasecmp((const char *)block.pvalue, "LION")) {
-        strlcpy(this->sync_rsp.basic.type, "liion", sizeof(this->sync_rsp.basic.type)); // Copy battery type to sync response structure
+    BQ4050         *gauge = this->_bq4050;
+    basic_config_t *basic = &this->sync_rsp.basic;
+    if (this->df_sealed("DataFlash read")) {
+        return false;
     }
-    else if(0 == strcasecmp((const char *)block.pvalue, "LIPO")) {
-        strlcpy(this->sync_rsp.basic.type, "lipo", sizeof(this->sync_rsp.basic.type)); // Copy battery type to sync response structure
+    /*****************************************   bat type   *************************************/
+    char gauge_id[8] = {0};
+    memset(basic->type, 0, sizeof(basic->type)); // Clear the battery type string
+    if (!gauge->df_read_string<df::device_chemistry>(gauge_id, sizeof(gauge_id))) {
+        return false;
     }
-    else {
-        LOG_E("Unknown battery type from BQ4050: %s", (const char *)block.pvalue);
+    const chemistry_profile_t *profile = chemistry_profile(chemistry_find_gauge_id(gauge_id));
+    if (profile == nullptr) {
+        LOG_E("Unknown battery type from BQ4050: %s", gauge_id);
         return false; // Unknown battery type, return false
     }
+    strlcpy(basic->type, profile->name, sizeof(basic->type)); // Copy battery type to sync response structure
+    basic->chemistry = profile->id;
+    this->_chemistry = profile->id;
     /*****************************************  cell count  *************************************/
-    block.cmd = DF_CMD_DA_CONFIGURATION; // Command to access DA configuration
-    block.len = 1; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read current DA configuration again
-    block.pvalue[0] = (block.pvalue[0] & 0b00000011);        // Mask to get only the last 2 bits for DA configuration
-    block.pvalue[0] = (block.pvalue[0] > 3) ? 3 : block.pvalue[0];  // Ensure DA value is within valid range (0-3)
-    this->sync_rsp.basic.cell_number = block.pvalue[0] + 1;   // Set cell count based on DA configuration (0-3 corresponds to 1-4 cells)
-    /*****************************************  design capacity  *************************************/
-    block.cmd = DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH; // Command to access design capacity
-    block.len = 2; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read design capacity
-    this->sync_rsp.basic.design_capacity = (block.pvalue[1] << 8) | block.pvalue[0]; // Combine bytes to get capacity in mAh
-    /*****************************************  cutoff voltage  *************************************/
-    block.cmd = DF_CMD_GAS_GAUGE_FD_SET_VOLTAGE_THR; // Command to access cutoff voltage
-    block.len = 2; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read cutoff voltage
-    this->sync_rsp.basic.discharge_cutoff_voltage = (block.pvalue[1] << 8) | block.pvalue[0]; // Combine bytes to get voltage in mV
-    /*****************************************  temperature protection charge high temp  *************************************/
-    block.cmd = DF_CMD_PROTECTIONS_OTC_THR; // Command to access temperature protection thresholds
-    block.len = 2;
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read temperature protection thresholds
-    int16_t raw_temp = (int16_t)((block.pvalue[1] << 8) | block.pvalue[0]); // Read as signed 16-bit value
-    this->sync_rsp.basic.protection.charge_high_temp_c = raw_temp / 10.0f; // Convert from 0.1°C to Celsius
-    /*****************************************  temperature protection charge low temp  *************************************/
-    block.cmd = DF_CMD_PROTECTIONS_UTC_THR; // Command to access charge low temperature threshold
-    block.len = 2; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read charge low temperature threshold
-    raw_temp = (int16_t)((block.pvalue[1] << 8) | block.pvalue[0]); // Read as signed 16-bit value
-    this->sync_rsp.basic.protection.charge_low_temp_c = raw_temp / 10.0f; // Convert from 0.1°C to Celsius
-    /*****************************************  temperature protection discharge high temp  *************************************/
-    block.cmd = DF_CMD_PROTECTIONS_OTD_THR; // Command to access discharge high temperature threshold
-    block.len = 2; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read discharge high temperature threshold
-    raw_temp = (int16_t)((block.pvalue[1] << 8) | block.pvalue[0]); // Read as signed 16-bit value
-    this->sync_rsp.basic.protection.discharge_high_temp_c = raw_temp / 10.0f; // Convert from 0.1°C to Celsius
-    /*****************************************  temperature protection discharge low temp  *************************************/
-    block.cmd = DF_CMD_PROTECTIONS_UTD_THR; // Command to access discharge low temperature threshold
-    block.len = 2; // Length of the data block to read
-    block.type = NUMBER; // Set block type to NUMBER
-    this->_bq4050->read_dataflash_block(&block); // Read discharge low temperature threshold
-    raw_temp = (int16_t)((block.pvalue[1] << 8) | block.pvalue[0]); // Read as signed 16-bit value
-    this->sync_rsp.basic.protection.discharge_low_temp_c = raw_temp / 10.0f; // Convert from 0.1°C to Celsius
+    uint8_t da = 0;
+    if (!gauge->df_read<df::da_configuration>(&da)) {
+        return false;
+    }
+    basic->cell_number = (da & 0b00000011) + 1;     // Last 2 bits, 0-3 corresponds to 1-4 cells
+    this->_cell_count  = basic->cell_number;        // Refresh the cell count used by status snapshots
+    /*****************************************  capacity, cutoff voltage and temperatures  *************************************/
+    int16_t otc = 0, utc = 0, otd = 0, utd = 0;     // 0.1°C
+    if (!gauge->df_read<df::design_capacity_mah>(&basic->design_capacity) ||
+        !gauge->df_read<df::fd_set_voltage>(&basic->discharge_cutoff_voltage) ||
+        !gauge->df_read<df::otc_threshold>(&otc) ||
+        !gauge->df_read<df::utc_threshold>(&utc) ||
+        !gauge->df_read<df::otd_threshold>(&otd) ||
+        !gauge->df_read<df::utd_threshold>(&utd)) {
+        return false;
+    }
+    basic->protection.charge_high_temp_c    = otc / 10.0f;  // Convert from 0.1°C to Celsius
+    basic->protection.charge_low_temp_c     = utc / 10.0f;
+    basic->protection.discharge_high_temp_c = otd / 10.0f;
+    basic->protection.discharge_low_temp_c  = utd / 10.0f;
     /*****************************************  temperature protection enabled  *************************************/
-    // Read temperature protection enable status from both Protection Enable registers
-    // Temperature protection is considered enabled only if all required bits are set in both registers
-    
-    bool protection_b_enabled = false, protection_d_enabled = false;
-    
-    // Read Protection Enable B register (controls OTC: bit 5, OTD: bit 4)
-    block.cmd = DF_CMD_SETTINGS_PROTECTIONS_ENABLE_B;
-    block.len = 1;
-    block.type = NUMBER;
-    if (this->_bq4050->read_dataflash_block(&block)) {
-        const uint8_t PROTECTION_B_TEMP_MASK = 0b00110000; // Bits 4 and 5 (OTD and OTC)
-        protection_b_enabled = ((block.pvalue[0] & PROTECTION_B_TEMP_MASK) == PROTECTION_B_TEMP_MASK);
-        LOG_D("Protection Enable B: 0x%02X, temp bits enabled: %s", block.pvalue[0], protection_b_enabled ? "Yes" : "No");
-    } else {
+    // Temperature protection is considered enabled only if all required bits are set in both registers:
+    // Protection Enable B controls OTC (bit 5) and OTD (bit 4), Protection Enable D controls UTC (bit 3) and UTD (bit 2)
+    const uint8_t PROTECTION_B_TEMP_MASK = 0b00110000;
+    const uint8_t PROTECTION_D_TEMP_MASK = 0b00001100;
+    uint8_t enable_b = 0, enable_d = 0;
+    if (!gauge->df_read<df::protection_enable_b>(&enable_b)) {
         LOG_E("Failed to read Protection Enable B register");
     }
-    
-    // Read Protection Enable D register (controls UTC: bit 3, UTD: bit 2)
-    block.cmd = DF_CMD_SETTINGS_PROTECTIONS_ENABLE_D;
-    block.len = 1;
-    block.type = NUMBER;
-    if (this->_bq4050->read_dataflash_block(&block)) {
-        const uint8_t PROTECTION_D_TEMP_MASK = 0b00001100; // Bits 2 and 3 (UTD and UTC)
-        protection_d_enabled = ((block.pvalue[0] & PROTECTION_D_TEMP_MASK) == PROTECTION_D_TEMP_MASK);
-        LOG_D("Protection Enable D: 0x%02X, temp bits enabled: %s", block.pvalue[0], protection_d_enabled ? "Yes" : "No");
-    } else {
+    if (!gauge->df_read<df::protection_enable_d>(&enable_d)) {
         LOG_E("Failed to read Protection Enable D register");
     }
-    // Temperature protection is enabled only if both registers have the required bits set
-    this->sync_rsp.basic.protection.enabled = protection_b_enabled && protection_d_enabled;
-    LOG_D("Temperature protection overall status: %s", this->sync_rsp.basic.protection.enabled ? "ENABLED" : "DISABLED");
+    LOG_D("Protection Enable B: 0x%02X, D: 0x%02X", enable_b, enable_d);
+    basic->protection.enabled = ((enable_b & PROTECTION_B_TEMP_MASK) == PROTECTION_B_TEMP_MASK) &&
+                                ((enable_d & PROTECTION_D_TEMP_MASK) == PROTECTION_D_TEMP_MASK);
+    LOG_D("Temperature protection overall status: %s", basic->protection.enabled ? "ENABLED" : "DISABLED");
 
-    return true; // Return false to indicate configuration update was successful
+    return true;
 }
 
 /**
@@ -512,16 +667,14 @@ bool MeshSolar::get_basic_bat_realtime_setting(){
  *   - Used for accurate SOC calculation during discharge
  * 
  * DATAFLASH COMMANDS USED:
- *   - DF_CMD_PROTECTIONS_CUV_THR: Under-voltage protection
- *   - DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL: Charge voltage
- *   - DF_CMD_PROTECTIONS_COV_STD_TEMP_THR: Over-voltage protection
- *   - DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV*: Fixed EDV points
- *   - DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_*: Discharge profile
+ *   - df::cuv_threshold: Under-voltage protection
+ *   - df::charge_voltage_std: Charge voltage
+ *   - df::cov_threshold_std: Over-voltage protection
+ *   - df::edv0-2: Fixed EDV points
+ *   - df::cedv_voltage_*: Discharge profile
  * 
  * TIMING CONSIDERATIONS:
- *   - Uses 50ms delays between CEDV profile reads
- *   - Total execution time: ~800-1000ms for full read
- *   - Sequential reads to avoid bus contention
+ *   - 17 sequential DataFlash reads, back to back
  * 
  * ERROR HANDLING:
  *   - Stops on first read failure and returns false
@@ -534,121 +687,301 @@ bool MeshSolar::get_basic_bat_realtime_setting(){
  *   - Compatible with any I2C implementation
  */
 bool MeshSolar::get_advance_bat_realtime_setting(){
-    bq4050_block_t block = {0, 0, nullptr, NUMBER};
-    
+    BQ4050           *gauge = this->_bq4050;
+    advance_config_t *adv   = &this->sync_rsp.advance;
+    if (this->df_sealed("DataFlash read")) {
+        return false;
+    }
+
     /*
      * Read advanced battery configuration from BQ4050
      * 
      * This function reads the advanced configuration parameters that correspond
      * to the settings configured in update_advance_bat_battery_setting() and
-     * update_advance_bat_cedv_setting() functions.
+     * update_advance_bat_cedv_setting() functions. EOC and EOC protection are
+     * read from the standard temperature charge voltage and COV threshold.
+     * Stops at the first failed read, the failing address is logged by BQ4050.
      */
-    
-    /*****************************************  CUV (Cell Under Voltage) Protection  *************************************/
-    block.cmd = DF_CMD_PROTECTIONS_CUV_THR;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read CUV threshold");
+    bool ok = gauge->df_read<df::cuv_threshold>(&adv->battery.cuv) &&
+              gauge->df_read<df::charge_voltage_std>(&adv->battery.eoc) &&
+              gauge->df_read<df::cov_threshold_std>(&adv->battery.eoc_protect) &&
+              gauge->df_read<df::edv0>(&adv->cedv.cedv0) &&
+              gauge->df_read<df::edv1>(&adv->cedv.cedv1) &&
+              gauge->df_read<df::edv2>(&adv->cedv.cedv2) &&
+              gauge->df_read<df::cedv_voltage_0>(&adv->cedv.discharge_cedv0) &&
+              gauge->df_read<df::cedv_voltage_10>(&adv->cedv.discharge_cedv10) &&
+              gauge->df_read<df::cedv_voltage_20>(&adv->cedv.discharge_cedv20) &&
+              gauge->df_read<df::cedv_voltage_30>(&adv->cedv.discharge_cedv30) &&
+              gauge->df_read<df::cedv_voltage_40>(&adv->cedv.discharge_cedv40) &&
+              gauge->df_read<df::cedv_voltage_50>(&adv->cedv.discharge_cedv50) &&
+              gauge->df_read<df::cedv_voltage_60>(&adv->cedv.discharge_cedv60) &&
+              gauge->df_read<df::cedv_voltage_70>(&adv->cedv.discharge_cedv70) &&
+              gauge->df_read<df::cedv_voltage_80>(&adv->cedv.discharge_cedv80) &&
+              gauge->df_read<df::cedv_voltage_90>(&adv->cedv.discharge_cedv90) &&
+              gauge->df_read<df::cedv_voltage_100>(&adv->cedv.discharge_cedv100);
+    if (!ok) {
+        LOG_E("Failed to read the advanced settings");
         return false;
     }
-    this->sync_rsp.advance.battery.cuv = (block.pvalue[1] << 8) | block.pvalue[0];
-    LOG_D("CUV threshold: %d mV", this->sync_rsp.advance.battery.cuv);
-    
-    /*****************************************  EOC (End of Charge) Voltage  *************************************/
-    // Read from standard temperature charge voltage (represents EOC setting)
-    block.cmd = DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read EOC voltage");
+    LOG_L("CUV %d mV, EOC %d mV, EOC protection %d mV", adv->battery.cuv, adv->battery.eoc, adv->battery.eoc_protect);
+    return true;
+}
+
+/*
+ * ============================================================================
+ * DATAFLASH WRITE PLAN
+ * ============================================================================
+ *
+ * The update_* settings are built in two phases. plan_*() turns the command
+ * structure into a list of DataFlash writes, df_plan_apply() performs them.
+ * Several commands can be planned before a single apply: an address planned
+ * more than once is written once with the last value, so "config" followed by
+ * "advance" does not write the shared COV, charge voltage, EDV and CUV
+ * addresses twice.
+ *
+ * Each entry remembers which steps planned it (df_plan_step()), so a batch can
+ * report a status per command after the single apply.
+ */
+
+/**
+ * @brief Start an empty plan, step 0
+ */
+void MeshSolar::df_plan_begin() {
+    this->_plan.count    = 0;
+    this->_plan.step     = 0;
+    this->_plan.overflow = false;
+    this->_plan.rejected = false;
+    this->_plan.chemistry = CHEMISTRY_COUNT;
+}
+
+/**
+ * @brief Record the following df_plan_*() calls under another step
+ * 
+ * @param step Step index, 0 to DF_PLAN_STEPS - 1
+ */
+void MeshSolar::df_plan_step(uint8_t step) {
+    this->_plan.step = (step < DF_PLAN_STEPS) ? step : (DF_PLAN_STEPS - 1);
+}
+
+/**
+ * @brief Find or append the plan entry of a DataFlash address
+ * 
+ * @return df_write_t* Entry marked for the current step and not verified, nullptr if the plan is full
+ */
+df_write_t *MeshSolar::df_plan_entry(uint16_t cmd, uint8_t len, uint8_t type, const char *name) {
+    df_write_t *e = nullptr;
+    for (uint8_t i = 0; i < this->_plan.count; i++) {
+        if (this->_plan.entries[i].cmd == cmd) {
+            e = &this->_plan.entries[i];
+            break;
+        }
+    }
+    if (e == nullptr) {
+        if (this->_plan.count >= DF_PLAN_MAX) {
+            LOG_E("DataFlash plan full, %s dropped", name);
+            this->_plan.overflow = true;
+            return nullptr;
+        }
+        e = &this->_plan.entries[this->_plan.count++];
+        memset(e, 0, sizeof(*e));
+        e->cmd = cmd;
+    }
+    e->len   = len;
+    e->type  = type;
+    e->name  = name;
+    e->ok    = false;
+    e->steps |= (uint8_t)(1 << this->_plan.step);
+    return e;
+}
+
+/**
+ * @brief Plan a 16-bit write, signed values are passed as their two's complement
+ */
+bool MeshSolar::df_plan_u16(uint16_t cmd, uint16_t value, const char *name) {
+    df_write_t *e = this->df_plan_entry(cmd, 2, NUMBER, name);
+    if (e == nullptr) {
         return false;
     }
-    this->sync_rsp.advance.battery.eoc = (block.pvalue[1] << 8) | block.pvalue[0];
-    LOG_L("EOC voltage: %d mV", this->sync_rsp.advance.battery.eoc);
-    
-    /*****************************************  EOC Protection Voltage  *************************************/
-    // Read from standard temperature COV threshold (represents EOC protection setting)
-    block.cmd = DF_CMD_PROTECTIONS_COV_STD_TEMP_THR;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read EOC protection voltage");
+    e->mask    = 0;
+    e->data[0] = (uint8_t)(value & 0xFF);
+    e->data[1] = (uint8_t)(value >> 8);
+    return true;
+}
+
+/**
+ * @brief Plan a read-modify-write of some bits of a 1-byte register
+ * 
+ * @param mask Bits to modify, the others keep the value read from the gauge
+ * @param bits New value of the masked bits
+ */
+bool MeshSolar::df_plan_bits(uint16_t cmd, uint8_t mask, uint8_t bits, const char *name) {
+    df_write_t *e = this->df_plan_entry(cmd, 1, NUMBER, name);
+    if (e == nullptr) {
         return false;
     }
-    this->sync_rsp.advance.battery.eoc_protect = (block.pvalue[1] << 8) | block.pvalue[0];
-    LOG_L("EOC protection voltage: %d mV", this->sync_rsp.advance.battery.eoc_protect);
-    
-    /*****************************************  CEDV Fixed Values  *************************************/
-    // Read CEDV fixed EDV0
-    block.cmd = DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read CEDV0");
+    e->mask   |= mask;                  // Merged with the bits planned earlier, if any
+    e->data[0] = (e->data[0] & ~mask) | (bits & mask);
+    return true;
+}
+
+/**
+ * @brief Plan a length-prefixed string block
+ * 
+ * @param len Block length including the length byte, at most sizeof(df_write_t::data)
+ */
+bool MeshSolar::df_plan_string(uint16_t cmd, const char *str, uint8_t len, const char *name) {
+    if (len > sizeof(((df_write_t *)0)->data)) {
+        LOG_E("%s too long for the DataFlash plan", name);
         return false;
     }
-    this->sync_rsp.advance.cedv.cedv0 = (block.pvalue[1] << 8) | block.pvalue[0];
-    
-    // Read CEDV fixed EDV1
-    block.cmd = DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV1;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read CEDV1");
+    df_write_t *e = this->df_plan_entry(cmd, len, STRING, name);
+    if (e == nullptr) {
         return false;
     }
-    this->sync_rsp.advance.cedv.cedv1 = (block.pvalue[1] << 8) | block.pvalue[0];
-    
-    // Read CEDV fixed EDV2
-    block.cmd = DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV2;
-    block.len = 2;
-    block.type = NUMBER;
-    if (!this->_bq4050->read_dataflash_block(&block)) {
-        LOG_E("Failed to read CEDV2");
+    memset(e->data, 0, sizeof(e->data));
+    e->mask    = 0;
+    e->data[0] = (uint8_t)strnlen(str, len - 1);
+    memcpy(&e->data[1], str, e->data[0]);
+    return true;
+}
+
+/**
+ * @brief Plan every basic configuration setting from cmd.basic
+ * 
+ * Same settings, in the same order, as the five update_basic_bat_*_setting()
+ * calls of a "config" command.
+ * 
+ * @return bool False if a setting was rejected (unknown type, invalid temperatures, plan full)
+ */
+bool MeshSolar::plan_basic_settings() {
+    bool res = true;
+    res &= this->plan_basic_bat_type_setting();
+    res &= this->plan_basic_bat_cells_setting();
+    res &= this->plan_basic_bat_design_capacity_setting();
+    res &= this->plan_basic_bat_discharge_cutoff_voltage_setting();
+    res &= this->plan_basic_bat_temp_protection_setting();
+    return res;
+}
+
+/**
+ * @brief Plan every advanced configuration setting from cmd.advance
+ * 
+ * @return bool False if the plan is full
+ */
+bool MeshSolar::plan_advance_settings() {
+    bool res = true;
+    res &= this->plan_advance_bat_battery_setting();
+    res &= this->plan_advance_bat_cedv_setting();
+    return res;
+}
+
+/**
+ * @brief Write the planned entries, then verify them
+ * 
+ * PLATFORM-INDEPENDENT DATAFLASH WRITER
+ * Every entry not verified yet is written once, followed by the usual settle
+ * delay. All written entries are then read back in a second pass. Calling it
+ * again after a failure only rewrites the entries that did not verify, which
+ * makes it safe to wrap in a retry loop.
+ * 
+ * @return bool True if every entry of the plan is verified, false without any
+ *              bus traffic if a planned value was out of range or the gauge
+ *              was last seen SEALED
+ * 
+ * READ-MODIFY-WRITE:
+ *   - Entries planned with df_plan_bits() read the register first and only
+ *     replace the masked bits, the verify compares those bits only
+ *   - A DA Configuration write invalidates the cached cell count
+ *   - The chemistry of the CEDV defaults only follows a DeviceChemistry
+ *     entry once it verifies, a rejected or failed plan leaves it as it was
+ * 
+ * TIMING:
+ *   - 100ms delay after each DataFlash write, as the single-setting functions
+ *   - One read per entry for the verify pass, one more per read-modify-write
+ */
+bool MeshSolar::df_plan_apply() {
+    bool written[DF_PLAN_MAX] = {false};
+    if (this->_plan.rejected) {
+        LOG_E("DataFlash plan holds an out of range value, nothing written");
         return false;
     }
-    this->sync_rsp.advance.cedv.cedv2 = (block.pvalue[1] << 8) | block.pvalue[0];
-    
-    /*****************************************  CEDV Discharge Profile Values  *************************************/
-    // Configuration table for CEDV discharge profile readings
-    struct cedv_read_entry_t {
-        uint16_t cmd;
-        int* target_field;
-        const char* name;
-    };
-    
-    cedv_read_entry_t cedv_readings[] = {
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_0,   &this->sync_rsp.advance.cedv.discharge_cedv0,   "Discharge CEDV 0%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_10,  &this->sync_rsp.advance.cedv.discharge_cedv10,  "Discharge CEDV 10%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_20,  &this->sync_rsp.advance.cedv.discharge_cedv20,  "Discharge CEDV 20%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_30,  &this->sync_rsp.advance.cedv.discharge_cedv30,  "Discharge CEDV 30%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_40,  &this->sync_rsp.advance.cedv.discharge_cedv40,  "Discharge CEDV 40%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_50,  &this->sync_rsp.advance.cedv.discharge_cedv50,  "Discharge CEDV 50%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_60,  &this->sync_rsp.advance.cedv.discharge_cedv60,  "Discharge CEDV 60%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_70,  &this->sync_rsp.advance.cedv.discharge_cedv70,  "Discharge CEDV 70%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_80,  &this->sync_rsp.advance.cedv.discharge_cedv80,  "Discharge CEDV 80%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_90,  &this->sync_rsp.advance.cedv.discharge_cedv90,  "Discharge CEDV 90%"},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_100, &this->sync_rsp.advance.cedv.discharge_cedv100, "Discharge CEDV 100%"}
-    };
-    
-    // Helper lambda to read CEDV values
-    auto read_cedv_value = [&](uint16_t cmd, int* target, const char* name) -> bool {
-        block.cmd = cmd;
-        block.len = 2;
-        block.type = NUMBER;
-        if (!this->_bq4050->read_dataflash_block(&block)) {
-            LOG_E("Failed to read %s", name);
-            return false;
+    if (this->df_sealed("DataFlash write")) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < this->_plan.count; i++) {
+        df_write_t *e = &this->_plan.entries[i];
+        if (e->ok) {
+            continue;
         }
-        *target = (block.pvalue[1] << 8) | block.pvalue[0];
-        delay(50); // Add a small delay to avoid flooding the bus
-        return true;
-    };
-    
-    // Read all CEDV discharge profile values
-    for (auto& entry : cedv_readings) {
-        if (!read_cedv_value(entry.cmd, entry.target_field, entry.name)) {
+        uint8_t value[sizeof(e->data)];
+        memcpy(value, e->data, sizeof(value));
+
+        if (e->mask != 0) {
+            bq4050_block_t cur = {e->cmd, 1, nullptr, NUMBER};
+            if (!this->_bq4050->read_dataflash_block(&cur)) {
+                LOG_E("Failed to read %s", e->name);
+                continue;
+            }
+            value[0] = (cur.pvalue[0] & ~e->mask) | (e->data[0] & e->mask);
+        }
+
+        bq4050_block_t block = {e->cmd, e->len, value, (block_type)e->type};
+        if (!this->_bq4050->write_dataflash_block(block)) {
+            LOG_E("Failed to write %s", e->name);
+            continue;
+        }
+        sysclk::delay(100);
+        written[i] = true;
+        if (e->cmd == df::da_configuration::reg().addr) {
+            this->_cell_count = 0; // Re-read the cell count on the next status snapshot
+        }
+    }
+
+    bool res = !this->_plan.overflow;
+    for (uint8_t i = 0; i < this->_plan.count; i++) {
+        df_write_t *e = &this->_plan.entries[i];
+        if (written[i]) {
+            bq4050_block_t ret = {e->cmd, e->len, nullptr, (block_type)e->type};
+            if (!this->_bq4050->read_dataflash_block(&ret)) {
+                LOG_E("Failed to read back %s", e->name);
+            }
+            else if (e->type == STRING) {
+                e->ok = (0 == strncasecmp((const char *)ret.pvalue, (const char *)&e->data[1], e->data[0]));
+            }
+            else if (e->mask != 0) {
+                e->ok = ((ret.pvalue[0] ^ e->data[0]) & e->mask) == 0;
+            }
+            else {
+                e->ok = (0 == memcmp(ret.pvalue, e->data, e->len));
+            }
+            if (e->ok) {
+                LOG_I("%-24s set to: 0x%02X%02X - OK", e->name, e->data[1], e->data[0]);
+            }
+            else {
+                LOG_E("%-24s verify - ERROR", e->name);
+            }
+            if (e->ok && e->cmd == df::device_chemistry::reg().addr && this->_plan.chemistry != CHEMISTRY_COUNT) {
+                this->_chemistry = this->_plan.chemistry;   // The gauge now runs the planned chemistry
+            }
+        }
+        res &= e->ok;
+    }
+    return res;
+}
+
+/**
+ * @brief Result of one step after df_plan_apply()
+ * 
+ * @return bool True if every entry planned by the step is verified
+ */
+bool MeshSolar::df_plan_step_ok(uint8_t step) const {
+    if (step >= DF_PLAN_STEPS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < this->_plan.count; i++) {
+        const df_write_t *e = &this->_plan.entries[i];
+        if ((e->steps & (1 << step)) && !e->ok) {
             return false;
         }
     }
@@ -663,10 +996,10 @@ bool MeshSolar::get_advance_bat_realtime_setting(){
  * charging voltages and protection thresholds. This function configures the BQ4050
  * for optimal operation with different lithium battery chemistries.
  * 
- * @param None (uses cmd.basic.type from internal command structure)
+ * @param None (uses cmd.basic.chemistry from internal command structure)
  * @return bool True if all configuration writes successful, false on any failure
  * 
- * SUPPORTED BATTERY TYPES:
+ * SUPPORTED BATTERY TYPES (rows of chemistry_profiles[]):
  *   - "lifepo4": LiFePO4 (3.6V nominal, safer, more stable)
  *   - "liion": Li-ion (4.2V nominal, higher energy density)
  *   - "lipo": LiPo (4.2V nominal, similar to Li-ion)
@@ -708,7 +1041,7 @@ bool MeshSolar::get_advance_bat_realtime_setting(){
  *   - Total execution time: ~2-3 seconds
  *   - Suitable for configuration-time use only
  */
-bool MeshSolar::update_basic_bat_type_setting(){ 
+bool MeshSolar::plan_basic_bat_type_setting(){ 
     bool res = true;
 
     /*
@@ -734,166 +1067,51 @@ bool MeshSolar::update_basic_bat_type_setting(){
      *    - Helps prevent oscillation between protection modes
      */
 
-    // Define temperature-specific voltage configuration
-    struct temp_voltage_t {
-        uint16_t low_temp;     // Low temperature (-20°C to 0°C) - Conservative voltages
-        uint16_t std_temp;     // Standard temperature (0°C to 45°C) - Nominal voltages
-        uint16_t high_temp;    // High temperature (45°C to 60°C) - Reduced for safety
-        uint16_t rec_temp;     // Recovery/recommended temperature - Transition values
-    };
-
-    // Define complete battery voltage configuration
-    struct battery_voltage_config_t {
-        temp_voltage_t charge_voltage;   // Charge voltages for different temperatures
-        temp_voltage_t cov_threshold;    // Charge over-voltage thresholds
-        temp_voltage_t cov_recovery;     // Charge over-voltage recovery voltages
-    } config;
-
-    // Configuration table: {command, value, description}
-    struct config_entry_t {
-        uint16_t cmd;
-        uint16_t value;
-        const char* name;
-    };
-
-    const char *type = nullptr;
-    // Set voltage parameters based on battery type with temperature compensation
-    if(0 == strcasecmp(this->cmd.basic.type, "lifepo4")) {
-        // LiFePO4 (Lithium Iron Phosphate) characteristics:
-        // - More stable across temperatures than Li-ion
-        // - Lower nominal voltage (3.2V vs 3.7V for Li-ion)
-        // - Very flat discharge curve
-        // - Inherently safer chemistry but still needs temperature protection
-        config = {
-            .charge_voltage = {3600, 3600, 3600, 3600},  // Conservative at temp extremes
-            .cov_threshold  = {3750, 3750, 3750, 3750},  // Safety margins, esp. at extremes
-            .cov_recovery   = {3600, 3600, 3600, 3600}   // Match charge voltages for stability
-        };
-        type = "LFE4"; // Set battery type to LiFePO4 , bq4050 uses 4 character to store chemistry name
-    }
-    else if((0 == strcasecmp(this->cmd.basic.type, "lipo"))) {
-        // Li-ion/LiPo (Lithium Cobalt/Polymer) characteristics:
-        // - Higher energy density but more temperature-sensitive
-        // - Higher nominal voltage (3.7V) and charge voltage (4.2V)
-        // - More aggressive temperature derating required for safety
-        // - Risk of thermal runaway at high temperatures
-        config = {
-            .charge_voltage = {4200, 4200, 4200, 4200},  // Significant reduction at extremes
-            .cov_threshold  = {4300, 4300, 4300, 4300},  // Conservative safety margins
-            .cov_recovery   = {4100, 4100, 4100, 4100}   // Lower recovery for safety
-        };
-        type = "LIPO"; // Set battery type to LiPo , bq4050 uses 4 character to store chemistry name
-    }
-    else if((0 == strcasecmp(this->cmd.basic.type, "liion"))) {
-        // Li-ion/LiPo (Lithium Cobalt/Polymer) characteristics:
-        // - Higher energy density but more temperature-sensitive
-        // - Higher nominal voltage (3.7V) and charge voltage (4.2V)
-        // - More aggressive temperature derating required for safety
-        // - Risk of thermal runaway at high temperatures
-        config = {
-            .charge_voltage = {4200, 4200, 4200, 4200},  // Significant reduction at extremes
-            .cov_threshold  = {4300, 4300, 4300, 4300},  // Conservative safety margins
-            .cov_recovery   = {4100, 4100, 4100, 4100}   // Lower recovery for safety
-        };
-        type = "LION"; // Set battery type to Li-ion , bq4050 uses 4 character to store chemistry name
-    }
-    else {
-        // dbgSerial.println("Unknown battery type, exit!!!!!!!");
+    // Chemistry resolved when the command was parsed, see meshsolar_chemistry.h
+    const chemistry_profile_t *config = chemistry_profile(this->cmd.basic.chemistry);
+    if (config == nullptr) {
         LOG_E("Unknown battery type, exit!!!!!!!");
         return false;
     }
-
-    config_entry_t configurations[] = {
-        // Advanced charge algorithm voltages
-        {DF_CMD_ADVANCED_CHARGE_ALG_LOW_TEMP_CHARG_VOL,  config.charge_voltage.low_temp,  "DF_CMD_ADVANCED_CHARGE_ALG_LOW_TEMP_CHARG_VOL "},
-        {DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL,  config.charge_voltage.std_temp,  "DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL "},
-        {DF_CMD_ADVANCED_CHARGE_ALG_HIGH_TEMP_CHARG_VOL, config.charge_voltage.high_temp, "DF_CMD_ADVANCED_CHARGE_ALG_HIGH_TEMP_CHARG_VOL"},
-        {DF_CMD_ADVANCED_CHARGE_ALG_REC_TEMP_CHARG_VOL,  config.charge_voltage.rec_temp,  "DF_CMD_ADVANCED_CHARGE_ALG_REC_TEMP_CHARG_VOL "},
-        
-        // Protection COV thresholds
-        {DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR,  config.cov_threshold.low_temp,             "DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR           "},
-        {DF_CMD_PROTECTIONS_COV_STD_TEMP_THR,  config.cov_threshold.std_temp,             "DF_CMD_PROTECTIONS_COV_STD_TEMP_THR           "},
-        {DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR, config.cov_threshold.high_temp,            "DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR          "},
-        {DF_CMD_PROTECTIONS_COV_REC_TEMP_THR,  config.cov_threshold.rec_temp,             "DF_CMD_PROTECTIONS_COV_REC_TEMP_THR           "},
-        
-        // Protection COV recovery
-        {DF_CMD_PROTECTIONS_COV_LOW_TEMP_RECOVERY,  config.cov_recovery.low_temp,         "DF_CMD_PROTECTIONS_COV_LOW_TEMP_RECOVERY      "},
-        {DF_CMD_PROTECTIONS_COV_STD_TEMP_RECOVERY,  config.cov_recovery.std_temp,         "DF_CMD_PROTECTIONS_COV_STD_TEMP_RECOVERY      "},
-        {DF_CMD_PROTECTIONS_COV_HIGH_TEMP_RECOVERY, config.cov_recovery.high_temp,        "DF_CMD_PROTECTIONS_COV_HIGH_TEMP_RECOVERY     "},
-        {DF_CMD_PROTECTIONS_COV_REC_TEMP_RECOVERY,  config.cov_recovery.rec_temp,         "DF_CMD_PROTECTIONS_COV_REC_TEMP_RECOVERY      "},
-    };
-
-
-    // Helper lambda function to write and verify voltage setting
-    auto write_and_verify = [&](uint16_t cmd, uint16_t value, const char* name) -> bool {
-        bq4050_block_t block = {cmd, 2, (uint8_t*)&value, NUMBER};
-        bq4050_block_t ret = {cmd, 2, nullptr, NUMBER};
-
-        // Write the value
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", name);
-            return false;
-        }
-        delay(100);
-
-        // Read back and verify
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to read back %s", name);
-            return false;
-        }
-
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        if(value == read_value) {
-            LOG_I("%s set to: %d mV - OK", name, read_value);
-            return true; // Return true if the value matches
-        }
-        else{
-            LOG_E("%s set to: %d mV - ERROR (expected %d mV)", name, read_value, value);
-            return false; // Return false if the value does not match
-        }
-
-        return (value == read_value);
-    };
-
-
-    // Apply all configurations
-    for(auto& cfg : configurations) {
-        res &= write_and_verify(cfg.cmd, cfg.value, cfg.name);
-    }
+    this->_plan.chemistry = config->id;  // Becomes the CEDV default once DeviceChemistry verifies
+
+    // Advanced charge algorithm voltages
+    res &= this->df_plan<df::charge_voltage_low>(config->charge.low);
+    res &= this->df_plan<df::charge_voltage_std>(config->charge.std);
+    res &= this->df_plan<df::charge_voltage_high>(config->charge.high);
+    res &= this->df_plan<df::charge_voltage_rec>(config->charge.rec);
+
+    // Protection COV thresholds
+    res &= this->df_plan<df::cov_threshold_low>(config->cov.low);
+    res &= this->df_plan<df::cov_threshold_std>(config->cov.std);
+    res &= this->df_plan<df::cov_threshold_high>(config->cov.high);
+    res &= this->df_plan<df::cov_threshold_rec>(config->cov.rec);
+
+    // Protection COV recovery
+    res &= this->df_plan<df::cov_recovery_low>(config->cov_recovery.low);
+    res &= this->df_plan<df::cov_recovery_std>(config->cov_recovery.std);
+    res &= this->df_plan<df::cov_recovery_high>(config->cov_recovery.high);
+    res &= this->df_plan<df::cov_recovery_rec>(config->cov_recovery.rec);
 
     /*****************************************   bat type   *************************************/
-    bq4050_block_t block = {0, 0, nullptr, STRING}; // Declare and initialize block structure
-    block.cmd = DF_CMD_SBS_DATA_CHEMISTRY; // Command to access battery chemistry
-    block.len = 5; // Length of the data block to read
-    block.type = STRING; // Set block type to STRING
-    block.pvalue = (uint8_t*)malloc(block.len + 1); // Allocate memory for the value
-    if (block.pvalue == nullptr) {
-        LOG_E("Memory allocation failed for block.pvalue");
-        free(block.pvalue); // Free memory if allocation fails
-        return false; // Return false if memory allocation fails
-    }
-    memset(block.pvalue, 0, block.len); // Initialize the value to zero
-    block.pvalue[0] = strlen(type); // Set the first byte to the length of the battery type string
-    strlcpy((char *)block.pvalue + 1, type, block.len); // Copy the battery type string into the block value
-    this->_bq4050->write_dataflash_block(block); // Write the battery type
-    free(block.pvalue); // Free the allocated memory for block.pvalue
-    block.pvalue = nullptr; // Set pointer to null after freeing memory
-
-
-    delay(100); // Ensure the write is complete before reading
-    bq4050_block_t ret = {0, 0, nullptr, STRING}; // Reset block structure for reading
-    ret.cmd = block.cmd; // Command to access battery chemistry
-    ret.len = block.len; // Length of the data block to read
-    ret.type = block.type; // Set block type to STRING
-    this->_bq4050->read_dataflash_block(&ret); // Read the battery type back from data flash
-    if(0 == strcasecmp((const char *)(ret.pvalue), type)) {
-        LOG_I("DF_CMD_SBS_DATA_CHEMISTRY set to: %s - OK", (const char *)(ret.pvalue)); // Log success
-    }
-    else {
-        LOG_E("DF_CMD_SBS_DATA_CHEMISTRY set to: %s - ERROR", (const char *)(ret.pvalue)); // Log error
-        res = false; // If the read value does not match, set result to false
-    }
+    // bq4050 stores the chemistry as a length-prefixed string in a 5 byte block
+    res &= this->df_plan_string<df::device_chemistry>(config->gauge_id);
+
+    return res;
+}
 
+/**
+ * @brief Write and verify the battery type settings now
+ * 
+ * Single-command form of plan_basic_bat_type_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_basic_bat_type_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_basic_bat_type_setting();
+    res &= this->df_plan_apply();
     return res;
 }
 
@@ -938,7 +1156,7 @@ bool MeshSolar::update_basic_bat_model_setting() {
  * This function updates both the DA (Data Acquisition) configuration and the
  * total design voltage to match the cell count and chemistry.
  * 
- * @param None (uses cmd.basic.cell_number and cmd.basic.type from internal structure)
+ * @param None (uses cmd.basic.cell_number and cmd.basic.chemistry from internal structure)
  * @return bool True if cell configuration successful, false on any failure
  * 
  * PARAMETERS CONFIGURED:
@@ -948,7 +1166,7 @@ bool MeshSolar::update_basic_bat_model_setting() {
  *   
  *   Design Voltage:
  *   - Calculated as: cell_count × cell_voltage
- *   - Cell voltage based on battery chemistry:
+ *   - Cell voltage from the chemistry profile (design_cell_mv):
  *     * LiFePO4: 3600 mV per cell
  *     * Li-ion/LiPo: 4200 mV per cell
  * 
@@ -977,85 +1195,44 @@ bool MeshSolar::update_basic_bat_model_setting() {
  *   - 100ms delays after each DataFlash write
  *   - Total execution time: ~300-400ms
  */
-bool MeshSolar::update_basic_bat_cells_setting() {
+bool MeshSolar::plan_basic_bat_cells_setting() {
     bool res = true;
 
     // Get cell voltage based on battery type
-    uint16_t cell_voltage_mv = 0;
-    if(0 == strcasecmp(this->cmd.basic.type, "lifepo4")) {
-        cell_voltage_mv = 3600;
-    }
-    else if((0 == strcasecmp(this->cmd.basic.type, "liion")) || (0 == strcasecmp(this->cmd.basic.type, "lipo"))){
-        cell_voltage_mv = 4200;
-    }
-    else {
+    const chemistry_profile_t *profile = chemistry_profile(this->cmd.basic.chemistry);
+    if (profile == nullptr) {
         LOG_E("Unknown battery type, exit!!!!!!!");
         return false;
     }
+    uint16_t cell_voltage_mv = profile->design_cell_mv;
 
     /******************************************Configure DA Configuration (Cell Count)**************************************/ 
-    {
-        bq4050_block_t block = {DF_CMD_DA_CONFIGURATION, 1, nullptr, NUMBER};
-        
-        // Read current DA configuration
-        if (!this->_bq4050->read_dataflash_block(&block)) {
-            LOG_E("Failed to read DA configuration");
-            return false;
-        }
-        delay(100);
-
-        // Calculate cell count bits (0-3 for 1-4 cells)
-        uint8_t cells_bits = (this->cmd.basic.cell_number > 4) ? 3 : (this->cmd.basic.cell_number - 1);
-        
-        // Clear the last 2 bits first, then set new cell count bits
-        block.pvalue[0] &= 0b11111100; // Clear bits 0 and 1
-        block.pvalue[0] |= cells_bits;  // Set new cell count bits
-        
-        // Write the modified configuration
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write DA configuration");
-            return false;
-        }
-        delay(100);
-
-        // Read back and verify
-        bq4050_block_t ret = {DF_CMD_DA_CONFIGURATION, 1, nullptr, NUMBER};
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to verify DA configuration");
-            return false;
-        }
-
-        LOG_L("DF_CMD_DA_CONFIGURATION after: 0x%02X", ret.pvalue[0]);
-        res &= (ret.pvalue[0] == block.pvalue[0]);
-    }
+    // Calculate cell count bits (0-3 for 1-4 cells), only bits 0 and 1 are modified
+    uint8_t cells_bits = (this->cmd.basic.cell_number > 4) ? 3 : (this->cmd.basic.cell_number - 1);
+    res &= this->df_plan_bits<df::da_configuration>(0b00000011, cells_bits);
 
     /*********************************************************Configure Design Voltage***************************************/
-    {
-        uint16_t total_voltage = this->cmd.basic.cell_number * cell_voltage_mv;
-        bq4050_block_t block = {DF_CMD_GAS_GAUGE_DESIGN_VOLTAGE_MV, 2, (uint8_t*)&total_voltage, NUMBER};
-        
-        // Write design voltage
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write design voltage");
-            return false;
-        }
-        delay(100);
-
-        // Read back and verify
-        bq4050_block_t ret = {DF_CMD_GAS_GAUGE_DESIGN_VOLTAGE_MV, 2, nullptr, NUMBER};
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to verify design voltage");
-            return false;
-        }
-
-        uint16_t read_voltage = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        LOG_I("DF_CMD_GAS_GAUGE_DESIGN_VOLTAGE_MV after: %d mV", read_voltage);
-        res &= (read_voltage == total_voltage);
-    }
+    uint16_t total_voltage = this->cmd.basic.cell_number * cell_voltage_mv;
+    res &= this->df_plan<df::design_voltage>(total_voltage);
 
     return res; 
 }
 
+/**
+ * @brief Write and verify the cell count settings now
+ * 
+ * Single-command form of plan_basic_bat_cells_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_basic_bat_cells_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_basic_bat_cells_setting();
+    res &= this->df_plan_apply();
+    return res;
+}
+
 /**
  * @brief Configure BQ4050 design capacity in multiple formats
  * 
@@ -1064,7 +1241,7 @@ bool MeshSolar::update_basic_bat_cells_setting() {
  * as required by the BQ4050. Also initializes the learned capacity to match the
  * design capacity for proper gas gauge operation.
  * 
- * @param None (uses cmd.basic.design_capacity, cell_number, and type from internal structure)
+ * @param None (uses cmd.basic.design_capacity, cell_number, and chemistry from internal structure)
  * @return bool True if all capacity settings successful, false on any failure
  * 
  * PARAMETERS CONFIGURED:
@@ -1074,7 +1251,7 @@ bool MeshSolar::update_basic_bat_cells_setting() {
  *   
  *   Design Capacity (cWh):
  *   - Calculated as: (cell_count × cell_voltage × capacity_mAh) / 10
- *   - Cell voltage varies by chemistry (LiFePO4: 3.6V, Li-ion/LiPo: 4.2V)
+ *   - Cell voltage from the chemistry profile (LiFePO4: 3.6V, Li-ion/LiPo: 4.2V)
  *   
  *   Learned Full Charge Capacity:
  *   - Initially set to design capacity
@@ -1085,9 +1262,9 @@ bool MeshSolar::update_basic_bat_cells_setting() {
  *   - Example: 4S LiFePO4 3200mAh = (4 × 3.6 × 3200) / 10 = 4608 cWh
  * 
  * DATAFLASH COMMANDS USED:
- *   - DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH: Primary capacity
- *   - DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_CWH: Energy capacity
- *   - DF_CMD_GAS_GAUGE_STATE_LEARNED_FULL_CAPACITY: Learning baseline
+ *   - df::design_capacity_mah: Primary capacity
+ *   - df::design_capacity_cwh: Energy capacity
+ *   - df::learned_full_capacity: Learning baseline
  * 
  * ERROR HANDLING:
  *   - Validates battery type before calculations
@@ -1104,67 +1281,45 @@ bool MeshSolar::update_basic_bat_cells_setting() {
  *   - 100ms delays after each DataFlash write
  *   - Total execution time: ~400-500ms
  */
-bool MeshSolar::update_basic_bat_design_capacity_setting(){
+bool MeshSolar::plan_basic_bat_design_capacity_setting(){
     // Get cell voltage based on battery type
-    float cell_voltage = 0.0f;
     bool res = true;
-
-    if(0 == strcasecmp(this->cmd.basic.type, "lifepo4")) {
-        cell_voltage = 3.6f;
-    }
-    else if((0 == strcasecmp(this->cmd.basic.type, "liion")) || (0 == strcasecmp(this->cmd.basic.type, "lipo"))){
-        cell_voltage = 4.2f;
-    }
-    else {
+    const chemistry_profile_t *profile = chemistry_profile(this->cmd.basic.chemistry);
+    if (profile == nullptr) {
         LOG_E("Unknown battery type, exit!!!!!!!");
         return false;
     }
+    float cell_voltage = profile->design_cell_mv / 1000.0f;
 
     /*******************************************************Design Capacity mAh*******************************************/
-    {
-        uint16_t capacity = this->cmd.basic.design_capacity;
-        bq4050_block_t block = {DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH, 2, (uint8_t*)(&capacity), NUMBER};
-        this->_bq4050->write_dataflash_block(block);
-        delay(100);
-
-        bq4050_block_t ret = {DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH, 2, nullptr, NUMBER};
-        this->_bq4050->read_dataflash_block(&ret);
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        LOG_I("DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_MAH after: %d mAh", read_value);
-        res &= (capacity == read_value);
-    }
+    uint16_t capacity_mah = this->cmd.basic.design_capacity;
+    res &= this->df_plan<df::design_capacity_mah>(capacity_mah);
 
     /*******************************************************Design Capacity cWh******************************************/
-    {
-        uint16_t capacity = static_cast<uint16_t>(this->cmd.basic.cell_number * cell_voltage * this->cmd.basic.design_capacity / 10.0f);
-        bq4050_block_t block = {DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_CWH, 2, (uint8_t*)(&capacity), NUMBER};
-        this->_bq4050->write_dataflash_block(block);
-        delay(100);
-
-        bq4050_block_t ret = {DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_CWH, 2, nullptr, NUMBER};
-        this->_bq4050->read_dataflash_block(&ret);
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        LOG_I("DF_CMD_GAS_GAUGE_DESIGN_CAPACITY_CWH after: %d cWh", read_value);
-        res &= (capacity == read_value);
-    }
+    uint16_t capacity_cwh = static_cast<uint16_t>(this->cmd.basic.cell_number * cell_voltage * this->cmd.basic.design_capacity / 10.0f);
+    res &= this->df_plan<df::design_capacity_cwh>(capacity_cwh);
 
     /*******************************************************Learned Full Charge Capacity mAh*****************************/
-    {
-        uint16_t capacity = this->cmd.basic.design_capacity;
-        bq4050_block_t block = {DF_CMD_GAS_GAUGE_STATE_LEARNED_FULL_CAPACITY, 2, (uint8_t*)(&capacity), NUMBER};
-        this->_bq4050->write_dataflash_block(block);
-        delay(100);
-
-        bq4050_block_t ret = {DF_CMD_GAS_GAUGE_STATE_LEARNED_FULL_CAPACITY, 2, nullptr, NUMBER};
-        this->_bq4050->read_dataflash_block(&ret);
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        LOG_I("DF_CMD_GAS_GAUGE_STATE_LEARNED_FULL_CAPACITY after: %d mAh", read_value);
-        res &= (capacity == read_value);
-    }
+    res &= this->df_plan<df::learned_full_capacity>(capacity_mah);
 
     return res;
 }
 
+/**
+ * @brief Write and verify the design capacity settings now
+ * 
+ * Single-command form of plan_basic_bat_design_capacity_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_basic_bat_design_capacity_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_basic_bat_design_capacity_setting();
+    res &= this->df_plan_apply();
+    return res;
+}
+
 /**
  * @brief Configure BQ4050 discharge cutoff voltage and protection levels
  * 
@@ -1197,10 +1352,10 @@ bool MeshSolar::update_basic_bat_design_capacity_setting(){
  *   - Recovery voltages higher than thresholds
  * 
  * DATAFLASH COMMANDS CONFIGURED:
- *   - DF_CMD_GAS_GAUGE_FD_SET/CLEAR_VOLTAGE_THR: Final discharge
- *   - DF_CMD_GAS_GAUGE_TD_SET/CLEAR_VOLTAGE_THR: Terminate discharge
- *   - DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV*: End discharge warnings
- *   - DF_CMD_PROTECTIONS_CUV_THR/RECOVERY: Hardware protection
+ *   - df::fd_set/clear_voltage: Final discharge
+ *   - df::td_set/clear_voltage: Terminate discharge
+ *   - df::edv0-2: End discharge warnings
+ *   - df::cuv_threshold/recovery: Hardware protection
  * 
  * ERROR HANDLING:
  *   - Verifies all DataFlash writes by reading back
@@ -1216,7 +1371,7 @@ bool MeshSolar::update_basic_bat_design_capacity_setting(){
  *   - 100ms delays after each DataFlash write
  *   - Total execution time: ~1-1.5 seconds
  */
-bool MeshSolar::update_basic_bat_discharge_cutoff_voltage_setting(){
+bool MeshSolar::plan_basic_bat_discharge_cutoff_voltage_setting(){
     bool res = true;
     
     /*
@@ -1232,69 +1387,41 @@ bool MeshSolar::update_basic_bat_discharge_cutoff_voltage_setting(){
      * These settings work together to provide multi-level protection during discharge.
      */
 
-    // Define base voltages from configuration
-    uint16_t cutoff_base = this->cmd.basic.discharge_cutoff_voltage;
-
-    // Configuration table: {command, voltage_offset, description}
-    struct cutoff_config_entry_t {
-        uint16_t cmd;
-        int16_t  offest;  // Offset from base cutoff voltage (can be negative)
-        const char* name;
-    };
-
+    // Signed base so a cutoff below the CUV margin is rejected, not wrapped
+    int32_t cutoff_base = this->cmd.basic.discharge_cutoff_voltage;
 
-    // Helper lambda function to write and verify voltage setting
-    auto write_and_verify = [&](uint16_t cmd, uint16_t value, const char* name) -> bool {
-        bq4050_block_t block = {cmd, 2, (uint8_t*)&value, NUMBER};
-        bq4050_block_t ret = {cmd, 2, nullptr, NUMBER};
+    // Gas Gauging - Final Discharge (FD) thresholds
+    res &= this->df_plan<df::fd_set_voltage>(cutoff_base);            // Lowest discharge voltage
+    res &= this->df_plan<df::fd_clear_voltage>(cutoff_base + 100);    // Recovery voltage (+100mV)
 
-        // Write the value
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", name);
-            return false;
-        }
-        delay(100);
+    // Gas Gauging - Terminate Discharge (TD) thresholds
+    res &= this->df_plan<df::td_set_voltage>(cutoff_base);            // Same as FD set
+    res &= this->df_plan<df::td_clear_voltage>(cutoff_base + 100);    // Recovery voltage (+100mV)
 
-        // Read back and verify
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to read back %s", name);
-            return false;
-        }
+    // Gas Gauging - End Discharge Voltage (EDV) stepped warnings
+    res &= this->df_plan<df::edv0>(cutoff_base);                      // First warning level
+    res &= this->df_plan<df::edv1>(cutoff_base + 20);                 // Second warning (+20mV)
+    res &= this->df_plan<df::edv2>(cutoff_base + 30);                 // Third warning (+30mV)
 
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        if (value == read_value) {
-            LOG_I("%s set to: %d mV - OK", name, read_value); // Log success
-            return true;
-        } else {
-            LOG_E("%s set to: %d mV - ERROR (expected %d mV)", name, read_value, value); // Log error
-            return false;
-        }
-    };
-    cutoff_config_entry_t configurations[] = {
-        // Gas Gauging - Final Discharge (FD) thresholds
-        {DF_CMD_GAS_GAUGE_FD_SET_VOLTAGE_THR,   0,    "FD Set Voltage Threshold                      "},      // Lowest discharge voltage
-        {DF_CMD_GAS_GAUGE_FD_CLEAR_VOLTAGE_THR, 100,  "FD Clear Voltage Threshold                    "},    // Recovery voltage (+100mV)
-        
-        // Gas Gauging - Terminate Discharge (TD) thresholds  
-        {DF_CMD_GAS_GAUGE_TD_SET_VOLTAGE_THR,   0,    "TD Set Voltage Threshold                      "},      // Same as FD set
-        {DF_CMD_GAS_GAUGE_TD_CLEAR_VOLTAGE_THR, 100,  "TD Clear Voltage Threshold                    "},    // Recovery voltage (+100mV)
-        
-        // Gas Gauging - End Discharge Voltage (EDV) stepped warnings
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0,  0,    "CEDV Fixed EDV0                               "},              // First warning level
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV1,  20,   "CEDV Fixed EDV1                               "},              // Second warning (+20mV)
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV2,  30,   "CEDV Fixed EDV2                               "},              // Third warning (+30mV)
-        
-        // Protection - Cell Under Voltage (CUV) hardware protection
-        {DF_CMD_PROTECTIONS_CUV_THR,           -50,   "CUV Protection Threshold                      "},      // Hardware cutoff (-50mV for safety margin)
-        {DF_CMD_PROTECTIONS_CUV_RECOVERY,      100,   "CUV Recovery Voltage                          "}           // Recovery to re-enable (+100mV)
-    };
+    // Protection - Cell Under Voltage (CUV) hardware protection
+    res &= this->df_plan<df::cuv_threshold>(cutoff_base - 50);        // Hardware cutoff (-50mV for safety margin)
+    res &= this->df_plan<df::cuv_recovery>(cutoff_base + 100);        // Recovery to re-enable (+100mV)
 
-    // Apply all discharge cutoff configurations
-    for(auto& cfg : configurations) {
-        uint16_t target_voltage = cutoff_base + cfg.offest;
-        res &= write_and_verify(cfg.cmd, target_voltage, cfg.name);
-    }
+    return res;
+}
 
+/**
+ * @brief Write and verify the discharge cutoff settings now
+ * 
+ * Single-command form of plan_basic_bat_discharge_cutoff_voltage_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_basic_bat_discharge_cutoff_voltage_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_basic_bat_discharge_cutoff_voltage_setting();
+    res &= this->df_plan_apply();
     return res;
 }
 
@@ -1358,7 +1485,7 @@ bool MeshSolar::update_basic_bat_discharge_cutoff_voltage_setting(){
  *   - 100ms delays after each DataFlash write
  *   - Total execution time: ~1.5-2 seconds
  */
-bool MeshSolar::update_basic_bat_temp_protection_setting() {
+bool MeshSolar::plan_basic_bat_temp_protection_setting() {
     bool res = true;
     
     /*
@@ -1374,25 +1501,6 @@ bool MeshSolar::update_basic_bat_temp_protection_setting() {
      * Each protection has threshold and recovery values to prevent oscillation
      */
 
-    // Define temperature protection structure
-    struct temp_protection_t {
-        int16_t otc_threshold;    // Over Temperature Charge threshold (0.1°C units)
-        int16_t otc_recovery;     // Over Temperature Charge recovery (0.1°C units)
-        int16_t utc_threshold;    // Under Temperature Charge threshold (0.1°C units)
-        int16_t utc_recovery;     // Under Temperature Charge recovery (0.1°C units)
-        int16_t otd_threshold;    // Over Temperature Discharge threshold (0.1°C units)
-        int16_t otd_recovery;     // Over Temperature Discharge recovery (0.1°C units)
-        int16_t utd_threshold;    // Under Temperature Discharge threshold (0.1°C units)
-        int16_t utd_recovery;     // Under Temperature Discharge recovery (0.1°C units)
-    } config;
-
-    // Configuration table: {command, value, description}
-    struct config_entry_t {
-        uint16_t cmd;
-        int16_t value;
-        const char* name;
-    };
-
     // Get temperature values from configuration and validate
     float charge_high    = this->cmd.basic.protection.charge_high_temp_c;
     float charge_low     = this->cmd.basic.protection.charge_low_temp_c;
@@ -1409,65 +1517,17 @@ bool MeshSolar::update_basic_bat_temp_protection_setting() {
 
     // Set temperature protection parameters with hysteresis
     // Convert to BQ4050 format (0.1°C units) and apply 5°C hysteresis
-    config = {
-        .otc_threshold = (int16_t)(charge_high * 10),           // Charge over temperature threshold
-        .otc_recovery  = (int16_t)((charge_high - 5) * 10),     // 5°C lower for recovery
-        .utc_threshold = (int16_t)(charge_low * 10),            // Charge under temperature threshold
-        .utc_recovery  = (int16_t)((charge_low + 5) * 10),      // 5°C higher for recovery
-        .otd_threshold = (int16_t)(discharge_high * 10),        // Discharge over temperature threshold
-        .otd_recovery  = (int16_t)((discharge_high - 5) * 10),  // 5°C lower for recovery
-        .utd_threshold = (int16_t)(discharge_low * 10),         // Discharge under temperature threshold
-        .utd_recovery  = (int16_t)((discharge_low + 5) * 10)    // 5°C higher for recovery
-    };
-
-    config_entry_t configurations[] = {
-        // Charge temperature protections
-        {DF_CMD_PROTECTIONS_OTC_THR,      config.otc_threshold, "DF_CMD_PROTECTIONS_OTC_THR                    "},
-        {DF_CMD_PROTECTIONS_OTC_RECOVERY, config.otc_recovery,  "DF_CMD_PROTECTIONS_OTC_RECOVERY               "},
-        {DF_CMD_PROTECTIONS_UTC_THR,      config.utc_threshold, "DF_CMD_PROTECTIONS_UTC_THR                    "},
-        {DF_CMD_PROTECTIONS_UTC_RECOVERY, config.utc_recovery,  "DF_CMD_PROTECTIONS_UTC_RECOVERY               "},
-        
-        // Discharge temperature protections
-        {DF_CMD_PROTECTIONS_OTD_THR,      config.otd_threshold, "DF_CMD_PROTECTIONS_OTD_THR                    "},
-        {DF_CMD_PROTECTIONS_OTD_RECOVERY, config.otd_recovery,  "DF_CMD_PROTECTIONS_OTD_RECOVERY               "},
-        {DF_CMD_PROTECTIONS_UTD_THR,      config.utd_threshold, "DF_CMD_PROTECTIONS_UTD_THR                    "},
-        {DF_CMD_PROTECTIONS_UTD_RECOVERY, config.utd_recovery,  "DF_CMD_PROTECTIONS_UTD_RECOVERY               "}
-    };
-
-    // Helper lambda function to write and verify temperature setting
-    auto write_and_verify = [&](uint16_t cmd, int16_t value, const char* name) -> bool {
-        bq4050_block_t block = {cmd, 2, (uint8_t*)&value, NUMBER};
-        bq4050_block_t ret = {cmd, 2, nullptr, NUMBER};
-
-        // Write the value
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", name);
-            return false;
-        }
-        delay(100);
-
-        // Read back and verify
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to read back %s", name);
-            return false;
-        }
-
-        int16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        float temp_celsius = read_value / 10.0f;  // Convert from 0.1°C units to °C
-        if (value == read_value) {
-            LOG_I("%s set to: %.1f°C - OK", name, temp_celsius); // Log success
-            return true;
-        } else {
-            float expected_celsius = value / 10.0f;  // Convert expected value to °C
-            LOG_E("%s set to: %.1f°C - ERROR (expected %.1f°C)", name, temp_celsius, expected_celsius); // Log error
-            return false;
-        }
-    };
-
-    // Apply all temperature protection configurations
-    for(auto& cfg : configurations) {
-        res &= write_and_verify(cfg.cmd, cfg.value, cfg.name);
-    }
+    // Charge temperature protections
+    res &= this->df_plan<df::otc_threshold>((int32_t)(charge_high * 10));             // Charge over temperature threshold
+    res &= this->df_plan<df::otc_recovery>((int32_t)((charge_high - 5) * 10));        // 5°C lower for recovery
+    res &= this->df_plan<df::utc_threshold>((int32_t)(charge_low * 10));              // Charge under temperature threshold
+    res &= this->df_plan<df::utc_recovery>((int32_t)((charge_low + 5) * 10));         // 5°C higher for recovery
+
+    // Discharge temperature protections
+    res &= this->df_plan<df::otd_threshold>((int32_t)(discharge_high * 10));          // Discharge over temperature threshold
+    res &= this->df_plan<df::otd_recovery>((int32_t)((discharge_high - 5) * 10));     // 5°C lower for recovery
+    res &= this->df_plan<df::utd_threshold>((int32_t)(discharge_low * 10));           // Discharge under temperature threshold
+    res &= this->df_plan<df::utd_recovery>((int32_t)((discharge_low + 5) * 10));      // 5°C higher for recovery
 
     /****************************************** protection enable/disable ******************************************/
     // Configure temperature protection enable/disable for both registers:
@@ -1477,82 +1537,32 @@ bool MeshSolar::update_basic_bat_temp_protection_setting() {
     // Protection Enable D - controls discharge temperature protections:
     //   Bit 2: UTD (Under Temperature Discharge) protection enable  
     //   Bit 3: UTC (Under Temperature Charge) protection enable
-    
-    // Helper lambda to configure protection enable bits
-    auto configure_protection_register = [&](uint16_t cmd, uint8_t bit_mask, 
-                                             const char* reg_name, const char* bit_desc) -> bool {
-        bq4050_block_t block = {cmd, 1, nullptr, NUMBER};
-        
-        // Read current register value
-        if (!this->_bq4050->read_dataflash_block(&block)) {
-            // dbgSerial.print("Failed to read ");
-            // dbgSerial.println(reg_name);
-            LOG_E("Failed to read %s", reg_name);
-            return false;
-        }
-        
-        uint8_t register_value = block.pvalue[0];
-        
-        if (this->cmd.basic.protection.enabled) {
-            // Enable temperature protection: set specified bits
-            register_value |= bit_mask;
-            LOG_I("Temperature protection enabled in %s (%s set)", reg_name, bit_desc);
-        } else {
-            // Disable temperature protection: clear specified bits
-            register_value &= ~bit_mask;
-            LOG_I("Temperature protection disabled in %s (%s cleared)", reg_name, bit_desc);
-        }
-        
-        // Write the modified register value back to the device
-        block.pvalue[0] = register_value;
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", reg_name);
-            return false;
-        }
-        delay(100);
-        
-        // Read back and verify the setting
-        bq4050_block_t verify_block = {cmd, 1, nullptr, NUMBER};
-        if (!this->_bq4050->read_dataflash_block(&verify_block)) {
-            LOG_E("Failed to verify %s", reg_name);
-            return false;
-        }
-        
-        uint8_t verified_value = verify_block.pvalue[0];
-        LOG_I("%s after: 0x%02X", reg_name, verified_value); // Log the register value
-        
-        // Check if bits are set correctly
-        bool bits_match_expected = ((verified_value & bit_mask) != 0) == this->cmd.basic.protection.enabled;
-        
-        if (bits_match_expected) {
-            LOG_I("%s temperature protection bits verified - OK", reg_name); // Log success
-            return true;
-        } else {
-            LOG_E("%s temperature protection bits verification failed - ERROR", reg_name); // Log error
-            LOG_E("  Expected: %s, Actual bits (%s): %s", 
-                  this->cmd.basic.protection.enabled ? "enabled" : "disabled",
-                  bit_desc,
-                  (verified_value & bit_mask) != 0 ? "set" : "clear");
+    // Only these bits are modified, the other protections keep their current state.
+    bool enabled = this->cmd.basic.protection.enabled;
 
-            return false;
-        }
-    };
-    
     // Configure Protection Enable B register (OTC: bit 5, OTD: bit 4)
     const uint8_t PROTECTION_B_TEMP_MASK = 0b00110000; // Bits 4 and 5 (OTD and OTC)
-    res &= configure_protection_register(DF_CMD_SETTINGS_PROTECTIONS_ENABLE_B, 
-                                        PROTECTION_B_TEMP_MASK,
-                                        "Protection Enable B", 
-                                        "bits 4,5 OTD/OTC");
-    
+    res &= this->df_plan_bits<df::protection_enable_b>(PROTECTION_B_TEMP_MASK, enabled ? PROTECTION_B_TEMP_MASK : 0);
+
     // Configure Protection Enable D register (UTC: bit 3, UTD: bit 2)  
     const uint8_t PROTECTION_D_TEMP_MASK = 0b00001100; // Bits 2 and 3 (UTD and UTC)
-    res &= configure_protection_register(DF_CMD_SETTINGS_PROTECTIONS_ENABLE_D,
-                                        PROTECTION_D_TEMP_MASK,
-                                        "Protection Enable D",
-                                        "bits 2,3 UTD/UTC");
+    res &= this->df_plan_bits<df::protection_enable_d>(PROTECTION_D_TEMP_MASK, enabled ? PROTECTION_D_TEMP_MASK : 0);
 
+    return res;
+}
 
+/**
+ * @brief Write and verify the temperature protection settings now
+ * 
+ * Single-command form of plan_basic_bat_temp_protection_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_basic_bat_temp_protection_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_basic_bat_temp_protection_setting();
+    res &= this->df_plan_apply();
     return res;
 }
 
@@ -1588,9 +1598,9 @@ bool MeshSolar::update_basic_bat_temp_protection_setting() {
  *   - Suitable for custom battery profiles
  * 
  * DATAFLASH COMMANDS USED:
- *   - DF_CMD_PROTECTIONS_CUV_THR: Under-voltage protection
- *   - DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL: Charge voltage
- *   - DF_CMD_PROTECTIONS_COV_STD_TEMP_THR: Over-voltage protection
+ *   - df::cuv_threshold/recovery: Under-voltage protection
+ *   - df::charge_voltage_*: Charge voltages
+ *   - df::cov_threshold_*, df::cov_recovery_*: Over-voltage protection
  * 
  * ERROR HANDLING:
  *   - Verifies all DataFlash writes by reading back
@@ -1611,7 +1621,7 @@ bool MeshSolar::update_basic_bat_temp_protection_setting() {
  *   - Provides fine-tuning of protection parameters
  *   - Used with advance command from JSON interface
  */
-bool MeshSolar::update_advance_bat_battery_setting() {
+bool MeshSolar::plan_advance_bat_battery_setting() {
     bool res = true;
     /*
      * Advanced battery configuration for BQ4050
@@ -1625,73 +1635,45 @@ bool MeshSolar::update_advance_bat_battery_setting() {
      * - Charge over-voltage protection thresholds
      */
 
-    // Configuration table: {command, value, description}
-    struct config_entry_t {
-        uint16_t cmd;
-        uint16_t value;
-        const char* name;
-    };
+    const advance_battery_config_t *battery = &this->cmd.advance.battery;
 
-    // Define configurations using advance command parameters
-    config_entry_t configurations[] = {
-        // CUV protection settings
-        {DF_CMD_PROTECTIONS_CUV_THR,                          (uint16_t)this->cmd.advance.battery.cuv,                                   "DF_CMD_PROTECTIONS_CUV_THR                         "},
-        {DF_CMD_PROTECTIONS_CUV_RECOVERY,                     (uint16_t)(this->cmd.advance.battery.cuv + 100),                           "DF_CMD_PROTECTIONS_CUV_RECOVERY                    "},
-        // Advanced charge algorithm - EOC voltages for all temperature ranges
-        {DF_CMD_ADVANCED_CHARGE_ALG_LOW_TEMP_CHARG_VOL,       (uint16_t)this->cmd.advance.battery.eoc,                                   "DF_CMD_ADVANCED_CHARGE_ALG_LOW_TEMP_CHARG_VOL      "},
-        {DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL,       (uint16_t)this->cmd.advance.battery.eoc,                                   "DF_CMD_ADVANCED_CHARGE_ALG_STD_TEMP_CHARG_VOL      "},
-        {DF_CMD_ADVANCED_CHARGE_ALG_HIGH_TEMP_CHARG_VOL,      (uint16_t)this->cmd.advance.battery.eoc,                                   "DF_CMD_ADVANCED_CHARGE_ALG_HIGH_TEMP_CHARG_VOL     "},
-        {DF_CMD_ADVANCED_CHARGE_ALG_REC_TEMP_CHARG_VOL,       (uint16_t)this->cmd.advance.battery.eoc,                                   "DF_CMD_ADVANCED_CHARGE_ALG_REC_TEMP_CHARG_VOL      "},
-        // Charge over-voltage protection thresholds for all temperature ranges
-        {DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR                "},
-        {DF_CMD_PROTECTIONS_COV_STD_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_STD_TEMP_THR                "},
-        {DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR,                (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR               "},
-        {DF_CMD_PROTECTIONS_COV_REC_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_REC_TEMP_THR                "},
-        // Protection COV thresholds settings
-        {DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_LOW_TEMP_THR                "},
-        {DF_CMD_PROTECTIONS_COV_STD_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_STD_TEMP_THR                "},
-        {DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR,                (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_HIGH_TEMP_THR               "},
-        {DF_CMD_PROTECTIONS_COV_REC_TEMP_THR,                 (uint16_t)this->cmd.advance.battery.eoc_protect,                           "DF_CMD_PROTECTIONS_COV_REC_TEMP_THR                "},
-        // Protection COV recovery settings
-        {DF_CMD_PROTECTIONS_COV_LOW_TEMP_RECOVERY,            (uint16_t)(this->cmd.advance.battery.eoc_protect - 100),                   "DF_CMD_PROTECTIONS_COV_LOW_TEMP_RECOVERY           "},
-        {DF_CMD_PROTECTIONS_COV_STD_TEMP_RECOVERY,            (uint16_t)(this->cmd.advance.battery.eoc_protect - 100),                   "DF_CMD_PROTECTIONS_COV_STD_TEMP_RECOVERY           "},
-        {DF_CMD_PROTECTIONS_COV_HIGH_TEMP_RECOVERY,           (uint16_t)(this->cmd.advance.battery.eoc_protect - 100),                   "DF_CMD_PROTECTIONS_COV_HIGH_TEMP_RECOVERY          "},
-        {DF_CMD_PROTECTIONS_COV_REC_TEMP_RECOVERY,            (uint16_t)(this->cmd.advance.battery.eoc_protect - 100),                   "DF_CMD_PROTECTIONS_COV_REC_TEMP_RECOVERY           "}
-    };
+    // CUV protection settings
+    res &= this->df_plan<df::cuv_threshold>(battery->cuv);
+    res &= this->df_plan<df::cuv_recovery>(battery->cuv + 100);
 
-    // Helper lambda function to write and verify voltage setting
-    auto write_and_verify = [&](uint16_t cmd, uint16_t value, const char* name) -> bool {
-        bq4050_block_t block = {cmd, 2, (uint8_t*)&value, NUMBER};
-        bq4050_block_t ret = {cmd, 2, nullptr, NUMBER};
-
-        // Write the value
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", name);
-            return false;
-        }
-        delay(100);
+    // Advanced charge algorithm - EOC voltages for all temperature ranges
+    res &= this->df_plan<df::charge_voltage_low>(battery->eoc);
+    res &= this->df_plan<df::charge_voltage_std>(battery->eoc);
+    res &= this->df_plan<df::charge_voltage_high>(battery->eoc);
+    res &= this->df_plan<df::charge_voltage_rec>(battery->eoc);
 
-        // Read back and verify
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to read back %s", name);
-            return false;
-        }
+    // Charge over-voltage protection thresholds for all temperature ranges
+    res &= this->df_plan<df::cov_threshold_low>(battery->eoc_protect);
+    res &= this->df_plan<df::cov_threshold_std>(battery->eoc_protect);
+    res &= this->df_plan<df::cov_threshold_high>(battery->eoc_protect);
+    res &= this->df_plan<df::cov_threshold_rec>(battery->eoc_protect);
 
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8);
-        if (value == read_value) {
-            LOG_I("%s set to: %d mV - OK", name, read_value);
-            return true;
-        } else {
-            LOG_E("%s set to: %d mV - ERROR (expected %d mV)", name, read_value, value);
-            return false;
-        }
-    };
+    // Protection COV recovery settings
+    res &= this->df_plan<df::cov_recovery_low>(battery->eoc_protect - 100);
+    res &= this->df_plan<df::cov_recovery_std>(battery->eoc_protect - 100);
+    res &= this->df_plan<df::cov_recovery_high>(battery->eoc_protect - 100);
+    res &= this->df_plan<df::cov_recovery_rec>(battery->eoc_protect - 100);
 
-    // Apply all configurations
-    for(auto& cfg : configurations) {
-        res &= write_and_verify(cfg.cmd, cfg.value, cfg.name);
-    }
+    return res;
+}
 
+/**
+ * @brief Write and verify the advanced battery settings now
+ * 
+ * Single-command form of plan_advance_bat_battery_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_advance_bat_battery_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_advance_bat_battery_setting();
+    res &= this->df_plan_apply();
     return res;
 }
 
@@ -1731,10 +1713,10 @@ bool MeshSolar::update_advance_bat_battery_setting() {
  * 
  * DATAFLASH COMMANDS CONFIGURED:
  *   Fixed Values:
- *   - DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0/1/2
+ *   - df::edv0/1/2
  *   
  *   Profile Points:
- *   - DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_0 through _100
+ *   - df::cedv_voltage_0 through _100
  *   - Total of 11 voltage points defining the curve
  * 
  * ERROR HANDLING:
@@ -1742,6 +1724,7 @@ bool MeshSolar::update_advance_bat_battery_setting() {
  *   - Returns false on any verification failure
  *   - Detailed logging of all profile points
  *   - Stops on first failure to prevent partial configuration
+ *   - A left out field with the chemistry still unknown rejects the plan
  * 
  * PLATFORM NOTES:
  *   - Uses standard BQ4050 DataFlash operations
@@ -1757,7 +1740,7 @@ bool MeshSolar::update_advance_bat_battery_setting() {
  *   - Critical for accurate SOC reporting
  *   - Should match actual battery discharge characteristics
  */
-bool MeshSolar::update_advance_bat_cedv_setting(){
+bool MeshSolar::plan_advance_bat_cedv_setting(){
     bool res = true; // Initialize result variable
 
     /*
@@ -1770,64 +1753,64 @@ bool MeshSolar::update_advance_bat_cedv_setting(){
      * - CEDV voltage thresholds
      */
 
-    // Configuration table: {command, value, description}
-    struct config_entry_t {
-        uint16_t cmd;
-        uint16_t value;
-        const char* name;
-    };
-
-    // Define configurations using advance command parameters
-    config_entry_t configurations[] = {
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0,       (uint16_t)this->cmd.advance.cedv.cedv0,             "DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV0               "},
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV1,       (uint16_t)this->cmd.advance.cedv.cedv1,             "DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV1               "},
-        {DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV2,       (uint16_t)this->cmd.advance.cedv.cedv2,             "DF_CMD_GAS_GAUGE_CEDV_CFG_FIXED_EDV2               "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_0,   (uint16_t)this->cmd.advance.cedv.discharge_cedv0,   "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_0           "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_10,  (uint16_t)this->cmd.advance.cedv.discharge_cedv10,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_10          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_20,  (uint16_t)this->cmd.advance.cedv.discharge_cedv20,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_20          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_30,  (uint16_t)this->cmd.advance.cedv.discharge_cedv30,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_30          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_40,  (uint16_t)this->cmd.advance.cedv.discharge_cedv40,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_40          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_50,  (uint16_t)this->cmd.advance.cedv.discharge_cedv50,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_50          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_60,  (uint16_t)this->cmd.advance.cedv.discharge_cedv60,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_60          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_70,  (uint16_t)this->cmd.advance.cedv.discharge_cedv70,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_70          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_80,  (uint16_t)this->cmd.advance.cedv.discharge_cedv80,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_80          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_90,  (uint16_t)this->cmd.advance.cedv.discharge_cedv90,  "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_90          "},
-        {DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_100, (uint16_t)this->cmd.advance.cedv.discharge_cedv100, "DF_CMD_GAS_GAUGE_CEDV_PROFILE1_VOLTAGE_100         "},
-    };
-
-
-    // Helper lambda function to write and verify voltage setting
-    auto write_and_verify = [&](uint16_t cmd, uint16_t value, const char* name) -> bool {
-        // Create a block structure for writing and reading data flash  
-        bq4050_block_t block = {cmd, 2, (uint8_t*)&value, NUMBER};
-        bq4050_block_t ret = {cmd, 2, nullptr, NUMBER};
-        // Write the value to data flash
-        if (!this->_bq4050->write_dataflash_block(block)) {
-            LOG_E("Failed to write %s", name);
-            return false;
-        }
-        delay(100); // Ensure the write is complete before reading
-        // Read back the value from data flash
-        if (!this->_bq4050->read_dataflash_block(&ret)) {
-            LOG_E("Failed to read back %s", name);
-            return false;
-        }
-        uint16_t read_value = ret.pvalue[0] | (ret.pvalue[1] << 8); // Combine two bytes into a single value
-        if (value == read_value) {
-            LOG_I("%s set to: %d mV - OK", name, read_value); // Log success
-            return true;
-        } else {
-            LOG_E("%s set to: %d mV - ERROR (expected %d mV)", name, read_value, value); // Log error
-            return false;
+    // A field the command left out (0) takes the default curve of the configured chemistry:
+    // the one planned alongside (batch), else the last one verified or read back
+    const chemistry_profile_t   *profile = chemistry_profile(
+        (this->_plan.chemistry != CHEMISTRY_COUNT) ? this->_plan.chemistry : this->_chemistry);
+    const advance_cedv_config_t *cedv    = &this->cmd.advance.cedv;
+    if (profile == nullptr) {
+        // Chemistry not known yet (no config and no successful read since boot): never guess a curve
+        const int given[] = {cedv->cedv0, cedv->cedv1, cedv->cedv2,
+                             cedv->discharge_cedv0, cedv->discharge_cedv10, cedv->discharge_cedv20,
+                             cedv->discharge_cedv30, cedv->discharge_cedv40, cedv->discharge_cedv50,
+                             cedv->discharge_cedv60, cedv->discharge_cedv70, cedv->discharge_cedv80,
+                             cedv->discharge_cedv90, cedv->discharge_cedv100};
+        for (int v : given) {
+            if (v == 0) {
+                LOG_E("CEDV field missing and battery chemistry unknown, send every field or a config first");
+                this->_plan.rejected = true;
+                return false;
+            }
         }
-    };
-    // Apply all configurations
-    for(auto& cfg : configurations) {
-        res &= write_and_verify(cfg.cmd, cfg.value, cfg.name);
+        static const chemistry_profile_t no_defaults = {};     // Every field is given, nothing is taken from it
+        profile = &no_defaults;
     }
+    auto pick = [](int value, uint16_t fallback) -> int32_t {
+        return (value != 0) ? value : fallback;
+    };
+
+    res &= this->df_plan<df::edv0>(pick(cedv->cedv0, profile->edv[0]));
+    res &= this->df_plan<df::edv1>(pick(cedv->cedv1, profile->edv[1]));
+    res &= this->df_plan<df::edv2>(pick(cedv->cedv2, profile->edv[2]));
+    res &= this->df_plan<df::cedv_voltage_0>(pick(cedv->discharge_cedv0, profile->cedv[0]));
+    res &= this->df_plan<df::cedv_voltage_10>(pick(cedv->discharge_cedv10, profile->cedv[1]));
+    res &= this->df_plan<df::cedv_voltage_20>(pick(cedv->discharge_cedv20, profile->cedv[2]));
+    res &= this->df_plan<df::cedv_voltage_30>(pick(cedv->discharge_cedv30, profile->cedv[3]));
+    res &= this->df_plan<df::cedv_voltage_40>(pick(cedv->discharge_cedv40, profile->cedv[4]));
+    res &= this->df_plan<df::cedv_voltage_50>(pick(cedv->discharge_cedv50, profile->cedv[5]));
+    res &= this->df_plan<df::cedv_voltage_60>(pick(cedv->discharge_cedv60, profile->cedv[6]));
+    res &= this->df_plan<df::cedv_voltage_70>(pick(cedv->discharge_cedv70, profile->cedv[7]));
+    res &= this->df_plan<df::cedv_voltage_80>(pick(cedv->discharge_cedv80, profile->cedv[8]));
+    res &= this->df_plan<df::cedv_voltage_90>(pick(cedv->discharge_cedv90, profile->cedv[9]));
+    res &= this->df_plan<df::cedv_voltage_100>(pick(cedv->discharge_cedv100, profile->cedv[10]));
     return res; // Return the result of all configurations
 }
 
+/**
+ * @brief Write and verify the CEDV profile settings now
+ * 
+ * Single-command form of plan_advance_bat_cedv_setting(): plans the entries, writes them and
+ * reads each one back before returning.
+ * 
+ * @return bool True if the settings were accepted and every write verified
+ */
+bool MeshSolar::update_advance_bat_cedv_setting(){
+    this->df_plan_begin();
+    bool res = this->plan_advance_bat_cedv_setting();
+    res &= this->df_plan_apply();
+    return res;
+}
+
 /**
  * @brief Toggle BQ4050 FET (Field Effect Transistor) enable/disable state
  * 
@@ -1945,3 +1928,230 @@ bool MeshSolar::toggle_fet(){
 bool MeshSolar::reset_bat_gauge() {
     return this->_bq4050->reset(); // Call the BQ4050 method to reset the device
 }
+
+/**
+ * @brief Set the key dataflash_unlock() unseals the gauge with
+ * 
+ * @param key Unseal key as the TI tools show it (default 0x36720414), low word
+ *            sent first; 0 = never unseal, a SEALED gauge refuses DataFlash access
+ * @return None
+ */
+void MeshSolar::set_unseal_key(uint32_t key) {
+    this->_unseal_key = key;
+}
+
+/**
+ * @brief SECURITY mode of the gauge
+ * 
+ * Cached from the OperationStatus of every status snapshot; OperationStatus
+ * is read once here if no snapshot has been taken yet.
+ * 
+ * @return security_mode_t SECURITY_UNKNOWN if the gauge could not be read
+ */
+security_mode_t MeshSolar::security_mode() {
+    if (this->_security == SECURITY_UNKNOWN) {
+        this->read_security_mode();
+    }
+    return this->_security;
+}
+
+bool MeshSolar::read_security_mode() {
+    OperationStatus_t operation = {0,};
+    bq4050_block_t    block     = {MAC_CMD_OPERATION_STATUS, sizeof(operation), nullptr, NUMBER};
+    if (!this->_bq4050->read_mac_block(&block) || block.len < sizeof(operation)) {
+        LOG_E("OperationStatus read failed, security mode unknown");
+        return false;
+    }
+    memcpy(&operation, block.pvalue, sizeof(operation)); // pvalue points to a shared driver buffer
+    this->_security = (security_mode_t)((operation.bits.sec1 << 1) | operation.bits.sec0);
+    return true;
+}
+
+// Fast failure of a DataFlash access the gauge would refuse, no bus traffic
+bool MeshSolar::df_sealed(const char *what) const {
+    if (this->_security != SECURITY_SEALED) {
+        return false;
+    }
+    LOG_E("Gauge SEALED, %s refused", what);
+    return true;
+}
+
+/**
+ * @brief Make sure the gauge accepts DataFlash access before a write command
+ * 
+ * PLATFORM-INDEPENDENT FUNCTION
+ * A SEALED BQ4050 NACKs nothing: DataFlash writes go through and only the
+ * read-back verify fails, so every retry of every setting burns its settle
+ * delay for nothing. Call this once before a command that touches DataFlash
+ * and reject the command when it returns false.
+ * 
+ * @param None (uses the cached security mode and the key of set_unseal_key())
+ * @return bool False only when the gauge is known to be SEALED and could not
+ *              be unsealed; an unknown mode returns true and leaves the
+ *              verdict to the access itself
+ * 
+ * UNSEAL:
+ *   - Only with a key set, one attempt per call
+ *   - OperationStatus is read back to confirm the new mode
+ *   - dataflash_relock() seals the gauge again after the command
+ * 
+ * TIMING:
+ *   - Not SEALED: no bus traffic once the mode is cached
+ *   - Unseal: two word writes, 10 ms, one MAC block read
+ */
+bool MeshSolar::dataflash_unlock() {
+    if (this->security_mode() != SECURITY_SEALED) {
+        return true;
+    }
+    if (this->_unseal_key == 0) {
+        LOG_E("Gauge SEALED and no unseal key set, DataFlash access refused");
+        return false;
+    }
+    if (!this->_bq4050->unseal(this->_unseal_key) || !this->read_security_mode() ||
+        this->_security == SECURITY_SEALED) {
+        LOG_E("Gauge unseal failed, DataFlash access refused");
+        return false;
+    }
+    LOG_I("Gauge unsealed for DataFlash access");
+    this->_unsealed = true;
+    return true;
+}
+
+/**
+ * @brief Seal the gauge again if dataflash_unlock() unsealed it
+ * 
+ * @return bool True if the gauge is back in the mode it was found in; on
+ *              false the next call tries again
+ */
+bool MeshSolar::dataflash_relock() {
+    if (!this->_unsealed) {
+        return true;
+    }
+    if (!this->_bq4050->seal() || !this->read_security_mode() || this->_security != SECURITY_SEALED) {
+        LOG_W("Gauge seal failed, still unsealed");
+        return false;
+    }
+    LOG_I("Gauge sealed again");
+    this->_unsealed = false;
+    return true;
+}
+
+/**
+ * @brief Set the thresholds used by the adaptive polling policy
+ * 
+ * @param policy New policy, copied into the MeshSolar instance
+ * @return None
+ */
+void MeshSolar::set_poll_policy(const poll_policy_t &policy) {
+    this->_poll_policy   = policy;
+    this->_poll_interval = policy.fast_interval_ms;
+}
+
+/**
+ * @brief Set the gauge alarm thresholds written by update_alarm_setting()
+ * 
+ * @param alarm New thresholds, copied into the MeshSolar instance
+ * @return None
+ */
+void MeshSolar::set_alarm_config(const alarm_config_t &alarm) {
+    this->_alarm = alarm;
+}
+
+/**
+ * @brief Program RemainingCapacityAlarm and RemainingTimeAlarm
+ * 
+ * PLATFORM-INDEPENDENT FUNCTION
+ * The gauge compares RemainingCapacity and AverageTimeToEmpty with these
+ * registers and sets RCA/RTA in BatteryStatus, which refresh_bat_status()
+ * watches instead of reading the capacity blocks on every poll.
+ * 
+ * @param None (uses the thresholds of set_alarm_config())
+ * @return bool True if both registers hold the thresholds
+ * 
+ * OPERATION:
+ *   - Each register is read first and only written when it differs, so the
+ *     call is cheap enough for the settings renew period
+ *   - Both are SBS registers, writable while SEALED, not saved in DataFlash:
+ *     a gauge reset restores the DataFlash defaults, the next call fixes them
+ */
+bool MeshSolar::update_alarm_setting() {
+    const bq4050_reg_t want[] = {
+        {BQ4050_REG_CAPACITY_ALARM, (uint16_t)this->_alarm.capacity_mah},
+        {BQ4050_REG_TIME_ALARM,     (uint16_t)this->_alarm.time_min},
+    };
+    bool res = true;
+    for (const bq4050_reg_t &w : want) {
+        bq4050_reg_t reg = {w.addr, 0};
+        if (this->_bq4050->read_reg_word(&reg) && reg.value == w.value) {
+            continue;
+        }
+        LOG_I("Alarm register 0x%02X: %u -> %u", w.addr, reg.value, w.value);
+        reg.value = 0;
+        bool ok = this->_bq4050->write_reg_word(w) && this->_bq4050->read_reg_word(&reg) && (reg.value == w.value);
+        if (!ok) {
+            LOG_E("Alarm register 0x%02X write failed", w.addr);
+        }
+        res &= ok;
+    }
+    return res;
+}
+
+/**
+ * @brief Compute the delay until the next status poll from the last snapshot
+ * 
+ * PLATFORM-INDEPENDENT POLLING POLICY
+ * Chooses how long the caller should wait before the next get_realtime_bat_status()
+ * call, based on the state captured by the previous one. Solar nodes spend most of
+ * their life idle, so the interval backs off exponentially while nothing changes
+ * and snaps back to the fast rate as soon as something does.
+ * 
+ * @param None (uses sta.charge_current, sta.soc_gauge and sta.safety_status)
+ * @return uint32_t Milliseconds until the next poll
+ * 
+ * POLICY:
+ *   Fast interval:
+ *   - Any SafetyStatus protection bit is set
+ *   - SOC is at or below low_soc (pack near cutoff)
+ *   - Current changed by current_step_ma or more since the previous call
+ *   
+ *   Normal interval:
+ *   - Steady charge or discharge above idle_current_ma
+ *   
+ *   Idle back-off:
+ *   - |current| below idle_current_ma and nothing above applies
+ *   - Interval doubles on every call, capped at idle_max_interval_ms
+ * 
+ * USAGE:
+ *   Call once after every get_realtime_bat_status() and schedule the next
+ *   poll with the returned value.
+ * 
+ * PLATFORM NOTES:
+ *   - Pure computation, no I/O or timing calls
+ */
+uint32_t MeshSolar::next_poll_interval_ms() {
+    const poll_policy_t &p = this->_poll_policy;
+    int16_t current = this->sta.charge_current;
+    int     step    = abs((int)current - (int)this->_poll_last_current);
+    this->_poll_last_current = current;
+
+    bool protection = (this->sta.safety_status.bytes != 0) || this->sta.emergency_shutdown;
+    bool low_soc    = (this->sta.soc_gauge <= p.low_soc);
+    bool changing   = (step >= p.current_step_ma);
+    bool idle       = (abs((int)current) < p.idle_current_ma);
+
+    if (protection || low_soc || changing) {
+        this->_poll_interval = p.fast_interval_ms;
+    }
+    else if (idle) {
+        // Back off from the normal rate, doubling while the pack stays idle
+        uint32_t next = (this->_poll_interval < p.normal_interval_ms) ? p.normal_interval_ms : this->_poll_interval * 2;
+        this->_poll_interval = (next > p.idle_max_interval_ms) ? p.idle_max_interval_ms : next;
+    }
+    else {
+        this->_poll_interval = p.normal_interval_ms;
+    }
+
+    LOG_D("Next poll in %lu ms (current %d mA, soc %d%%, protection %s)",
+          (unsigned long)this->_poll_interval, current, this->sta.soc_gauge, protection ? "yes" : "no");
+    return this->_poll_interval;
+}
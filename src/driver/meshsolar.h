@@ -3,9 +3,13 @@
 
 #include <stdbool.h>
 #include "bq4050.h"
+#include "meshsolar_events.h"
+#include "meshsolar_chemistry.h"
 
 // Forward declaration for SafetyStatus_t parsing function
 String parseSafetyStatusBits(const SafetyStatus_t& safety_status);
+const char *safetyStatusBitName(uint8_t bit);
+const char *operationStatusBitName(uint8_t bit);
 
 // Temperature protection structure
 typedef struct {
@@ -19,6 +23,7 @@ typedef struct {
 // Battery configuration structure
 typedef struct {
     char              type[16];          // Battery type string
+    chemistry_t       chemistry;         // type resolved when the command is parsed
     int               cell_number;       // Number of battery cells
     int               design_capacity;   // Battery design capacity
     int               discharge_cutoff_voltage;    // Battery discharge cutoff voltage
@@ -63,9 +68,87 @@ typedef struct {
 
 
 typedef struct {
-    uint16_t    times;          // Number of times to sync
+    uint16_t    times;          // Legacy: number of times to repeat the settings, 0 = sequenced frames
 } sync_config_t;
 
+typedef struct {
+    uint16_t    session;        // Sync session being acknowledged
+    uint8_t     missing;        // Frames not received, bit n = seq n, 0 = complete
+} ack_config_t;
+
+typedef struct {
+    int         window_ms;      // Aggregation window, 0 = per-sample telemetry
+} aggregate_config_t;
+
+typedef struct {
+    int         from_s;         // Oldest record wanted, seconds before now
+    int         to_s;           // Newest record wanted, seconds before now, 0 = now
+} history_config_t;
+
+typedef struct {
+    int         from_s;         // Oldest bucket wanted, seconds before now
+    int         to_s;           // Newest bucket wanted, seconds before now, 0 = now
+    char        series[16];     // "voltage", "temperature", "current" or "soc"
+    int         cell;           // Cell or sensor 1-4 of per-cell series, 0 = every cell
+} trend_config_t;
+
+typedef struct {
+    int         count;          // Newest flash log records wanted, 0 = STORE_LOG_DEFAULT
+} log_config_t;
+
+typedef struct {
+    int         from;           // First event sequence number wanted, 0 = oldest kept
+} events_config_t;
+
+typedef struct {
+    int         capacity_mah;   // RemainingCapacityAlarm (0x01), 0 = off
+    int         time_min;       // RemainingTimeAlarm (0x02), 0 = off
+} alarm_config_t;
+
+typedef struct {
+    int         samples;        // Samples in the window, 0 = CAPTURE_SAMPLES_DEFAULT
+    int         trigger_ma;     // Start when |current| crosses this, 0 = start at once
+    int         timeout_ms;     // Longest wait for the trigger, 0 = CAPTURE_TIMEOUT_DEFAULT
+    char        source[8];      // "da1" (default) or "sbs"
+} capture_config_t;
+
+#define DF_IMAGE_CHUNK          64       // DataFlash bytes in one export or import data frame
+
+typedef struct {
+    char        op[8];          // Import: "begin", "data" or "commit"
+    int         addr;           // Export: first address, 0 = DF_BASE; import "data": address of the chunk
+    int         len;            // Export: bytes, 0 = up to the end of the region
+    int         crc;            // CRC-16 of "data", or of every staged byte in address order for "commit"
+    char        data[DF_IMAGE_CHUNK * 2 + 1];   // Import "data": chunk bytes in hex
+} image_config_t;
+
+#define MESHSOLAR_BATCH_MAX     8        // Steps in one batch, at most DF_PLAN_STEPS
+
+typedef struct {
+    uint8_t     count;                          // Number of steps
+    uint8_t     steps[MESHSOLAR_BATCH_MAX];     // Command id of each step (meshsolar_cmd_t), request order
+} batch_config_t;
+
+#define MESHSOLAR_SUB_MAX       10       // Fields in one subscription
+
+typedef enum {
+    SUB_FIELD_STATUS = 0,                // Scalar of meshsolar_status_fields[]
+    SUB_FIELD_CELL,                      // Per-cell value of meshsolar_cell_fields[]
+    SUB_FIELD_PROTECTION,                // protection_sta, sent on any edge
+} sub_field_kind_t;
+
+typedef struct {
+    uint8_t     kind;                    // sub_field_kind_t
+    uint8_t     index;                   // Field index in its table
+    int         period_ms;               // Resend at least this often, 0 = on change only
+    float       delta;                   // Send once moved by this much (JSON units), 0 = any change, < 0 = periodic only
+} sub_field_t;
+
+typedef struct {
+    uint8_t     count;                   // Subscribed fields, 0 = full status telemetry
+    sub_field_t fields[MESHSOLAR_SUB_MAX];
+} subscribe_config_t;
+
 
 typedef struct {
     int   cell_num;         // Cell number
@@ -81,6 +164,17 @@ typedef struct {
     advance_config_t    advance;       // Advanced configuration
     fet_config_t        fet_en;        // FET enable configuration
     sync_config_t       sync;          // Sync configuration               
+    ack_config_t        ack;           // Sync acknowledgement
+    batch_config_t      batch;         // Batch steps, their parameters are in the members above
+    subscribe_config_t  subscribe;     // Telemetry field subscription
+    aggregate_config_t  aggregate;     // Telemetry aggregation window
+    history_config_t    history;       // History range
+    trend_config_t      trend;         // Rollup query
+    log_config_t        log;           // Flash log replay
+    events_config_t     events;        // Event journal replay
+    alarm_config_t      alarm;         // Gauge alarm thresholds
+    capture_config_t    capture;       // Burst capture window
+    image_config_t      image;         // DataFlash image export and import
 } meshsolar_config_t;
 
 typedef struct {
@@ -93,17 +187,123 @@ typedef struct {
     int             cell_count;          // Number of valid cells in the array
     bool            fet_enable;          // FET enable status
     uint16_t        pack_voltage;        // pack voltage (mV)
-    char            protection_sta[128]; // Protection status as parsed bit names string, e.g. "CUV,COV,OTC"
-    bool            emergency_shutdown;  // Emergency shutdown status
+    bool            emergency_shutdown;  // Emergency shutdown status, from the pin interrupt until the gauge confirms
+    bool            emshut_pin;          // Emergency shutdown pin asserted
+    uint32_t        emshut_pin_ms;       // Time of the last emergency shutdown pin edge (ms)
+    SafetyStatus_t  safety_status;       // Raw SafetyStatus bits, "protection_sta" is rendered from them on output
+    OperationStatus_t operation_status;  // Raw OperationStatus bits
+    BatteryStatus_t battery_status;      // Raw BatteryStatus word, read by every refresh_bat_status()
 } meshsolar_status_t;
 
+// Adaptive status polling policy
+typedef struct {
+    uint32_t    fast_interval_ms;        // Poll interval while current changes, protection is active or SOC is low
+    uint32_t    normal_interval_ms;      // Poll interval while charging/discharging steadily
+    uint32_t    idle_max_interval_ms;    // Longest back-off interval while idle and stable
+    int16_t     idle_current_ma;         // |current| below this is treated as idle (mA)
+    int16_t     current_step_ma;         // Current change between polls treated as "changing" (mA)
+    int         low_soc;                 // SOC at or below this is treated as near cutoff (%)
+    uint32_t    full_refresh_ms;         // Oldest full snapshot refresh_bat_status() keeps while steady
+} poll_policy_t;
+
+// BatteryStatus bits whose change triggers a full snapshot: alarms and state, not the error code
+#define BATTERY_STATUS_CHANGE_MASK  0xDBF0
+#define BATTERY_STATUS_INIT         0x0080
+
+// DataFlash write plan
+#define DF_PLAN_MAX         64           // Distinct DataFlash addresses in one plan
+#define DF_PLAN_STEPS       8            // Steps tracked per entry (bits of df_write_t.steps)
+
+typedef struct {
+    uint16_t    cmd;                     // DataFlash address
+    uint8_t     len;                     // Bytes written
+    uint8_t     type;                    // NUMBER or STRING (length-prefixed)
+    uint8_t     mask;                    // 1-byte read-modify-write: bits owned by the plan, 0 = whole value
+    uint8_t     data[6];                 // Value, little endian
+    uint8_t     steps;                   // Steps that planned this entry
+    bool        ok;                      // Written and verified
+    const char *name;                    // Log name
+} df_write_t;
+
+typedef struct {
+    df_write_t  entries[DF_PLAN_MAX];
+    uint8_t     count;
+    uint8_t     step;                    // Step recorded by the next df_plan_*() calls
+    bool        overflow;                // An entry did not fit, the plan is incomplete
+    bool        rejected;                // A value was out of range, df_plan_apply() writes nothing
+    chemistry_t chemistry;               // Planned DeviceChemistry, CHEMISTRY_COUNT = none
+} df_plan_t;
+
+// Gauge SECURITY mode, OperationStatus SEC1:SEC0
+typedef enum {
+    SECURITY_UNKNOWN = 0,                // Not read yet, 0b00 is reserved
+    SECURITY_FULL_ACCESS,
+    SECURITY_UNSEALED,
+    SECURITY_SEALED,                     // DataFlash reads and writes are refused
+} security_mode_t;
+
 
 
 class MeshSolar{
 private:
     BQ4050 *_bq4050;                // Instance of BQ4050 class for battery
+    int     _cell_count;            // Cached cell count from DA Configuration, 0 = not read yet
+    chemistry_t _chemistry;         // Last chemistry verified or read back, picks the default CEDV curve, CHEMISTRY_COUNT = unknown
+    poll_policy_t _poll_policy;     // Adaptive polling thresholds
+    uint32_t      _poll_interval;   // Interval returned by the last next_poll_interval_ms() call
+    int16_t       _poll_last_current; // Current seen by the last next_poll_interval_ms() call
+    df_plan_t     _plan;            // Pending DataFlash writes
+    alarm_config_t _alarm;          // Thresholds written by update_alarm_setting()
+    uint32_t      _full_ms;         // Time of the last full snapshot
+    bool          _full_valid;      // A full snapshot was read
+    bool          _emshut_check;    // A pin edge waits for the gauge EMSHUT bit
+    security_mode_t _security;      // Cached SECURITY mode, refreshed by every status snapshot
+    uint32_t      _unseal_key;      // 0 = never unseal
+    bool          _unsealed;        // dataflash_unlock() unsealed the gauge, dataflash_relock() seals it
+
+    int read_cell_count();
+    bool read_security_mode();
+    bool df_sealed(const char *what) const;
+
+    // DataFlash write plan, an address planned twice keeps the last value
+    df_write_t *df_plan_entry(uint16_t cmd, uint8_t len, uint8_t type, const char *name);
+    bool df_plan_u16(uint16_t cmd, uint16_t value, const char *name);
+    bool df_plan_bits(uint16_t cmd, uint8_t mask, uint8_t bits, const char *name);
+    bool df_plan_string(uint16_t cmd, const char *str, uint8_t len, const char *name);
+    // Typed forms, P is a df:: descriptor of bq4050_df.h, the value is range checked here
+    template <class P> bool df_plan(int32_t value) {
+        static_assert(P::kind == DF_U2 || P::kind == DF_I2, "df_plan() plans 16-bit parameters");
+        const df_reg_t reg = P::reg();
+        if (!bq4050_df_check(reg, value)) {
+            this->_plan.rejected = true;
+            return false;
+        }
+        return this->df_plan_u16(reg.addr, (uint16_t)value, reg.name);
+    }
+    template <class P> bool df_plan_bits(uint8_t mask, uint8_t bits) {
+        static_assert(P::kind == DF_U1, "df_plan_bits() plans 1-byte parameters");
+        return this->df_plan_bits(P::reg().addr, mask, bits, P::reg().name);
+    }
+    template <class P> bool df_plan_string(const char *str) {
+        static_assert(P::kind == DF_S, "df_plan_string() plans strings");
+        const df_reg_t reg = P::reg();
+        if (!bq4050_df_check(reg, (int32_t)strlen(str))) {
+            this->_plan.rejected = true;
+            return false;
+        }
+        return this->df_plan_string(reg.addr, str, reg.len, reg.name);
+    }
+
+    bool plan_basic_bat_type_setting();
+    bool plan_basic_bat_cells_setting();
+    bool plan_basic_bat_design_capacity_setting();
+    bool plan_basic_bat_discharge_cutoff_voltage_setting();
+    bool plan_basic_bat_temp_protection_setting();
+    bool plan_advance_bat_battery_setting();
+    bool plan_advance_bat_cedv_setting();
 public:
     meshsolar_status_t sta;         // Initialize status structure
+    MeshSolarEvents    events;      // Protection edges, updated by every get_realtime_bat_status()
     meshsolar_config_t cmd;         // Basic and advance command structure
     struct {
         basic_config_t basic;         // Basic configuration
@@ -126,12 +326,36 @@ public:
     bool update_advance_bat_battery_setting();
     bool update_advance_bat_cedv_setting();
 
+    // Batched configuration: plan several commands, write each address once
+    void df_plan_begin();
+    void df_plan_step(uint8_t step);
+    bool plan_basic_settings();
+    bool plan_advance_settings();
+    bool df_plan_apply();
+    bool df_plan_step_ok(uint8_t step) const;
+
     bool toggle_fet();
     bool reset_bat_gauge();
 
     bool get_realtime_bat_status();
+    bool refresh_bat_status(bool *full, uint32_t max_age_ms = 0);
+    void emshut_pin_event(bool asserted, uint32_t time_ms);
     bool get_basic_bat_realtime_setting();
     bool get_advance_bat_realtime_setting();
+
+    // Security mode: DataFlash access is refused while SEALED
+    void set_unseal_key(uint32_t key);
+    security_mode_t security_mode();
+    bool dataflash_unlock();
+    bool dataflash_relock();
+
+    // Adaptive polling
+    void set_poll_policy(const poll_policy_t &policy);
+    uint32_t next_poll_interval_ms();
+
+    // Gauge-side alarms
+    void set_alarm_config(const alarm_config_t &alarm);
+    bool update_alarm_setting();
 };
 
 
@@ -0,0 +1,222 @@
+#include "meshsolar_aggregate.h"
+#include "../utils/logger.h"
+#include <math.h>
+
+#define MS_PER_HOUR     3600000.0f
+
+static void stat_seed(agg_stat_t *s){
+    s->min  = s->held;
+    s->max  = s->held;
+    s->area = 0;
+}
+
+static void stat_sample(agg_stat_t *s, float v){
+    s->min  = (v < s->min) ? v : s->min;
+    s->max  = (v > s->max) ? v : s->max;
+    s->held = v;
+}
+
+static float round_to(float v, uint8_t decimals){
+    float pow10 = 1.0f;
+    for (uint8_t d = 0; d < decimals; d++) {
+        pow10 *= 10.0f;
+    }
+    return roundf(v * pow10) / pow10;
+}
+
+/**
+ * @brief Add {"min","max","mean"} of a statistic, values multiplied by scale
+ */
+static void stat_to_json(JsonObject obj, const agg_stat_t *s, uint32_t covered, float scale, uint8_t decimals){
+    float mean = (covered > 0) ? s->area / covered : s->held;
+    obj["min"]  = round_to(s->min * scale, decimals);
+    obj["max"]  = round_to(s->max * scale, decimals);
+    obj["mean"] = round_to(mean * scale, decimals);
+}
+
+/**
+ * @brief Construct an inactive aggregator
+ */
+MeshSolarAggregate::MeshSolarAggregate(){
+    memset(this, 0, sizeof(*this));
+}
+
+/**
+ * @brief Set the window length and start a new window
+ *
+ * @param window_ms Window (ms), 0 turns aggregation off
+ * @param now       Current time (ms)
+ */
+void MeshSolarAggregate::set_window(uint32_t window_ms, uint32_t now){
+    if (window_ms > 0 && window_ms < AGG_MIN_WINDOW) {
+        window_ms = AGG_MIN_WINDOW;
+    }
+    this->window_ms = window_ms;
+    this->primed    = false;            // Do not credit time from before the request
+    this->restart(now);
+    LOG_I("Aggregation window: %u ms", (unsigned)window_ms);
+}
+
+uint32_t MeshSolarAggregate::window() const{
+    return this->window_ms;
+}
+
+bool MeshSolarAggregate::active() const{
+    return this->window_ms > 0;
+}
+
+void MeshSolarAggregate::restart(uint32_t now){
+    this->start_ms      = now;
+    this->last_ms       = now;
+    this->samples       = 0;
+    this->covered_ms    = 0;
+    this->charge_mah    = 0;
+    this->discharge_mah = 0;
+    this->charge_wh     = 0;
+    this->discharge_wh  = 0;
+    this->normal_ms     = 0;
+    this->emshut_ms     = 0;
+    memset(this->protection_ms, 0, sizeof(this->protection_ms));
+
+    // The held snapshot is the state at the start of the new window
+    stat_seed(&this->voltage);
+    stat_seed(&this->current);
+    for (uint8_t c = 0; c < AGG_CELLS; c++) {
+        stat_seed(&this->cell_voltage[c]);
+        stat_seed(&this->cell_temp[c]);
+    }
+}
+
+/**
+ * @brief Credit the time since the last credit to the held snapshot
+ */
+void MeshSolarAggregate::credit(uint32_t now){
+    uint32_t dt = now - this->last_ms;
+    this->last_ms = now;
+    if (!this->primed || dt == 0) {
+        return;
+    }
+    this->covered_ms += dt;
+
+    this->voltage.area += this->voltage.held * dt;
+    this->current.area += this->current.held * dt;
+    for (uint8_t c = 0; c < AGG_CELLS; c++) {
+        this->cell_voltage[c].area += this->cell_voltage[c].held * dt;
+        this->cell_temp[c].area    += this->cell_temp[c].held * dt;
+    }
+
+    float mah = this->current.held * dt / MS_PER_HOUR;
+    float wh  = mah * this->voltage.held / 1000000.0f;      // mAh x mV -> Wh
+    if (mah > 0) {
+        this->charge_mah += mah;
+        this->charge_wh  += wh;
+    }
+    else {
+        this->discharge_mah -= mah;
+        this->discharge_wh  -= wh;
+    }
+
+    if (this->held_safety == 0) {
+        this->normal_ms += dt;
+    }
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        if (this->held_safety & (1UL << bit)) {
+            this->protection_ms[bit] += dt;
+        }
+    }
+    if (this->held_emshut) {
+        this->emshut_ms += dt;
+    }
+}
+
+/**
+ * @brief Feed one status snapshot
+ *
+ * @param sta Snapshot just read by get_realtime_bat_status()
+ * @param now Current time (ms)
+ */
+void MeshSolarAggregate::add(const meshsolar_status_t *sta, uint32_t now){
+    if (!this->active()) {
+        return;
+    }
+    this->credit(now);
+
+    if (!this->primed) {
+        // First snapshot since set_window(), it seeds min/max
+        this->voltage.held = sta->total_voltage;
+        this->current.held = sta->charge_current;
+        stat_seed(&this->voltage);
+        stat_seed(&this->current);
+        for (uint8_t c = 0; c < AGG_CELLS; c++) {
+            this->cell_voltage[c].held = sta->cells[c].voltage;
+            this->cell_temp[c].held    = sta->cells[c].temperature;
+            stat_seed(&this->cell_voltage[c]);
+            stat_seed(&this->cell_temp[c]);
+        }
+    }
+    stat_sample(&this->voltage, sta->total_voltage);
+    stat_sample(&this->current, sta->charge_current);
+    for (uint8_t c = 0; c < AGG_CELLS; c++) {
+        stat_sample(&this->cell_voltage[c], sta->cells[c].voltage);
+        stat_sample(&this->cell_temp[c], sta->cells[c].temperature);
+    }
+    this->cell_count  = (sta->cell_count >= 1 && sta->cell_count <= AGG_CELLS) ? sta->cell_count : AGG_CELLS;
+    this->held_safety = sta->safety_status.bytes;
+    this->held_emshut = sta->emergency_shutdown;
+    this->primed      = true;
+    this->samples++;
+}
+
+/**
+ * @brief Close the current window and build its "aggregate" frame
+ *
+ * The next window starts at now, seeded with the last snapshot.
+ *
+ * @param now    Current time (ms)
+ * @param output Receives the frame
+ * @return size_t Frame length, 0 if aggregation is off or no snapshot was seen yet
+ */
+size_t MeshSolarAggregate::report(uint32_t now, String &output){
+    output = "";
+    if (!this->active() || !this->primed) {
+        return 0;
+    }
+    this->credit(now);
+    uint32_t duration = now - this->start_ms;
+
+    StaticJsonDocument<1536> doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["command"]  = "aggregate";
+    root["window"]   = this->window_ms;
+    root["duration"] = duration;
+    root["samples"]  = this->samples;
+    stat_to_json(root.createNestedObject("voltage"), &this->voltage, this->covered_ms, 0.001f, 3);    // mV -> V
+    stat_to_json(root.createNestedObject("current"), &this->current, this->covered_ms, 1.0f, 1);      // mA
+    root["charge_mah"]    = round_to(this->charge_mah, 2);
+    root["discharge_mah"] = round_to(this->discharge_mah, 2);
+    root["charge_wh"]     = round_to(this->charge_wh, 3);
+    root["discharge_wh"]  = round_to(this->discharge_wh, 3);
+
+    JsonArray cells = root.createNestedArray("cells");
+    for (int c = 0; c < this->cell_count; c++) {
+        JsonObject cell = cells.createNestedObject();
+        cell["cell_num"] = c + 1;
+        stat_to_json(cell.createNestedObject("voltage"), &this->cell_voltage[c], this->covered_ms, 0.001f, 3);  // mV -> V
+        stat_to_json(cell.createNestedObject("temperature"), &this->cell_temp[c], this->covered_ms, 1.0f, 1);   // degC
+    }
+
+    JsonObject protection = root.createNestedObject("protection");
+    if (this->normal_ms > 0) {
+        protection["Normal"] = this->normal_ms;
+    }
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        const char *name = safetyStatusBitName(bit);
+        if (name != nullptr && this->protection_ms[bit] > 0) {
+            protection[name] = this->protection_ms[bit];
+        }
+    }
+    root["emshut"] = this->emshut_ms;
+
+    this->restart(now);
+    return serializeJson(doc, output);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file meshsolar_aggregate.h
+ * @brief Windowed aggregation of status snapshots: one summary per window instead of one line per sample.
+ *
+ * Every snapshot read by get_realtime_bat_status() is fed to add(). The
+ * aggregator keeps, for the current window:
+ *
+ * - min/max/mean of the pack (BAT) voltage and current
+ * - min/max/mean of each cell voltage and temperature
+ * - charge and discharge in mAh and Wh, integrated from current x BAT voltage
+ * - time spent in each SafetyStatus protection, in "Normal" and in EMSHUT
+ *
+ * report() closes the window and builds one "aggregate" frame:
+ *
+ *   {"command":"aggregate","window":60000,"duration":60000,"samples":58,
+ *    "voltage":{"min":13.201,"max":13.262,"mean":13.240},
+ *    "current":{"min":-1210,"max":-1180,"mean":-1195.2},
+ *    "charge_mah":0,"discharge_mah":19.92,"charge_wh":0,"discharge_wh":0.264,
+ *    "cells":[{"cell_num":1,"voltage":{...},"temperature":{...}},...],
+ *    "protection":{"Normal":60000},"emshut":0}
+ *
+ * TIMING:
+ * - Snapshots arrive at the adaptive poll interval (1 s to minutes), so means
+ *   and integrals are time-weighted: each sample holds until the next one. The
+ *   span from the last sample to the end of the window is credited to that
+ *   sample, so consecutive windows cover time without gaps or overlap.
+ * - Like the timer wheel, the aggregator never reads a clock: callers pass
+ *   the current time.
+ */
+
+#ifndef __MESHSOLAR_AGGREGATE_H__
+#define __MESHSOLAR_AGGREGATE_H__
+
+#include "meshsolar_json.h"
+
+#define AGG_CELLS               4           // Cells aggregated, matches meshsolar_status_t::cells
+#define AGG_MIN_WINDOW          1000        // Shortest window (ms), shorter requests are raised to it
+
+typedef struct {
+    float   min;
+    float   max;
+    float   area;                           // Value x ms, for the time-weighted mean
+    float   held;                           // Last sample, valid until the next one
+} agg_stat_t;
+
+class MeshSolarAggregate{
+private:
+    uint32_t   window_ms;                   // 0 = aggregation off
+    uint32_t   start_ms;                    // Start of the current window
+    uint32_t   last_ms;                     // Time credited up to
+    uint32_t   samples;                     // Snapshots added in this window
+    uint32_t   covered_ms;                  // Time of the window covered by a held snapshot
+    bool       primed;                      // A snapshot is held
+
+    agg_stat_t voltage;                     // BAT voltage (mV)
+    agg_stat_t current;                     // mA, positive = charging
+    agg_stat_t cell_voltage[AGG_CELLS];     // mV
+    agg_stat_t cell_temp[AGG_CELLS];        // degC
+    int        cell_count;                  // Cells of the last snapshot
+    uint32_t   held_safety;                 // SafetyStatus bits of the last snapshot
+    bool       held_emshut;
+
+    float      charge_mah;
+    float      discharge_mah;
+    float      charge_wh;
+    float      discharge_wh;
+    uint32_t   protection_ms[32];           // Time with each SafetyStatus bit set
+    uint32_t   normal_ms;                   // Time with no protection
+    uint32_t   emshut_ms;                   // Time in emergency shutdown
+
+    void credit(uint32_t now);
+    void restart(uint32_t now);
+
+public:
+    MeshSolarAggregate();
+
+    void     set_window(uint32_t window_ms, uint32_t now);  // 0 turns aggregation off
+    uint32_t window() const;
+    bool     active() const;
+
+    // Feed one status snapshot
+    void     add(const meshsolar_status_t *sta, uint32_t now);
+    // Close the window, build its frame and start the next one, 0 if no snapshot was seen yet
+    size_t   report(uint32_t now, String &output);
+};
+
+#endif // __MESHSOLAR_AGGREGATE_H__
@@ -0,0 +1,240 @@
+#include "meshsolar_capture.h"
+#include "../utils/logger.h"
+#include "../utils/sysclock.h"
+#include <ArduinoJson.h>
+#include <algorithm>
+
+static const char *const source_names[CAPTURE_SOURCE_COUNT] = {
+    "da1", "sbs",
+};
+
+/**
+ * @brief Map a "source" name to its id, an empty name is the default "da1"
+ */
+capture_source_t capture_find_source(const char *name){
+    if (name == nullptr || name[0] == '\0') {
+        return CAPTURE_SOURCE_DA1;
+    }
+    for (int i = 0; i < CAPTURE_SOURCE_COUNT; i++) {
+        if (strcmp(name, source_names[i]) == 0) {
+            return (capture_source_t)i;
+        }
+    }
+    return CAPTURE_SOURCE_COUNT;
+}
+
+MeshSolarCapture::MeshSolarCapture(){
+    memset(this->buf, 0, sizeof(this->buf));
+    this->count   = 0;
+    this->trigger = -1;
+    this->source  = CAPTURE_SOURCE_DA1;
+    this->cells   = 0;
+    this->i_low   = 0;
+    this->i_high  = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        this->r_mohm[i] = -1;
+    }
+}
+
+/**
+ * @brief Read one sample from the configured source
+ */
+bool MeshSolarCapture::sample(BQ4050 *gauge, capture_sample_t *s){
+    s->t_us = sysclk::micros();
+    if (this->source == CAPTURE_SOURCE_DA1) {
+        DAStatus1_t    da1;
+        bq4050_block_t block = {MAC_CMD_DA_STATUS1, sizeof(da1), nullptr, NUMBER};
+        if (!gauge->read_mac_block(&block) || block.len < sizeof(da1)) {
+            return false;
+        }
+        memcpy(&da1, block.pvalue, sizeof(da1));    // pvalue points to a shared driver buffer
+        s->cell_mv[0]  = da1.cell_1_voltage;
+        s->cell_mv[1]  = da1.cell_2_voltage;
+        s->cell_mv[2]  = da1.cell_3_voltage;
+        s->cell_mv[3]  = da1.cell_4_voltage;
+        s->current_ma  = (int16_t)da1.cell_1_current;
+        return true;
+    }
+    static const uint8_t regs[4] = {
+        BQ4050_REG_CELL_VOLTAGE1, BQ4050_REG_CELL_VOLTAGE2, BQ4050_REG_CELL_VOLTAGE3, BQ4050_REG_CELL_VOLTAGE4,
+    };
+    bq4050_reg_t reg = {BQ4050_REG_CURRENT, 0};
+    if (!gauge->read_reg_word(&reg)) {
+        return false;
+    }
+    s->current_ma = (int16_t)reg.value;
+    for (uint8_t i = 0; i < 4; i++) {
+        reg.addr = regs[i];
+        if (i >= this->cells) {
+            s->cell_mv[i] = 0;              // Absent cell, not worth a bus read
+        }
+        else if (!gauge->read_reg_word(&reg)) {
+            return false;
+        }
+        else {
+            s->cell_mv[i] = reg.value;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Capture one window
+ *
+ * @param gauge BQ4050 to read
+ * @param cells Cells of the pack, 1-4
+ * @param cfg   "capture" parameters: samples, trigger (mA, 0 = none), timeout (ms), source
+ * @return bool False on a bus error or when the trigger did not fire in time
+ */
+bool MeshSolarCapture::run(BQ4050 *gauge, uint8_t cells, const capture_config_t &cfg){
+    uint16_t n       = (cfg.samples > 0) ? (uint16_t)cfg.samples : CAPTURE_SAMPLES_DEFAULT;
+    uint32_t timeout = (cfg.timeout_ms > 0) ? (uint32_t)cfg.timeout_ms : CAPTURE_TIMEOUT_DEFAULT;
+    int32_t  thr     = cfg.trigger_ma;
+    this->count   = 0;
+    this->trigger = -1;
+    this->source  = capture_find_source(cfg.source);
+    this->cells   = (cells >= 1 && cells <= 4) ? cells : 4;
+    if (this->source == CAPTURE_SOURCE_COUNT || n > CAPTURE_SAMPLES_MAX) {
+        LOG_E("Capture: bad source \"%s\" or %u samples", cfg.source, (unsigned)n);
+        this->source = CAPTURE_SOURCE_DA1;
+        return false;
+    }
+
+    uint32_t total = 0;                     // Samples read, the ring index is total % n
+    uint32_t at    = 0;                     // total when the trigger fired
+    uint16_t post  = (thr > 0) ? (uint16_t)(n - n / CAPTURE_PRETRIGGER_DIV) : n;
+    bool     below = false;                 // |current| was under the threshold, the crossing is armed
+    uint32_t start = sysclk::millis();
+    for (;;) {
+        capture_sample_t *s = &this->buf[total % n];
+        if (!this->sample(gauge, s)) {
+            LOG_E("Capture: read failed after %u samples", (unsigned)total);
+            return false;
+        }
+        total++;
+        if (thr <= 0) {
+            if (total == n) {
+                break;
+            }
+            continue;
+        }
+        int32_t mag = (s->current_ma < 0) ? -s->current_ma : s->current_ma;
+        if (this->trigger < 0) {
+            if (mag < thr) {
+                below = true;
+            }
+            else if (below) {
+                this->trigger = 0;          // Fixed up once the ring is unrolled
+                at = total - 1;
+            }
+            if (this->trigger < 0 && (sysclk::millis() - start) >= timeout) {
+                LOG_W("Capture: no trigger at %d mA within %u ms", (int)thr, (unsigned)timeout);
+                return false;
+            }
+        }
+        if (this->trigger >= 0 && (total - at) >= post) {
+            break;
+        }
+    }
+
+    // Unroll the ring, oldest sample first
+    this->count = (total < n) ? (uint16_t)total : n;
+    if (total > n) {
+        std::rotate(this->buf, this->buf + (total % n), this->buf + n);
+    }
+    if (this->trigger >= 0) {
+        this->trigger = (int32_t)(at - (total - this->count));
+    }
+    this->estimate();
+    LOG_I("Capture: %u samples in %u us", (unsigned)this->count,
+          (unsigned)(this->buf[this->count - 1].t_us - this->buf[0].t_us));
+    return true;
+}
+
+/**
+ * @brief Estimate the DC resistance of each cell from the two current levels
+ */
+void MeshSolarCapture::estimate(){
+    int16_t lo = this->buf[0].current_ma;
+    int16_t hi = lo;
+    for (uint16_t k = 1; k < this->count; k++) {
+        lo = (this->buf[k].current_ma < lo) ? this->buf[k].current_ma : lo;
+        hi = (this->buf[k].current_ma > hi) ? this->buf[k].current_ma : hi;
+    }
+    int32_t mid = ((int32_t)lo + hi) / 2;
+    int32_t n[2]     = {0, 0};
+    int32_t i_sum[2] = {0, 0};
+    int32_t v_sum[2][4];
+    memset(v_sum, 0, sizeof(v_sum));
+    for (uint16_t k = 0; k < this->count; k++) {
+        uint8_t g = (this->buf[k].current_ma > mid) ? 1 : 0;
+        n[g]++;
+        i_sum[g] += this->buf[k].current_ma;
+        for (uint8_t c = 0; c < 4; c++) {
+            v_sum[g][c] += this->buf[k].cell_mv[c];
+        }
+    }
+    this->i_low  = (n[0] > 0) ? (int16_t)(i_sum[0] / n[0]) : lo;
+    this->i_high = (n[1] > 0) ? (int16_t)(i_sum[1] / n[1]) : hi;
+    for (uint8_t c = 0; c < 4; c++) {
+        this->r_mohm[c] = -1;
+        if (c >= this->cells || n[0] == 0 || n[1] == 0) {
+            continue;
+        }
+        float di = (float)i_sum[1] / n[1] - (float)i_sum[0] / n[0];
+        float dv = (float)v_sum[1][c] / n[1] - (float)v_sum[0][c] / n[0];
+        if (di >= CAPTURE_MIN_STEP_MA) {
+            this->r_mohm[c] = (int16_t)(dv / di * 1000.0f + 0.5f);  // mV / mA = ohm
+        }
+    }
+}
+
+size_t MeshSolarCapture::chunk_json(uint16_t seq, String &output){
+    static const char hex[] = "0123456789abcdef";
+    output = "";
+    if (seq >= this->chunks()) {
+        return 0;
+    }
+    char     data[CAPTURE_CHUNK_SAMPLES * CAPTURE_SAMPLE_LEN * 2 + 1];
+    char    *p   = data;
+    uint16_t end = (uint16_t)((seq + 1) * CAPTURE_CHUNK_SAMPLES);
+    for (uint16_t k = seq * CAPTURE_CHUNK_SAMPLES; k < end && k < this->count; k++) {
+        const capture_sample_t *s = &this->buf[k];
+        uint32_t t = s->t_us - this->buf[0].t_us;
+        uint8_t  b[CAPTURE_SAMPLE_LEN] = {
+            (uint8_t)t, (uint8_t)(t >> 8), (uint8_t)(t >> 16), (uint8_t)(t >> 24),
+            (uint8_t)s->cell_mv[0], (uint8_t)(s->cell_mv[0] >> 8), (uint8_t)s->cell_mv[1], (uint8_t)(s->cell_mv[1] >> 8),
+            (uint8_t)s->cell_mv[2], (uint8_t)(s->cell_mv[2] >> 8), (uint8_t)s->cell_mv[3], (uint8_t)(s->cell_mv[3] >> 8),
+            (uint8_t)s->current_ma, (uint8_t)((uint16_t)s->current_ma >> 8),
+        };
+        for (uint8_t i = 0; i < CAPTURE_SAMPLE_LEN; i++) {
+            *p++ = hex[b[i] >> 4];
+            *p++ = hex[b[i] & 0x0F];
+        }
+    }
+    *p = '\0';
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(4)> doc;
+    doc["command"] = "capture";
+    doc["seq"]     = seq;
+    doc["total"]   = this->chunks();
+    doc["data"]    = (const char *)data;    // Stored as a pointer, data outlives serializeJson()
+    return serializeJson(doc, output);
+}
+
+size_t MeshSolarCapture::summary_json(String &output){
+    output = "";
+    StaticJsonDocument<JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(4)> doc;
+    doc["command"]    = "capture";
+    doc["source"]     = source_names[this->source];
+    doc["samples"]    = this->count;
+    doc["span_us"]    = (this->count > 0) ? this->buf[this->count - 1].t_us - this->buf[0].t_us : 0;
+    doc["trigger_us"] = (this->trigger >= 0) ? (int32_t)(this->buf[this->trigger].t_us - this->buf[0].t_us) : -1;
+    doc["i_low"]      = this->i_low;
+    doc["i_high"]     = this->i_high;
+    JsonArray r = doc.createNestedArray("r_mohm");
+    for (uint8_t c = 0; c < this->cells; c++) {
+        r.add(this->r_mohm[c]);
+    }
+    return serializeJson(doc, output);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file meshsolar_capture.h
+ * @brief Burst capture of the cell voltages and current, with a DC internal resistance estimate.
+ *
+ * The status poll runs at 1 Hz at best, too slow to see the sag of a radio
+ * transmission. A capture reads the gauge back to back, as fast as the bus
+ * allows, into a preallocated buffer of CAPTURE_SAMPLES_MAX samples:
+ *
+ *   source   reads per sample                              about, 100 kHz SMBus
+ *   "da1"    DAStatus1 MAC block (voltages and current     5 ms
+ *            sampled together by the gauge)
+ *   "sbs"    CellVoltage1-4 and Current words              3 ms
+ *
+ * Without a trigger the capture starts at once. With "trigger" the buffer runs
+ * as a ring until |current| crosses the threshold from below, then keeps
+ * 1/CAPTURE_PRETRIGGER_DIV of the window before the crossing and fills the
+ * rest after it. The waveform is sent in binary chunks, hex encoded, of
+ * CAPTURE_CHUNK_SAMPLES samples of CAPTURE_SAMPLE_LEN bytes, little endian:
+ *
+ *   u32 time (us from the first sample), u16 cell 1-4 (mV), i16 current (mA)
+ *
+ *   {"command":"capture","seq":0,"total":16,"data":"00000000e60ce80c..."}
+ *
+ * and a summary closes the reply:
+ *
+ *   {"command":"capture","source":"da1","samples":128,"span_us":640212,
+ *    "trigger_us":160050,"i_low":-410,"i_high":-12,"r_mohm":[48,51,47,-1]}
+ *
+ * The samples are split at the midpoint of the current range; each cell's
+ * resistance is the difference of the mean voltages over the difference of
+ * the mean currents of the two groups. -1 means a step below
+ * CAPTURE_MIN_STEP_MA, or a cell the pack does not have.
+ *
+ * TIMING:
+ * - The capture blocks the bus for its window; status polls wait meanwhile.
+ * - The gauge updates its readings at its own conversion rate, so consecutive
+ *   samples often repeat. The means are not biased by it, the waveform shows
+ *   the conversion steps.
+ */
+
+#ifndef __MESHSOLAR_CAPTURE_H__
+#define __MESHSOLAR_CAPTURE_H__
+
+#include "meshsolar.h"
+
+#define CAPTURE_SAMPLES_MAX     256         // Buffer size (samples)
+#define CAPTURE_SAMPLES_DEFAULT 128         // Samples without a "samples" parameter
+#define CAPTURE_TIMEOUT_DEFAULT 5000        // Longest wait for the trigger without "timeout" (ms)
+#define CAPTURE_PRETRIGGER_DIV  4           // 1/4 of the window precedes the trigger
+#define CAPTURE_CHUNK_SAMPLES   8           // Samples in one data frame
+#define CAPTURE_SAMPLE_LEN      14          // Bytes per sample in a data frame
+#define CAPTURE_MIN_STEP_MA     50          // Smallest current step a resistance is derived from
+
+typedef enum {
+    CAPTURE_SOURCE_DA1 = 0,
+    CAPTURE_SOURCE_SBS,
+    CAPTURE_SOURCE_COUNT,
+} capture_source_t;
+
+typedef struct {
+    uint32_t t_us;                          // micros() of the read
+    uint16_t cell_mv[4];
+    int16_t  current_ma;
+} capture_sample_t;
+
+class MeshSolarCapture{
+private:
+    capture_sample_t buf[CAPTURE_SAMPLES_MAX];
+    uint16_t         count;                 // Samples captured, oldest first after run()
+    int32_t          trigger;               // Index of the trigger sample, -1 = none
+    capture_source_t source;
+    uint8_t          cells;
+    int16_t          i_low;                 // Mean current of the low and high groups
+    int16_t          i_high;
+    int16_t          r_mohm[4];
+
+    bool sample(BQ4050 *gauge, capture_sample_t *s);
+    void estimate();
+
+public:
+    MeshSolarCapture();
+
+    // Run one capture, false on a bus error or a trigger timeout
+    bool     run(BQ4050 *gauge, uint8_t cells, const capture_config_t &cfg);
+    uint16_t samples() const { return count; }
+    uint16_t chunks() const { return (count + CAPTURE_CHUNK_SAMPLES - 1) / CAPTURE_CHUNK_SAMPLES; }
+    // Data frame of chunk seq, 0 past the last one
+    size_t   chunk_json(uint16_t seq, String &output);
+    // Summary frame with the resistance estimate
+    size_t   summary_json(String &output);
+};
+
+// Source name to id, CAPTURE_SOURCE_COUNT if unknown ("" = "da1")
+capture_source_t capture_find_source(const char *name);
+
+#endif // __MESHSOLAR_CAPTURE_H__
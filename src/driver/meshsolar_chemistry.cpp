@@ -0,0 +1,69 @@
+#include "meshsolar_chemistry.h"
+#include <string.h>
+#include <strings.h>
+
+/*
+ * LiFePO4 (Lithium Iron Phosphate):
+ * - Stable across temperatures, flat discharge curve, 3.2V nominal
+ * - Same voltages in every temperature zone
+ *
+ * Li-ion / LiPo (Lithium Cobalt / Polymer):
+ * - Higher energy density but more temperature-sensitive, 3.7V nominal
+ * - Same voltages, only the gauge id differs
+ */
+constexpr chemistry_profile_t chemistry_profiles[CHEMISTRY_COUNT] = {
+    {
+        CHEMISTRY_LIFEPO4, "lifepo4", "LFE4",
+        {3600, 3600, 3600, 3600},           // Charge
+        {3750, 3750, 3750, 3750},           // COV, safety margin above charge
+        {3600, 3600, 3600, 3600},           // COV recovery, matches charge for stability
+        3600,
+        {2800, 2950, 3050},
+        {3450, 3330, 3310, 3295, 3285, 3275, 3260, 3235, 3205, 3150, 2800},
+    },
+    {
+        CHEMISTRY_LIION, "liion", "LION",
+        {4200, 4200, 4200, 4200},
+        {4300, 4300, 4300, 4300},
+        {4100, 4100, 4100, 4100},           // Lower recovery for safety
+        4200,
+        {3000, 3300, 3450},
+        {4173, 4043, 3925, 3821, 3725, 3656, 3619, 3582, 3515, 3438, 3000},
+    },
+    {
+        CHEMISTRY_LIPO, "lipo", "LIPO",
+        {4200, 4200, 4200, 4200},
+        {4300, 4300, 4300, 4300},
+        {4100, 4100, 4100, 4100},
+        4200,
+        {3000, 3300, 3450},
+        {4173, 4043, 3925, 3821, 3725, 3656, 3619, 3582, 3515, 3438, 3000},
+    },
+};
+
+// Rows must stay in enum order, chemistry_profile() indexes the table directly
+static_assert(chemistry_profiles[CHEMISTRY_LIFEPO4].id == CHEMISTRY_LIFEPO4, "chemistry_profiles out of order");
+static_assert(chemistry_profiles[CHEMISTRY_LIION].id   == CHEMISTRY_LIION,   "chemistry_profiles out of order");
+static_assert(chemistry_profiles[CHEMISTRY_LIPO].id    == CHEMISTRY_LIPO,    "chemistry_profiles out of order");
+
+const chemistry_profile_t *chemistry_profile(chemistry_t id){
+    return (id < CHEMISTRY_COUNT) ? &chemistry_profiles[id] : nullptr;
+}
+
+chemistry_t chemistry_find(const char *name){
+    for (int i = 0; i < CHEMISTRY_COUNT; i++) {
+        if (0 == strcasecmp(name, chemistry_profiles[i].name)) {
+            return (chemistry_t)i;
+        }
+    }
+    return CHEMISTRY_COUNT;
+}
+
+chemistry_t chemistry_find_gauge_id(const char *gauge_id){
+    for (int i = 0; i < CHEMISTRY_COUNT; i++) {
+        if (0 == strcasecmp(gauge_id, chemistry_profiles[i].gauge_id)) {
+            return (chemistry_t)i;
+        }
+    }
+    return CHEMISTRY_COUNT;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file meshsolar_chemistry.h
+ * @brief Battery chemistry registry, one constant table row per supported chemistry.
+ *
+ * Every chemistry dependent value the driver writes to the gauge lives in
+ * chemistry_profiles[], indexed by chemistry_t:
+ *
+ *   name      "type" of the config command and of the sync reply
+ *   gauge_id  SBS DeviceChemistry string, the BQ4050 stores 4 characters
+ *   charge / cov / cov_recovery
+ *             Advanced Charge Algorithm and COV protection voltages per
+ *             temperature zone (low, standard, high, recommended), per cell
+ *   design_cell_mv
+ *             Per cell voltage behind Design Voltage and Design Capacity cWh
+ *   edv / cedv
+ *             Default fixed EDV0-2 and CEDV Profile 1 voltages, used for the
+ *             "cedv" fields an advance command leaves out. cedv[n] is the
+ *             voltage at n * 10 % depth of discharge, TI profile order.
+ *
+ * The "type" string is resolved to a chemistry_t once, when the command is
+ * parsed; the setting planners only index the table. Adding a chemistry is a
+ * new enum value and a new row in meshsolar_chemistry.cpp.
+ *
+ * PORTING NOTES:
+ * - The table is constexpr and stays in flash
+ */
+
+#ifndef __MESHSOLAR_CHEMISTRY_H__
+#define __MESHSOLAR_CHEMISTRY_H__
+
+#include <stdint.h>
+
+typedef enum {
+    CHEMISTRY_LIFEPO4 = 0,
+    CHEMISTRY_LIION,
+    CHEMISTRY_LIPO,
+    CHEMISTRY_COUNT,                        // Also "unknown"
+} chemistry_t;
+
+// Per cell voltages of the four BQ4050 temperature zones (mV)
+typedef struct {
+    uint16_t low;                           // Low temperature (-20°C to 0°C)
+    uint16_t std;                           // Standard temperature (0°C to 45°C)
+    uint16_t high;                          // High temperature (45°C to 60°C)
+    uint16_t rec;                           // Recommended temperature
+} chemistry_temp_mv_t;
+
+typedef struct {
+    chemistry_t         id;                 // Row index, checked at compile time
+    const char         *name;
+    const char         *gauge_id;
+    chemistry_temp_mv_t charge;             // Charge voltage
+    chemistry_temp_mv_t cov;                // Cell over-voltage threshold
+    chemistry_temp_mv_t cov_recovery;       // Cell over-voltage recovery
+    uint16_t            design_cell_mv;
+    uint16_t            edv[3];             // Fixed EDV0, EDV1, EDV2 (mV)
+    uint16_t            cedv[11];           // CEDV Profile 1 Voltage 0-100 (mV)
+} chemistry_profile_t;
+
+extern const chemistry_profile_t chemistry_profiles[CHEMISTRY_COUNT];
+
+// Row of a chemistry, nullptr for CHEMISTRY_COUNT
+const chemistry_profile_t *chemistry_profile(chemistry_t id);
+// "type" name to chemistry, case-insensitive, CHEMISTRY_COUNT if unknown
+chemistry_t chemistry_find(const char *name);
+// DeviceChemistry string read from the gauge to chemistry, CHEMISTRY_COUNT if unknown
+chemistry_t chemistry_find_gauge_id(const char *gauge_id);
+
+#endif // __MESHSOLAR_CHEMISTRY_H__
@@ -0,0 +1,93 @@
+#include "meshsolar_events.h"
+#include <string.h>
+
+MeshSolarEvents::MeshSolarEvents(){
+    memset(this->ring, 0, sizeof(this->ring));
+    this->total     = 0;
+    this->pushed    = 0;
+    this->safety    = 0;
+    this->operation = 0;
+    this->pin_state = false;
+    this->lock      = nullptr;
+}
+
+/**
+ * @brief Append one edge per changed bit, lowest bit first
+ */
+void MeshSolarEvents::record(uint8_t reg, uint32_t changed, uint32_t bits, uint32_t now){
+    for (uint8_t bit = 0; changed != 0; bit++, changed >>= 1) {
+        if (changed & 1) {
+            protection_event_t *e = &this->ring[this->total % EVENT_JOURNAL_SIZE];
+            e->time_ms = now;
+            e->reg     = reg;
+            e->bit     = bit;
+            e->set     = (bits >> bit) & 1;
+            this->total++;
+        }
+    }
+}
+
+/**
+ * @brief Record the edges between the previous snapshot and this one
+ *
+ * @param safety    Raw SafetyStatus bits
+ * @param operation Raw OperationStatus bits
+ * @param now       Time of the snapshot (ms)
+ * @return uint8_t Edges recorded
+ */
+uint8_t MeshSolarEvents::update(uint32_t safety, uint32_t operation, uint32_t now){
+    safety    &= EVENT_SAFETY_MASK;
+    operation &= EVENT_OPERATION_MASK;
+    if (this->lock != nullptr) {
+        this->lock(true);
+    }
+    uint32_t before = this->total;
+    this->record(EVENT_REG_SAFETY, safety ^ this->safety, safety, now);
+    this->record(EVENT_REG_OPERATION, operation ^ this->operation, operation, now);
+    this->safety    = safety;
+    this->operation = operation;
+    uint8_t found   = (uint8_t)(this->total - before);
+    if (this->lock != nullptr) {
+        this->lock(false);
+    }
+    return found;
+}
+
+/**
+ * @brief Record an edge of the emergency shutdown pin
+ *
+ * @param asserted Pin level, true = shutdown requested
+ * @param time_ms  Time of the interrupt that saw the edge (ms)
+ * @return bool False if the level equals the last one recorded (bounce)
+ */
+bool MeshSolarEvents::pin(bool asserted, uint32_t time_ms){
+    if (this->lock != nullptr) {
+        this->lock(true);
+    }
+    bool changed = (asserted != this->pin_state);
+    if (changed) {
+        this->record(EVENT_REG_PIN, 1, asserted ? 1 : 0, time_ms);
+        this->pin_state = asserted;
+    }
+    if (this->lock != nullptr) {
+        this->lock(false);
+    }
+    return changed;
+}
+
+uint32_t MeshSolarEvents::first() const{
+    return (this->total > EVENT_JOURNAL_SIZE) ? this->total - EVENT_JOURNAL_SIZE : 0;
+}
+
+/**
+ * @brief Read one edge by sequence number
+ *
+ * @return false if it was dropped or not recorded yet
+ */
+bool MeshSolarEvents::get(uint32_t seq, protection_event_t *e) const{
+    if (seq < this->first() || seq >= this->total) {
+        return false;
+    }
+    *e = this->ring[seq % EVENT_JOURNAL_SIZE];
+    return true;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file meshsolar_events.h
+ * @brief Edge journal of the SafetyStatus and OperationStatus bits.
+ *
+ * Polled status lines only show the protection state at the moment of the
+ * poll: a COV that trips and clears between two polls never reaches the
+ * host, and a latched one repeats its full name in every line. The journal
+ * instead compares the raw registers of each snapshot with the previous one
+ * and records one entry per bit that changed:
+ *
+ *   time (ms), register, bit, set or cleared          8 bytes per edge
+ *
+ * The entries not yet sent are pushed as one small frame right after the
+ * read that found them, oldest first, at most EVENT_FRAME_MAX per frame:
+ *
+ *   {"command":"event","now":93512,"seq":41,"events":[[93400,"COV",1],[93400,"CHG",0]]}
+ *
+ * Each event is [time, bit name, 1 = set / 0 = cleared]. Names come from
+ * safetyStatusBitName() and operationStatusBitName(); the two sets do not
+ * overlap. "seq" numbers the first event, so a host that sees a gap asks
+ * for it again with {"command":"events","from":seq}.
+ *
+ * Only the OperationStatus bits in EVENT_OPERATION_MASK are tracked: FET,
+ * fuse, security, safety/permanent failure, shutdown and EMSHUT. Calibration,
+ * LED and balancing bits toggle in normal operation.
+ *
+ * The emergency shutdown pin is journaled as its own register (EVENT_REG_PIN,
+ * name "EMSHUT_PIN"), from the interrupt timestamp instead of a poll.
+ *
+ * CONCURRENCY:
+ * - update() runs inside the status reads and pin() from whichever task
+ *   serves the pin interrupt. set_lock() installs a lock that both take
+ *   around their ring writes; a reader holds the same lock while it walks
+ *   get() and moves pushed_to(). Without a lock the journal is single-task.
+ *
+ * TIMING:
+ * - The journal starts from all-clear, so protections already active at
+ *   boot appear as "set" edges of the first snapshot.
+ * - Edges are as fine as the poll: a bit that sets and clears between two
+ *   reads is still missed, but MeshSolar polls fast while protection is active.
+ */
+
+#ifndef __MESHSOLAR_EVENTS_H__
+#define __MESHSOLAR_EVENTS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENT_JOURNAL_SIZE      64          // Edges kept, the oldest is dropped first
+#define EVENT_FRAME_MAX         8           // Edges in one frame
+#define EVENT_SAFETY_MASK       0x0FD57FFFu // Defined SafetyStatus bits
+#define EVENT_OPERATION_MASK    0x20017F2Eu // DSG, CHG, PCHG, FUSE, SEC0-1, SDV, SS, PF, XDSG, XCHG, SDM, EMSHUT
+
+typedef enum {
+    EVENT_REG_SAFETY = 0,
+    EVENT_REG_OPERATION,
+    EVENT_REG_PIN,                          // Bit 0: emergency shutdown pin asserted
+} event_reg_t;
+
+typedef struct {
+    uint32_t time_ms;                       // Time of the snapshot that saw the edge
+    uint8_t  reg;                           // event_reg_t
+    uint8_t  bit;
+    bool     set;                           // true = 0 -> 1, false = 1 -> 0
+} protection_event_t;
+
+class MeshSolarEvents{
+private:
+    protection_event_t ring[EVENT_JOURNAL_SIZE];
+    uint32_t           total;               // Edges recorded, sequence number of the next one
+    uint32_t           pushed;              // Sequence number of the next edge to push
+    uint32_t           safety;              // Bits of the last snapshot
+    uint32_t           operation;
+    bool               pin_state;           // Last emergency shutdown pin level seen
+    void             (*lock)(bool take);    // Optional, see set_lock()
+
+    void     record(uint8_t reg, uint32_t changed, uint32_t bits, uint32_t now);
+
+public:
+    MeshSolarEvents();
+
+    // Lock taken around the ring writes of update() and pin(), nullptr = none
+    void     set_lock(void (*lock)(bool take)) { this->lock = lock; }
+
+    // Compare a snapshot with the previous one, returns the number of edges found
+    uint8_t  update(uint32_t safety, uint32_t operation, uint32_t now);
+    // Record an emergency shutdown pin edge, returns false if the level did not change
+    bool     pin(bool asserted, uint32_t time_ms);
+
+    uint32_t first() const;                 // Sequence number of the oldest edge kept
+    uint32_t end() const { return total; }  // Sequence number after the newest edge
+    bool     get(uint32_t seq, protection_event_t *e) const;
+
+    // Edges found since the last push, and the sequence number to push from
+    uint32_t unpushed() const { return total - ((pushed < first()) ? first() : pushed); }
+    uint32_t push_from() const { return (pushed < first()) ? first() : pushed; }
+    void     pushed_to(uint32_t seq) { pushed = seq; }
+};
+
+#endif // __MESHSOLAR_EVENTS_H__
@@ -0,0 +1,353 @@
+#include "meshsolar_history.h"
+#include "../utils/varint.h"
+#include "../utils/logger.h"
+#include <ArduinoJson.h>
+#include <math.h>
+
+/**
+ * @brief Quantize a status snapshot to the stored integer units
+ */
+void history_sample_from_status(const meshsolar_status_t *sta, uint32_t now, history_sample_t *s){
+    memset(s, 0, sizeof(*s));
+    s->time_ms = now;
+    s->soc     = sta->soc_gauge;
+    s->current = sta->charge_current;
+    s->voltage = lroundf(sta->total_voltage);
+    for (int c = 0; c < 4; c++) {
+        s->cell_mv[c] = lroundf(sta->cells[c].voltage);
+        s->temp_dc[c] = lroundf(sta->cells[c].temperature * 10.0f);
+    }
+    s->safety = sta->safety_status.bytes;
+    int cells = (sta->cell_count >= 1 && sta->cell_count <= 4) ? sta->cell_count : 4;
+    s->flags  = (sta->fet_enable ? HISTORY_FLAG_FET : 0) | (sta->emergency_shutdown ? HISTORY_FLAG_EMSHUT : 0) |
+                HISTORY_FLAG_CELLS(cells);
+    s->fcc    = lroundf(sta->learned_capacity);
+}
+
+/**
+ * @brief Expand a stored sample to a status snapshot
+ *
+ * The safety bits are restored raw, so the result serializes with
+ * meshsolar_status_to_json() like a live snapshot.
+ */
+void history_sample_to_status(const history_sample_t *s, meshsolar_status_t *sta){
+    memset(sta, 0, sizeof(*sta));
+    strlcpy(sta->command, "status", sizeof(sta->command));
+    sta->soc_gauge        = s->soc;
+    sta->charge_current   = (int16_t)s->current;
+    sta->total_voltage    = (float)s->voltage;
+    sta->pack_voltage     = (uint16_t)s->voltage;
+    sta->learned_capacity = (float)s->fcc;
+    for (int c = 0; c < 4; c++) {
+        sta->cells[c].cell_num    = c + 1;
+        sta->cells[c].voltage     = (float)s->cell_mv[c];
+        sta->cells[c].temperature = s->temp_dc[c] / 10.0f;
+    }
+    sta->cell_count          = ((s->flags >> 2) & 0x03) + 1;
+    sta->fet_enable          = (s->flags & HISTORY_FLAG_FET) != 0;
+    sta->emergency_shutdown  = (s->flags & HISTORY_FLAG_EMSHUT) != 0;
+    sta->safety_status.bytes = s->safety;
+}
+
+#define QUAD_ESCAPE     0x88        // Nibbles -8,-8: four varints follow
+
+/**
+ * @brief Write four deltas, two bytes of signed nibbles when all are in -7..7
+ */
+static size_t put_quad(uint8_t *buf, size_t len, const int32_t *v, const int32_t *prev){
+    int32_t d[4];
+    bool    small = true;
+    for (int c = 0; c < 4; c++) {
+        d[c]  = v[c] - prev[c];
+        small = small && (d[c] >= -7 && d[c] <= 7);
+    }
+    if (small && len >= 2) {
+        buf[0] = (uint8_t)((d[0] & 0x0F) | ((d[1] & 0x0F) << 4));
+        buf[1] = (uint8_t)((d[2] & 0x0F) | ((d[3] & 0x0F) << 4));
+        return 2;
+    }
+    size_t n = 0;
+    if (len > 0) {
+        buf[n++] = QUAD_ESCAPE;
+    }
+    for (int c = 0; c < 4; c++) {
+        n += varint_put(&buf[n], len - n, zigzag_encode(d[c]));
+    }
+    return n;
+}
+
+static int32_t nibble(uint8_t b){
+    return (b & 0x08) ? (int32_t)b - 16 : (int32_t)b;
+}
+
+/**
+ * @brief Encode one record against the previous sample of its block
+ *
+ * @param s     Sample, dt_ms already set
+ * @param prev  Previous sample of the block, zero for the first record
+ * @param key   First record of the block, every group is written
+ * @param buf   Output, HISTORY_RECORD_MAX bytes
+ * @return size_t Record length
+ */
+static size_t encode_record(const history_sample_t *s, const history_sample_t *prev, bool key, uint8_t *buf){
+    uint8_t mask = key ? 0xFF : 0;
+    if (!key) {
+        mask |= (s->dt_ms   != prev->dt_ms)   ? HISTORY_REC_DT      : 0;
+        mask |= (s->soc     != prev->soc)     ? HISTORY_REC_SOC     : 0;
+        mask |= (s->current != prev->current) ? HISTORY_REC_CURRENT : 0;
+        mask |= (s->voltage != prev->voltage) ? HISTORY_REC_VOLTAGE : 0;
+        mask |= memcmp(s->cell_mv, prev->cell_mv, sizeof(s->cell_mv)) ? HISTORY_REC_CELLS : 0;
+        mask |= memcmp(s->temp_dc, prev->temp_dc, sizeof(s->temp_dc)) ? HISTORY_REC_TEMPS : 0;
+        mask |= (s->safety != prev->safety || s->flags != prev->flags) ? HISTORY_REC_STATE : 0;
+        mask |= (s->fcc     != prev->fcc)     ? HISTORY_REC_FCC     : 0;
+    }
+
+    size_t n = 0;
+    buf[n++] = mask;
+    #define PUT(V)  n += varint_put(&buf[n], HISTORY_RECORD_MAX - n, (V))
+    if (mask & HISTORY_REC_DT)      { PUT(s->dt_ms); }
+    if (mask & HISTORY_REC_SOC)     { PUT(zigzag_encode(s->soc - prev->soc)); }
+    if (mask & HISTORY_REC_CURRENT) { PUT(zigzag_encode(s->current - prev->current)); }
+    if (mask & HISTORY_REC_VOLTAGE) { PUT(zigzag_encode(s->voltage - prev->voltage)); }
+    if (mask & HISTORY_REC_CELLS)   { n += put_quad(&buf[n], HISTORY_RECORD_MAX - n, s->cell_mv, prev->cell_mv); }
+    if (mask & HISTORY_REC_TEMPS)   { n += put_quad(&buf[n], HISTORY_RECORD_MAX - n, s->temp_dc, prev->temp_dc); }
+    if (mask & HISTORY_REC_STATE) {
+        PUT(s->safety);
+        buf[n++] = s->flags;
+    }
+    if (mask & HISTORY_REC_FCC)     { PUT(zigzag_encode(s->fcc - prev->fcc)); }
+    #undef PUT
+    return n;
+}
+
+/**
+ * @brief Construct an empty history
+ */
+MeshSolarHistory::MeshSolarHistory(){
+    this->clear();
+}
+
+void MeshSolarHistory::clear(){
+    this->head  = 0;
+    this->count = 0;
+}
+
+history_block_t *MeshSolarHistory::newest(){
+    return (this->count == 0) ? nullptr : &this->blocks[(this->head + this->count - 1) % HISTORY_BLOCKS];
+}
+
+/**
+ * @brief Start a new block, dropping the oldest one when the ring is full
+ */
+history_block_t *MeshSolarHistory::open_block(uint32_t now){
+    if (this->count == HISTORY_BLOCKS) {
+        this->head = (this->head + 1) % HISTORY_BLOCKS;
+        this->count--;
+    }
+    this->count++;
+    history_block_t *b = this->newest();
+    memset(b, 0, sizeof(*b));
+    b->t0     = now;
+    b->t_last = now;
+    return b;
+}
+
+/**
+ * @brief Store one status snapshot
+ *
+ * @param sta Snapshot just read by get_realtime_bat_status()
+ * @param now Current time (ms)
+ */
+void MeshSolarHistory::add(const meshsolar_status_t *sta, uint32_t now){
+    history_sample_t s;
+    uint8_t          rec[HISTORY_RECORD_MAX];
+    history_sample_from_status(sta, now, &s);
+
+    history_block_t *b = this->newest();
+    size_t n = 0;
+    if (b != nullptr) {
+        s.dt_ms = now - b->t_last;
+        n = encode_record(&s, &b->prev, b->count == 0, rec);
+    }
+    if (b == nullptr || b->used + n > HISTORY_BLOCK_SIZE) {
+        b = this->open_block(now);
+        s.dt_ms = 0;
+        n = encode_record(&s, &b->prev, true, rec);
+    }
+    memcpy(&b->data[b->used], rec, n);
+    b->used  += n;
+    b->count++;
+    b->t_last = now;
+    b->prev   = s;
+}
+
+/**
+ * @brief List the blocks holding records in [from, to]
+ *
+ * @param from  Oldest time wanted (node millis)
+ * @param to    Newest time wanted (node millis)
+ * @param index Receives the block indexes, oldest first
+ * @param max   Size of index
+ * @return uint8_t Blocks found
+ */
+uint8_t MeshSolarHistory::find(uint32_t from, uint32_t to, uint8_t *index, uint8_t max) const{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < this->count && n < max; i++) {
+        uint8_t k = (this->head + i) % HISTORY_BLOCKS;
+        const history_block_t *b = &this->blocks[k];
+        // Compare as ages from 'to' so the millis() wrap-around does not matter
+        if ((int32_t)(b->t0 - to) <= 0 && (int32_t)(b->t_last - from) >= 0) {
+            index[n++] = k;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Build the "history" frame of one block
+ *
+ * @param index  Block index returned by find()
+ * @param seq    Position of the frame in the reply
+ * @param total  Frames in the reply
+ * @param now    Current time (ms), lets the host turn t0 into an age
+ * @param output Receives the frame
+ * @return size_t Frame length
+ */
+size_t MeshSolarHistory::block_to_json(uint8_t index, uint8_t seq, uint8_t total, uint32_t now, String &output) const{
+    static const char hex[] = "0123456789abcdef";
+    const history_block_t *b = &this->blocks[index % HISTORY_BLOCKS];
+    char data[HISTORY_BLOCK_SIZE * 2 + 1];
+    for (uint16_t i = 0; i < b->used; i++) {
+        data[2 * i]     = hex[b->data[i] >> 4];
+        data[2 * i + 1] = hex[b->data[i] & 0x0F];
+    }
+    data[2 * b->used] = '\0';
+
+    StaticJsonDocument<256> doc;
+    doc["command"] = "history";
+    doc["now"]     = now;
+    doc["seq"]     = seq;
+    doc["total"]   = total;
+    doc["t0"]      = b->t0;
+    doc["count"]   = b->count;
+    doc["data"]    = (const char *)data;    // Stored as a pointer, data outlives serializeJson()
+    output = "";
+    return serializeJson(doc, output);
+}
+
+size_t MeshSolarHistory::bytes() const{
+    size_t n = 0;
+    for (uint8_t i = 0; i < this->count; i++) {
+        n += this->blocks[(this->head + i) % HISTORY_BLOCKS].used;
+    }
+    return n;
+}
+
+uint32_t MeshSolarHistory::records() const{
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < this->count; i++) {
+        n += this->blocks[(this->head + i) % HISTORY_BLOCKS].count;
+    }
+    return n;
+}
+
+/**
+ * @brief Start decoding a block
+ *
+ * @param data Block bytes ("data" of a history frame, see history_hex_decode())
+ * @param len  Number of bytes
+ * @param t0   "t0" of the frame
+ */
+HistoryDecoder::HistoryDecoder(const uint8_t *data, size_t len, uint32_t t0){
+    this->data = data;
+    this->len  = len;
+    this->pos  = 0;
+    memset(&this->s, 0, sizeof(this->s));
+    this->s.time_ms = t0;
+}
+
+/**
+ * @brief Decode the next record
+ *
+ * @param out Receives the sample, time_ms in node millis()
+ * @return true if a record was decoded
+ */
+bool HistoryDecoder::next(history_sample_t *out){
+    if (this->pos >= this->len) {
+        return false;
+    }
+    history_sample_t *s = &this->s;
+    uint8_t mask = this->data[this->pos++];
+    bool    ok   = true;
+    uint32_t v;
+    auto get = [&](void) -> uint32_t {
+        size_t n = ok ? varint_get(&this->data[this->pos], this->len - this->pos, &v) : 0;
+        ok = ok && (n > 0);
+        this->pos += n;
+        return ok ? v : 0;
+    };
+
+    if (mask & HISTORY_REC_DT)      { s->dt_ms = get(); }
+    s->time_ms += s->dt_ms;
+    if (mask & HISTORY_REC_SOC)     { s->soc     += zigzag_decode(get()); }
+    if (mask & HISTORY_REC_CURRENT) { s->current += zigzag_decode(get()); }
+    if (mask & HISTORY_REC_VOLTAGE) { s->voltage += zigzag_decode(get()); }
+    auto get_quad = [&](int32_t *v) {
+        ok = ok && (this->pos + 2 <= this->len);
+        if (!ok) {
+            return;
+        }
+        if (this->data[this->pos] == QUAD_ESCAPE) {
+            this->pos++;
+            for (int c = 0; c < 4; c++) { v[c] += zigzag_decode(get()); }
+            return;
+        }
+        for (int c = 0; c < 4; c++) {
+            v[c] += nibble((this->data[this->pos + c / 2] >> ((c & 1) * 4)) & 0x0F);
+        }
+        this->pos += 2;
+    };
+
+    if (mask & HISTORY_REC_CELLS)   { get_quad(s->cell_mv); }
+    if (mask & HISTORY_REC_TEMPS)   { get_quad(s->temp_dc); }
+    if (mask & HISTORY_REC_STATE) {
+        s->safety = get();
+        ok = ok && (this->pos < this->len);
+        s->flags  = ok ? this->data[this->pos++] : 0;
+    }
+    if (mask & HISTORY_REC_FCC)     { s->fcc += zigzag_decode(get()); }
+
+    if (!ok) {
+        LOG_E("History record at %u truncated", (unsigned)this->pos);
+        this->pos = this->len;
+        return false;
+    }
+    *out = *s;
+    return true;
+}
+
+/**
+ * @brief Convert the hex "data" of a history frame to bytes
+ *
+ * @param hex Hex string, lower or upper case
+ * @param out Output buffer
+ * @param len Size of out
+ * @return size_t Bytes written, 0 on an odd length, a bad digit or a short buffer
+ */
+size_t history_hex_decode(const char *hex, uint8_t *out, size_t len){
+    size_t n = strlen(hex);
+    if ((n & 1) || n / 2 > len) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        char c = hex[i];
+        uint8_t d = (c >= '0' && c <= '9') ? c - '0' :
+                    (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                    (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0xFF;
+        if (d == 0xFF) {
+            return 0;
+        }
+        out[i / 2] = (i & 1) ? (out[i / 2] | d) : (uint8_t)(d << 4);
+    }
+    return n / 2;
+}
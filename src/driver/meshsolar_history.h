@@ -0,0 +1,132 @@
+/**
+ * @file meshsolar_history.h
+ * @brief Delta-compressed RAM history of status snapshots, replayed with the "history" command.
+ *
+ * Snapshots are quantized to integers (mV, mA, 0.1 degC, mAh) and stored as
+ * the difference to the previous snapshot. The history is a ring of
+ * HISTORY_BLOCKS fixed blocks; when all are full the oldest block is dropped
+ * whole. Each block starts from a zero state, so any block decodes on its own.
+ *
+ * RECORD FORMAT (one per snapshot):
+ *
+ *   byte    mask of the groups that follow, HISTORY_REC_*
+ *   varint  DT       time since the previous record (ms), when it changed
+ *   zigzag  SOC      soc_gauge delta (%)
+ *   zigzag  CURRENT  charge_current delta (mA)
+ *   zigzag  VOLTAGE  total_voltage delta (mV)
+ *   quad    CELLS    4 cell voltage deltas (mV)
+ *   quad    TEMPS    4 temperature deltas (0.1 degC)
+ *   varint  STATE    SafetyStatus bits, then a flags byte: bit 0 FET,
+ *                    bit 1 EMSHUT, bits 2-3 cell_count - 1
+ *   zigzag  FCC      learned_capacity delta (mAh)
+ *
+ * varint/zigzag are described in varint.h. A quad is 2 bytes of signed
+ * nibbles (delta 0 in bits 0-3 of the first byte ... delta 3 in bits 4-7 of
+ * the second) when every delta is within -7..7, else 0x88 and 4 zigzag
+ * varints. A group is left out when it did not change, so an idle pack costs
+ * 1 byte per snapshot and a discharging one with ADC jitter about 5. The
+ * first record of a block has every bit set.
+ *
+ * The "history" command sends one JSON frame per block overlapping the range,
+ * the block bytes in hex:
+ *
+ *   {"command":"history","now":7260000,"seq":0,"total":3,"t0":3600000,"count":240,"data":"ff00..."}
+ *
+ * t0 and now are node millis(), so the age of a record is now - (t0 + sum of DT).
+ * HistoryDecoder turns the bytes back into snapshots on the gateway or host.
+ */
+
+#ifndef __MESHSOLAR_HISTORY_H__
+#define __MESHSOLAR_HISTORY_H__
+
+#include "meshsolar.h"
+
+#define HISTORY_BLOCK_SIZE      256         // Bytes per block, one JSON frame
+#define HISTORY_BLOCKS          32          // Blocks in the ring (HISTORY_BLOCKS * HISTORY_BLOCK_SIZE bytes of RAM)
+#define HISTORY_RECORD_MAX      76          // Longest record: mask, 14 varints, 2 quad escapes, flags
+
+#define HISTORY_REC_DT          0x01
+#define HISTORY_REC_SOC         0x02
+#define HISTORY_REC_CURRENT     0x04
+#define HISTORY_REC_VOLTAGE     0x08
+#define HISTORY_REC_CELLS       0x10
+#define HISTORY_REC_TEMPS       0x20
+#define HISTORY_REC_STATE       0x40
+#define HISTORY_REC_FCC         0x80
+
+// One snapshot as stored, integer units
+typedef struct {
+    uint32_t time_ms;                   // Node millis() of the snapshot
+    uint32_t dt_ms;                     // Time since the previous snapshot of the block
+    int32_t  soc;                       // %
+    int32_t  current;                   // mA
+    int32_t  voltage;                   // mV
+    int32_t  cell_mv[4];                // mV
+    int32_t  temp_dc[4];                // 0.1 degC
+    uint32_t safety;                    // SafetyStatus bits
+    uint8_t  flags;                     // HISTORY_FLAG_* and cell_count - 1
+    int32_t  fcc;                       // mAh
+} history_sample_t;
+
+#define HISTORY_FLAG_FET        0x01
+#define HISTORY_FLAG_EMSHUT     0x02
+#define HISTORY_FLAG_CELLS(n)   ((uint8_t)(((n) - 1) & 0x03) << 2)
+
+// Quantize a snapshot / expand a stored sample
+void history_sample_from_status(const meshsolar_status_t *sta, uint32_t now, history_sample_t *s);
+void history_sample_to_status(const history_sample_t *s, meshsolar_status_t *sta);
+
+typedef struct {
+    uint32_t         t0;                // Time of the first record
+    uint32_t         t_last;            // Time of the last record
+    uint16_t         used;              // Bytes of data in use
+    uint16_t         count;             // Records
+    history_sample_t prev;              // Last record, base of the next delta
+    uint8_t          data[HISTORY_BLOCK_SIZE];
+} history_block_t;
+
+class MeshSolarHistory{
+private:
+    history_block_t blocks[HISTORY_BLOCKS];
+    uint8_t         head;               // Oldest block
+    uint8_t         count;              // Blocks in use, the newest is (head + count - 1)
+
+    history_block_t *newest();
+    history_block_t *open_block(uint32_t now);
+
+public:
+    MeshSolarHistory();
+
+    void    clear();
+    // Store one snapshot
+    void    add(const meshsolar_status_t *sta, uint32_t now);
+
+    // Blocks overlapping [from, to] (node millis), oldest first
+    uint8_t find(uint32_t from, uint32_t to, uint8_t *index, uint8_t max) const;
+    // "history" frame of one block
+    size_t  block_to_json(uint8_t index, uint8_t seq, uint8_t total, uint32_t now, String &output) const;
+    // Bytes stored, records stored
+    size_t  bytes() const;
+    uint32_t records() const;
+};
+
+/**
+ * @brief Decodes the records of one block, on the node or on a host
+ */
+class HistoryDecoder{
+private:
+    const uint8_t   *data;
+    size_t           len;
+    size_t           pos;
+    history_sample_t s;                 // Last decoded record
+
+public:
+    HistoryDecoder(const uint8_t *data, size_t len, uint32_t t0);
+
+    bool next(history_sample_t *out);   // false at the end of the block or on a corrupt record
+};
+
+// Hex string of a "data" field to bytes, returns bytes written, 0 on bad input
+size_t history_hex_decode(const char *hex, uint8_t *out, size_t len);
+
+#endif // __MESHSOLAR_HISTORY_H__
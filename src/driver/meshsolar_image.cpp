@@ -0,0 +1,259 @@
+#include "meshsolar_image.h"
+#include "meshsolar_history.h"
+#include "../utils/frame_sync.h"
+#include "../utils/logger.h"
+#include "../utils/sysclock.h"
+#include <ArduinoJson.h>
+
+static const char *const op_names[IMAGE_OP_COUNT] = {
+    "begin", "data", "commit",
+};
+
+/**
+ * @brief Map an import "op" name to its id
+ */
+image_op_t image_find_op(const char *name){
+    for (int i = 0; i < IMAGE_OP_COUNT; i++) {
+        if (strcmp(name, op_names[i]) == 0) {
+            return (image_op_t)i;
+        }
+    }
+    return IMAGE_OP_COUNT;
+}
+
+MeshSolarImage::MeshSolarImage(){
+    this->begin();
+    this->exp_addr = DF_BASE;
+    this->exp_len  = 0;
+    this->exp_crc  = 0xFFFF;
+}
+
+bool MeshSolarImage::block_staged(uint16_t off) const{
+    for (uint16_t k = off; k < off + DF_BLOCK_MAX; k += 8) {
+        if (this->mask[k >> 3] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Set the range of the next export
+ *
+ * @param addr First address, 0 = DF_BASE
+ * @param len  Bytes, 0 = up to the end of the region
+ * @return false if the range leaves the DataFlash region
+ */
+bool MeshSolarImage::export_begin(int addr, int len){
+    addr = (addr == 0) ? DF_BASE : addr;
+    if (addr < DF_BASE || addr >= DF_BASE + DF_SIZE) {
+        LOG_E("Export: 0x%04X outside DataFlash", addr);
+        return false;
+    }
+    len = (len == 0) ? DF_BASE + DF_SIZE - addr : len;
+    if (addr + len > DF_BASE + DF_SIZE) {
+        LOG_E("Export: 0x%04X + %d passes the end of DataFlash", addr, len);
+        return false;
+    }
+    this->exp_addr = (uint16_t)addr;
+    this->exp_len  = (uint16_t)len;
+    this->exp_crc  = 0xFFFF;
+    return true;
+}
+
+/**
+ * @brief Read one chunk of the export range and create its frame
+ *
+ * Chunks must be requested in order from 0, the summary CRC is accumulated here.
+ *
+ * @return Size of serialized JSON, 0 past the last chunk or on a bus error
+ */
+size_t MeshSolarImage::export_chunk_json(BQ4050 *gauge, uint16_t seq, String &output){
+    static const char hex[] = "0123456789abcdef";
+    output = "";
+    if (seq >= this->chunks()) {
+        return 0;
+    }
+    uint16_t addr = (uint16_t)(this->exp_addr + seq * DF_IMAGE_CHUNK);
+    uint16_t end  = this->exp_addr + this->exp_len;
+    uint16_t len  = (end - addr < DF_IMAGE_CHUNK) ? end - addr : DF_IMAGE_CHUNK;
+    uint8_t  bytes[DF_IMAGE_CHUNK];
+    for (uint16_t n = 0; n < len; n += DF_BLOCK_MAX) {
+        uint8_t        part  = (len - n < DF_BLOCK_MAX) ? len - n : DF_BLOCK_MAX;
+        bq4050_block_t block = {(uint16_t)(addr + n), part, nullptr, NUMBER};
+        if (!gauge->read_dataflash_block(&block)) {
+            LOG_E("Export: read of 0x%04X failed", addr + n);
+            return 0;
+        }
+        memcpy(&bytes[n], block.pvalue, part);  // pvalue points to a shared driver buffer
+    }
+    if (seq == 0) {
+        this->exp_crc = 0xFFFF;
+    }
+    this->exp_crc = frame_crc16(bytes, len, this->exp_crc);
+
+    char data[DF_IMAGE_CHUNK * 2 + 1];
+    for (uint16_t i = 0; i < len; i++) {
+        data[2 * i]     = hex[bytes[i] >> 4];
+        data[2 * i + 1] = hex[bytes[i] & 0x0F];
+    }
+    data[2 * len] = '\0';
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(6)> doc;
+    doc["command"] = "export";
+    doc["seq"]     = seq;
+    doc["total"]   = this->chunks();
+    doc["addr"]    = addr;
+    doc["data"]    = (const char *)data;    // Stored as a pointer, data outlives serializeJson()
+    doc["crc"]     = frame_crc16(bytes, len);
+    return serializeJson(doc, output);
+}
+
+size_t MeshSolarImage::export_summary_json(String &output){
+    output = "";
+    StaticJsonDocument<JSON_OBJECT_SIZE(4)> doc;
+    doc["command"] = "export";
+    doc["addr"]    = this->exp_addr;
+    doc["len"]     = this->exp_len;
+    doc["crc"]     = this->exp_crc;
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Drop every staged byte
+ */
+void MeshSolarImage::begin(){
+    memset(this->buf, 0xFF, sizeof(this->buf));
+    memset(this->mask, 0, sizeof(this->mask));
+    memset(&this->result, 0, sizeof(this->result));
+    this->staged = 0;
+}
+
+/**
+ * @brief Stage one chunk, nothing is written to the gauge
+ *
+ * @param addr DataFlash address of the first byte
+ * @param hex  Chunk bytes in hex
+ * @param crc  CRC-16 of the chunk bytes
+ * @return false on a bad hex string, a CRC mismatch or a range outside DataFlash
+ */
+bool MeshSolarImage::stage(int addr, const char *hex, int crc){
+    uint8_t bytes[DF_IMAGE_CHUNK];
+    size_t  len = history_hex_decode(hex, bytes, sizeof(bytes));
+    if (len == 0) {
+        LOG_E("Import: bad chunk data at 0x%04X", addr);
+        return false;
+    }
+    if (addr < DF_BASE || addr + (int)len > DF_BASE + DF_SIZE) {
+        LOG_E("Import: 0x%04X + %u outside DataFlash", addr, (unsigned)len);
+        return false;
+    }
+    if (frame_crc16(bytes, len) != (uint16_t)crc) {
+        LOG_E("Import: chunk 0x%04X CRC %04X, expected %04X", addr, frame_crc16(bytes, len), crc);
+        return false;
+    }
+    uint16_t off = (uint16_t)(addr - DF_BASE);
+    for (uint16_t i = 0; i < len; i++, off++) {
+        if (!this->is_staged(off)) {
+            this->mask[off >> 3] |= (uint8_t)(1 << (off & 7));
+            this->staged++;
+        }
+        this->buf[off] = bytes[i];          // A later chunk overrides an earlier one
+    }
+    return true;
+}
+
+/**
+ * @brief Write the staged bytes to the gauge, then verify them
+ *
+ * @param crc CRC-16 of every staged byte in address order
+ * @return true if every block holding a staged byte reads back the staged
+ *         bytes; false without any write on a CRC mismatch or an empty staging
+ */
+bool MeshSolarImage::commit(BQ4050 *gauge, int crc){
+    memset(&this->result, 0, sizeof(this->result));
+    if (this->staged == 0) {
+        LOG_E("Import: nothing staged");
+        return false;
+    }
+    uint16_t sum = 0xFFFF;
+    for (uint16_t off = 0; off < DF_SIZE; off++) {
+        if (this->is_staged(off)) {
+            sum = frame_crc16(&this->buf[off], 1, sum);
+        }
+    }
+    if (sum != (uint16_t)crc) {
+        LOG_E("Import: staged CRC %04X, expected %04X, nothing written", sum, crc);
+        return false;
+    }
+
+    uint8_t written[DF_IMAGE_BLOCKS / 8];
+    memset(written, 0, sizeof(written));
+    for (uint16_t b = 0; b < DF_IMAGE_BLOCKS; b++) {
+        uint16_t off = b * DF_BLOCK_MAX;
+        if (!this->block_staged(off)) {
+            continue;
+        }
+        this->result.blocks++;
+        bq4050_block_t cur = {(uint16_t)(DF_BASE + off), DF_BLOCK_MAX, nullptr, NUMBER};
+        if (!gauge->read_dataflash_block(&cur)) {
+            LOG_E("Import: read of 0x%04X failed", DF_BASE + off);
+            this->result.failed++;
+            continue;
+        }
+        uint8_t data[DF_BLOCK_MAX];
+        bool    change = false;
+        memcpy(data, cur.pvalue, sizeof(data));
+        for (uint16_t k = 0; k < DF_BLOCK_MAX; k++) {
+            if (this->is_staged(off + k) && data[k] != this->buf[off + k]) {
+                data[k] = this->buf[off + k];
+                change  = true;
+            }
+        }
+        if (!change) {
+            this->result.unchanged++;       // Saves a flash write and its settle time
+            continue;
+        }
+        bq4050_block_t block = {(uint16_t)(DF_BASE + off), DF_BLOCK_MAX, data, NUMBER};
+        if (!gauge->write_dataflash_block(block)) {
+            LOG_E("Import: write of 0x%04X failed", DF_BASE + off);
+            this->result.failed++;
+            continue;
+        }
+        sysclk::delay(100);
+        written[b >> 3] |= (uint8_t)(1 << (b & 7));
+    }
+
+    for (uint16_t b = 0; b < DF_IMAGE_BLOCKS; b++) {
+        if (!((written[b >> 3] >> (b & 7)) & 1)) {
+            continue;
+        }
+        uint16_t       off = b * DF_BLOCK_MAX;
+        bq4050_block_t ret = {(uint16_t)(DF_BASE + off), DF_BLOCK_MAX, nullptr, NUMBER};
+        bool           ok  = gauge->read_dataflash_block(&ret);
+        for (uint16_t k = 0; ok && k < DF_BLOCK_MAX; k++) {
+            ok = !this->is_staged(off + k) || ret.pvalue[k] == this->buf[off + k];
+        }
+        if (ok) {
+            this->result.written++;
+        }
+        else {
+            LOG_E("Import: 0x%04X verify - ERROR", DF_BASE + off);
+            this->result.failed++;
+        }
+    }
+    LOG_I("Import: %u blocks, %u written, %u unchanged, %u failed", (unsigned)this->result.blocks,
+          (unsigned)this->result.written, (unsigned)this->result.unchanged, (unsigned)this->result.failed);
+    return this->result.failed == 0;
+}
+
+size_t MeshSolarImage::commit_json(String &output){
+    output = "";
+    StaticJsonDocument<JSON_OBJECT_SIZE(5)> doc;
+    doc["command"]   = "import";
+    doc["blocks"]    = this->result.blocks;
+    doc["written"]   = this->result.written;
+    doc["unchanged"] = this->result.unchanged;
+    doc["failed"]    = this->result.failed;
+    return serializeJson(doc, output);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file meshsolar_image.h
+ * @brief DataFlash golden image: streamed export, staged import with block writes.
+ *
+ * "config" and "advance" turn into a few dozen single-parameter writes and
+ * only cover the parameters they know. An image is the raw DataFlash of a
+ * known-good pack, moved in frames of DF_IMAGE_CHUNK bytes, hex encoded, each
+ * with the CRC-16/CCITT-FALSE of its bytes (frame_crc16()):
+ *
+ *   {"command":"export"}                      whole region, "addr"/"len" for part of it
+ *   {"command":"export","seq":0,"total":128,"addr":16384,"data":"0a1b...","crc":4660}
+ *   ...
+ *   {"command":"export","addr":16384,"len":8192,"crc":51966}    CRC-16 of every byte
+ *
+ * Import stages chunks in RAM and touches the gauge only on commit:
+ *
+ *   {"command":"import","op":"begin"}                                    clear the staging
+ *   {"command":"import","op":"data","addr":16384,"data":"...","crc":4660}  one per chunk
+ *   {"command":"import","op":"commit","crc":51966}
+ *
+ * An export chunk frame is a valid "data" frame once renamed, so an export
+ * replays into an import. A sparse patch is any set of chunks; the commit
+ * "crc" covers the staged bytes in address order. Every frame is answered
+ * with an rsp, the host resends a rejected chunk.
+ *
+ * Commit checks that CRC first, then for every DF_BLOCK_MAX byte block holding
+ * a staged byte: reads the block, overlays the staged bytes, skips it if
+ * nothing changes, else writes it with one block access. One read-back pass
+ * over the written blocks verifies the staged bytes, and a summary closes the
+ * reply:
+ *
+ *   {"command":"import","blocks":40,"written":6,"unchanged":34,"failed":0}
+ *
+ * PORTING NOTES:
+ * - The staging buffer covers the whole region plus a bit per byte, ~9 KB RAM
+ * - A full image carries the calibration, lifetime and learned data of its
+ *   source pack; export the ranges to clone, or patch, when packs differ
+ * - The gauge must be unsealed for DataFlash access
+ *
+ * TIMING:
+ * - Export: two block reads per frame, about 1-2 s for the region
+ * - Commit: one read per staged block, then 100 ms per written block and one
+ *   verify read per written block. A retry rewrites only the blocks that did
+ *   not take, the others read back unchanged.
+ */
+
+#ifndef __MESHSOLAR_IMAGE_H__
+#define __MESHSOLAR_IMAGE_H__
+
+#include "meshsolar.h"
+
+#define DF_IMAGE_BLOCKS     (DF_SIZE / DF_BLOCK_MAX)
+
+typedef enum {
+    IMAGE_OP_BEGIN = 0,
+    IMAGE_OP_DATA,
+    IMAGE_OP_COMMIT,
+    IMAGE_OP_COUNT,
+} image_op_t;
+
+typedef struct {
+    uint16_t blocks;                        // Blocks holding a staged byte
+    uint16_t written;                       // Blocks written and verified
+    uint16_t unchanged;                     // Blocks that already held the staged bytes
+    uint16_t failed;                        // Blocks that failed to read, write or verify
+} image_result_t;
+
+class MeshSolarImage{
+private:
+    uint8_t        buf[DF_SIZE];            // Staged bytes, indexed from DF_BASE
+    uint8_t        mask[DF_SIZE / 8];       // Bit set = byte staged
+    uint16_t       staged;                  // Bytes staged
+    image_result_t result;                  // Last commit
+    uint16_t       exp_addr;                // Export range
+    uint16_t       exp_len;
+    uint16_t       exp_crc;                 // CRC-16 of the chunks sent so far
+
+    bool is_staged(uint16_t off) const { return (this->mask[off >> 3] >> (off & 7)) & 1; }
+    bool block_staged(uint16_t off) const;
+
+public:
+    MeshSolarImage();
+
+    // Export: check the range, then send the chunks in order and the summary
+    bool     export_begin(int addr, int len);
+    uint16_t chunks() const { return (this->exp_len + DF_IMAGE_CHUNK - 1) / DF_IMAGE_CHUNK; }
+    size_t   export_chunk_json(BQ4050 *gauge, uint16_t seq, String &output);
+    size_t   export_summary_json(String &output);
+
+    // Import
+    void     begin();
+    bool     stage(int addr, const char *hex, int crc);
+    bool     commit(BQ4050 *gauge, int crc);
+    size_t   commit_json(String &output);
+};
+
+// "op" name to id, IMAGE_OP_COUNT if unknown
+image_op_t image_find_op(const char *name);
+
+#endif // __MESHSOLAR_IMAGE_H__
@@ -0,0 +1,646 @@
+#include "meshsolar_json.h"
+#include "meshsolar_image.h"
+#include "../utils/logger.h"
+
+/*
+ * ============================================================================
+ * FIELD TABLES - JSON protocol of the MeshSolar structures
+ * ============================================================================
+ *
+ * Each line maps one JSON key to one struct member. The same line is used to
+ * parse commands and to serialize responses, so a new field is added here only.
+ *
+ * Columns: group, key, struct, member, storage type, scale (JSON = C * scale),
+ *          accepted min/max (JSON units), serialized decimals, flags
+ *
+ * Bounds follow what the gauge can store: voltages and capacities are 16-bit
+ * DataFlash values, temperatures are limited to the BQ4050 operating range.
+ */
+#define U16_MAX     65535.0f
+
+const json_field_t meshsolar_basic_fields[] = {
+    JSON_FIELD("battery",                "type",                  basic_config_t, type,                             JSON_FIELD_STR,   1.0f,   0.0f,    0.0f,   0, 0),
+    JSON_FIELD("battery",                "cell_number",           basic_config_t, cell_number,                      JSON_FIELD_INT,   1.0f,   1.0f,    4.0f,   0, 0),
+    JSON_FIELD("battery",                "design_capacity",       basic_config_t, design_capacity,                  JSON_FIELD_INT,   1.0f,   1.0f,    U16_MAX,0, 0),
+    JSON_FIELD("battery",                "cutoff_voltage",        basic_config_t, discharge_cutoff_voltage,         JSON_FIELD_INT,   1.0f,   0.0f,    U16_MAX,0, 0),
+    JSON_FIELD("temperature_protection", "discharge_high_temp_c", basic_config_t, protection.discharge_high_temp_c, JSON_FIELD_FLOAT, 1.0f,  -40.0f,  125.0f,  1, 0),
+    JSON_FIELD("temperature_protection", "discharge_low_temp_c",  basic_config_t, protection.discharge_low_temp_c,  JSON_FIELD_FLOAT, 1.0f,  -40.0f,  125.0f,  1, 0),
+    JSON_FIELD("temperature_protection", "charge_high_temp_c",    basic_config_t, protection.charge_high_temp_c,    JSON_FIELD_FLOAT, 1.0f,  -40.0f,  125.0f,  1, 0),
+    JSON_FIELD("temperature_protection", "charge_low_temp_c",     basic_config_t, protection.charge_low_temp_c,     JSON_FIELD_FLOAT, 1.0f,  -40.0f,  125.0f,  1, 0),
+    JSON_FIELD("temperature_protection", "temp_enabled",          basic_config_t, protection.enabled,               JSON_FIELD_BOOL,  1.0f,   0.0f,    1.0f,   0, 0),
+};
+const size_t meshsolar_basic_field_count = JSON_FIELD_COUNT(meshsolar_basic_fields);
+
+const json_field_t meshsolar_advance_fields[] = {
+    JSON_FIELD("battery", "cuv",               advance_config_t, battery.cuv,            JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX - 100.0f, 0, 0), // CUV recovery = cuv + 100
+    JSON_FIELD("battery", "eoc",               advance_config_t, battery.eoc,            JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, 0),
+    JSON_FIELD("battery", "eoc_protect",       advance_config_t, battery.eoc_protect,    JSON_FIELD_INT, 1.0f, 100.0f, U16_MAX,          0, 0), // COV recovery = eoc_protect - 100
+    JSON_FIELD("cedv",    "cedv0",             advance_config_t, cedv.cedv0,             JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL), // Absent or 0 = chemistry default
+    JSON_FIELD("cedv",    "cedv1",             advance_config_t, cedv.cedv1,             JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "cedv2",             advance_config_t, cedv.cedv2,             JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv0",   advance_config_t, cedv.discharge_cedv0,   JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv10",  advance_config_t, cedv.discharge_cedv10,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv20",  advance_config_t, cedv.discharge_cedv20,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv30",  advance_config_t, cedv.discharge_cedv30,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv40",  advance_config_t, cedv.discharge_cedv40,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv50",  advance_config_t, cedv.discharge_cedv50,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv60",  advance_config_t, cedv.discharge_cedv60,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv70",  advance_config_t, cedv.discharge_cedv70,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv80",  advance_config_t, cedv.discharge_cedv80,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv90",  advance_config_t, cedv.discharge_cedv90,  JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD("cedv",    "discharge_cedv100", advance_config_t, cedv.discharge_cedv100, JSON_FIELD_INT, 1.0f, 0.0f,   U16_MAX,          0, JSON_FIELD_OPTIONAL),
+};
+const size_t meshsolar_advance_field_count = JSON_FIELD_COUNT(meshsolar_advance_fields);
+
+// Status is only serialized, bounds are informative
+const json_field_t meshsolar_status_fields[] = {
+    JSON_FIELD(nullptr, "soc_gauge",        meshsolar_status_t, soc_gauge,        JSON_FIELD_INT,    1.0f,    0.0f,      100.0f,   0, 0),
+    JSON_FIELD(nullptr, "charge_current",   meshsolar_status_t, charge_current,   JSON_FIELD_INT16,  1.0f,   -32768.0f,  32767.0f, 0, 0),
+    JSON_FIELD(nullptr, "total_voltage",    meshsolar_status_t, total_voltage,    JSON_FIELD_FLOAT,  0.001f,  0.0f,      U16_MAX,  3, JSON_FIELD_AS_STRING), // mV -> "V.vvv"
+    JSON_FIELD(nullptr, "learned_capacity", meshsolar_status_t, learned_capacity, JSON_FIELD_FLOAT,  0.001f,  0.0f,      U16_MAX,  3, JSON_FIELD_AS_STRING), // mAh -> "Ah.aaa"
+    JSON_FIELD(nullptr, "pack_voltage",     meshsolar_status_t, pack_voltage,     JSON_FIELD_UINT16, 1.0f,    0.0f,      U16_MAX,  0, JSON_FIELD_AS_STRING), // mV
+    JSON_FIELD(nullptr, "fet_enable",       meshsolar_status_t, fet_enable,       JSON_FIELD_BOOL,   1.0f,    0.0f,      1.0f,     0, 0),
+};
+const size_t meshsolar_status_field_count = JSON_FIELD_COUNT(meshsolar_status_fields);
+
+const json_field_t meshsolar_cell_fields[] = {
+    JSON_FIELD(nullptr, "cell_num",    cell_status_t, cell_num,    JSON_FIELD_INT,   1.0f,    1.0f,   4.0f,    0, 0),
+    JSON_FIELD(nullptr, "temperature", cell_status_t, temperature, JSON_FIELD_FLOAT, 1.0f,   -40.0f,  125.0f,  3, 0), // °C
+    JSON_FIELD(nullptr, "voltage",     cell_status_t, voltage,     JSON_FIELD_FLOAT, 0.001f,  0.0f,   U16_MAX, 3, 0), // mV -> V
+};
+const size_t meshsolar_cell_field_count = JSON_FIELD_COUNT(meshsolar_cell_fields);
+
+static const json_field_t switch_fields[] = {
+    JSON_FIELD(nullptr, "fet_en", fet_config_t, enable, JSON_FIELD_BOOL, 1.0f, 0.0f, 1.0f, 0, 0),
+};
+
+static const json_field_t sync_fields[] = {
+    JSON_FIELD(nullptr, "times", sync_config_t, times, JSON_FIELD_UINT16, 1.0f, 1.0f, 10.0f, 0, JSON_FIELD_OPTIONAL),
+};
+
+static const json_field_t ack_fields[] = {
+    JSON_FIELD(nullptr, "session", ack_config_t, session, JSON_FIELD_UINT16, 1.0f, 1.0f, U16_MAX, 0, 0),
+};
+
+static const json_field_t aggregate_fields[] = {
+    JSON_FIELD(nullptr, "window", aggregate_config_t, window_ms, JSON_FIELD_INT, 1.0f, 0.0f, 86400000.0f, 0, 0), // ms
+};
+
+static const json_field_t history_fields[] = {
+    JSON_FIELD(nullptr, "from", history_config_t, from_s, JSON_FIELD_INT, 1.0f, 0.0f, 2000000.0f, 0, 0),                   // s ago
+    JSON_FIELD(nullptr, "to",   history_config_t, to_s,   JSON_FIELD_INT, 1.0f, 0.0f, 2000000.0f, 0, JSON_FIELD_OPTIONAL), // s ago
+};
+
+static const json_field_t trend_fields[] = {
+    JSON_FIELD(nullptr, "from",   trend_config_t, from_s, JSON_FIELD_INT, 1.0f, 0.0f, 5400000.0f, 0, 0),                   // s ago
+    JSON_FIELD(nullptr, "to",     trend_config_t, to_s,   JSON_FIELD_INT, 1.0f, 0.0f, 5400000.0f, 0, JSON_FIELD_OPTIONAL), // s ago
+    JSON_FIELD(nullptr, "series", trend_config_t, series, JSON_FIELD_STR, 1.0f, 0.0f, 0.0f,       0, 0),
+    JSON_FIELD(nullptr, "cell",   trend_config_t, cell,   JSON_FIELD_INT, 1.0f, 0.0f, 4.0f,       0, JSON_FIELD_OPTIONAL),
+};
+
+static const json_field_t events_fields[] = {
+    JSON_FIELD(nullptr, "from", events_config_t, from, JSON_FIELD_INT, 1.0f, 0.0f, 1000000000.0f, 0, JSON_FIELD_OPTIONAL), // Event seq
+};
+
+static const json_field_t alarm_fields[] = {
+    JSON_FIELD(nullptr, "capacity", alarm_config_t, capacity_mah, JSON_FIELD_INT, 1.0f, 0.0f, U16_MAX, 0, 0), // RemainingCapacityAlarm (mAh)
+    JSON_FIELD(nullptr, "time", alarm_config_t, time_min, JSON_FIELD_INT, 1.0f, 0.0f, U16_MAX, 0, 0),         // RemainingTimeAlarm (min)
+};
+
+static const json_field_t capture_fields[] = {
+    JSON_FIELD(nullptr, "samples", capture_config_t, samples,    JSON_FIELD_INT, 1.0f, 1.0f, 256.0f,   0, JSON_FIELD_OPTIONAL), // CAPTURE_SAMPLES_MAX
+    JSON_FIELD(nullptr, "trigger", capture_config_t, trigger_ma, JSON_FIELD_INT, 1.0f, 0.0f, 32767.0f, 0, JSON_FIELD_OPTIONAL), // |current| (mA)
+    JSON_FIELD(nullptr, "timeout", capture_config_t, timeout_ms, JSON_FIELD_INT, 1.0f, 0.0f, 10000.0f, 0, JSON_FIELD_OPTIONAL), // ms
+    JSON_FIELD(nullptr, "source",  capture_config_t, source,     JSON_FIELD_STR, 1.0f, 0.0f, 0.0f,     0, JSON_FIELD_OPTIONAL), // "da1" or "sbs"
+};
+
+static const json_field_t export_fields[] = {
+    JSON_FIELD(nullptr, "addr", image_config_t, addr, JSON_FIELD_INT, 1.0f, 0.0f, 24575.0f, 0, JSON_FIELD_OPTIONAL), // 0 = DF_BASE
+    JSON_FIELD(nullptr, "len",  image_config_t, len,  JSON_FIELD_INT, 1.0f, 0.0f, 8192.0f,  0, JSON_FIELD_OPTIONAL), // 0 = to the end
+};
+
+static const json_field_t import_fields[] = {
+    JSON_FIELD(nullptr, "op",   image_config_t, op,   JSON_FIELD_STR, 1.0f, 0.0f, 0.0f,     0, 0),                   // "begin", "data", "commit"
+    JSON_FIELD(nullptr, "addr", image_config_t, addr, JSON_FIELD_INT, 1.0f, 0.0f, 24575.0f, 0, JSON_FIELD_OPTIONAL),
+    JSON_FIELD(nullptr, "data", image_config_t, data, JSON_FIELD_STR, 1.0f, 0.0f, 0.0f,     0, JSON_FIELD_OPTIONAL), // Hex, DF_IMAGE_CHUNK bytes at most
+    JSON_FIELD(nullptr, "crc",  image_config_t, crc,  JSON_FIELD_INT, 1.0f, 0.0f, U16_MAX,  0, JSON_FIELD_OPTIONAL), // CRC-16/CCITT-FALSE
+};
+
+static const json_field_t log_fields[] = {
+    JSON_FIELD(nullptr, "count", log_config_t, count, JSON_FIELD_INT, 1.0f, 1.0f, 4096.0f, 0, JSON_FIELD_OPTIONAL), // Records
+};
+
+// One entry of the subscribe "fields" array, besides its "name"
+static const json_field_t sub_field_fields[] = {
+    JSON_FIELD(nullptr, "period", sub_field_t, period_ms, JSON_FIELD_INT,   1.0f, 100.0f, 86400000.0f, 0, JSON_FIELD_OPTIONAL), // ms
+    JSON_FIELD(nullptr, "delta",  sub_field_t, delta,     JSON_FIELD_FLOAT, 1.0f, 0.0f,   U16_MAX,     3, JSON_FIELD_OPTIONAL), // JSON units of the field
+};
+
+/*
+ * ============================================================================
+ * COMMAND TABLE
+ * ============================================================================
+ */
+constexpr const char *const meshsolar_cmd_names[MESHSOLAR_CMD_COUNT] = {
+    "config", "advance", "switch", "reset", "sync", "status", "renew", "diag", "batch",
+    "subscribe", "ack", "aggregate", "history", "trend", "log", "events",
+    "alarm", "capture", "packs", "export", "import",
+};
+
+// Command hash seed, searched by the compiler; a new name that collides fails the build
+static constexpr int cmd_hash_seed = command_hash_seed(meshsolar_cmd_names, MESHSOLAR_CMD_COUNT);
+static_assert(cmd_hash_seed >= 0, "no perfect hash seed for meshsolar_cmd_names, raise COMMAND_HASH_SLOTS");
+
+typedef struct {
+    const json_field_t *fields;         // Parameter table, nullptr = no parameters
+    size_t              count;
+    uint16_t            offset;         // Offset of the parameters in meshsolar_config_t
+    uint16_t            size;           // Size of the parameters in meshsolar_config_t
+} cmd_params_t;
+
+#define CMD_PARAMS(FIELDS, MEMBER) \
+    { FIELDS, JSON_FIELD_COUNT(FIELDS), offsetof(meshsolar_config_t, MEMBER), sizeof(((meshsolar_config_t *)0)->MEMBER) }
+#define CMD_NO_PARAMS   { nullptr, 0, 0, 0 }
+
+static const cmd_params_t cmd_params[MESHSOLAR_CMD_COUNT] = {
+    CMD_PARAMS(meshsolar_basic_fields,   basic),    // config
+    CMD_PARAMS(meshsolar_advance_fields, advance),  // advance
+    CMD_PARAMS(switch_fields,            fet_en),   // switch
+    CMD_NO_PARAMS,                                  // reset
+    CMD_PARAMS(sync_fields,              sync),     // sync
+    CMD_NO_PARAMS,                                  // status
+    CMD_NO_PARAMS,                                  // renew
+    CMD_NO_PARAMS,                                  // diag
+    CMD_NO_PARAMS,                                  // batch, see parse_batch()
+    CMD_NO_PARAMS,                                  // subscribe, see parse_subscribe()
+    CMD_PARAMS(ack_fields,               ack),      // ack, "missing" see parse_missing()
+    CMD_PARAMS(aggregate_fields,         aggregate),// aggregate
+    CMD_PARAMS(history_fields,           history),  // history
+    CMD_PARAMS(trend_fields,             trend),    // trend
+    CMD_PARAMS(log_fields,               log),      // log
+    CMD_PARAMS(events_fields,            events),   // events
+    CMD_PARAMS(alarm_fields,             alarm),    // alarm
+    CMD_PARAMS(capture_fields,           capture),  // capture
+    CMD_NO_PARAMS,                                  // packs
+    CMD_PARAMS(export_fields,            image),    // export
+    CMD_PARAMS(import_fields,            image),    // import
+};
+
+/**
+ * @brief Map a command name to its id
+ *
+ * The perfect hash is built on first use from meshsolar_cmd_names[] and the
+ * build time seed. Should that ever fail, the failure is logged once and
+ * every lookup falls back to a linear scan of the names.
+ *
+ * @param name Command name
+ * @return meshsolar_cmd_t Command id, MESHSOLAR_CMD_INVALID if unknown
+ */
+meshsolar_cmd_t meshsolar_find_command(const char *name){
+    static CommandHash hash;
+    static int8_t      state = 0;       // 0 = not built, 1 = hash, -1 = linear scan
+    if (state == 0) {
+        state = hash.begin(meshsolar_cmd_names, MESHSOLAR_CMD_COUNT, (uint8_t)cmd_hash_seed) ? 1 : -1;
+        if (state < 0) {
+            LOG_E("Command hash unusable, using a linear scan");
+        }
+    }
+    if (state < 0) {
+        for (int i = 0; name != nullptr && i < MESHSOLAR_CMD_COUNT; i++) {
+            if (strcmp(name, meshsolar_cmd_names[i]) == 0) {
+                return (meshsolar_cmd_t)i;
+            }
+        }
+        return MESHSOLAR_CMD_INVALID;
+    }
+    int i = hash.find(name);
+    return (i < 0) ? MESHSOLAR_CMD_INVALID : (meshsolar_cmd_t)i;
+}
+
+/**
+ * @brief Whether a parsed command needs DataFlash access
+ *
+ * "config", "advance", a batch holding either, "export" and an import
+ * "commit". Staging import chunks stays in RAM and is always accepted.
+ *
+ * @param id  Parsed command
+ * @param cmd Its parameters
+ * @return true if the gauge must not be SEALED
+ */
+bool meshsolar_cmd_uses_dataflash(meshsolar_cmd_t id, const meshsolar_config_t *cmd){
+    switch (id) {
+        case MESHSOLAR_CMD_CONFIG:
+        case MESHSOLAR_CMD_ADVANCE:
+        case MESHSOLAR_CMD_EXPORT:
+            return true;
+        case MESHSOLAR_CMD_IMPORT:
+            return image_find_op(cmd->image.op) == IMAGE_OP_COMMIT;
+        case MESHSOLAR_CMD_BATCH:
+            for (uint8_t i = 0; i < cmd->batch.count; i++) {
+                if (cmd->batch.steps[i] == MESHSOLAR_CMD_CONFIG || cmd->batch.steps[i] == MESHSOLAR_CMD_ADVANCE) {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Parse the "steps" array of a batch command
+ *
+ * Each step is a regular config, advance, switch, reset or sync command
+ * object. Its parameters are copied to the matching member of cmd, so a
+ * command may appear only once per batch.
+ *
+ * @param steps Array of command objects
+ * @param cmd   Command structure, receives the step list and parameters
+ * @return true if every step is valid
+ */
+static bool parse_batch(JsonArrayConst steps, meshsolar_config_t *cmd){
+    if (steps.isNull() || steps.size() == 0 || steps.size() > MESHSOLAR_BATCH_MAX) {
+        LOG_E("Batch needs 1 to %d steps", MESHSOLAR_BATCH_MAX);
+        return false;
+    }
+    meshsolar_config_t step;
+    for (JsonObjectConst obj : steps) {
+        meshsolar_cmd_t id = meshsolar_find_command(obj["command"] | "");
+        if (id != MESHSOLAR_CMD_CONFIG && id != MESHSOLAR_CMD_ADVANCE && id != MESHSOLAR_CMD_SWITCH &&
+            id != MESHSOLAR_CMD_RESET && id != MESHSOLAR_CMD_SYNC) {
+            LOG_E("Step %d: command not allowed in a batch", cmd->batch.count);
+            return false;
+        }
+        for (uint8_t i = 0; i < cmd->batch.count; i++) {
+            if (cmd->batch.steps[i] == id) {
+                LOG_E("Step %d: '%s' repeated", cmd->batch.count, meshsolar_cmd_names[id]);
+                return false;
+            }
+        }
+        if (meshsolar_parse_command(obj, &step) != id) {
+            return false;
+        }
+        const cmd_params_t *params = &cmd_params[id];
+        memcpy((uint8_t *)cmd + params->offset, (const uint8_t *)&step + params->offset, params->size);
+        cmd->batch.steps[cmd->batch.count++] = (uint8_t)id;
+    }
+    return true;
+}
+
+/**
+ * @brief Map a subscribable field name to its table entry
+ *
+ * Accepted names are the keys of meshsolar_status_fields[], "cells.<key>" for
+ * meshsolar_cell_fields[] (sent for every cell) and "protection_sta".
+ *
+ * @param name  Field name
+ * @param field Receives kind and index, period and delta are left untouched
+ * @return true if the name is known
+ */
+bool meshsolar_find_sub_field(const char *name, sub_field_t *field){
+    if (0 == strcmp(name, "protection_sta")) {
+        field->kind  = SUB_FIELD_PROTECTION;
+        field->index = 0;
+        return true;
+    }
+    const json_field_t *table = meshsolar_status_fields;
+    size_t              count = meshsolar_status_field_count;
+    field->kind = SUB_FIELD_STATUS;
+    if (0 == strncmp(name, "cells.", 6)) {
+        name += 6;
+        table = meshsolar_cell_fields;
+        count = meshsolar_cell_field_count;
+        field->kind = SUB_FIELD_CELL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (0 == strcmp(table[i].name, name)) {
+            field->index = (uint8_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parse the "fields" array of a subscribe command
+ *
+ * Each entry is {"name": "...", "period": ms, "delta": x}, both rates
+ * optional. Without either the field is sent on any change. An empty array
+ * cancels the subscription.
+ *
+ * @param fields Array of field objects
+ * @param sub    Receives the subscription
+ * @return true if every entry is valid
+ */
+static bool parse_subscribe(JsonArrayConst fields, subscribe_config_t *sub){
+    if (fields.isNull() || fields.size() > MESHSOLAR_SUB_MAX) {
+        LOG_E("Subscribe needs 0 to %d fields", MESHSOLAR_SUB_MAX);
+        return false;
+    }
+    for (JsonObjectConst obj : fields) {
+        sub_field_t *f = &sub->fields[sub->count];
+        f->period_ms = 0;
+        f->delta     = -1.0f;
+        if (!meshsolar_find_sub_field(obj["name"] | "", f)) {
+            LOG_E("Field %d: unknown name", sub->count);
+            return false;
+        }
+        if (!json_codec_read(obj, sub_field_fields, JSON_FIELD_COUNT(sub_field_fields), f)) {
+            return false;
+        }
+        if (f->delta < 0 && f->period_ms == 0) {
+            f->delta = 0;                           // No rate given: any change
+        }
+        for (uint8_t i = 0; i < sub->count; i++) {
+            if (sub->fields[i].kind == f->kind && sub->fields[i].index == f->index) {
+                LOG_E("Field %d: subscribed twice", sub->count);
+                return false;
+            }
+        }
+        sub->count++;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse the optional "missing" array of an ack command
+ *
+ * @param missing Array of frame sequence numbers, absent = none missing
+ * @param ack     Receives the missing frames as a bit mask
+ * @return true if every entry is a valid sequence number
+ */
+static bool parse_missing(JsonArrayConst missing, ack_config_t *ack){
+    ack->missing = 0;
+    for (JsonVariantConst v : missing) {
+        if (!v.is<unsigned int>() || v.as<unsigned int>() >= 8) {
+            LOG_E("Invalid missing frame");
+            return false;
+        }
+        ack->missing |= (uint8_t)(1 << v.as<unsigned int>());
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a command object and populate the command structure
+ * @param obj JSON object holding "command" and its parameters
+ * @param cmd Pointer to command structure to populate
+ * @return meshsolar_cmd_t Command id, MESHSOLAR_CMD_INVALID on any error
+ */
+meshsolar_cmd_t meshsolar_parse_command(JsonObjectConst obj, meshsolar_config_t *cmd){
+    // clear the command structure
+    memset(cmd, 0, sizeof(meshsolar_config_t));
+
+    const char *name = obj["command"] | (const char *)nullptr;
+    if (name == nullptr) {
+        LOG_E("Missing 'command' field");
+        return MESHSOLAR_CMD_INVALID;
+    }
+    strlcpy(cmd->command, name, sizeof(cmd->command));
+
+    meshsolar_cmd_t id = meshsolar_find_command(name);
+    if (id == MESHSOLAR_CMD_INVALID) {
+        LOG_E("Unknown command '%s'", name);
+        return MESHSOLAR_CMD_INVALID;
+    }
+    const cmd_params_t *params = &cmd_params[id];
+    if (params->fields != nullptr &&
+        !json_codec_read(obj, params->fields, params->count, (uint8_t *)cmd + params->offset)) {
+        LOG_E("Invalid parameters for '%s' command", name);
+        return MESHSOLAR_CMD_INVALID;
+    }
+    if (id == MESHSOLAR_CMD_CONFIG &&
+        (cmd->basic.chemistry = chemistry_find(cmd->basic.type)) == CHEMISTRY_COUNT) {
+        LOG_E("Unknown battery type '%s'", cmd->basic.type);
+        return MESHSOLAR_CMD_INVALID;
+    }
+    if (id == MESHSOLAR_CMD_IMPORT && image_find_op(cmd->image.op) == IMAGE_OP_COUNT) {
+        LOG_E("Unknown import op '%s'", cmd->image.op);
+        return MESHSOLAR_CMD_INVALID;
+    }
+    if (id == MESHSOLAR_CMD_BATCH && !parse_batch(obj["steps"], cmd)) {
+        LOG_E("Invalid steps for 'batch' command");
+        return MESHSOLAR_CMD_INVALID;
+    }
+    if (id == MESHSOLAR_CMD_SUBSCRIBE && !parse_subscribe(obj["fields"], &cmd->subscribe)) {
+        LOG_E("Invalid fields for 'subscribe' command");
+        return MESHSOLAR_CMD_INVALID;
+    }
+    if (id == MESHSOLAR_CMD_ACK && !parse_missing(obj["missing"], &cmd->ack)) {
+        LOG_E("Invalid missing list for 'ack' command");
+        return MESHSOLAR_CMD_INVALID;
+    }
+    return id;
+}
+
+/**
+ * @brief Parse incoming JSON command and populate command structure
+ * @param json JSON string to parse
+ * @param cmd Pointer to command structure to populate
+ * @return meshsolar_cmd_t Command id, MESHSOLAR_CMD_INVALID on any error
+ *
+ * PORTING NOTES:
+ * - Requires ArduinoJson library (version 6.x)
+ * - Uses a static StaticJsonDocument<2048>, large enough for a config + advance
+ *   batch; not reentrant, callers already serialize command handling
+ */
+meshsolar_cmd_t meshsolar_parse_command(const char *json, meshsolar_config_t *cmd){
+    static StaticJsonDocument<2048> doc;
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        LOG_E("Failed to parse JSON: %s", error.c_str());
+        return MESHSOLAR_CMD_INVALID;
+    }
+    return meshsolar_parse_command(doc.as<JsonObjectConst>(), cmd);
+}
+
+/*
+ * ============================================================================
+ * JSON SERIALIZATION FUNCTIONS - Data output formatting (snake_case naming)
+ * ============================================================================
+ */
+
+/**
+ * @brief Convert battery status to JSON format
+ * @param status Pointer to battery status structure
+ * @param output Reference to output string
+ * @param pack   Pack number 1-N added as "pack", 0 = single pack, no "pack" key
+ * @return Size of serialized JSON
+ *
+ * OUTPUT FORMAT:
+ * {
+ *   "command": "status",
+ *   "soc_gauge": 85,
+ *   "charge_current": -1200,
+ *   "total_voltage": "12.345",
+ *   "learned_capacity": "3.200",
+ *   "pack_voltage": "12345",
+ *   "fet_enable": true,
+ *   "protection_sta": "CUV,COV",
+ *   "cells": [
+ *     {"cell_num": 1, "temperature": 25.123, "voltage": 3.234},
+ *     ...
+ *   ]
+ * }
+ *
+ * PORTING NOTES:
+ * - Uses StaticJsonDocument<512> - ensure sufficient RAM
+ * - Always outputs 4 cells regardless of actual cell count
+ */
+size_t meshsolar_status_to_json(const meshsolar_status_t *status, String &output, uint8_t pack){
+    output = "";
+    StaticJsonDocument<512> doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["command"] = "status";
+    if (pack != 0) {
+        root["pack"] = pack;            // Multi-pack sites, see meshsolar_packs.h
+    }
+    json_codec_write(root, meshsolar_status_fields, meshsolar_status_field_count, status);
+    root["protection_sta"] = meshsolar_protection_str(status);
+
+    JsonArray cells = root.createNestedArray("cells");
+    for (int i = 0; i < 4; ++i) {
+        json_codec_write(cells.createNestedObject(), meshsolar_cell_fields, meshsolar_cell_field_count, &status->cells[i]);
+    }
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Convert basic battery configuration to JSON format
+ * @param basic Pointer to basic configuration structure
+ * @param output Reference to output string
+ * @return Size of serialized JSON
+ */
+size_t meshsolar_basic_config_to_json(const basic_config_t *basic, String &output){
+    output = "";
+    StaticJsonDocument<512> doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["command"] = "config";
+    json_codec_write(root, meshsolar_basic_fields, meshsolar_basic_field_count, basic);
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Convert advanced battery configuration to JSON format
+ * @param config Pointer to advanced configuration structure
+ * @param output Reference to output string
+ * @return Size of serialized JSON
+ */
+size_t meshsolar_advance_config_to_json(const advance_config_t *config, String &output){
+    output = "";
+    StaticJsonDocument<512> doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["command"] = "advance";
+    json_codec_write(root, meshsolar_advance_fields, meshsolar_advance_field_count, config);
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Create standardized command response JSON
+ * @param status Boolean indicating command success/failure
+ * @param output Reference to output string
+ * @param id Host command id to echo, nullptr or "" for none
+ * @param error Reason of a failure the host should not retry, nullptr for none
+ * @return Size of serialized JSON
+ *
+ * OUTPUT FORMAT:
+ * {"command":"rsp","status":false,"id":"42","error":"sealed"}
+ */
+size_t meshsolar_cmd_rsp_to_json(bool status, String &output, const char *id, const char *error){
+    output = "";
+    StaticJsonDocument<96> doc;
+    doc["command"] = "rsp";
+    doc["status"] = status;
+    if (id != nullptr && id[0] != '\0') {
+        doc["id"] = id;
+    }
+    if (error != nullptr) {
+        doc["error"] = error;
+    }
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Create the aggregated response of a batch command
+ * @param batch   Executed steps
+ * @param step_ok Result of each step, same order as batch->steps
+ * @param output  Reference to output string
+ * @param id      Host command id to echo, nullptr or "" for none
+ * @return Size of serialized JSON
+ *
+ * OUTPUT FORMAT:
+ * {"command":"rsp","status":false,"steps":[true,false,true],"id":"42"}
+ * "status" is true only if every step succeeded.
+ */
+size_t meshsolar_batch_rsp_to_json(const batch_config_t *batch, const bool *step_ok, String &output, const char *id){
+    output = "";
+    StaticJsonDocument<192> doc;
+    bool all = true;
+    doc["command"] = "rsp";
+    doc["status"]  = true;                          // Keeps its place, set below
+    JsonArray steps = doc.createNestedArray("steps");
+    for (uint8_t i = 0; i < batch->count; i++) {
+        steps.add(step_ok[i]);
+        all &= step_ok[i];
+    }
+    doc["status"] = all;
+    if (id != nullptr && id[0] != '\0') {
+        doc["id"] = id;
+    }
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Create one protection event frame
+ * @param events Edge journal
+ * @param seq    First edge to send, advanced past the edges sent
+ * @param now    Current time (ms)
+ * @param output Reference to output string
+ * @param pack   Pack number 1-N added as "pack", 0 = single pack
+ * @return Size of serialized JSON, 0 when no edge is left from seq
+ *
+ * OUTPUT FORMAT:
+ * {"command":"event","now":93512,"seq":41,"events":[[93400,"COV",1],[93400,"CHG",0]]}
+ * At most EVENT_FRAME_MAX edges; call again until it returns 0.
+ */
+size_t meshsolar_events_to_json(const MeshSolarEvents *events, uint32_t *seq, uint32_t now, String &output, uint8_t pack){
+    output = "";
+    if (*seq < events->first()) {
+        *seq = events->first();             // Dropped from the journal
+    }
+    if (*seq >= events->end()) {
+        return 0;
+    }
+    StaticJsonDocument<JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(EVENT_FRAME_MAX) + EVENT_FRAME_MAX * JSON_ARRAY_SIZE(3)> doc;
+    doc["command"] = "event";
+    if (pack != 0) {
+        doc["pack"] = pack;
+    }
+    doc["now"]     = now;
+    doc["seq"]     = *seq;
+    JsonArray list = doc.createNestedArray("events");
+    protection_event_t e;
+    for (uint8_t n = 0; n < EVENT_FRAME_MAX && events->get(*seq, &e); n++, (*seq)++) {
+        const char *name = (e.reg == EVENT_REG_SAFETY)    ? safetyStatusBitName(e.bit) :
+                           (e.reg == EVENT_REG_OPERATION) ? operationStatusBitName(e.bit) : "EMSHUT_PIN";
+        JsonArray item = list.createNestedArray();
+        item.add(e.time_ms);
+        item.add(name);                     // Static string, stored as a pointer
+        item.add(e.set ? 1 : 0);
+    }
+    return serializeJson(doc, output);
+}
+
+/**
+ * @brief Render the protection state for humans
+ *
+ * Snapshots keep only the raw SafetyStatus bits; the names are built here,
+ * when a status frame or a subscribed "protection_sta" is actually sent.
+ */
+String meshsolar_protection_str(const meshsolar_status_t *status){
+    String s = parseSafetyStatusBits(status->safety_status);
+    if (status->emergency_shutdown) {
+        s += ",EMSHUT";
+    }
+    return s;
+}
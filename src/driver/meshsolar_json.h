@@ -0,0 +1,65 @@
+#ifndef __MESHSOLAR_JSON_H__
+#define __MESHSOLAR_JSON_H__
+
+#include "meshsolar.h"
+#include "../utils/json_codec.h"
+
+// Host commands, the order matches meshsolar_cmd_names[]
+typedef enum {
+    MESHSOLAR_CMD_CONFIG = 0,           // Basic battery configuration
+    MESHSOLAR_CMD_ADVANCE,              // Advanced battery settings
+    MESHSOLAR_CMD_SWITCH,               // FET control
+    MESHSOLAR_CMD_RESET,                // Battery gauge reset
+    MESHSOLAR_CMD_SYNC,                 // Synchronize settings
+    MESHSOLAR_CMD_STATUS,               // Get current status
+    MESHSOLAR_CMD_RENEW,                // Re-read status and settings
+    MESHSOLAR_CMD_DIAG,                 // Get command port counters
+    MESHSOLAR_CMD_BATCH,                // Several configuration commands in one request
+    MESHSOLAR_CMD_SUBSCRIBE,            // Stream selected status fields as deltas
+    MESHSOLAR_CMD_ACK,                  // Acknowledge sequenced sync frames
+    MESHSOLAR_CMD_AGGREGATE,            // Report windowed statistics instead of every sample
+    MESHSOLAR_CMD_HISTORY,              // Replay stored status history
+    MESHSOLAR_CMD_TREND,                // Long-term min/max/mean from the rollup pyramid
+    MESHSOLAR_CMD_LOG,                  // Replay the records kept in flash
+    MESHSOLAR_CMD_EVENTS,               // Replay the protection edge journal
+    MESHSOLAR_CMD_ALARM,                // Program the gauge-side capacity/time alarms
+    MESHSOLAR_CMD_CAPTURE,              // Burst capture of cell voltages and current
+    MESHSOLAR_CMD_PACKS,                // Combined status of a multi-pack site
+    MESHSOLAR_CMD_EXPORT,               // Stream the gauge DataFlash as an image
+    MESHSOLAR_CMD_IMPORT,               // Stage and commit a DataFlash image or patch
+    MESHSOLAR_CMD_COUNT,
+    MESHSOLAR_CMD_INVALID = MESHSOLAR_CMD_COUNT, // Unparsable, unknown or rejected command
+} meshsolar_cmd_t;
+
+extern const char *const meshsolar_cmd_names[MESHSOLAR_CMD_COUNT];
+
+// Field tables, one line per JSON field
+extern const json_field_t meshsolar_basic_fields[];
+extern const size_t       meshsolar_basic_field_count;
+extern const json_field_t meshsolar_advance_fields[];
+extern const size_t       meshsolar_advance_field_count;
+extern const json_field_t meshsolar_status_fields[];
+extern const size_t       meshsolar_status_field_count;
+extern const json_field_t meshsolar_cell_fields[];
+extern const size_t       meshsolar_cell_field_count;
+
+// Command parsing
+meshsolar_cmd_t meshsolar_parse_command(const char *json, meshsolar_config_t *cmd);
+meshsolar_cmd_t meshsolar_parse_command(JsonObjectConst obj, meshsolar_config_t *cmd);
+meshsolar_cmd_t meshsolar_find_command(const char *name);
+bool meshsolar_find_sub_field(const char *name, sub_field_t *field);
+// Parsed command reads or writes DataFlash, refused while the gauge is SEALED
+bool meshsolar_cmd_uses_dataflash(meshsolar_cmd_t id, const meshsolar_config_t *cmd);
+
+// Serialization
+size_t meshsolar_status_to_json(const meshsolar_status_t *status, String &output, uint8_t pack = 0);
+size_t meshsolar_basic_config_to_json(const basic_config_t *basic, String &output);
+size_t meshsolar_advance_config_to_json(const advance_config_t *config, String &output);
+size_t meshsolar_cmd_rsp_to_json(bool status, String &output, const char *id = nullptr, const char *error = nullptr);
+size_t meshsolar_batch_rsp_to_json(const batch_config_t *batch, const bool *step_ok, String &output, const char *id = nullptr);
+size_t meshsolar_events_to_json(const MeshSolarEvents *events, uint32_t *seq, uint32_t now, String &output, uint8_t pack = 0);
+
+// Human-readable protection state, e.g. "CUV,COV" or "Normal,EMSHUT"
+String meshsolar_protection_str(const meshsolar_status_t *status);
+
+#endif // __MESHSOLAR_JSON_H__
@@ -0,0 +1,120 @@
+#include "meshsolar_pack.h"
+#include "../utils/bitpack.h"
+#include "../utils/logger.h"
+#include <math.h>
+
+#define PACK_VOLT_MIN       1500        // mV, lowest voltage raw 1 stands for
+#define PACK_VOLT_STEP      3           // mV per step
+#define PACK_TEMP_OFFSET    40          // degC added before packing
+#define PACK_CURRENT_STEP   4           // mA per step
+#define PACK_FCC_STEP       32          // mAh per step
+#define PACK_SOC_UNKNOWN    127
+
+#define PACK_SAFETY_MASK    0x0FD57FFFUL    // Defined SafetyStatus bits, see bq4050.h
+
+static long clamp(long v, long lo, long hi){
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+/**
+ * @brief Pack a status snapshot into a MESHSOLAR_PACKED_LEN byte frame
+ *
+ * @param status Snapshot, usually MeshSolar::sta
+ * @param buf    Output frame
+ * @param len    Size of buf
+ * @return size_t Bytes written, 0 if buf is too small
+ */
+size_t meshsolar_pack_status(const meshsolar_status_t *status, uint8_t *buf, size_t len){
+    if (len < MESHSOLAR_PACKED_LEN) {
+        return 0;
+    }
+    BitWriter w(buf, MESHSOLAR_PACKED_LEN);
+    int cells = (int)clamp(status->cell_count, 1, 4);
+
+    w.put(MESHSOLAR_PACK_VERSION, 2);
+    w.put(cells - 1, 2);
+    w.put((status->soc_gauge >= 0 && status->soc_gauge <= 100) ? status->soc_gauge : PACK_SOC_UNKNOWN, 7);
+    w.put(status->fet_enable ? 1 : 0, 1);
+    w.put(status->emergency_shutdown ? 1 : 0, 1);
+
+    for (int i = 0; i < 4; i++) {
+        long raw = 0;                   // Cells beyond cell_count are sent as absent
+        if (i < cells && status->cells[i].voltage >= PACK_VOLT_MIN) {
+            raw = clamp(lroundf((status->cells[i].voltage - PACK_VOLT_MIN) / PACK_VOLT_STEP) + 1, 1, 1023);
+        }
+        w.put((uint32_t)raw, 10);
+    }
+    for (int i = 0; i < 4; i++) {
+        w.put((uint32_t)clamp(lroundf(status->cells[i].temperature) + PACK_TEMP_OFFSET, 0, 127), 7);
+    }
+    w.put((uint32_t)clamp(lroundf(status->charge_current / (float)PACK_CURRENT_STEP), -4095, 4095), 13);
+    w.put((uint32_t)clamp(lroundf(status->learned_capacity / PACK_FCC_STEP), 0, 1023), 10);
+
+    uint32_t safety = status->safety_status.bytes;
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        if (PACK_SAFETY_MASK & (1UL << bit)) {
+            w.put((safety >> bit) & 1, 1);
+        }
+    }
+    return w.ok() ? MESHSOLAR_PACKED_LEN : 0;
+}
+
+/**
+ * @brief Restore a status snapshot from a packed frame
+ *
+ * Values come back quantized to the steps of the frame format. The safety
+ * bits are restored raw, so the result serializes with
+ * meshsolar_status_to_json() like a local snapshot.
+ *
+ * @param buf    Frame received from the mesh
+ * @param len    Frame size
+ * @param status Output snapshot
+ * @return true if the frame was decoded
+ */
+bool meshsolar_unpack_status(const uint8_t *buf, size_t len, meshsolar_status_t *status){
+    if (len < MESHSOLAR_PACKED_LEN) {
+        LOG_E("Packed frame too short: %d bytes", (int)len);
+        return false;
+    }
+    BitReader r(buf, MESHSOLAR_PACKED_LEN);
+    uint32_t version = r.get(2);
+    if (version != MESHSOLAR_PACK_VERSION) {
+        LOG_E("Unknown packed frame version %u", (unsigned)version);
+        return false;
+    }
+
+    memset(status, 0, sizeof(*status));
+    strlcpy(status->command, "status", sizeof(status->command));
+    status->cell_count = (int)r.get(2) + 1;
+    uint32_t soc = r.get(7);
+    status->soc_gauge          = (soc == PACK_SOC_UNKNOWN) ? -1 : (int)soc;
+    status->fet_enable         = r.get(1) != 0;
+    status->emergency_shutdown = r.get(1) != 0;
+
+    float total = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t raw = r.get(10);
+        status->cells[i].cell_num = i + 1;
+        status->cells[i].voltage  = (raw == 0) ? 0.0f : (float)(PACK_VOLT_MIN + (raw - 1) * PACK_VOLT_STEP);
+        if (i < status->cell_count) {
+            total += status->cells[i].voltage;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        status->cells[i].temperature = (float)((int)r.get(7) - PACK_TEMP_OFFSET);
+    }
+    status->charge_current   = (int16_t)(r.get_signed(13) * PACK_CURRENT_STEP);
+    status->learned_capacity = (float)(r.get(10) * PACK_FCC_STEP);
+    status->total_voltage    = total;
+    status->pack_voltage     = (uint16_t)lroundf(total);
+
+    uint32_t safety = 0;
+    for (uint8_t bit = 0; bit < 32; bit++) {
+        if (PACK_SAFETY_MASK & (1UL << bit)) {
+            safety |= r.get(1) << bit;
+        }
+    }
+    status->safety_status.bytes = safety;
+
+    return r.ok();
+}
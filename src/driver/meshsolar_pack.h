@@ -0,0 +1,44 @@
+/**
+ * @file meshsolar_pack.h
+ * @brief Fixed 16-byte binary status frame for LoRa mesh telemetry.
+ *
+ * The JSON status object is about 400 bytes, too much airtime for a mesh
+ * broadcast. meshsolar_pack_status() quantizes one meshsolar_status_t
+ * snapshot into a 128-bit frame, meshsolar_unpack_status() restores it on a
+ * gateway. Fields are LSB-first (see bitpack.h), in this order:
+ *
+ *   bits  field            encoding
+ *   ----  ---------------  ---------------------------------------------------
+ *     2   version          MESHSOLAR_PACK_VERSION
+ *     2   cell_count       count - 1 (1..4 cells)
+ *     7   soc_gauge        0..100 %, 127 = unknown
+ *     1   fet_enable
+ *     1   emergency_shutdown
+ *  4x10   cell voltage     0 = absent or below 1500 mV, else 1500 mV + (raw - 1) * 3 mV
+ *   4x7   cell temperature raw - 40 degC (-40..87 degC)
+ *    13   charge_current   signed, 4 mA steps (+-16380 mA)
+ *    10   learned_capacity 32 mAh steps (max 32736 mAh)
+ *    24   safety_status    defined SafetyStatus bits, reserved bits squeezed out
+ *
+ * total_voltage is rebuilt as the sum of the cell voltages, pack_voltage is
+ * not carried and is set to total_voltage.
+ *
+ * TIMING:
+ * - Packing is a few hundred bit operations, no heap and no String, so it can
+ *   run in the mesh stack's send path.
+ */
+
+#ifndef __MESHSOLAR_PACK_H__
+#define __MESHSOLAR_PACK_H__
+
+#include "meshsolar.h"
+
+#define MESHSOLAR_PACK_VERSION      1
+#define MESHSOLAR_PACKED_LEN        16          // Frame size (bytes)
+
+// Pack a status snapshot, returns MESHSOLAR_PACKED_LEN or 0 if buf is too small
+size_t meshsolar_pack_status(const meshsolar_status_t *status, uint8_t *buf, size_t len);
+// Restore a status snapshot, fails on a short frame or an unknown version
+bool meshsolar_unpack_status(const uint8_t *buf, size_t len, meshsolar_status_t *status);
+
+#endif // __MESHSOLAR_PACK_H__
@@ -0,0 +1,264 @@
+#include "meshsolar_packs.h"
+#include "../utils/logger.h"
+#include <ArduinoJson.h>
+#include <math.h>
+
+MeshSolarPacks::MeshSolarPacks(){
+    this->count = 0;
+    for (uint8_t i = 0; i < PACKS_MAX; i++) {
+        this->slot[i].wire   = nullptr;
+        this->slot[i].due_ms = 0;
+        this->slot[i].fails  = 0;
+        this->slot[i].online = false;
+    }
+}
+
+/**
+ * @brief Add a pack on its own bus
+ *
+ * @param sda  SDA pin of the pack's bus (nRF52840: g_ADigitalPinMap[] value)
+ * @param scl  SCL pin
+ * @param now  Current time (ms), the first poll is staggered from it
+ * @param addr Gauge address
+ * @return uint8_t Pack number 1-N, 0 if PACKS_MAX packs are already added
+ */
+uint8_t MeshSolarPacks::add(uint8_t sda, uint8_t scl, uint32_t now, uint8_t addr){
+    if (this->count >= PACKS_MAX) {
+        LOG_E("Packs: %d packs already added", PACKS_MAX);
+        return 0;
+    }
+    pack_slot_t *p = &this->slot[this->count];
+    p->wire   = new SoftwareWire(sda, scl);
+    p->gauge.begin(p->wire, addr);
+    p->solar.begin(&p->gauge);
+    p->due_ms = now + (uint32_t)this->count * PACKS_STAGGER_MS;
+    p->fails  = 0;
+    p->online = false;
+    this->count++;
+    LOG_I("Pack %u on SDA %u / SCL %u", (unsigned)this->count, (unsigned)sda, (unsigned)scl);
+    return this->count;
+}
+
+MeshSolar *MeshSolarPacks::pack(uint8_t n){
+    return (n >= 1 && n <= this->count) ? &this->slot[n - 1].solar : nullptr;
+}
+
+BQ4050 *MeshSolarPacks::gauge(uint8_t n){
+    return (n >= 1 && n <= this->count) ? &this->slot[n - 1].gauge : nullptr;
+}
+
+bool MeshSolarPacks::online(uint8_t n) const{
+    return (n >= 1 && n <= this->count) && this->slot[n - 1].online;
+}
+
+/**
+ * @brief Poll the most overdue pack, one pack per call
+ *
+ * @param now  Current time (ms)
+ * @param full Set as refresh_bat_status() does, false if no pack was due
+ * @return uint8_t Pack polled 1-N, 0 when none is due
+ */
+uint8_t MeshSolarPacks::poll(uint32_t now, bool *full){
+    *full = false;
+    int     best = -1;
+    int32_t late = -1;
+    for (uint8_t i = 0; i < this->count; i++) {
+        int32_t d = (int32_t)(now - this->slot[i].due_ms);     // Signed difference survives the wrap
+        if (d >= 0 && d > late) {
+            late = d;
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return 0;
+    }
+
+    pack_slot_t *p = &this->slot[best];
+    if (p->solar.refresh_bat_status(full)) {
+        if (!p->online) {
+            LOG_I("Pack %d online", best + 1);
+        }
+        p->fails  = 0;
+        p->online = true;
+        p->due_ms = now + p->solar.next_poll_interval_ms();
+    }
+    else {
+        uint32_t retry = PACKS_RETRY_MS << ((p->fails < 5) ? p->fails : 5);
+        p->fails  = (p->fails < 255) ? p->fails + 1 : p->fails;
+        p->due_ms = now + ((retry < PACKS_RETRY_MAX_MS) ? retry : PACKS_RETRY_MAX_MS);
+        if (p->online && p->fails >= PACKS_OFFLINE_FAILS) {
+            LOG_W("Pack %d offline after %u failed polls", best + 1, (unsigned)p->fails);
+            p->online = false;
+        }
+        *full = false;
+    }
+    return (uint8_t)(best + 1);
+}
+
+uint32_t MeshSolarPacks::next_due(uint32_t now) const{
+    uint32_t next = PACKS_RETRY_MAX_MS;
+    for (uint8_t i = 0; i < this->count; i++) {
+        int32_t d = (int32_t)(this->slot[i].due_ms - now);
+        if (d <= 0) {
+            return 0;
+        }
+        next = ((uint32_t)d < next) ? (uint32_t)d : next;
+    }
+    return next;
+}
+
+/**
+ * @brief Resolve a "pack" value to a range of slots
+ */
+bool MeshSolarPacks::target(int pack, uint8_t *first, uint8_t *last) const{
+    if (pack == 0 && this->count > 0) {
+        *first = 0;
+        *last  = this->count - 1;
+        return true;
+    }
+    if (pack >= 1 && pack <= this->count) {
+        *first = *last = (uint8_t)(pack - 1);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Parse a command into the cmd of every pack it targets
+ *
+ * @param json Command JSON, with an optional "pack" (1-N, 0 or absent = all)
+ * @param pack Set to the "pack" value, -1 if it is not a number
+ * @return meshsolar_cmd_t Command id, MESHSOLAR_CMD_INVALID on any error or a bad pack
+ *
+ * PORTING NOTES:
+ * - Uses a static StaticJsonDocument<2048> like meshsolar_parse_command();
+ *   not reentrant
+ */
+meshsolar_cmd_t MeshSolarPacks::parse_command(const char *json, int *pack){
+    static StaticJsonDocument<2048> doc;
+    *pack = -1;
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        LOG_E("Failed to parse JSON: %s", error.c_str());
+        return MESHSOLAR_CMD_INVALID;
+    }
+    JsonObjectConst obj = doc.as<JsonObjectConst>();
+    JsonVariantConst v  = obj["pack"];
+    *pack = v.isNull() ? 0 : (v.is<int>() ? v.as<int>() : -1);
+
+    uint8_t first, last;
+    if (!this->target(*pack, &first, &last)) {
+        LOG_E("No pack %d", *pack);
+        return MESHSOLAR_CMD_INVALID;
+    }
+    meshsolar_cmd_t id = MESHSOLAR_CMD_INVALID;
+    for (uint8_t i = first; i <= last; i++) {
+        id = meshsolar_parse_command(obj, &this->slot[i].solar.cmd);
+        if (id == MESHSOLAR_CMD_INVALID) {
+            break;                          // Same JSON for every pack, the first failure says it all
+        }
+    }
+    return id;
+}
+
+/**
+ * @brief Run fn on every pack a "pack" value targets
+ *
+ * Every targeted pack is attempted even after a failure, so a broadcast
+ * "switch" or "reset" still reaches the healthy packs.
+ */
+bool MeshSolarPacks::for_each(int pack, bool (*fn)(uint8_t n, MeshSolar *solar, void *ctx), void *ctx){
+    uint8_t first, last;
+    if (!this->target(pack, &first, &last)) {
+        return false;
+    }
+    bool res = true;
+    for (uint8_t i = first; i <= last; i++) {
+        res &= fn(i + 1, &this->slot[i].solar, ctx);
+    }
+    return res;
+}
+
+/**
+ * @brief Combine the online packs' snapshots
+ *
+ * SOC is weighted by each pack's FCC, current is summed, and the lowest
+ * and highest cells and the hottest sensor are found across all packs.
+ */
+void MeshSolarPacks::status(packs_status_t *out) const{
+    memset(out, 0, sizeof(*out));
+    out->packs    = this->count;
+    out->soc      = -1;
+    out->max_temp = -273.15f;
+    uint64_t weighted = 0;
+    for (uint8_t i = 0; i < this->count; i++) {
+        const meshsolar_status_t *sta = &this->slot[i].solar.sta;
+        if (!this->slot[i].online) {
+            continue;
+        }
+        out->online++;
+        out->current_ma += sta->charge_current;
+        if (sta->soc_gauge >= 0) {
+            weighted     += (uint64_t)sta->soc_gauge * sta->learned_capacity;
+            out->fcc_mah += sta->learned_capacity;
+        }
+        uint8_t cells = (sta->cell_count >= 1 && sta->cell_count <= 4) ? sta->cell_count : 4;
+        for (uint8_t c = 0; c < cells; c++) {
+            uint16_t mv = sta->cells[c].voltage;
+            if (out->min_pack == 0 || mv < out->min_cell_mv) {
+                out->min_pack    = i + 1;
+                out->min_cell    = c + 1;
+                out->min_cell_mv = mv;
+            }
+            if (out->max_pack == 0 || mv > out->max_cell_mv) {
+                out->max_pack    = i + 1;
+                out->max_cell    = c + 1;
+                out->max_cell_mv = mv;
+            }
+        }
+        for (uint8_t c = 0; c < 4; c++) {
+            if (out->hot_pack == 0 || sta->cells[c].temperature > out->max_temp) {
+                out->hot_pack = i + 1;
+                out->max_temp = sta->cells[c].temperature;
+            }
+        }
+        out->protection         |= (sta->safety_status.bytes != 0);
+        out->emergency_shutdown |= sta->emergency_shutdown;
+    }
+    if (out->fcc_mah > 0) {
+        out->soc = (int)((weighted + out->fcc_mah / 2) / out->fcc_mah);
+    }
+}
+
+/**
+ * @brief Create the combined status frame
+ * @param status Combined status from MeshSolarPacks::status()
+ * @param output Reference to output string
+ * @return Size of serialized JSON
+ */
+size_t meshsolar_packs_to_json(const packs_status_t *status, String &output){
+    output = "";
+    StaticJsonDocument<JSON_OBJECT_SIZE(10) + 3 * JSON_OBJECT_SIZE(3)> doc;
+    doc["command"] = "packs";
+    doc["packs"]   = status->packs;
+    doc["online"]  = status->online;
+    doc["soc"]     = status->soc;
+    doc["fcc"]     = status->fcc_mah;
+    doc["current"] = status->current_ma;
+    if (status->min_pack != 0) {
+        JsonObject min = doc.createNestedObject("min_cell");
+        min["pack"] = status->min_pack;
+        min["cell"] = status->min_cell;
+        min["mv"]   = status->min_cell_mv;
+        JsonObject max = doc.createNestedObject("max_cell");
+        max["pack"] = status->max_pack;
+        max["cell"] = status->max_cell;
+        max["mv"]   = status->max_cell_mv;
+        JsonObject hot = doc.createNestedObject("max_temp");
+        hot["pack"] = status->hot_pack;
+        hot["temp"] = roundf(status->max_temp * 10.0f) / 10.0f;
+    }
+    doc["protection"] = status->protection;
+    doc["emshut"]     = status->emergency_shutdown;
+    return serializeJson(doc, output);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file meshsolar_packs.h
+ * @brief Several BQ4050 packs in parallel, polled in turn and reported as one.
+ *
+ * Every BQ4050 answers at 0x0B, so each pack needs its own bus. The manager
+ * owns one (SoftwareWire, BQ4050, MeshSolar) set per pack, up to PACKS_MAX,
+ * and each pack keeps its own adaptive poll interval:
+ *
+ *   poll()   serves the single most overdue pack and returns. The loop
+ *            handles commands and transmits between two packs, so a pack
+ *            that stretches the clock or stops answering delays only its own
+ *            poll, never the others'. A pack that fails is retried with a
+ *            back-off and is reported offline after PACKS_OFFLINE_FAILS.
+ *
+ * The combined status weighs each online pack's SOC by its FCC and reports
+ * the worst cells across all packs:
+ *
+ *   {"command":"packs","packs":3,"online":3,"soc":71,"fcc":9600,"current":-1240,
+ *    "min_cell":{"pack":2,"cell":3,"mv":3288},"max_cell":{"pack":1,"cell":1,"mv":3402},
+ *    "max_temp":{"pack":3,"temp":31.5},"protection":false,"emshut":false}
+ *
+ * Commands carry an optional "pack" (1-N); without it, or with 0, they go to
+ * every pack. parse_command() fills the cmd of each targeted pack.
+ *
+ * TIMING:
+ * - Packs are staggered by PACKS_STAGGER_MS at start, so their polls do not
+ *   fall due together.
+ * - A pack's data is as fresh as its own poll interval; the combined status
+ *   mixes snapshots up to that far apart.
+ */
+
+#ifndef __MESHSOLAR_PACKS_H__
+#define __MESHSOLAR_PACKS_H__
+
+#include "meshsolar_json.h"
+#include "SoftwareWire.h"
+
+#define PACKS_MAX               4           // Packs one manager owns
+#define PACKS_STAGGER_MS        250         // Start offset between packs
+#define PACKS_RETRY_MS          2000        // First retry after a failed poll, doubled per failure
+#define PACKS_RETRY_MAX_MS      60000       // Longest retry interval
+#define PACKS_OFFLINE_FAILS     3           // Failed polls in a row before a pack is offline
+
+typedef struct {
+    SoftwareWire *wire;                     // Owned, allocated by add()
+    BQ4050        gauge;
+    MeshSolar     solar;
+    uint32_t      due_ms;                   // millis() of the next poll
+    uint8_t       fails;                    // Failed polls in a row
+    bool          online;
+} pack_slot_t;
+
+typedef struct {
+    uint8_t  packs;                         // Packs configured
+    uint8_t  online;                        // Packs with a valid snapshot
+    int      soc;                           // FCC weighted SOC (%), -1 = no pack online
+    uint32_t fcc_mah;                       // Sum of the online packs' FCC
+    int32_t  current_ma;                    // Sum of the online packs' current
+    uint8_t  min_pack;                      // Lowest cell: pack 1-N, cell 1-4, 0 = none
+    uint8_t  min_cell;
+    uint16_t min_cell_mv;
+    uint8_t  max_pack;                      // Highest cell
+    uint8_t  max_cell;
+    uint16_t max_cell_mv;
+    uint8_t  hot_pack;                      // Pack with the highest temperature
+    float    max_temp;                      // degC
+    bool     protection;                    // Any SafetyStatus bit set on any pack
+    bool     emergency_shutdown;            // Any pack in EMSHUT
+} packs_status_t;
+
+class MeshSolarPacks{
+private:
+    pack_slot_t slot[PACKS_MAX];
+    uint8_t     count;
+
+    bool target(int pack, uint8_t *first, uint8_t *last) const;
+
+public:
+    MeshSolarPacks();                       // Lives as long as the program, the buses are never freed
+
+    // Add a pack on its own bus, returns its number 1-N, 0 when full
+    uint8_t    add(uint8_t sda, uint8_t scl, uint32_t now, uint8_t addr = BQ4050ADDR);
+    uint8_t    size() const { return count; }
+    // Pack 1-N, nullptr if out of range
+    MeshSolar *pack(uint8_t n);
+    BQ4050    *gauge(uint8_t n);
+    bool       online(uint8_t n) const;
+
+    // Poll the most overdue pack, returns its number (0 = none due), full as refresh_bat_status()
+    uint8_t    poll(uint32_t now, bool *full);
+    // Milliseconds until the next pack is due
+    uint32_t   next_due(uint32_t now) const;
+
+    // Parse a command into every pack it targets, *pack = "pack" (0 = all)
+    meshsolar_cmd_t parse_command(const char *json, int *pack);
+    // Run fn on every targeted pack, true if all succeeded, false for a bad pack number
+    bool       for_each(int pack, bool (*fn)(uint8_t n, MeshSolar *solar, void *ctx), void *ctx);
+
+    // Combine the online packs' snapshots
+    void       status(packs_status_t *out) const;
+};
+
+size_t meshsolar_packs_to_json(const packs_status_t *status, String &output);
+
+#endif // __MESHSOLAR_PACKS_H__
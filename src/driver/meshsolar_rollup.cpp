@@ -0,0 +1,243 @@
+#include "meshsolar_rollup.h"
+#include "../utils/logger.h"
+#include <math.h>
+
+static const char *const series_names[ROLLUP_SERIES_COUNT] = {
+    "voltage", "temperature", "current", "soc",
+};
+
+/**
+ * @brief Map a "series" name to its id
+ */
+rollup_series_t rollup_find_series(const char *name){
+    for (int i = 0; i < ROLLUP_SERIES_COUNT; i++) {
+        if (name != nullptr && strcmp(name, series_names[i]) == 0) {
+            return (rollup_series_t)i;
+        }
+    }
+    return ROLLUP_SERIES_COUNT;
+}
+
+static int16_t clamp16(float v){
+    long x = lroundf(v);
+    return (int16_t)((x < INT16_MIN) ? INT16_MIN : (x > INT16_MAX) ? INT16_MAX : x);
+}
+
+/**
+ * @brief Construct an empty pyramid
+ */
+MeshSolarRollup::MeshSolarRollup(){
+    static const char *const names[ROLLUP_LEVELS]   = {"minute", "hour", "day"};
+    static const uint32_t    periods[ROLLUP_LEVELS] = {60, 3600, 86400};
+    rollup_bucket_t *rings[ROLLUP_LEVELS] = {this->minutes, this->hours, this->days};
+    uint8_t          sizes[ROLLUP_LEVELS] = {sizeof(this->minutes) / sizeof(this->minutes[0]),
+                                             sizeof(this->hours) / sizeof(this->hours[0]),
+                                             sizeof(this->days) / sizeof(this->days[0])};
+
+    memset(this->levels, 0, sizeof(this->levels));
+    for (uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+        this->levels[l].name   = names[l];
+        this->levels[l].period = periods[l];
+        this->levels[l].ring   = rings[l];
+        this->levels[l].size   = sizes[l];
+    }
+    this->clock_s     = 1;                  // 0 marks "no sample yet"
+    this->clock_ms    = 0;
+    this->clock_frac  = 0;
+    this->last_sample = 0;
+}
+
+/**
+ * @brief Advance the seconds-since-boot clock to millis() = now
+ *
+ * @return uint32_t Current time in seconds since boot
+ */
+uint32_t MeshSolarRollup::advance(uint32_t now){
+    uint32_t ms = (now - this->clock_ms) + this->clock_frac;    // Unsigned difference survives the wrap
+    this->clock_ms   = now;
+    this->clock_s   += ms / 1000;
+    this->clock_frac = ms % 1000;
+    return this->clock_s;
+}
+
+/**
+ * @brief Move the open bucket of a level into its ring
+ */
+void MeshSolarRollup::close(rollup_level_t *level){
+    rollup_acc_t *acc = &level->acc;
+    if (acc->weight <= 0) {
+        return;
+    }
+    if (level->count == level->size) {
+        level->head = (level->head + 1) % level->size;
+        level->count--;
+    }
+    rollup_bucket_t *b = &level->ring[(level->head + level->count) % level->size];
+    level->count++;
+
+    b->start = acc->start;
+    for (uint8_t i = 0; i < ROLLUP_VALUES; i++) {
+        b->v[i][0] = clamp16(acc->min[i]);
+        b->v[i][1] = clamp16(acc->max[i]);
+        b->v[i][2] = clamp16(acc->sum[i] / acc->weight);
+    }
+    b->fcc = acc->fcc;
+    b->soc = acc->soc;
+    acc->weight = 0;
+}
+
+/**
+ * @brief Feed one status snapshot
+ *
+ * @param sta Snapshot just read by get_realtime_bat_status()
+ * @param now Current time (ms)
+ */
+void MeshSolarRollup::add(const meshsolar_status_t *sta, uint32_t now){
+    uint32_t t = this->advance(now);
+    float    weight = 1;
+    if (this->last_sample != 0) {
+        uint32_t gap = t - this->last_sample;
+        weight = (gap == 0) ? 1.0f : (gap > ROLLUP_MAX_GAP) ? ROLLUP_MAX_GAP : (float)gap;
+    }
+    this->last_sample = t;
+
+    float v[ROLLUP_VALUES];
+    for (uint8_t c = 0; c < 4; c++) {
+        v[c]     = sta->cells[c].voltage;               // mV
+        v[4 + c] = sta->cells[c].temperature * 10.0f;   // 0.1 degC
+    }
+    v[8] = sta->charge_current;                         // mA
+
+    for (uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+        rollup_level_t *level = &this->levels[l];
+        rollup_acc_t   *acc   = &level->acc;
+        uint32_t start = t - (t % level->period);
+        if (acc->weight > 0 && acc->start != start) {
+            this->close(level);
+        }
+        if (acc->weight <= 0) {
+            acc->start = start;
+            for (uint8_t i = 0; i < ROLLUP_VALUES; i++) {
+                acc->min[i] = v[i];
+                acc->max[i] = v[i];
+                acc->sum[i] = 0;
+            }
+        }
+        for (uint8_t i = 0; i < ROLLUP_VALUES; i++) {
+            acc->min[i]  = (v[i] < acc->min[i]) ? v[i] : acc->min[i];
+            acc->max[i]  = (v[i] > acc->max[i]) ? v[i] : acc->max[i];
+            acc->sum[i] += v[i] * weight;
+        }
+        acc->weight += weight;
+        acc->fcc     = (uint16_t)lroundf(sta->learned_capacity);
+        acc->soc     = (uint8_t)((sta->soc_gauge < 0) ? 0 : sta->soc_gauge);
+    }
+}
+
+/**
+ * @brief Choose the finest level covering from_s seconds with at most ROLLUP_MAX_POINTS buckets
+ */
+uint8_t MeshSolarRollup::pick(uint32_t from_s) const{
+    for (uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+        const rollup_level_t *level = &this->levels[l];
+        uint32_t points = from_s / level->period + 1;
+        if (points <= ROLLUP_MAX_POINTS && points <= (uint32_t)level->size + 1) {
+            return l;
+        }
+    }
+    return ROLLUP_LEVELS - 1;
+}
+
+/**
+ * @brief Build the "trend" frame of one series
+ *
+ * @param series Series to send
+ * @param cell   Cell or sensor 1-4 for voltage and temperature, ignored otherwise
+ * @param from_s Oldest time wanted, seconds before now
+ * @param to_s   Newest time wanted, seconds before now
+ * @param now    Current time (ms)
+ * @param output Receives the frame
+ * @return size_t Frame length, 0 on a bad series or cell
+ */
+size_t MeshSolarRollup::to_json(rollup_series_t series, uint8_t cell, uint32_t from_s, uint32_t to_s, uint32_t now, String &output){
+    output = "";
+    bool per_cell = (series == ROLLUP_SERIES_VOLTAGE || series == ROLLUP_SERIES_TEMPERATURE);
+    if (series >= ROLLUP_SERIES_COUNT || (per_cell && (cell < 1 || cell > 4))) {
+        return 0;
+    }
+    uint32_t t = this->advance(now);
+    uint8_t  l = this->pick(from_s);
+    const rollup_level_t *level = &this->levels[l];
+    uint32_t oldest = (from_s < t) ? t - from_s : 0;
+    uint32_t newest = (to_s < t) ? t - to_s : 0;
+    uint8_t  value  = (series == ROLLUP_SERIES_VOLTAGE) ? cell - 1 :
+                      (series == ROLLUP_SERIES_TEMPERATURE) ? 4 + cell - 1 : 8;
+
+    static StaticJsonDocument<JSON_OBJECT_SIZE(10) + 4 * JSON_ARRAY_SIZE(ROLLUP_MAX_POINTS)> doc;   // Too big for the stack
+    doc.clear();
+    doc["command"] = "trend";
+    doc["series"]  = series_names[series];
+    if (per_cell) {
+        doc["cell"] = cell;
+    }
+    doc["level"]  = level->name;
+    doc["period"] = level->period;
+    JsonArray age = doc.createNestedArray("age");
+    JsonArray a   = doc.createNestedArray((series == ROLLUP_SERIES_SOC) ? "soc" : "min");
+    JsonArray b   = doc.createNestedArray((series == ROLLUP_SERIES_SOC) ? "fcc" : "max");
+    JsonArray m;
+    if (series != ROLLUP_SERIES_SOC) {
+        m = doc.createNestedArray("mean");
+    }
+
+    // Closed buckets oldest first, then the open one, at most ROLLUP_MAX_POINTS newest
+    rollup_bucket_t open;
+    const rollup_acc_t *acc = &level->acc;
+    uint8_t total = level->count + ((acc->weight > 0) ? 1 : 0);
+    uint8_t skip  = 0;
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < total; i++) {
+            const rollup_bucket_t *bk;
+            if (i < level->count) {
+                bk = &level->ring[(level->head + i) % level->size];
+            }
+            else {
+                open.start = acc->start;
+                for (uint8_t k = 0; k < ROLLUP_VALUES; k++) {
+                    open.v[k][0] = clamp16(acc->min[k]);
+                    open.v[k][1] = clamp16(acc->max[k]);
+                    open.v[k][2] = clamp16(acc->sum[k] / acc->weight);
+                }
+                open.fcc = acc->fcc;
+                open.soc = acc->soc;
+                bk = &open;
+            }
+            if (bk->start + level->period <= oldest || bk->start > newest) {
+                continue;
+            }
+            if (pass == 0) {
+                n++;                        // Count only, to keep the newest points
+                continue;
+            }
+            if (skip > 0) {
+                skip--;
+                continue;
+            }
+            age.add(t - bk->start);
+            if (series == ROLLUP_SERIES_SOC) {
+                a.add(bk->soc);
+                b.add(bk->fcc);
+            }
+            else {
+                a.add(bk->v[value][0]);
+                b.add(bk->v[value][1]);
+                m.add(bk->v[value][2]);
+            }
+        }
+        if (pass == 0) {
+            skip = (n > ROLLUP_MAX_POINTS) ? n - ROLLUP_MAX_POINTS : 0;
+        }
+    }
+    return serializeJson(doc, output);
+}
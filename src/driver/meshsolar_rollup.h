@@ -0,0 +1,107 @@
+/**
+ * @file meshsolar_rollup.h
+ * @brief Minute / hour / day rollup pyramid of the status, for long-term trends.
+ *
+ * Every snapshot updates the open bucket of each level: min/max/mean of the
+ * four cell voltages, the four temperatures and the current, plus the last
+ * SOC and FCC as trend points. When a snapshot falls into the next period the
+ * open bucket is closed into that level's ring. Nothing is rescanned: a query
+ * reads at most ROLLUP_MAX_POINTS buckets of a single level.
+ *
+ *   level    period   buckets kept   span
+ *   minute   60 s     60             1 hour
+ *   hour     3600 s   72             3 days
+ *   day      86400 s  62             2 months
+ *
+ * A query picks the finest level that covers the range in at most
+ * ROLLUP_MAX_POINTS buckets, so "last 30 days" is 30 day buckets in one frame:
+ *
+ *   {"command":"trend","series":"voltage","cell":1,"level":"day","period":86400,
+ *    "age":[2592000,...,0],"min":[3201,...],"max":[3412,...],"mean":[3320,...]}
+ *
+ * "age" is the bucket start in seconds before now; the newest bucket is the
+ * open one. Voltages are mV, temperatures 0.1 degC, current mA; the "soc"
+ * series has "soc" and "fcc" arrays instead of min/max/mean.
+ *
+ * TIMING:
+ * - Snapshots come at the adaptive poll interval, so a sample weighs the time
+ *   since the previous one (at most ROLLUP_MAX_GAP), and buckets with no
+ *   snapshot are missing rather than interpolated.
+ * - Time is kept in seconds since boot, extended past the millis() wrap.
+ */
+
+#ifndef __MESHSOLAR_ROLLUP_H__
+#define __MESHSOLAR_ROLLUP_H__
+
+#include "meshsolar_json.h"
+
+#define ROLLUP_LEVELS           3
+#define ROLLUP_MAX_POINTS       64          // Buckets in one query frame
+#define ROLLUP_MAX_GAP          600         // Longest time one sample weighs (s)
+#define ROLLUP_VALUES           9           // Cell voltages 0-3, temperatures 4-7, current 8
+
+typedef enum {
+    ROLLUP_SERIES_VOLTAGE = 0,              // Per cell, mV
+    ROLLUP_SERIES_TEMPERATURE,              // Per sensor, 0.1 degC
+    ROLLUP_SERIES_CURRENT,                  // mA
+    ROLLUP_SERIES_SOC,                      // SOC and FCC trend points
+    ROLLUP_SERIES_COUNT,
+} rollup_series_t;
+
+// Closed bucket
+typedef struct {
+    uint32_t start;                         // Seconds since boot
+    int16_t  v[ROLLUP_VALUES][3];           // min, max, mean
+    uint16_t fcc;                           // mAh, last sample
+    uint8_t  soc;                           // %, last sample
+} rollup_bucket_t;
+
+// Open bucket
+typedef struct {
+    uint32_t start;
+    float    weight;                        // Seconds accumulated, 0 = empty
+    float    min[ROLLUP_VALUES];
+    float    max[ROLLUP_VALUES];
+    float    sum[ROLLUP_VALUES];            // Value x weight
+    uint16_t fcc;
+    uint8_t  soc;
+} rollup_acc_t;
+
+typedef struct {
+    const char      *name;
+    uint32_t         period;                // Seconds
+    rollup_bucket_t *ring;
+    uint8_t          size;                  // Buckets in ring
+    uint8_t          head;                  // Oldest bucket
+    uint8_t          count;
+    rollup_acc_t     acc;
+} rollup_level_t;
+
+class MeshSolarRollup{
+private:
+    rollup_bucket_t minutes[60];
+    rollup_bucket_t hours[72];
+    rollup_bucket_t days[62];
+    rollup_level_t  levels[ROLLUP_LEVELS];
+    uint32_t        clock_s;                // Seconds since boot
+    uint32_t        clock_ms;               // millis() the clock was last advanced to
+    uint16_t        clock_frac;             // Milliseconds not yet counted in clock_s
+    uint32_t        last_sample;            // clock_s of the last sample, 0 = none
+
+    uint32_t advance(uint32_t now);
+    void     close(rollup_level_t *level);
+    uint8_t  pick(uint32_t from_s) const;
+
+public:
+    MeshSolarRollup();
+
+    // Feed one status snapshot
+    void   add(const meshsolar_status_t *sta, uint32_t now);
+    // Build the frame of one series over [from_s, to_s] seconds ago, cell 1-4 for per-cell series
+    size_t to_json(rollup_series_t series, uint8_t cell, uint32_t from_s, uint32_t to_s, uint32_t now, String &output);
+};
+
+// Series name to id, ROLLUP_SERIES_COUNT if unknown
+rollup_series_t rollup_find_series(const char *name);
+
+#endif // __MESHSOLAR_ROLLUP_H__
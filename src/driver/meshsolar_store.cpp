@@ -0,0 +1,173 @@
+#include "meshsolar_store.h"
+#include "meshsolar_pack.h"
+#include "../utils/logger.h"
+#include <ArduinoJson.h>
+
+static void put32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t status_flags(const meshsolar_status_t *sta){
+    return (sta->fet_enable ? STORE_FLAG_FET : 0) | (sta->emergency_shutdown ? STORE_FLAG_EMSHUT : 0);
+}
+
+MeshSolarStore::MeshSolarStore(){
+    this->ready       = false;
+    this->clock_s     = 0;
+    this->clock_ms    = 0;
+    this->clock_frac  = 0;
+    this->last_status = 0;
+    this->last_flush  = 0;
+    this->primed      = false;
+    this->last_safety = 0;
+    this->last_flags  = 0;
+    memset(&this->cur, 0, sizeof(this->cur));
+}
+
+/**
+ * @brief Advance the seconds-since-boot clock to millis() = now
+ */
+uint32_t MeshSolarStore::advance(uint32_t now){
+    uint32_t ms = (now - this->clock_ms) + this->clock_frac;    // Unsigned difference survives the wrap
+    this->clock_ms   = now;
+    this->clock_s   += ms / 1000;
+    this->clock_frac = ms % 1000;
+    return this->clock_s;
+}
+
+/**
+ * @brief Recover the log and write the boot record
+ *
+ * @param dev          Flash region of the log
+ * @param reset_reason Platform reset cause (nRF52: POWER->RESETREAS), kept to tell brownouts apart
+ * @param now          Current time (ms)
+ */
+bool MeshSolarStore::begin(FlashDevice *dev, uint32_t reset_reason, uint32_t now){
+    this->clock_ms = now;
+    this->ready    = this->log.begin(dev);
+    if (!this->ready) {
+        return false;
+    }
+    uint8_t p[4];
+    put32(p, reset_reason);
+    this->log.append(STORE_REC_BOOT, p, sizeof(p));
+    this->flush();
+    return true;
+}
+
+/**
+ * @brief Log one status snapshot
+ *
+ * A protection or EMSHUT change is logged and flushed at once; status
+ * records are rate limited to STORE_STATUS_INTERVAL and batched.
+ */
+void MeshSolarStore::add(const meshsolar_status_t *sta, uint32_t now){
+    if (!this->ready) {
+        return;
+    }
+    uint32_t t       = this->advance(now);
+    uint32_t safety  = sta->safety_status.bytes;
+    uint8_t  flags   = status_flags(sta);
+    bool     urgent  = false;
+
+    if (this->primed && (safety != this->last_safety || (flags & STORE_FLAG_EMSHUT) != (this->last_flags & STORE_FLAG_EMSHUT))) {
+        uint8_t p[13];
+        put32(p, t);
+        put32(p + 4, this->last_safety);
+        put32(p + 8, safety);
+        p[12] = flags;
+        this->log.append(STORE_REC_EVENT, p, sizeof(p));
+        urgent = true;
+    }
+    if (!this->primed || urgent || (t - this->last_status) >= STORE_STATUS_INTERVAL) {
+        uint8_t p[4 + MESHSOLAR_PACKED_LEN];
+        put32(p, t);
+        meshsolar_pack_status(sta, p + 4, MESHSOLAR_PACKED_LEN);
+        this->log.append(STORE_REC_STATUS, p, sizeof(p));  // The state the event led to
+        this->last_status = t;
+    }
+    this->primed      = true;
+    this->last_safety = safety;
+    this->last_flags  = flags;
+
+    bool low = (sta->soc_gauge >= 0 && sta->soc_gauge <= STORE_LOW_SOC);
+    if (this->log.buffered() > 0 && (urgent || low || (t - this->last_flush) >= STORE_FLUSH_INTERVAL)) {
+        this->flush();
+    }
+}
+
+bool MeshSolarStore::flush(){
+    if (!this->ready) {
+        return false;
+    }
+    this->last_flush = this->clock_s;
+    return this->log.flush();
+}
+
+/**
+ * @brief Skip to the newest max records of the log
+ *
+ * Flushes first, so the reply includes the records still in RAM.
+ */
+uint32_t MeshSolarStore::select(uint32_t max){
+    if (!this->ready) {
+        return 0;
+    }
+    this->flush();
+    flash_record_t rec;
+    uint32_t n = 0;
+    this->log.rewind(&this->cur);
+    while (this->log.next(&this->cur, &rec)) {
+        n++;
+    }
+    this->log.rewind(&this->cur);
+    for (uint32_t skip = (n > max) ? n - max : 0; skip > 0; skip--) {
+        this->log.next(&this->cur, &rec);
+    }
+    return (n > max) ? max : n;
+}
+
+size_t MeshSolarStore::next_json(uint32_t seq, uint32_t total, String &output){
+    static const char hex[] = "0123456789abcdef";
+    flash_record_t rec;
+    output = "";
+    if (!this->ready || !this->log.next(&this->cur, &rec)) {
+        return 0;
+    }
+
+    StaticJsonDocument<256> doc;
+    char data[MESHSOLAR_PACKED_LEN * 2 + 1];
+    doc["command"] = "log";
+    doc["seq"]     = seq;
+    doc["total"]   = total;
+    doc["page"]    = rec.page_seq;
+    if (rec.type == STORE_REC_BOOT && rec.len >= 4) {
+        doc["type"]   = "boot";
+        doc["reason"] = get32(rec.data);
+    }
+    else if (rec.type == STORE_REC_STATUS && rec.len >= 4 + MESHSOLAR_PACKED_LEN) {
+        for (uint8_t i = 0; i < MESHSOLAR_PACKED_LEN; i++) {
+            data[2 * i]     = hex[rec.data[4 + i] >> 4];
+            data[2 * i + 1] = hex[rec.data[4 + i] & 0x0F];
+        }
+        data[2 * MESHSOLAR_PACKED_LEN] = '\0';
+        doc["type"] = "status";
+        doc["t"]    = get32(rec.data);
+        doc["data"] = (const char *)data;   // Stored as a pointer, data outlives serializeJson()
+    }
+    else if (rec.type == STORE_REC_EVENT && rec.len >= 13) {
+        doc["type"]   = "event";
+        doc["t"]      = get32(rec.data);
+        doc["before"] = get32(rec.data + 4);
+        doc["after"]  = get32(rec.data + 8);
+        doc["flags"]  = rec.data[12];
+    }
+    else {
+        doc["type"] = rec.type;             // Written by a newer firmware
+    }
+    return serializeJson(doc, output);
+}
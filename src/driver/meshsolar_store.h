@@ -0,0 +1,83 @@
+/**
+ * @file meshsolar_store.h
+ * @brief Status and protection records kept in flash across resets, replayed with the "log" command.
+ *
+ * The RAM history is gone after a brownout, which on a solar node is exactly
+ * the moment worth looking at. MeshSolarStore writes a FlashLog with three
+ * record types:
+ *
+ *   type    payload                                            when
+ *   boot    u32 reset reason                                   begin()
+ *   status  u32 uptime (s), 16-byte meshsolar_pack frame       every STORE_STATUS_INTERVAL
+ *   event   u32 uptime (s), u32 safety before, u32 safety      SafetyStatus or EMSHUT changed
+ *           after, u8 flags (bit 0 FET, bit 1 EMSHUT)
+ *
+ * Uptime restarts at every boot record. The "log" command sends the newest
+ * records, one frame each, oldest first:
+ *
+ *   {"command":"log","seq":0,"total":3,"page":12,"type":"boot","reason":4}
+ *   {"command":"log","seq":1,"total":3,"page":12,"type":"status","t":300,"data":"51a4..."}
+ *   {"command":"log","seq":2,"total":3,"page":12,"type":"event","t":412,"before":0,"after":2,"flags":1}
+ *
+ * "data" is the packed frame in hex, see meshsolar_unpack_status().
+ *
+ * TIMING:
+ * - Status records stay in the FlashLog RAM buffer and reach the flash when
+ *   it fills (about ten records), every STORE_FLUSH_INTERVAL, or at once
+ *   when an event is logged or the SOC is at or below STORE_LOW_SOC, where
+ *   a brownout is likely.
+ */
+
+#ifndef __MESHSOLAR_STORE_H__
+#define __MESHSOLAR_STORE_H__
+
+#include "meshsolar.h"
+#include "../utils/flash_log.h"
+
+#define STORE_STATUS_INTERVAL   300         // Seconds between status records
+#define STORE_FLUSH_INTERVAL    3600        // Longest time a record waits in RAM (s)
+#define STORE_LOW_SOC           10          // At or below this SOC every record is flushed (%)
+#define STORE_LOG_DEFAULT       16          // Records sent by "log" without a count
+
+typedef enum {
+    STORE_REC_BOOT = 1,
+    STORE_REC_STATUS,
+    STORE_REC_EVENT,
+} store_record_t;
+
+#define STORE_FLAG_FET          0x01
+#define STORE_FLAG_EMSHUT       0x02
+
+class MeshSolarStore{
+private:
+    FlashLog           log;
+    bool               ready;
+    uint32_t           clock_s;             // Seconds since boot
+    uint32_t           clock_ms;            // millis() the clock was last advanced to
+    uint16_t           clock_frac;          // Milliseconds not yet counted in clock_s
+    uint32_t           last_status;         // clock_s of the last status record
+    uint32_t           last_flush;          // clock_s of the last flush
+    bool               primed;              // A snapshot was seen
+    uint32_t           last_safety;
+    uint8_t            last_flags;
+    flash_log_cursor_t cur;                 // Read position of the "log" reply
+
+    uint32_t advance(uint32_t now);
+
+public:
+    MeshSolarStore();
+
+    // Recover the log and record the boot, false without usable flash
+    bool     begin(FlashDevice *dev, uint32_t reset_reason, uint32_t now);
+    bool     active() const { return ready; }
+    // Feed one status snapshot
+    void     add(const meshsolar_status_t *sta, uint32_t now);
+    bool     flush();
+
+    // Position the reply on the newest max records, returns how many will follow
+    uint32_t select(uint32_t max);
+    // "log" frame of the next selected record, 0 when done
+    size_t   next_json(uint32_t seq, uint32_t total, String &output);
+};
+
+#endif // __MESHSOLAR_STORE_H__
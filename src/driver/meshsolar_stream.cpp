@@ -0,0 +1,124 @@
+#include "meshsolar_stream.h"
+#include "../utils/logger.h"
+#include <math.h>
+
+/**
+ * @brief Construct an inactive stream, the caller sends full status telemetry
+ */
+MeshSolarStream::MeshSolarStream(){
+    memset(&this->sub, 0, sizeof(this->sub));
+    this->resync();
+}
+
+/**
+ * @brief Replace the subscription
+ *
+ * @param sub Parsed "subscribe" parameters, count 0 cancels the subscription
+ */
+void MeshSolarStream::subscribe(const subscribe_config_t *sub){
+    this->sub = *sub;
+    this->resync();
+    LOG_I("Telemetry subscription: %d fields", this->sub.count);
+}
+
+bool MeshSolarStream::active() const{
+    return this->sub.count > 0;
+}
+
+uint32_t MeshSolarStream::min_period() const{
+    uint32_t period = 0;
+    for (uint8_t i = 0; i < this->sub.count; i++) {
+        uint32_t p = (uint32_t)this->sub.fields[i].period_ms;
+        if (p > 0 && (period == 0 || p < period)) {
+            period = p;
+        }
+    }
+    return period;
+}
+
+/**
+ * @brief Forget the values sent, e.g. after a frame could not be queued
+ */
+void MeshSolarStream::resync(){
+    this->primed = false;
+}
+
+/**
+ * @brief Build the delta frame of a new status snapshot
+ *
+ * A field is added when it was never sent, when its period elapsed or when
+ * its value moved by at least its delta since the last frame holding it.
+ * A per-cell field is sent for every cell as soon as one cell is due.
+ *
+ * @param sta    Latest status snapshot
+ * @param now    Current time (ms)
+ * @param output Receives the frame
+ * @return size_t Frame length, 0 if nothing is due (output is then empty)
+ */
+size_t MeshSolarStream::poll(const meshsolar_status_t *sta, uint32_t now, String &output){
+    output = "";
+    if (!this->active()) {
+        return 0;
+    }
+    StaticJsonDocument<512> doc;
+    JsonObject root = doc.to<JsonObject>();
+    JsonArray  cells;
+    bool       any = false;
+
+    root["command"] = "delta";
+    for (uint8_t i = 0; i < this->sub.count; i++) {
+        const sub_field_t *f = &this->sub.fields[i];
+        bool due = !this->primed || (f->period_ms > 0 && (now - this->last_ms[i]) >= (uint32_t)f->period_ms);
+
+        if (f->kind == SUB_FIELD_PROTECTION) {
+            bool changed = (sta->safety_status.bytes != this->last_protection) || (sta->emergency_shutdown != this->last_emshut);
+            if (due || (f->delta >= 0 && changed)) {
+                root["protection_sta"] = meshsolar_protection_str(sta);    // Rendered only when sent
+                this->last_protection = sta->safety_status.bytes;
+                this->last_emshut     = sta->emergency_shutdown;
+                this->last_ms[i]      = now;
+                any = true;
+            }
+            continue;
+        }
+
+        uint8_t n = (f->kind == SUB_FIELD_CELL) ? STREAM_CELLS : 1;
+        const json_field_t *field = (f->kind == SUB_FIELD_CELL) ? &meshsolar_cell_fields[f->index]
+                                                                : &meshsolar_status_fields[f->index];
+        float v[STREAM_CELLS];
+        for (uint8_t c = 0; c < n; c++) {
+            v[c] = (f->kind == SUB_FIELD_CELL) ? json_codec_value(field, &sta->cells[c]) : json_codec_value(field, sta);
+            float d = fabsf(v[c] - this->last[i][c]);
+            if (f->delta >= 0 && ((f->delta == 0) ? (d > 0) : (d >= f->delta))) {
+                due = true;
+            }
+        }
+        if (!due) {
+            continue;
+        }
+
+        if (f->kind == SUB_FIELD_CELL) {
+            if (cells.isNull()) {
+                cells = root.createNestedArray("cells");
+                for (uint8_t c = 0; c < STREAM_CELLS; c++) {
+                    cells.createNestedObject()["cell_num"] = sta->cells[c].cell_num;
+                }
+            }
+            for (uint8_t c = 0; c < n; c++) {
+                json_codec_write(cells[c].as<JsonObject>(), field, 1, &sta->cells[c]);
+            }
+        }
+        else {
+            json_codec_write(root, field, 1, sta);
+        }
+        memcpy(this->last[i], v, n * sizeof(float));
+        this->last_ms[i] = now;
+        any = true;
+    }
+    this->primed = true;
+
+    if (!any) {
+        return 0;
+    }
+    return serializeJson(doc, output);
+}
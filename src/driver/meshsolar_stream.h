@@ -0,0 +1,46 @@
+/**
+ * @file meshsolar_stream.h
+ * @brief Field-subscription telemetry: stream only the status fields that changed.
+ *
+ * A "subscribe" command names the status fields a client wants, each with a
+ * change threshold and/or a resend period. After every status snapshot poll()
+ * compares the subscribed values with the ones last sent and builds a
+ * "delta" frame holding only the fields that are due:
+ *
+ *   {"command":"delta","soc_gauge":84,"cells":[{"cell_num":1,"voltage":3.301},...]}
+ *
+ * Keys and value formats are those of the full "status" object, so a client
+ * applies a delta frame to its copy of the status with the same parser. The
+ * first frame after subscribe() and after resync() carries every subscribed
+ * field.
+ */
+
+#ifndef __MESHSOLAR_STREAM_H__
+#define __MESHSOLAR_STREAM_H__
+
+#include "meshsolar_json.h"
+
+#define STREAM_CELLS        4           // Cells per per-cell field, matches meshsolar_status_t::cells
+
+class MeshSolarStream{
+private:
+    subscribe_config_t sub;
+    float     last[MESHSOLAR_SUB_MAX][STREAM_CELLS];  // Values of the last frame sent
+    uint32_t  last_ms[MESHSOLAR_SUB_MAX];             // Time of the last frame holding the field
+    uint32_t  last_protection;                        // SafetyStatus bits of the last frame
+    bool      last_emshut;                            // Emergency shutdown flag of the last frame
+    bool      primed;                                 // A frame with every field was sent
+
+public:
+    MeshSolarStream();
+
+    void     subscribe(const subscribe_config_t *sub);
+    bool     active() const;                          // true while fields are subscribed
+    uint32_t min_period() const;                      // Shortest subscribed period (ms), 0 = none
+    void     resync();                                // Send every field in the next frame
+
+    // Build the next delta frame, 0 if no field is due
+    size_t   poll(const meshsolar_status_t *sta, uint32_t now, String &output);
+};
+
+#endif // __MESHSOLAR_STREAM_H__
@@ -35,9 +35,14 @@
  *    - Ensure sufficient RAM on target platform
  * 
  * 6. TIMING CONSIDERATIONS:
- *    - Main loop runs every 1ms
- *    - Status updates every 1000 iterations (1 second)
+ *    - Status is renewed on demand by the meshSolarGet*() getters
+ *    - Renew interval is adaptive: 1 s when active, backing off to 1 min when idle
+ *    - An idle renew reads only the BatteryStatus word; the full status and
+ *      settings are read when it changes, while active, or every 5 min
+ *    - EMERGENCY_SHUTDOWN_PIN edges are taken by interrupt and pushed as
+ *      "EMSHUT_PIN" events at once, the gauge EMSHUT bit confirms them later
  *    - BQ4050 I2C operations require delay(10-100ms) between calls
+ *    - Responses are queued and drained by the meshSolarTx task, no post-write delays
  * 
  * 7. DEPENDENCIES:
  *    - ArduinoJson library (version 6.x)
@@ -57,6 +62,9 @@
 #define SCL_PIN                         32          // I2C clock line pin
 #define RGB_LED_PIN                     47          // RGB LED data line pin
 #define EMERGENCY_SHUTDOWN_PIN          35          // Emergency shutdown pin
+#define EMERGENCY_SHUTDOWN_ACTIVE       LOW         // Pin level that requests the emergency shutdown
+#define EMSHUT_TASK_STACK               1024        // meshSolarEmshut task stack size (words)
+#define GAUGE_UNSEAL_KEY                0           // BQ4050 unseal key (TI default 0x36720414), 0 = never unseal
 // Common pin assignments:
 // ESP32: GPIO 21 (SDA), GPIO 22 (SCL)
 // Arduino Uno: A4 (SDA), A5 (SCL)
@@ -96,307 +104,62 @@ static bool listenString(String& input, char terminator = '\n') {
     return false; 
 }
 
-/**
- * @brief Parse incoming JSON command and populate command structure
- * @param json JSON string to parse
- * @param cmd Pointer to command structure to populate
- * @return true if parsing successful, false otherwise
- * 
- * SUPPORTED COMMANDS:
- * - "config": Basic battery configuration
- * - "advance": Advanced battery settings
- * - "switch": FET control
- * - "reset": Battery gauge reset
- * - "sync": Synchronize settings
- * - "status": Get current status (no parameters)
- * 
- * PORTING NOTES:
- * - Requires ArduinoJson library (version 6.x)
- * - Uses StaticJsonDocument<1024> - ensure sufficient RAM
- * - All string operations use safe strlcpy() for buffer protection
- */
-static bool parseJsonCommand(const char* json, meshsolar_config_t* cmd) {
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, json);
-    if (error) {
-        LOG_E("Failed to parse JSON: %s", error.c_str());
-        return false;
-    }
-
-    // clear the command structure
-    memset(cmd, 0, sizeof(meshsolar_config_t));
-
-    if (!doc.containsKey("command")) {
-        // dbgSerial.println("Missing 'command' field");
-        LOG_E("Missing 'command' field");
-        return false;
-    }
-    strlcpy(cmd->command, doc["command"] | "", sizeof(cmd->command));
-
-    if (strcmp(cmd->command, "config") == 0) {
-        if (!doc.containsKey("battery") || !doc.containsKey("temperature_protection")) {
-            // dbgSerial.println("Missing 'battery' or 'temperature_protection' field for 'config' command");
-            LOG_E("Missing 'battery' or 'temperature_protection' field for 'config' command");
-            return false;
-        }
-        JsonObject battery = doc["battery"];
-        JsonObject tp = doc["temperature_protection"];
-        if (!battery.containsKey("type") ||
-            !battery.containsKey("cell_number") ||
-            !battery.containsKey("design_capacity") ||
-            !battery.containsKey("cutoff_voltage") ||
-            !tp.containsKey("charge_high_temp_c") ||
-            !tp.containsKey("charge_low_temp_c") ||
-            !tp.containsKey("discharge_high_temp_c") ||
-            !tp.containsKey("discharge_low_temp_c") ||
-            !tp.containsKey("temp_enabled")) {
-            LOG_E("Missing fields in 'battery' or 'temperature_protection'");
-            return false;
-        }
-        strlcpy(cmd->basic.type, battery["type"] | "", sizeof(cmd->basic.type));
-        cmd->basic.cell_number = battery["cell_number"] | 0;
-        cmd->basic.design_capacity = battery["design_capacity"] | 0;
-        cmd->basic.discharge_cutoff_voltage = battery["cutoff_voltage"] | 0;
-
-        cmd->basic.protection.charge_high_temp_c = tp["charge_high_temp_c"] | 0;
-        cmd->basic.protection.charge_low_temp_c = tp["charge_low_temp_c"] | 0;
-        cmd->basic.protection.discharge_high_temp_c = tp["discharge_high_temp_c"] | 0;
-        cmd->basic.protection.discharge_low_temp_c = tp["discharge_low_temp_c"] | 0;
-        cmd->basic.protection.enabled = tp["temp_enabled"] | false;
-    } 
-    else if (strcmp(cmd->command, "switch") == 0) {
-        if (!doc.containsKey("fet_en")) {
-            LOG_E("Missing 'fet_en' field for 'switch' command");
-            return false;
-        }
-        cmd->fet_en.enable = doc["fet_en"] | false;
-    } 
-    else if (strcmp(cmd->command, "advance") == 0) {
-        if(doc["battery"].isNull() || doc["cedv"].isNull()) {
-            LOG_E("Missing 'battery' or 'cedv' field for 'advance' command");
-            return false;
-        }
-        JsonObject battery = doc["battery"];
-        JsonObject cedv = doc["cedv"];
-        if (!battery.containsKey("cuv") ||
-            !battery.containsKey("eoc") ||
-            !battery.containsKey("eoc_protect") ||
-            !cedv.containsKey("cedv0") ||
-            !cedv.containsKey("cedv1") ||
-            !cedv.containsKey("cedv2") ||
-            !cedv.containsKey("discharge_cedv0") ||
-            !cedv.containsKey("discharge_cedv10") ||
-            !cedv.containsKey("discharge_cedv20") ||
-            !cedv.containsKey("discharge_cedv30") ||
-            !cedv.containsKey("discharge_cedv40") ||
-            !cedv.containsKey("discharge_cedv50") ||
-            !cedv.containsKey("discharge_cedv60") ||
-            !cedv.containsKey("discharge_cedv70") ||
-            !cedv.containsKey("discharge_cedv80") ||
-            !cedv.containsKey("discharge_cedv90") ||
-            !cedv.containsKey("discharge_cedv100")) {
-                LOG_E("Missing fields in 'battery' or 'cedv'");
-                return false;
-        }
-        cmd->advance.battery.cuv            = battery["cuv"] | 0;
-        cmd->advance.battery.eoc            = battery["eoc"] | 0;
-        cmd->advance.battery.eoc_protect    = battery["eoc_protect"] | 0;
-        cmd->advance.cedv.cedv0             = cedv["cedv0"] | 0;
-        cmd->advance.cedv.cedv1             = cedv["cedv1"] | 0;
-        cmd->advance.cedv.cedv2             = cedv["cedv2"] | 0;
-        cmd->advance.cedv.discharge_cedv0   = cedv["discharge_cedv0"]  | 0;
-        cmd->advance.cedv.discharge_cedv10  = cedv["discharge_cedv10"] | 0;
-        cmd->advance.cedv.discharge_cedv20  = cedv["discharge_cedv20"] | 0;
-        cmd->advance.cedv.discharge_cedv30  = cedv["discharge_cedv30"] | 0;
-        cmd->advance.cedv.discharge_cedv40  = cedv["discharge_cedv40"] | 0;
-        cmd->advance.cedv.discharge_cedv50  = cedv["discharge_cedv50"] | 0;
-        cmd->advance.cedv.discharge_cedv60  = cedv["discharge_cedv60"] | 0;
-        cmd->advance.cedv.discharge_cedv70  = cedv["discharge_cedv70"] | 0;
-        cmd->advance.cedv.discharge_cedv80  = cedv["discharge_cedv80"] | 0;
-        cmd->advance.cedv.discharge_cedv90  = cedv["discharge_cedv90"] | 0;
-        cmd->advance.cedv.discharge_cedv100 = cedv["discharge_cedv100"]| 0;
-    } 
-    else if (strcmp(cmd->command, "reset") == 0) {
-
-    } 
-    else if (strcmp(cmd->command, "sync") == 0) {
-        if (!doc.containsKey("times")) {
-            LOG_E("Missing 'times' field for 'sync' command");
-            return false;
-        }
-        cmd->sync.times = doc["times"] | 1; // Default to 1 if not specified
-        if (cmd->sync.times < 1 || cmd->sync.times > 10) {
-            LOG_E("'times' must be between 1 and 10");
-            cmd->sync.times = 10; // Reset to default if out of range
-            return false;
-        }
-    } 
-    else if (strcmp(cmd->command, "status") == 0) {
-        // No additional fields required for status command
-    }
-    else if (strcmp(cmd->command, "renew") == 0) {
-        // No additional fields required for renew command
-    }
-    else {
-        LOG_E("Unknown command '%s'", cmd->command);
-        return false;
-    }
-
-    return true;
-}
-
 /*
  * ============================================================================
- * JSON SERIALIZATION FUNCTIONS - Data output formatting (snake_case naming)
+ * BUFFERED TRANSMIT - Responses are queued, a background task drains them
  * ============================================================================
- */
-
-/**
- * @brief Convert battery status to JSON format
- * @param status Pointer to battery status structure
- * @param output Reference to output string
- * @return Size of serialized JSON
- * 
- * OUTPUT FORMAT:
- * {
- *   "command": "status",
- *   "soc_gauge": 85,
- *   "charge_current": -1200,
- *   "total_voltage": "12.345",
- *   "learned_capacity": "3.200",
- *   "pack_voltage": "12345",
- *   "fet_enable": true,
- *   "protection_sta": "CUV,COV",
- *   "emergency_shutdown": false,
- *   "cells": [
- *     {"cell_num": 1, "temperature": 25.123, "voltage": 3.234},
- *     ...
- *   ]
- * }
- * 
- * PORTING NOTES:
- * - Uses StaticJsonDocument<512> - ensure sufficient RAM
- * - Voltage/temperature values rounded to 3 decimal places
- * - Always outputs 4 cells regardless of actual cell count
- * - Function name follows snake_case convention for better readability
- */
-size_t meshsolar_status_to_json(const meshsolar_status_t* status, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"]          = "status";
-    doc["soc_gauge"]        = status->soc_gauge;
-    doc["charge_current"]   = status->charge_current;
-    doc["total_voltage"]    = String(status->total_voltage/1000.0f, 3);
-    doc["learned_capacity"] = String(status->learned_capacity /1000.0f, 3);
-    doc["pack_voltage"]     = String(status->pack_voltage);
-    doc["fet_enable"]       = status->fet_enable;
-    doc["protection_sta"]   = String(status->protection_sta) + String((status->emergency_shutdown) ? ",EMSHUT" : "");
-    // doc["emergency_shutdown"] = status->emergency_shutdown;
-    
-    JsonArray cells = doc.createNestedArray("cells");
-    for (int i = 0; i < 4; ++i) {
-        JsonObject cell     = cells.createNestedObject();
-        cell["cell_num"]    = status->cells[i].cell_num;
-        cell["temperature"] = round(status->cells[i].temperature * 1000)/1000.0f; // Round to 3 decimal places
-        cell["voltage"]     = round((status->cells[i].voltage / 1000.0f) * 1000) / 1000.0f; // Round to 3 decimal places
-    }
-    output = "";
-    return serializeJson(doc, output);
-}
-
-
-/**
- * @brief Convert basic battery configuration to JSON format
- * @param basic Pointer to basic configuration structure
- * @param output Reference to output string
- * @return Size of serialized JSON
  * 
- * FUNCTION: meshsolar_basic_config_to_json
- * - Serializes basic battery settings into JSON format
- * - Includes battery type, cell count, capacity, and temperature protection
- * - Used for configuration synchronization and validation
+ * Command handlers never sleep after a write: lines go into comTx and the
+ * meshSolarTx task moves them to comSerial as fast as the host reads. When
+ * the queue is full the handler waits for room (backpressure) instead of
+ * dropping a response, up to TX_BACKPRESSURE_TIMEOUT for a host that stopped
+ * reading altogether.
  */
-size_t meshsolar_basic_config_to_json(const basic_config_t *basic, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"] = "config";
-    doc["battery"]["type"] = String(basic->type);
-    doc["battery"]["cell_number"] = basic->cell_number;
-    doc["battery"]["design_capacity"] = basic->design_capacity;
-    doc["battery"]["cutoff_voltage"] = basic->discharge_cutoff_voltage;
-
-    JsonObject protection = doc.createNestedObject("temperature_protection");
-    protection["discharge_high_temp_c"] = basic->protection.discharge_high_temp_c;
-    protection["discharge_low_temp_c"]  = basic->protection.discharge_low_temp_c;
-    protection["charge_high_temp_c"]    = basic->protection.charge_high_temp_c;
-    protection["charge_low_temp_c"]     = basic->protection.charge_low_temp_c;
-    protection["temp_enabled"]          = basic->protection.enabled;
-
-    output = "";
-    return serializeJson(doc, output);
-}
+#define TX_DRAIN_INTERVAL               2           // Drain retry interval while the host is slow (ms)
+#define TX_BACKPRESSURE_TIMEOUT         1000        // Give up on a response the host does not read (ms)
+#define TX_TASK_STACK                   1024        // meshSolarTx task stack size (words)
 
+static TxQueue           comTx;                     // Command port TX queue
+static SemaphoreHandle_t xTxMutex;                  // Guards comTx, held only for non-blocking calls
+static SemaphoreHandle_t xTxWake;                   // Given when new bytes are queued
 
-/**
- * @brief Convert advanced battery configuration to JSON format
- * @param config Pointer to advanced configuration structure  
- * @param output Reference to output string
- * @return Size of serialized JSON
- * 
- * FUNCTION: meshsolar_advance_config_to_json
- * - Serializes advanced battery settings including CEDV curves
- * - Contains cutoff voltages and discharge curve data points
- * - Critical for battery gauge calibration and performance tuning
- */
-size_t meshsolar_advance_config_to_json(const advance_config_t *config, String& output) {
-    output = "";
-    StaticJsonDocument<512> doc;
-    doc["command"] = "advance";
-
-    JsonObject battery = doc.createNestedObject("battery");
-    battery["cuv"] = config->battery.cuv;
-    battery["eoc"] = config->battery.eoc;
-    battery["eoc_protect"] = config->battery.eoc_protect;
-
-    JsonObject cedv = doc.createNestedObject("cedv");
-    cedv["cedv0"] = config->cedv.cedv0;
-    cedv["cedv1"] = config->cedv.cedv1;
-    cedv["cedv2"] = config->cedv.cedv2;
-    cedv["discharge_cedv0"] = config->cedv.discharge_cedv0;
-    cedv["discharge_cedv10"] = config->cedv.discharge_cedv10;
-    cedv["discharge_cedv20"] = config->cedv.discharge_cedv20;
-    cedv["discharge_cedv30"] = config->cedv.discharge_cedv30;
-    cedv["discharge_cedv40"] = config->cedv.discharge_cedv40;
-    cedv["discharge_cedv50"] = config->cedv.discharge_cedv50;
-    cedv["discharge_cedv60"] = config->cedv.discharge_cedv60;
-    cedv["discharge_cedv70"] = config->cedv.discharge_cedv70;
-    cedv["discharge_cedv80"] = config->cedv.discharge_cedv80;
-    cedv["discharge_cedv90"] = config->cedv.discharge_cedv90;
-    cedv["discharge_cedv100"] = config->cedv.discharge_cedv100;
-    output = "";
-    return serializeJson(doc, output);
+static void meshSolarTxTask(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(xTxMutex, portMAX_DELAY);
+        size_t left = comTx.drain();
+        xSemaphoreGive(xTxMutex);
+        if (left > 0) {
+            sysclk::delay(TX_DRAIN_INTERVAL);
+        }
+        else {
+            xSemaphoreTake(xTxWake, portMAX_DELAY);
+        }
+    }
 }
 
-
 /**
- * @brief Create standardized command response JSON
- * @param status Boolean indicating command success/failure
- * @param output Reference to output string  
- * @return Size of serialized JSON
- * 
- * FUNCTION: meshsolar_cmd_rsp_to_json
- * - Generates consistent response format for all commands
- * - Simple true/false status indication
- * - Used for acknowledgment of configuration changes
+ * @brief Queue a command response, waiting for room instead of dropping it
  */
-size_t meshsolar_cmd_rsp_to_json(bool status, String& output) {
-    output = "";
-    StaticJsonDocument<64> doc;
-    doc["command"] = "rsp";
-    doc["status"] = status;
-    output = "";
-    // Serialize the JSON document to the output string
-    return serializeJson(doc, output);
+static void sendResponse(const String &json)
+{
+    uint32_t start = sysclk::millis();
+    for (;;) {
+        xSemaphoreTake(xTxMutex, portMAX_DELAY);
+        bool queued = comTx.send(json, TX_RESPONSE);
+        comTx.drain();
+        xSemaphoreGive(xTxMutex);
+        if (queued) {
+            break;
+        }
+        if ((sysclk::millis() - start) >= TX_BACKPRESSURE_TIMEOUT) {
+            LOG_E("TX queue full, response dropped");
+            return;
+        }
+        sysclk::delay(TX_DRAIN_INTERVAL);
+    }
+    xSemaphoreGive(xTxWake);
 }
 
 /*
@@ -427,6 +190,27 @@ size_t meshsolar_cmd_rsp_to_json(bool status, String& output) {
  * - Power issues: BQ4050 requires stable 3.3V supply
  */
 static volatile SemaphoreHandle_t xMutex;
+static SemaphoreHandle_t xIdMutex;         // Guards the command id cache only, never held across I2C
+
+static SemaphoreHandle_t xEventMutex;      // Guards meshsolar.events and the pending pin edge, never held across I2C
+
+static SemaphoreHandle_t xEmshutWake;       // Given by the emergency shutdown pin interrupt
+static volatile uint32_t emshutEdgeMs = 0;  // Time of the last pin edge (ms)
+static bool              emshutPending = false; // A journaled pin edge not yet mirrored in sta
+static bool              emshutLevel   = false;
+static uint32_t          emshutLevelMs = 0;
+static void emshutIsr(void);
+static void meshSolarEmshutTask(void *arg);
+
+static void eventLock(bool take)
+{
+    if (take) {
+        xSemaphoreTake(xEventMutex, portMAX_DELAY);
+    }
+    else {
+        xSemaphoreGive(xEventMutex);
+    }
+}
 
 void meshSolarStart(void)
 {
@@ -442,13 +226,25 @@ void meshSolarStart(void)
     // Initialize main communication serial port (REQUIRED)
     // MODIFY: Change to your platform's primary serial port
     comSerial.begin(115200);            
+
+    // Buffered transmit for command responses
+    xTxMutex = xSemaphoreCreateMutex();
+    xTxWake  = xSemaphoreCreateBinary();
+    comTx.begin(&comSerial);
+    xTaskCreate(meshSolarTxTask, "meshSolarTx", TX_TASK_STACK, NULL, 1, NULL);
     
+    // The pin task journals edges while a command may be reading the status
+    xEventMutex = xSemaphoreCreateMutex();
+    meshsolar.events.set_lock(eventLock);
+
     // Initialize BQ4050 with I2C interface (REQUIRED)
     // VERIFY: Ensure Wire object is properly configured for your platform
     bq4050.begin(&SoftWire, BQ4050ADDR);    
     
     // Initialize MeshSolar controller (REQUIRED)
     meshsolar.begin(&bq4050);           
+    meshsolar.set_unseal_key(GAUGE_UNSEAL_KEY); // A SEALED gauge refuses DataFlash commands without it
+    meshsolar.update_alarm_setting();   // Gauge-side alarms, so idle renews read one status word
     
     // INITIALIZE NeoPixel strip object (REQUIRED)
     // strip.begin();     
@@ -464,6 +260,14 @@ void meshSolarStart(void)
     //     strip.setPixelColor(i, strip.Color(0, 0, 0, 0)); // Set pixel to black
     // }
     xMutex = xSemaphoreCreateRecursiveMutex( );
+    xIdMutex = xSemaphoreCreateMutex();
+
+    // Emergency shutdown pin interrupt, the task only takes xEventMutex and the TX queue
+    xEmshutWake = xSemaphoreCreateBinary();
+    xTaskCreate(meshSolarEmshutTask, "meshSolarEmshut", EMSHUT_TASK_STACK, NULL, 2, NULL);
+    attachInterrupt(digitalPinToInterrupt(EMERGENCY_SHUTDOWN_PIN), emshutIsr, CHANGE);
+    emshutEdgeMs = sysclk::millis();
+    xSemaphoreGive(xEmshutWake);        // Journal a pin already asserted at boot
 
     LOG_I("MeshSolar %s initialized successfully", MESHSOLAR_VERSION);
 }
@@ -475,7 +279,7 @@ void meshSolarStart(void)
             if ((RESULT_VAR = (EXPR))) { \
                 break; \
             } \
-            delay(RETRY_INTERVAL); \
+            sysclk::delay(RETRY_INTERVAL); \
         } \
     } while (0)
 
@@ -484,7 +288,220 @@ void meshSolarStart(void)
 #define READ_TRY_NUM 6
 #define READ_TRY_INTERVAL 100
 
-int meshSolarCmdHandle(const char *cmd)
+// Status renew scheduling, the interval is chosen by the adaptive polling policy
+static uint32_t lastRenewTime = 0;
+static uint32_t renewInterval = 0;   // 0 = renew on first access
+
+/*
+ * Idempotent command ids
+ *
+ * A host may add an optional "id" to any command. Configuration commands
+ * rewrite DataFlash and take seconds, so a host that times out and retransmits
+ * would otherwise repeat the whole write sequence ("switch" would even toggle
+ * the FETs back). The last CMD_ID_CACHE_SIZE ids are remembered with their
+ * result and "rsp" line:
+ * - a repeated id that already completed gets the cached "rsp" replayed
+ * - a repeated id that is still executing waits for the original and shares
+ *   its result, the original sends the single "rsp"
+ * - a repeated id that completed without a "rsp" runs again: "ack" and
+ *   sequenced "sync" reply through the TX queue only, replaying nothing
+ *   would leave the host without its frames
+ * Commands without an id behave exactly as before.
+ */
+#define CMD_ID_CACHE_SIZE       4
+#define CMD_ID_LEN              24          // Longest accepted id, including terminator
+#define CMD_RSP_LEN             128         // Longest cached "rsp" line, a full batch rsp fits
+#define CMD_ID_ATTACH_TIMEOUT   30000       // Max wait for an in-flight duplicate (ms)
+#define CMD_ID_ATTACH_POLL      20          // Completion poll interval while attached (ms)
+
+typedef struct {
+    char        id[CMD_ID_LEN];             // Host command id, empty = free slot
+    bool        done;                       // false while the original is executing
+    int         result;                     // meshSolarCmdHandle() result of the original
+    char        rsp[CMD_RSP_LEN];           // "rsp" line sent by the original, empty = nothing to replay
+} cmd_id_entry_t;
+
+static cmd_id_entry_t cmdIdCache[CMD_ID_CACHE_SIZE];
+static uint8_t        cmdIdNext = 0;       // Round-robin replacement cursor
+
+/**
+ * @brief Extract the optional "id" field of a command without a full parse
+ * @param json Command JSON
+ * @param id   Output buffer, set to "" when there is no usable id
+ * @param len  Size of the output buffer
+ * @return true if the command carries an id
+ */
+static bool parseCommandId(const char *json, char *id, size_t len)
+{
+    StaticJsonDocument<32> filter;
+    filter["id"] = true;
+    StaticJsonDocument<128> doc;
+
+    id[0] = '\0';
+    if (strstr(json, "\"id\"") == NULL) {
+        return false; // Fast path for the frequent id-less commands (e.g. renew)
+    }
+    if (deserializeJson(doc, json, DeserializationOption::Filter(filter))) {
+        return false;
+    }
+    JsonVariant v = doc["id"];
+    if (v.is<const char*>()) {
+        strlcpy(id, v.as<const char*>(), len);
+    }
+    else if (v.is<unsigned long>()) {
+        snprintf(id, len, "%lu", v.as<unsigned long>());
+    }
+    return id[0] != '\0';
+}
+
+static int cmdIdFind(const char *id)
+{
+    for (int i = 0; i < CMD_ID_CACHE_SIZE; i++) {
+        if (cmdIdCache[i].id[0] != '\0' && 0 == strcmp(cmdIdCache[i].id, id)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Claim a cache slot for a new id, skipping slots still in flight
+ * @return Slot index, -1 if every slot is in flight (the command then runs uncached)
+ */
+static int cmdIdReserve(const char *id)
+{
+    for (int n = 0; n < CMD_ID_CACHE_SIZE; n++) {
+        int i = (cmdIdNext + n) % CMD_ID_CACHE_SIZE;
+        if (cmdIdCache[i].id[0] == '\0' || cmdIdCache[i].done) {
+            strlcpy(cmdIdCache[i].id, id, sizeof(cmdIdCache[i].id));
+            cmdIdCache[i].done   = false;
+            cmdIdCache[i].result = 0;
+            cmdIdCache[i].rsp[0] = '\0';
+            cmdIdNext = (i + 1) % CMD_ID_CACHE_SIZE;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Serialize, send and optionally remember a command "rsp"
+ */
+static void sendCmdRsp(bool status, const char *id, String *rsp, const char *error = NULL)
+{
+    String json;
+    meshsolar_cmd_rsp_to_json(status, json, id, error); // Create a response JSON
+    sendResponse(json); // Queue the response for the serial port
+    if (rsp != NULL) {
+        *rsp = json;
+    }
+}
+
+/*
+ * Sequenced sync
+ *
+ * "sync" without "times" sends status, basic and advanced settings once each
+ * as tagged, checksummed frames (see frame_sync.h). The host answers with
+ * {"command":"ack","session":n,"missing":[...]} and only the missing frames
+ * are sent again. Unacknowledged frames are also resent from
+ * meshSolarRenewIfDue() once SYNC_RETRY_TIMEOUT elapsed. Both paths hold
+ * xMutex while touching syncFrames.
+ */
+static SyncSession syncFrames;
+static MeshSolarHistory history;           // Status history, one record per renew
+static MeshSolarRollup  rollup;            // Minute/hour/day buckets, one sample per renew
+static MeshSolarStore   store;             // Flash log, off until meshSolarStoreBegin()
+static MeshSolarCapture capture;           // Burst capture buffer for "capture"
+static MeshSolarImage   image;             // DataFlash image staging for "import"
+
+static void sendSyncFrames(uint8_t mask)
+{
+    for (uint8_t seq = 0; seq < SYNC_FRAMES_MAX; seq++) {
+        if ((mask & (1 << seq)) && syncFrames.frame(seq) != NULL) {
+            sendResponse(syncFrames.frame(seq));
+        }
+    }
+    syncFrames.sent(sysclk::millis());
+}
+
+/**
+ * @brief Push the journaled edges not sent yet as "event" frames
+ * 
+ * Called after every command, since several commands read the status, and
+ * by the meshSolarEmshut task. Each frame is rendered under xEventMutex and
+ * sent after releasing it, so a slow host never stalls a status read.
+ */
+static void pushEvents(void)
+{
+    String json = "";
+    for (;;) {
+        xSemaphoreTake(xEventMutex, portMAX_DELAY);
+        uint32_t seq = meshsolar.events.push_from();
+        size_t   len = meshsolar_events_to_json(&meshsolar.events, &seq, sysclk::millis(), json);
+        meshsolar.events.pushed_to(seq);
+        xSemaphoreGive(xEventMutex);
+        if (len == 0) {
+            break;
+        }
+        sendResponse(json);
+    }
+}
+
+/**
+ * @brief Mirror a pin edge journaled by the meshSolarEmshut task in sta
+ * 
+ * Called with xMutex held. The following status read then checks the
+ * gauge EMSHUT bit against it.
+ */
+static void emshutApply(void)
+{
+    xSemaphoreTake(xEventMutex, portMAX_DELAY);
+    bool     pending = emshutPending;
+    bool     level   = emshutLevel;
+    uint32_t ms      = emshutLevelMs;
+    emshutPending    = false;
+    xSemaphoreGive(xEventMutex);
+    if (pending) {
+        meshsolar.emshut_pin_event(level, ms);
+    }
+}
+
+/*
+ * Emergency shutdown pin: the interrupt only takes the time and wakes the
+ * meshSolarEmshut task, which journals the edge and pushes its event frame
+ * without waiting for the next status renew. It never takes xMutex, a
+ * DataFlash pass can hold that for seconds; the command path mirrors the
+ * edge in sta when it next runs.
+ */
+static void emshutIsr(void)
+{
+    emshutEdgeMs = sysclk::millis();
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(xEmshutWake, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void meshSolarEmshutTask(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(xEmshutWake, portMAX_DELAY);
+        uint32_t edge     = emshutEdgeMs;
+        bool     asserted = (digitalRead(EMERGENCY_SHUTDOWN_PIN) == EMERGENCY_SHUTDOWN_ACTIVE); // Level after any bounce
+        if (!meshsolar.events.pin(asserted, edge)) {
+            continue;                       // Bounce, or the level was already seen
+        }
+        xSemaphoreTake(xEventMutex, portMAX_DELAY);
+        emshutPending = true;
+        emshutLevel   = asserted;
+        emshutLevelMs = edge;
+        xSemaphoreGive(xEventMutex);
+        pushEvents();
+        renewInterval = 0;                  // Cross-check with the gauge EMSHUT bit on the next access
+    }
+}
+
+static int meshSolarCmdExecute(const char *cmd, const char *id, String *rsp)
 {
     int result = 0;
     bool writeResults[5] = {false};
@@ -494,19 +511,28 @@ int meshSolarCmdHandle(const char *cmd)
     {
         return -1;
     }
+    emshutApply();
     if (0 == strncmp(cmd,"{\"command\":\"renew\"}", strlen("{\"command\":\"renew\"}"))) 
     {
-        TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_realtime_bat_status());
-        TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_basic_bat_realtime_setting());
-        TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[2], meshsolar.get_advance_bat_realtime_setting());
+        bool full = false;
+        TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.refresh_bat_status(&full));
+        if (readResults[0] && full) {
+            TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_basic_bat_realtime_setting());
+            TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[2], meshsolar.get_advance_bat_realtime_setting());
+            history.add(&meshsolar.sta, sysclk::millis());
+            rollup.add(&meshsolar.sta, sysclk::millis());
+            store.add(&meshsolar.sta, sysclk::millis());
+        }
+        renewInterval = meshsolar.next_poll_interval_ms(); // Idle packs back off, active ones renew fast
+        pushEvents();
         xSemaphoreGive(xMutex);
         return 0;
     }
     String json = cmd;
     LOG_D(" JSON: %s", json.c_str());
     if(json.length() >  6) {
-        bool res = parseJsonCommand(json.c_str(), &meshsolar.cmd);
-        if (res) {
+        meshsolar_cmd_t command = meshsolar_parse_command(json.c_str(), &meshsolar.cmd);
+        if (command != MESHSOLAR_CMD_INVALID) {
             /*
              * COMMAND HANDLERS
              * Each command type has specific processing requirements:
@@ -515,7 +541,22 @@ int meshSolarCmdHandle(const char *cmd)
              * "advance": Updates advanced settings (CEDV, protection thresholds)
              * "switch": Controls FET enable/disable
              * "reset": Resets battery gauge learning data
-             * "sync": Sends current configuration data multiple times
+             * "sync": Sends status and configuration as sequenced frames ("times": legacy repetition)
+             * "ack": Host acknowledgement of sync frames, missing frames are resent
+             * "batch": Runs config/advance/switch/reset/sync steps with one DataFlash pass
+             * "history": Sends the stored status records of a time range, one frame per block
+             * "trend": Sends min/max/mean of a series from the rollup pyramid
+             * "log": Sends the newest records of the flash log, one frame per record
+             * "events": Sends the protection edge journal from sequence number "from"
+             * "alarm": Programs the gauge RemainingCapacity/RemainingTime alarms
+             * "capture": Reads the cells and current back to back, sends the waveform and resistance
+             * "export": Streams the gauge DataFlash in CRC-checked chunks
+             * "import": Stages image chunks, "commit" writes them in blocks and verifies once
+             * 
+             * DataFlash commands on a SEALED gauge are answered at once with
+             * "error":"sealed" instead of retrying writes that cannot verify;
+             * with GAUGE_UNSEAL_KEY set the gauge is unsealed for the command
+             * and sealed again afterwards.
              * 
              * PORTING NOTES:
              * - All configuration changes are immediately written to BQ4050
@@ -523,7 +564,11 @@ int meshSolarCmdHandle(const char *cmd)
              * - Responses are sent immediately after completion
              * - Consider implementing timeout mechanisms for production use
              */
-            if (0 == strcmp(meshsolar.cmd.command, "config")) {
+            if (meshsolar_cmd_uses_dataflash(command, &meshsolar.cmd) && !meshsolar.dataflash_unlock()) {
+                LOG_E("'%s' rejected, gauge SEALED", meshsolar.cmd.command);
+                sendCmdRsp(false, id, rsp, "sealed"); // Nothing written, nothing to retry
+            }
+            else if (command == MESHSOLAR_CMD_CONFIG) {
                 log_i("\r\n");
                 LOG_W("Updating basic battery configuration...");
 
@@ -553,18 +598,15 @@ int meshSolarCmdHandle(const char *cmd)
                 //sync the basic battery configuration immediately
                 TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_basic_bat_realtime_setting());
                 meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json); // Get the basic battery settings
-                comSerial.println(json); // Send the configuration back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the configuration for the serial port
                 LOG_I("Basic configuration sync completed");
 
                 bool allSuccess = writeResults[0] && writeResults[1] && writeResults[2] && writeResults[3] && writeResults[4];
                 // Respond with the updated basic configuration
-                meshsolar_cmd_rsp_to_json(allSuccess, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendCmdRsp(allSuccess, id, rsp); // Send (and remember) the response
                 LOG_I("Basic configuration response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "advance")) {
+            else if (command == MESHSOLAR_CMD_ADVANCE) {
                 log_i("\r\n");
                 LOG_W("Updating advanced battery configuration...");
                 
@@ -586,69 +628,261 @@ int meshSolarCmdHandle(const char *cmd)
                 //respond with the updated advanced configuration
                 TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_advance_bat_realtime_setting());
                 meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json); // Get the advanced battery settings
-                comSerial.println(json); // Send the configuration back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendResponse(json); // Queue the configuration for the serial port
                 LOG_I("Advanced configuration sync");
 
                 // Respond with the updated advanced configuration
                 bool allSuccess = writeResults[0] && writeResults[1];
-                meshsolar_cmd_rsp_to_json(allSuccess, json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendCmdRsp(allSuccess, id, rsp); // Send (and remember) the response
                 LOG_I("Advanced configuration response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "switch")) {
+            else if (command == MESHSOLAR_CMD_SWITCH) {
                 TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, writeResults[0], meshsolar.toggle_fet());
                 LOG_I("FET Toggle...");
 
                 // Respond with the FET toggle result
-                meshsolar_cmd_rsp_to_json(writeResults[0], json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendCmdRsp(writeResults[0], id, rsp); // Send (and remember) the response
                 LOG_I("FET toggle response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "reset")) {
+            else if (command == MESHSOLAR_CMD_RESET) {
                 TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, writeResults[0], meshsolar.reset_bat_gauge());     
                 LOG_I("Resetting BQ4050...");
 
                 // Respond with the reset result
-                meshsolar_cmd_rsp_to_json(writeResults[0], json); // Create a response JSON
-                comSerial.println(json); // Send the response back to the serial port
-                delay(10); // Small delay to avoid flooding the serial output
+                sendCmdRsp(writeResults[0], id, rsp); // Send (and remember) the response
                 LOG_I("Reset response sent");
             }
-            else if (0 == strcmp(meshsolar.cmd.command, "sync")) {
+            else if (command == MESHSOLAR_CMD_SYNC && meshsolar.cmd.sync.times == 0) {
+                TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_realtime_bat_status());
+                TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_basic_bat_realtime_setting());
+                TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[2], meshsolar.get_advance_bat_realtime_setting());
+                // Each frame is sent once, the host acks and names missing frames
+                syncFrames.begin(3);
+                meshsolar_status_to_json(&meshsolar.sta, json);
+                syncFrames.add(json.c_str());
+                meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json);
+                syncFrames.add(json.c_str());
+                meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json);
+                syncFrames.add(json.c_str());
+                sendSyncFrames(syncFrames.all());
+                LOG_I("Sync session %u sent", syncFrames.id());
+            }
+            else if (command == MESHSOLAR_CMD_ACK) {
+                if (syncFrames.ack(meshsolar.cmd.ack.session, meshsolar.cmd.ack.missing)) {
+                    sendSyncFrames(meshsolar.cmd.ack.missing); // Selective retransmit
+                }
+                else {
+                    sendCmdRsp(false, id, rsp); // Stale session, the host starts a new sync
+                }
+            }
+            else if (command == MESHSOLAR_CMD_SYNC) {
                 size_t len = 0;
                 TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_realtime_bat_status());
                 TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_basic_bat_realtime_setting());
                 TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[2], meshsolar.get_advance_bat_realtime_setting());    
                 len = meshsolar_status_to_json(&meshsolar.sta, json);
                 if(len > 0) {
-                    comSerial.println(json); // Send the configuration back to the serial port
-                    delay(10); // Small delay to avoid flooding the serial output
+                    sendResponse(json); // Queue the configuration for the serial port
                     LOG_D("%s", json.c_str());
                 }
                 for(uint8_t i = 0; i < meshsolar.cmd.sync.times; i++) {
                     len = meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json); // Get the basic battery settings
                     if(len > 0) {
-                        comSerial.println(json); // Send the configuration back to the serial port
-                        delay(10); // Small delay to avoid flooding the serial output
+                        sendResponse(json); // Queue the configuration for the serial port
                         LOG_D("%s", json.c_str());
                     }
 
                     len = meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json); // Get the advanced battery settings
                     if(len > 0) {
-                        comSerial.println(json); // Send the configuration back to the serial port
-                        delay(10); // Small delay to avoid flooding the serial output
+                        sendResponse(json); // Queue the configuration for the serial port
                         LOG_D("%s", json.c_str());
                     }
                 }
                 LOG_I("Sync data sent %d times.", meshsolar.cmd.sync.times);
             }
+            else if (command == MESHSOLAR_CMD_BATCH) {
+                const batch_config_t *batch = &meshsolar.cmd.batch;
+                bool results[MESHSOLAR_BATCH_MAX] = {false};
+                bool settings = false;      // Settings are read back and sent once
+                bool sync = false;
+                log_i("\r\n");
+                LOG_W("Executing %d step batch...", batch->count);
+
+                // Plan the DataFlash writes of every step, each address is written once
+                meshsolar.df_plan_begin();
+                for (uint8_t i = 0; i < batch->count; i++) {
+                    meshsolar.df_plan_step(i);
+                    if (batch->steps[i] == MESHSOLAR_CMD_CONFIG) {
+                        results[i] = meshsolar.plan_basic_settings();
+                    }
+                    else if (batch->steps[i] == MESHSOLAR_CMD_ADVANCE) {
+                        results[i] = meshsolar.plan_advance_settings();
+                    }
+                }
+                TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, writeResults[0], meshsolar.df_plan_apply());
+
+                // FET and gauge commands run after the writes, in request order
+                for (uint8_t i = 0; i < batch->count; i++) {
+                    switch (batch->steps[i]) {
+                        case MESHSOLAR_CMD_CONFIG:
+                        case MESHSOLAR_CMD_ADVANCE:
+                            results[i] = results[i] && meshsolar.df_plan_step_ok(i);
+                            settings = true;
+                            break;
+                        case MESHSOLAR_CMD_SWITCH:
+                            TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, results[i], meshsolar.toggle_fet());
+                            break;
+                        case MESHSOLAR_CMD_RESET:
+                            TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, results[i], meshsolar.reset_bat_gauge());
+                            break;
+                        case MESHSOLAR_CMD_SYNC:
+                            results[i] = true;
+                            settings = sync = true;
+                            break;
+                        default:
+                            break;
+                    }
+                    LOG_I("Step %d %-8s | %s", i, meshsolar_cmd_names[batch->steps[i]], results[i] ? "Success" : "Failed");
+                }
+
+                // Read back once, send the settings once (sync repeats them)
+                if (settings) {
+                    TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_realtime_bat_status());
+                    TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_basic_bat_realtime_setting());
+                    TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[2], meshsolar.get_advance_bat_realtime_setting());
+                    if (sync && meshsolar_status_to_json(&meshsolar.sta, json) > 0) {
+                        sendResponse(json); // Queue the status for the serial port
+                    }
+                    uint16_t times = (sync && meshsolar.cmd.sync.times > 1) ? meshsolar.cmd.sync.times : 1;
+                    for (uint16_t t = 0; t < times; t++) {
+                        if (meshsolar_basic_config_to_json(&meshsolar.sync_rsp.basic, json) > 0) {
+                            sendResponse(json); // Queue the configuration for the serial port
+                        }
+                        if (meshsolar_advance_config_to_json(&meshsolar.sync_rsp.advance, json) > 0) {
+                            sendResponse(json); // Queue the configuration for the serial port
+                        }
+                    }
+                }
+
+                meshsolar_batch_rsp_to_json(batch, results, json, id); // One response for the whole batch
+                sendResponse(json); // Queue the response for the serial port
+                if (rsp != NULL) {
+                    *rsp = json;
+                }
+                LOG_I("Batch response sent");
+            }
+            else if (command == MESHSOLAR_CMD_HISTORY) {
+                const history_config_t *range = &meshsolar.cmd.history;
+                bool ok = range->from_s >= range->to_s;
+                if (ok) {
+                    uint32_t now = sysclk::millis();
+                    uint8_t  blocks[HISTORY_BLOCKS];
+                    uint8_t  n = history.find(now - (uint32_t)range->from_s * 1000, now - (uint32_t)range->to_s * 1000,
+                                              blocks, HISTORY_BLOCKS);
+                    for (uint8_t i = 0; i < n; i++) {
+                        history.block_to_json(blocks[i], i, n, now, json);
+                        sendResponse(json); // One frame per block, oldest first
+                    }
+                    LOG_I("History: %d blocks sent", n);
+                }
+                sendCmdRsp(ok, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_TREND) {
+                const trend_config_t *query = &meshsolar.cmd.trend;
+                rollup_series_t series = rollup_find_series(query->series);
+                bool per_cell = (series == ROLLUP_SERIES_VOLTAGE || series == ROLLUP_SERIES_TEMPERATURE);
+                int  cells    = (series == ROLLUP_SERIES_VOLTAGE) ? meshsolar.sta.cell_count : 4;
+                bool ok = (series != ROLLUP_SERIES_COUNT) && (query->from_s >= query->to_s);
+                for (int cell = 1; ok && cell <= (per_cell ? cells : 1); cell++) {
+                    if (per_cell && query->cell != 0 && query->cell != cell) {
+                        continue;
+                    }
+                    if (rollup.to_json(series, cell, query->from_s, query->to_s, sysclk::millis(), json) > 0) {
+                        sendResponse(json); // One frame per series and cell
+                    }
+                }
+                sendCmdRsp(ok, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_ALARM) {
+                meshsolar.set_alarm_config(meshsolar.cmd.alarm);
+                TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, writeResults[0], meshsolar.update_alarm_setting());
+                sendCmdRsp(writeResults[0], id, rsp);
+            }
+            else if (command == MESHSOLAR_CMD_CAPTURE) {
+                // Blocks the bus for the window, xMutex keeps the renew out meanwhile
+                bool ok = capture.run(&bq4050, (uint8_t)meshsolar.sta.cell_count, meshsolar.cmd.capture);
+                for (uint16_t seq = 0; ok && capture.chunk_json(seq, json) > 0; seq++) {
+                    sendResponse(json); // Waveform, CAPTURE_CHUNK_SAMPLES samples per frame
+                }
+                if (ok && capture.summary_json(json) > 0) {
+                    sendResponse(json); // Internal resistance estimate
+                }
+                sendCmdRsp(ok, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_EXPORT) {
+                // Blocks the bus while the region is read, xMutex keeps the renew out meanwhile
+                bool ok = image.export_begin(meshsolar.cmd.image.addr, meshsolar.cmd.image.len);
+                for (uint16_t seq = 0; ok && seq < image.chunks(); seq++) {
+                    ok = image.export_chunk_json(&bq4050, seq, json) > 0;
+                    if (ok) {
+                        sendResponse(json); // DF_IMAGE_CHUNK bytes per frame
+                    }
+                }
+                if (ok && image.export_summary_json(json) > 0) {
+                    sendResponse(json); // Length and CRC of the whole range
+                }
+                sendCmdRsp(ok, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_IMPORT) {
+                const image_config_t *req = &meshsolar.cmd.image;
+                image_op_t op = image_find_op(req->op);
+                bool ok = true;
+                if (op == IMAGE_OP_BEGIN) {
+                    image.begin();
+                }
+                else if (op == IMAGE_OP_DATA) {
+                    ok = image.stage(req->addr, req->data, req->crc); // RAM only, the host resends on false
+                }
+                else {
+                    log_i("\r\n");
+                    LOG_W("Committing DataFlash image...");
+                    TRY_EXECUTE(WRITE_TRY_NUM, WRITE_TRY_INTERVAL, ok, image.commit(&bq4050, req->crc));
+                    if (image.commit_json(json) > 0) {
+                        sendResponse(json); // Block counts of the last attempt
+                    }
+                    // Cell count, chemistry and the sync reply follow the new image
+                    TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[0], meshsolar.get_basic_bat_realtime_setting());
+                    TRY_EXECUTE(READ_TRY_NUM, READ_TRY_INTERVAL, readResults[1], meshsolar.get_advance_bat_realtime_setting());
+                }
+                sendCmdRsp(ok, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_EVENTS) {
+                uint32_t seq = (uint32_t)meshsolar.cmd.events.from;
+                for (;;) {
+                    xSemaphoreTake(xEventMutex, portMAX_DELAY);
+                    size_t len = meshsolar_events_to_json(&meshsolar.events, &seq, sysclk::millis(), json);
+                    xSemaphoreGive(xEventMutex);
+                    if (len == 0) {
+                        break;
+                    }
+                    sendResponse(json); // Journal from "from", oldest first
+                }
+                sendCmdRsp(true, id, rsp); // Ends the reply
+            }
+            else if (command == MESHSOLAR_CMD_LOG) {
+                int      count = (meshsolar.cmd.log.count > 0) ? meshsolar.cmd.log.count : STORE_LOG_DEFAULT;
+                uint32_t total = store.select((uint32_t)count);
+                for (uint32_t i = 0; i < total && store.next_json(i, total, json) > 0; i++) {
+                    sendResponse(json); // One frame per record, oldest first
+                }
+                LOG_I("Log: %u records sent", (unsigned)total);
+                sendCmdRsp(store.active(), id, rsp); // Ends the reply
+            }
             else{
                 LOG_E("Unknown command: %s", meshsolar.cmd.command);
                 result = -3;
             }
+            meshsolar.dataflash_relock(); // Seal the gauge again if the command unsealed it
         } else {
             LOG_E("Failed to parse command");
             result = -2;
@@ -659,22 +893,103 @@ int meshSolarCmdHandle(const char *cmd)
         LOG_E("The length is too short, the command is invalid.");
         result = -1;
     }
+    pushEvents();
     xSemaphoreGive(xMutex);
     return result;
 }
 
+int meshSolarCmdHandle(const char *cmd)
+{
+    char id[CMD_ID_LEN];
+
+    if ((cmd == NULL) || !parseCommandId(cmd, id, sizeof(id))) {
+        return meshSolarCmdExecute(cmd, NULL, NULL);
+    }
+
+    xSemaphoreTake(xIdMutex, portMAX_DELAY);
+    int slot = cmdIdFind(id);
+    if (slot >= 0 && cmdIdCache[slot].done && cmdIdCache[slot].rsp[0] == '\0') {
+        // Nothing cached to replay, run it again in the same slot
+        LOG_I("Command id %s has no cached response, executing again", id);
+        cmdIdCache[slot].done = false;
+    }
+    else if (slot >= 0 && cmdIdCache[slot].done) {
+        // Completed duplicate: replay the cached response, touch nothing on the bus
+        int  result = cmdIdCache[slot].result;
+        char line[CMD_RSP_LEN];
+        strlcpy(line, cmdIdCache[slot].rsp, sizeof(line));
+        xSemaphoreGive(xIdMutex);
+        LOG_I("Command id %s already executed, replaying response", id);
+        sendResponse(line);
+        return result;
+    }
+    else if (slot >= 0) {
+        // In-flight duplicate: attach to the original and share its result
+        xSemaphoreGive(xIdMutex);
+        LOG_I("Command id %s in flight, attaching", id);
+        for (uint32_t waited = 0; waited < CMD_ID_ATTACH_TIMEOUT; waited += CMD_ID_ATTACH_POLL) {
+            sysclk::delay(CMD_ID_ATTACH_POLL);
+            xSemaphoreTake(xIdMutex, portMAX_DELAY);
+            bool done   = (0 == strcmp(cmdIdCache[slot].id, id)) && cmdIdCache[slot].done;
+            int  result = cmdIdCache[slot].result;
+            xSemaphoreGive(xIdMutex);
+            if (done) {
+                return result;
+            }
+        }
+        LOG_E("Command id %s attach timeout", id);
+        return -1;
+    }
+    else {
+        slot = cmdIdReserve(id);
+    }
+    xSemaphoreGive(xIdMutex);
+
+    String rsp;
+    int result = meshSolarCmdExecute(cmd, id, &rsp);
+
+    if (slot >= 0) {
+        xSemaphoreTake(xIdMutex, portMAX_DELAY);
+        strlcpy(cmdIdCache[slot].rsp, rsp.c_str(), sizeof(cmdIdCache[slot].rsp));
+        cmdIdCache[slot].result = result;
+        cmdIdCache[slot].done   = true;
+        xSemaphoreGive(xIdMutex);
+    }
+    return result;
+}
+
+
+/**
+ * @brief Renew the cached battery status when the adaptive poll interval elapsed
+ * 
+ * The interval is recomputed after every renew by MeshSolar::next_poll_interval_ms():
+ * fast while current changes, protection is active or SOC is low, minutes while idle.
+ * Also resends sync frames the host did not acknowledge in time.
+ */
+static void meshSolarRenewIfDue(void)
+{
+    if (syncFrames.active() && xSemaphoreTake(xMutex, 0) == pdTRUE)
+    {
+        uint8_t mask = syncFrames.due(sysclk::millis());
+        if (mask != 0) {
+            LOG_W("Sync session %u: resending frames 0x%02X", syncFrames.id(), mask);
+            sendSyncFrames(mask);
+        }
+        xSemaphoreGive(xMutex);
+    }
+
+    if((sysclk::millis()-lastRenewTime) >= renewInterval)
+    {
+        meshSolarCmdHandle("{\"command\":\"renew\"}");
+        lastRenewTime = sysclk::millis();
+    }
+}
 
     /**
      * Battery state of charge, from 0 to 100 or -1 for unknown
      */
-uint32_t lastRenewTime = 0;
-#define RENEW_INTERVAL 10000
     int meshSolarGetBatteryPercent()  {
-        if((millis()-lastRenewTime) > RENEW_INTERVAL)
-        {
-            meshSolarCmdHandle("{\"command\":\"renew\"}");
-            lastRenewTime = millis();
-        }
+        meshSolarRenewIfDue();
         return (int)meshsolar.sta.soc_gauge; 
     }
 
@@ -682,11 +997,7 @@ uint32_t lastRenewTime = 0;
      * The raw voltage of the battery in millivolts, or NAN if unknown
      */
      uint16_t meshSolarGetBattVoltage()  { 
-        if((millis()-lastRenewTime) > RENEW_INTERVAL)
-        {
-            meshSolarCmdHandle("{\"command\":\"renew\"}");
-            lastRenewTime = millis();
-        }
+        meshSolarRenewIfDue();
         return (uint16_t)meshsolar.sta.total_voltage;
     }
 
@@ -700,24 +1011,37 @@ uint32_t lastRenewTime = 0;
      * return true if there is an external power source detected
      */
      bool meshSolarIsVbusIn()  {
-        if((millis()-lastRenewTime) > RENEW_INTERVAL)
-        {
-            meshSolarCmdHandle("{\"command\":\"renew\"}");
-            lastRenewTime = millis();
-        }
+        meshSolarRenewIfDue();
         return (meshsolar.sta.charge_current>0)? true:false;
     }
     /**
      * return true if the battery is currently charging
      */
      bool meshSolarIsCharging()  {
-        if((millis()-lastRenewTime) > RENEW_INTERVAL)
-        {
-            meshSolarCmdHandle("{\"command\":\"renew\"}");
-            lastRenewTime = millis();
-        }
+        meshSolarRenewIfDue();
         return (meshsolar.sta.charge_current>0)? true:false;
     }
+    /**
+     * Pack the current status into a MESHSOLAR_PACKED_LEN byte frame for a mesh
+     * telemetry payload, see meshsolar_pack.h. Returns the frame size, 0 if buf
+     * is too small
+     */
+     size_t meshSolarGetTelemetryFrame(uint8_t *buf, size_t len)  {
+        meshSolarRenewIfDue();
+        return meshsolar_pack_status(&meshsolar.sta, buf, len);
+    }
+    /**
+     * Keep status and protection records in flash across resets, see
+     * meshsolar_store.h. Call after meshSolarStart(). dev must stay valid;
+     * with BLE running it has to go through the SoftDevice flash API, not
+     * Nrf52Flash. Returns false if the device is unusable
+     */
+     bool meshSolarStoreBegin(FlashDevice *dev, uint32_t reset_reason)  {
+        xSemaphoreTake(xMutex, portMAX_DELAY);
+        bool ok = store.begin(dev, reset_reason, sysclk::millis());
+        xSemaphoreGive(xMutex);
+        return ok;
+    }
 /*
  * ============================================================================
  * PORTING CHECKLIST - Verify these items for successful port
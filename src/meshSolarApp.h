@@ -4,9 +4,19 @@
 #include "Adafruit_TinyUSB.h"
 #include <ArduinoJson.h>
 #include "driver/meshsolar.h"
+#include "driver/meshsolar_json.h"
+#include "driver/meshsolar_pack.h"
+#include "driver/meshsolar_history.h"
+#include "driver/meshsolar_rollup.h"
+#include "driver/meshsolar_store.h"
+#include "driver/meshsolar_capture.h"
+#include "driver/meshsolar_image.h"
 #include "driver/SoftwareWire.h"
 #include "driver/bq4050.h"
 #include "utils/logger.h"
+#include "utils/sysclock.h"
+#include "utils/tx_queue.h"
+#include "utils/frame_sync.h"
 #include <Adafruit_NeoPixel.h>
 
 void meshSolarStart(void);
@@ -17,5 +27,7 @@ uint16_t meshSolarGetBattVoltage();
 bool meshSolarIsBatteryConnect();
 bool meshSolarIsVbusIn();
 bool meshSolarIsCharging();
+size_t meshSolarGetTelemetryFrame(uint8_t *buf, size_t len);
+bool meshSolarStoreBegin(FlashDevice *dev, uint32_t reset_reason);
 
 #endif // __MESH_SOLAR_APP_H__
\ No newline at end of file
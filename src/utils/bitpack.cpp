@@ -0,0 +1,72 @@
+#include "bitpack.h"
+#include <string.h>
+
+/**
+ * @brief Start writing at bit 0 of buf, the buffer is cleared
+ */
+BitWriter::BitWriter(uint8_t *buf, size_t len){
+    this->buf      = buf;
+    this->len      = len;
+    this->pos      = 0;
+    this->overflow = false;
+    memset(buf, 0, len);
+}
+
+/**
+ * @brief Append the low bits of a value
+ *
+ * @param value Field value, higher bits are ignored
+ * @param bits  Field width, 1 to 32
+ */
+void BitWriter::put(uint32_t value, uint8_t bits){
+    if (this->overflow || this->pos + bits > this->len * 8) {
+        this->overflow = true;
+        return;
+    }
+    for (uint8_t i = 0; i < bits; i++, this->pos++) {
+        if (value & (1UL << i)) {
+            this->buf[this->pos >> 3] |= (uint8_t)(1 << (this->pos & 7));
+        }
+    }
+}
+
+/**
+ * @brief Start reading at bit 0 of buf
+ */
+BitReader::BitReader(const uint8_t *buf, size_t len){
+    this->buf       = buf;
+    this->len       = len;
+    this->pos       = 0;
+    this->underflow = false;
+}
+
+/**
+ * @brief Read the next unsigned field
+ *
+ * @param bits Field width, 1 to 32
+ * @return uint32_t Field value, 0 past the end of the buffer
+ */
+uint32_t BitReader::get(uint8_t bits){
+    if (this->underflow || this->pos + bits > this->len * 8) {
+        this->underflow = true;
+        return 0;
+    }
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < bits; i++, this->pos++) {
+        if (this->buf[this->pos >> 3] & (1 << (this->pos & 7))) {
+            value |= (1UL << i);
+        }
+    }
+    return value;
+}
+
+/**
+ * @brief Read the next field as a two's complement number
+ */
+int32_t BitReader::get_signed(uint8_t bits){
+    uint32_t value = this->get(bits);
+    if (bits < 32 && (value & (1UL << (bits - 1)))) {
+        value |= ~((1UL << bits) - 1);      // Sign extend
+    }
+    return (int32_t)value;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file bitpack.h
+ * @brief LSB-first bit stream writer and reader for fixed binary frames.
+ *
+ * Fields are appended at an arbitrary bit position, the first field lands in
+ * the low bits of byte 0. Both sides only need the field widths, there is no
+ * per-field framing, so a frame costs exactly the sum of its field widths.
+ *
+ * PORTING NOTES:
+ * - Byte order and bit order are fixed by the format, not by the CPU, so a
+ *   frame written on the nRF52 decodes unchanged on any host.
+ */
+
+#ifndef _BITPACK_H_
+#define _BITPACK_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+class BitWriter{
+private:
+    uint8_t *buf;
+    size_t   len;           // Buffer size (bytes)
+    size_t   pos;           // Next bit to write
+    bool     overflow;      // A field did not fit, the frame is unusable
+
+public:
+    BitWriter(uint8_t *buf, size_t len);
+
+    void   put(uint32_t value, uint8_t bits);       // Low `bits` bits of value, bits <= 32
+    size_t bytes() const { return (this->pos + 7) / 8; }
+    bool   ok() const { return !this->overflow; }
+};
+
+class BitReader{
+private:
+    const uint8_t *buf;
+    size_t         len;     // Buffer size (bytes)
+    size_t         pos;     // Next bit to read
+    bool           underflow;
+
+public:
+    BitReader(const uint8_t *buf, size_t len);
+
+    uint32_t get(uint8_t bits);                     // Unsigned field, bits <= 32
+    int32_t  get_signed(uint8_t bits);              // Two's complement field
+    bool     ok() const { return !this->underflow; }
+};
+
+#endif
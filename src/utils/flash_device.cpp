@@ -0,0 +1,135 @@
+#include "flash_device.h"
+#include "sysclock.h"
+#include "logger.h"
+#include <string.h>
+
+/**
+ * @brief Allocate the simulated pages, erased
+ */
+SimFlash::SimFlash(const sim_flash_geometry_t &geometry) : geo(geometry), cut(-1), fail(-1){
+    this->mem         = new uint8_t[(size_t)geo.page_size * geo.page_count];
+    this->page_erases = new uint32_t[geo.page_count];
+    memset(this->mem, 0xFF, (size_t)geo.page_size * geo.page_count);
+    memset(this->page_erases, 0, sizeof(uint32_t) * geo.page_count);
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+SimFlash::~SimFlash(){
+    delete[] this->mem;
+    delete[] this->page_erases;
+}
+
+bool SimFlash::read(uint32_t page, uint32_t offset, void *data, size_t len){
+    if (page >= geo.page_count || offset + len > geo.page_size) {
+        return false;
+    }
+    memcpy(data, this->mem + (size_t)page * geo.page_size + offset, len);
+    return true;
+}
+
+/**
+ * @brief Program words: like NOR flash, bits can only go from 1 to 0
+ */
+bool SimFlash::program(uint32_t page, uint32_t offset, const void *data, size_t len){
+    if (page >= geo.page_count || offset + len > geo.page_size ||
+        (offset % FLASH_WORD_SIZE) != 0 || (len % FLASH_WORD_SIZE) != 0) {
+        return false;
+    }
+    uint8_t       *dst = this->mem + (size_t)page * geo.page_size + offset;
+    const uint8_t *src = (const uint8_t *)data;
+    for (size_t w = 0; w < len; w += FLASH_WORD_SIZE) {
+        if (this->fail == 0) {
+            return false;                   // Earlier words stay programmed
+        }
+        if (this->fail > 0) {
+            this->fail--;
+        }
+        if (this->cut == 0) {
+            return true;                    // Power is gone, the caller never learns
+        }
+        if (this->cut > 0) {
+            this->cut--;
+        }
+        for (uint8_t i = 0; i < FLASH_WORD_SIZE; i++) {
+            dst[w + i] &= src[w + i];
+        }
+        this->stats.words++;
+        this->stats.busy_us += geo.program_us;
+        sysclk::delay_us(geo.program_us);
+    }
+    return true;
+}
+
+bool SimFlash::erase(uint32_t page){
+    if (page >= geo.page_count) {
+        return false;
+    }
+    memset(this->mem + (size_t)page * geo.page_size, 0xFF, geo.page_size);
+    this->page_erases[page]++;
+    this->stats.erases++;
+    if (this->page_erases[page] > this->stats.max_page_erases) {
+        this->stats.max_page_erases = this->page_erases[page];
+    }
+    this->stats.busy_us += geo.erase_ms * 1000;
+    sysclk::delay(geo.erase_ms);
+    return true;
+}
+
+#if defined(ARDUINO_ARCH_NRF52) || defined(NRF52_SERIES)
+#include <nrf.h>
+#include <nrf_sdm.h>
+
+/**
+ * @brief The NVMC is ours only while the SoftDevice is off
+ */
+bool Nrf52Flash::writable(){
+    uint8_t sd_en = 0;
+    (void)sd_softdevice_is_enabled(&sd_en);
+    if (sd_en) {
+        LOG_E("Flash: SoftDevice enabled, NVMC access refused");
+        return false;
+    }
+    return true;
+}
+
+bool Nrf52Flash::read(uint32_t page, uint32_t offset, void *data, size_t len){
+    if (page >= this->pages || offset + len > this->page_size()) {
+        return false;
+    }
+    memcpy(data, (const void *)(uintptr_t)(this->base + page * this->page_size() + offset), len);   // Flash is memory mapped
+    return true;
+}
+
+bool Nrf52Flash::program(uint32_t page, uint32_t offset, const void *data, size_t len){
+    if (page >= this->pages || offset + len > this->page_size() ||
+        (offset % FLASH_WORD_SIZE) != 0 || (len % FLASH_WORD_SIZE) != 0 || !this->writable()) {
+        return false;
+    }
+    volatile uint32_t *dst = (volatile uint32_t *)(uintptr_t)(this->base + page * this->page_size() + offset);
+    const uint8_t     *src = (const uint8_t *)data;
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    for (size_t w = 0; w < len / FLASH_WORD_SIZE; w++) {
+        uint32_t word;
+        memcpy(&word, src + w * FLASH_WORD_SIZE, FLASH_WORD_SIZE);  // Source may be unaligned
+        dst[w] = word;
+        while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    }
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    return true;
+}
+
+bool Nrf52Flash::erase(uint32_t page){
+    if (page >= this->pages || !this->writable()) {
+        return false;
+    }
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    NRF_NVMC->ERASEPAGE = this->base + page * this->page_size();
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}
+    return true;
+}
+#endif
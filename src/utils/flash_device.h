@@ -0,0 +1,115 @@
+/**
+ * @file flash_device.h
+ * @brief Page-erasable NOR flash behind an injectable interface, with a simulated backend.
+ *
+ * FlashLog only sees pages: read anywhere, program words into erased space,
+ * erase a whole page back to 0xFF. On target Nrf52Flash drives the NVMC of
+ * the nRF52840. Off target SimFlash keeps the pages in RAM with NOR
+ * semantics (programming can only clear bits) and charges the erase and
+ * program time to sysclk, so on a VirtualClock a simulated run reports the
+ * flash time it would have spent on the chip.
+ */
+
+#ifndef _FLASH_DEVICE_H_
+#define _FLASH_DEVICE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FLASH_WORD_SIZE         4           // Program granularity, offsets and lengths are multiples of it
+
+class FlashDevice{
+public:
+    virtual ~FlashDevice() {}
+    virtual uint32_t page_size() const = 0;
+    virtual uint32_t page_count() const = 0;
+    virtual bool     read(uint32_t page, uint32_t offset, void *data, size_t len) = 0;
+    // Program erased words, offset and len must be FLASH_WORD_SIZE aligned
+    virtual bool     program(uint32_t page, uint32_t offset, const void *data, size_t len) = 0;
+    virtual bool     erase(uint32_t page) = 0;
+};
+
+// Simulated geometry and timing, defaults are the nRF52840 NVMC figures
+typedef struct {
+    uint32_t page_size;                     // Bytes per page
+    uint32_t page_count;
+    uint32_t erase_ms;                      // Page erase time
+    uint32_t program_us;                    // Time per programmed word
+} sim_flash_geometry_t;
+
+#define SIM_FLASH_DEFAULT_GEOMETRY  {4096, 8, 85, 41}
+
+typedef struct {
+    uint32_t erases;                        // Page erases, all pages
+    uint32_t max_page_erases;               // Erases of the most worn page
+    uint32_t words;                         // Words programmed
+    uint32_t busy_us;                       // Time spent erasing and programming
+} sim_flash_stats_t;
+
+/**
+ * @brief RAM-backed NOR flash for host runs
+ *
+ * cut_after() simulates a brownout: the Nth programmed word from now and
+ * every later one are dropped, leaving a torn record for recovery to find.
+ * fail_after() simulates a worn or locked page instead: from the Nth word on
+ * program() stops and reports the failure.
+ */
+class SimFlash : public FlashDevice{
+private:
+    sim_flash_geometry_t geo;
+    uint8_t             *mem;
+    uint32_t            *page_erases;
+    sim_flash_stats_t    stats;
+    int32_t              cut;               // Words left before the simulated power cut, -1 = none
+    int32_t              fail;              // Words left before program() fails, -1 = never
+
+public:
+    SimFlash(const sim_flash_geometry_t &geometry);
+    ~SimFlash();
+
+    uint32_t page_size() const override { return geo.page_size; }
+    uint32_t page_count() const override { return geo.page_count; }
+    bool     read(uint32_t page, uint32_t offset, void *data, size_t len) override;
+    bool     program(uint32_t page, uint32_t offset, const void *data, size_t len) override;
+    bool     erase(uint32_t page) override;
+
+    void     cut_after(int32_t words) { cut = words; }
+    void     fail_after(int32_t words) { fail = words; }
+    void     get_stats(sim_flash_stats_t *out) const { *out = stats; }
+};
+
+#if defined(ARDUINO_ARCH_NRF52) || defined(NRF52_SERIES)
+/**
+ * @brief Internal flash of the nRF52840 through the NVMC
+ *
+ * PLATFORM NOTES:
+ * - The NVMC stalls the CPU while it erases or programs, 85 ms per page
+ *   erase and 41 us per word. FlashLog batches records so a page is erased
+ *   once per page_size bytes of log.
+ * - The region must be page aligned and outside the application image and
+ *   the InternalFS (LittleFS) area, see FLASH_LOG_BASE in the example.
+ *
+ * PORTING NOTES:
+ * - With the SoftDevice enabled (Bluefruit BLE) the NVMC belongs to it and
+ *   direct access faults. Every call then fails; give FlashLog a FlashDevice
+ *   that goes through sd_flash_write()/sd_flash_page_erase() instead.
+ */
+class Nrf52Flash : public FlashDevice{
+private:
+    uint32_t base;                          // Address of page 0
+    uint32_t pages;
+
+    bool     writable();
+
+public:
+    Nrf52Flash(uint32_t base, uint32_t pages) : base(base), pages(pages) {}
+
+    uint32_t page_size() const override { return 4096; }
+    uint32_t page_count() const override { return pages; }
+    bool     read(uint32_t page, uint32_t offset, void *data, size_t len) override;
+    bool     program(uint32_t page, uint32_t offset, const void *data, size_t len) override;
+    bool     erase(uint32_t page) override;
+};
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+#include "flash_log.h"
+#include "frame_sync.h"
+#include "logger.h"
+#include <string.h>
+
+#define REC_ERASED          0xFF
+
+static uint32_t record_size(uint8_t len){
+    return FLASH_LOG_RECORD_HEADER + ((len + FLASH_WORD_SIZE - 1) / FLASH_WORD_SIZE) * FLASH_WORD_SIZE;
+}
+
+/**
+ * @brief CRC of a record: len, type, then the payload
+ */
+static uint16_t record_crc(uint8_t len, uint8_t type, const uint8_t *payload){
+    uint8_t tmp[2 + FLASH_LOG_PAYLOAD_MAX];
+    tmp[0] = len;
+    tmp[1] = type;
+    memcpy(tmp + 2, payload, len);
+    return frame_crc16(tmp, 2 + len);
+}
+
+static void put32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+FlashLog::FlashLog() : dev(nullptr), open(false), head(0), head_seq(0), write_off(0), buf_used(0){
+}
+
+/**
+ * @brief Read and check a page header
+ *
+ * @return true if the page holds a valid header
+ */
+bool FlashLog::read_header(uint32_t page, uint32_t *seq, uint32_t *erases){
+    uint8_t h[FLASH_LOG_HEADER_SIZE];
+    if (!this->dev->read(page, 0, h, sizeof(h)) || get32(h) != FLASH_LOG_MAGIC) {
+        return false;
+    }
+    uint16_t crc = (uint16_t)(h[14] | (h[15] << 8));
+    if (frame_crc16(h, 14) != crc) {
+        return false;
+    }
+    *seq    = get32(h + 4);
+    *erases = get32(h + 8);
+    return true;
+}
+
+/**
+ * @brief Read and check the record at offset
+ *
+ * @param size Receives the record size in flash
+ * @return true if a complete record with a good CRC is there
+ */
+bool FlashLog::read_record(uint32_t page, uint32_t offset, flash_record_t *rec, uint32_t *size){
+    uint8_t h[FLASH_LOG_RECORD_HEADER];
+    if (offset + FLASH_LOG_RECORD_HEADER > this->dev->page_size() || !this->dev->read(page, offset, h, sizeof(h))) {
+        return false;
+    }
+    if (h[0] == REC_ERASED || h[0] > FLASH_LOG_PAYLOAD_MAX || h[1] == REC_ERASED) {
+        return false;
+    }
+    *size = record_size(h[0]);
+    if (offset + *size > this->dev->page_size() ||
+        !this->dev->read(page, offset + FLASH_LOG_RECORD_HEADER, rec->data, h[0])) {
+        return false;
+    }
+    if (record_crc(h[0], h[1], rec->data) != (uint16_t)(h[2] | (h[3] << 8))) {
+        return false;
+    }
+    rec->len  = h[0];
+    rec->type = h[1];
+    return true;
+}
+
+/**
+ * @brief Find the newest page and the end of its records
+ *
+ * RECOVERY:
+ * 1. Read every page header, keep the highest valid sequence number
+ * 2. Walk the records of that page only, stop at erased space or a bad CRC
+ * 3. A bad CRC closes the page, so the torn record is never appended to
+ * An empty or foreign device is left alone until the first flush formats it.
+ */
+bool FlashLog::begin(FlashDevice *dev){
+    this->dev      = dev;
+    this->open     = false;
+    this->buf_used = 0;
+    if (dev == nullptr || dev->page_count() < 2 || dev->page_size() < FLASH_LOG_HEADER_SIZE + FLASH_LOG_BUFFER) {
+        LOG_E("Flash log: unusable device");
+        return false;
+    }
+
+    uint32_t valid = 0;
+    for (uint32_t p = 0; p < dev->page_count(); p++) {
+        uint32_t seq, erases;
+        if (this->read_header(p, &seq, &erases)) {
+            if (!this->open || seq > this->head_seq) {
+                this->head     = p;
+                this->head_seq = seq;
+                this->open     = true;
+            }
+            valid++;
+        }
+    }
+    if (!this->open) {
+        LOG_I("Flash log: empty, %u pages", (unsigned)dev->page_count());
+        return true;
+    }
+
+    flash_record_t rec;
+    uint32_t size;
+    this->write_off = FLASH_LOG_HEADER_SIZE;
+    while (this->read_record(this->head, this->write_off, &rec, &size)) {
+        this->write_off += size;
+    }
+    uint8_t h[FLASH_LOG_RECORD_HEADER] = {0};
+    if (this->write_off + FLASH_LOG_RECORD_HEADER <= dev->page_size()) {
+        dev->read(this->head, this->write_off, h, sizeof(h));
+    }
+    if (h[0] != REC_ERASED || h[1] != REC_ERASED || h[2] != REC_ERASED || h[3] != REC_ERASED) {
+        LOG_W("Flash log: torn record in page %u at %u, page closed", (unsigned)this->head, (unsigned)this->write_off);
+        this->write_off = dev->page_size();
+    }
+    LOG_I("Flash log: %u pages in use, head %u seq %u at %u",
+          (unsigned)valid, (unsigned)this->head, (unsigned)this->head_seq, (unsigned)this->write_off);
+    return true;
+}
+
+/**
+ * @brief Erase the next page of the ring and write its header
+ */
+bool FlashLog::open_next(){
+    uint32_t page = this->open ? (this->head + 1) % this->dev->page_count() : 0;
+    uint32_t seq  = this->open ? this->head_seq + 1 : 1;
+    uint32_t old_seq, erases = 0;
+    if (!this->read_header(page, &old_seq, &erases)) {
+        erases = 0;                         // Never used, or torn
+    }
+    if (!this->dev->erase(page)) {
+        LOG_E("Flash log: erase of page %u failed", (unsigned)page);
+        return false;
+    }
+
+    uint8_t h[FLASH_LOG_HEADER_SIZE];
+    put32(h, FLASH_LOG_MAGIC);
+    put32(h + 4, seq);
+    put32(h + 8, erases + 1);
+    h[12] = 0xFF;
+    h[13] = 0xFF;
+    uint16_t crc = frame_crc16(h, 14);
+    h[14] = (uint8_t)crc;
+    h[15] = (uint8_t)(crc >> 8);
+    if (!this->dev->program(page, 0, h, sizeof(h))) {
+        LOG_E("Flash log: header of page %u failed", (unsigned)page);
+        return false;
+    }
+    this->open      = true;
+    this->head      = page;
+    this->head_seq  = seq;
+    this->write_off = FLASH_LOG_HEADER_SIZE;
+    return true;
+}
+
+/**
+ * @brief Queue one record
+ *
+ * @param type Record type, anything but 0xFF
+ * @param data Payload
+ * @param len  Payload bytes, at most FLASH_LOG_PAYLOAD_MAX
+ * @return false on a bad record or when a forced flush failed
+ */
+bool FlashLog::append(uint8_t type, const void *data, uint8_t len){
+    if (this->dev == nullptr || type == REC_ERASED || len > FLASH_LOG_PAYLOAD_MAX) {
+        return false;
+    }
+    uint32_t size = record_size(len);
+    if (this->buf_used + size > FLASH_LOG_BUFFER && !this->flush()) {
+        return false;
+    }
+    uint8_t *r = this->buf + this->buf_used;
+    uint16_t crc = record_crc(len, type, (const uint8_t *)data);
+    r[0] = len;
+    r[1] = type;
+    r[2] = (uint8_t)crc;
+    r[3] = (uint8_t)(crc >> 8);
+    memcpy(r + FLASH_LOG_RECORD_HEADER, data, len);
+    memset(r + FLASH_LOG_RECORD_HEADER + len, 0xFF, size - FLASH_LOG_RECORD_HEADER - len);
+    this->buf_used += size;
+    return true;
+}
+
+/**
+ * @brief Program the queued records
+ *
+ * Records never straddle pages: the run that fits in the head page is
+ * programmed in one call, the rest goes to a freshly opened page.
+ */
+bool FlashLog::flush(){
+    if (this->dev == nullptr) {
+        return false;
+    }
+    uint16_t done = 0;
+    bool     ok   = true;
+    while (ok && done < this->buf_used) {
+        if (!this->open || this->write_off + record_size(this->buf[done]) > this->dev->page_size()) {
+            if (!this->open_next()) {
+                ok = false;                 // Keep the records for the next try
+                break;
+            }
+        }
+        uint16_t run = 0;
+        while (done + run < this->buf_used) {
+            uint32_t size = record_size(this->buf[done + run]);
+            if (this->write_off + run + size > this->dev->page_size()) {
+                break;
+            }
+            run += size;
+        }
+        if (!this->dev->program(this->head, this->write_off, this->buf + done, run)) {
+            LOG_E("Flash log: program of page %u failed", (unsigned)this->head);
+            this->write_off = this->dev->page_size();   // Unknown state, start over on a new page
+            ok = false;
+            break;
+        }
+        this->write_off += run;
+        done += run;
+    }
+    memmove(this->buf, this->buf + done, this->buf_used - done);   // Drop what reached the flash
+    this->buf_used -= done;
+    return ok;
+}
+
+/**
+ * @brief Start a walk at the oldest page
+ *
+ * Pages are opened in ring order, so from the page after the head the valid
+ * pages come oldest to newest.
+ */
+void FlashLog::rewind(flash_log_cursor_t *cur) const{
+    cur->page       = this->open ? (this->head + 1) % this->dev->page_count() : 0;
+    cur->offset     = 0;
+    cur->pages_left = this->open ? this->dev->page_count() : 0;
+}
+
+/**
+ * @brief Read the next record
+ *
+ * @return false once every page has been walked
+ */
+bool FlashLog::next(flash_log_cursor_t *cur, flash_record_t *rec){
+    while (cur->pages_left > 0) {
+        uint32_t size;
+        if (cur->offset == 0) {
+            uint32_t erases;
+            if (!this->read_header(cur->page, &cur->seq, &erases) || cur->seq > this->head_seq) {
+                cur->offset = this->dev->page_size();       // Free or stale page
+            }
+            else {
+                cur->offset = FLASH_LOG_HEADER_SIZE;
+            }
+        }
+        else if (this->read_record(cur->page, cur->offset, rec, &size)) {
+            rec->page_seq = cur->seq;
+            cur->offset  += size;
+            return true;
+        }
+        else {
+            cur->offset = this->dev->page_size();
+        }
+        if (cur->offset >= this->dev->page_size()) {
+            cur->page   = (cur->page + 1) % this->dev->page_count();
+            cur->offset = 0;
+            cur->pages_left--;
+        }
+    }
+    return false;
+}
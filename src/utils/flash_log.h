@@ -0,0 +1,94 @@
+/**
+ * @file flash_log.h
+ * @brief Append-only, wear-leveled record log over a FlashDevice.
+ *
+ * The pages form a ring written strictly in order. Each page starts with a
+ * header carrying a sequence number; records follow back to back until the
+ * page is full, then the next page in the ring is erased (dropping the
+ * oldest data) and opened with the next sequence number. Every page is
+ * therefore erased once per turn of the ring, whatever the record mix.
+ *
+ * PAGE HEADER (FLASH_LOG_HEADER_SIZE bytes):
+ *
+ *   u32 magic      FLASH_LOG_MAGIC
+ *   u32 seq        Increments with every page opened, newest page = highest
+ *   u32 erases     Wear count of this page, carried over each erase
+ *   u16 reserved   0xFFFF
+ *   u16 crc        frame_crc16() of the 14 bytes above
+ *
+ * RECORD:
+ *
+ *   u8  len        Payload bytes, 0xFF = erased space (end of page)
+ *   u8  type       Caller defined, 0xFF is reserved
+ *   u16 crc        frame_crc16() of len, type and payload
+ *   payload, padded with 0xFF to FLASH_WORD_SIZE
+ *
+ * TIMING:
+ * - begin() reads only the page headers to find the newest page, then walks
+ *   the records of that single page to find the write position, so boot
+ *   cost does not grow with the log.
+ * - append() only copies into a RAM buffer. The buffer is programmed when
+ *   it is full, or on flush(): one NVMC session per FLASH_LOG_BUFFER bytes
+ *   instead of one per record.
+ *
+ * A record that fails its CRC (power lost while programming) ends its page:
+ * nothing more is written there, the next flush opens a new page.
+ */
+
+#ifndef _FLASH_LOG_H_
+#define _FLASH_LOG_H_
+#include "flash_device.h"
+
+#define FLASH_LOG_MAGIC         0x474C534Du // "MSLG"
+#define FLASH_LOG_HEADER_SIZE   16
+#define FLASH_LOG_RECORD_HEADER 4
+#define FLASH_LOG_PAYLOAD_MAX   60          // Longest payload
+#define FLASH_LOG_BUFFER        256         // Records held in RAM before programming
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  len;
+    uint32_t page_seq;                      // Sequence number of the page holding it
+    uint8_t  data[FLASH_LOG_PAYLOAD_MAX];
+} flash_record_t;
+
+// Read position, oldest record first
+typedef struct {
+    uint32_t page;
+    uint32_t offset;                        // 0 = page header not read yet
+    uint32_t seq;                           // Sequence number of page
+    uint32_t pages_left;
+} flash_log_cursor_t;
+
+class FlashLog{
+private:
+    FlashDevice *dev;
+    bool         open;                      // head is a valid page
+    uint32_t     head;                      // Page being written
+    uint32_t     head_seq;
+    uint32_t     write_off;                 // Next free byte of head, page_size = closed
+    uint8_t      buf[FLASH_LOG_BUFFER];
+    uint16_t     buf_used;
+
+    bool read_header(uint32_t page, uint32_t *seq, uint32_t *erases);
+    bool read_record(uint32_t page, uint32_t offset, flash_record_t *rec, uint32_t *size);
+    bool open_next();
+
+public:
+    FlashLog();
+
+    // Recover the write position from flash, false without a usable device
+    bool     begin(FlashDevice *dev);
+    // Queue one record, programmed at the next flush
+    bool     append(uint8_t type, const void *data, uint8_t len);
+    // Program the queued records
+    bool     flush();
+    uint16_t buffered() const { return buf_used; }
+    uint32_t sequence() const { return open ? head_seq : 0; }
+
+    // Walk the programmed records, oldest first; queued records are not seen until flushed
+    void     rewind(flash_log_cursor_t *cur) const;
+    bool     next(flash_log_cursor_t *cur, flash_record_t *rec);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "frame_sync.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief CRC-16/CCITT-FALSE, bitwise (frames are short and rare)
+ */
+uint16_t frame_crc16(const uint8_t *data, size_t len, uint16_t crc){
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+SyncSession::SyncSession(){
+    this->count   = 0;
+    this->total   = 0;
+    this->acked   = 0;
+    this->session = 0;
+    this->retries = 0;
+    this->sent_ms = 0;
+}
+
+/**
+ * @brief Start a new session, dropping any unfinished one
+ *
+ * @param total Number of frames that will be added, at most SYNC_FRAMES_MAX
+ * @return uint16_t Session id to announce, never 0
+ */
+uint16_t SyncSession::begin(uint8_t total){
+    this->session++;
+    if (this->session == 0) {
+        this->session = 1;
+    }
+    this->count   = 0;
+    this->total   = (total > SYNC_FRAMES_MAX) ? SYNC_FRAMES_MAX : total;
+    this->acked   = 0;
+    this->retries = 0;
+    return this->session;
+}
+
+/**
+ * @brief Append session, seq and total to a JSON object and add the checksum
+ *
+ * @param json Serialized JSON object, ending with '}'
+ * @return true if stored, false if the session is full or the frame too long
+ */
+bool SyncSession::add(const char *json){
+    size_t n = strlen(json);
+    if (this->count >= this->total || n < 2 || json[n - 1] != '}') {
+        LOG_E("Sync frame %d rejected", this->count);
+        return false;
+    }
+    char *f = this->frames[this->count];
+    int len = snprintf(f, SYNC_FRAME_LEN, "%.*s%s\"session\":%u,\"seq\":%u,\"total\":%u}",
+                       (int)(n - 1), json, (n > 2) ? "," : "", this->session, this->count, this->total);
+    if (len < 0 || len + 5 >= SYNC_FRAME_LEN) {
+        LOG_E("Sync frame %d too long", this->count);
+        f[0] = '\0';
+        return false;
+    }
+    snprintf(f + len, SYNC_FRAME_LEN - len, "*%04X", frame_crc16((const uint8_t *)f, len));
+    this->count++;
+    return true;
+}
+
+/**
+ * @brief Record that frames were queued, restarts the retry timeout
+ */
+void SyncSession::sent(uint32_t now){
+    this->sent_ms = now;
+}
+
+/**
+ * @brief Apply a host acknowledgement
+ *
+ * @param session Session id echoed by the host
+ * @param missing Frames the host did not receive (bit n = seq n), 0 = complete
+ * @return true if the session matches, the missing frames are then due for resend
+ */
+bool SyncSession::ack(uint16_t session, uint8_t missing){
+    if (session != this->session || this->count == 0) {
+        LOG_W("Ack for unknown sync session %u", session);
+        return false;
+    }
+    this->acked   = this->all() & ~missing;
+    this->retries = 0;
+    if (!this->active()) {
+        LOG_I("Sync session %u complete", session);
+    }
+    return true;
+}
+
+/**
+ * @brief Frames to resend because no acknowledgement arrived in time
+ *
+ * The session is abandoned after SYNC_MAX_RETRIES resends.
+ *
+ * @return uint8_t Mask of frames to resend, the caller then calls sent()
+ */
+uint8_t SyncSession::due(uint32_t now){
+    if (!this->active() || (now - this->sent_ms) < SYNC_RETRY_TIMEOUT) {
+        return 0;
+    }
+    if (this->retries >= SYNC_MAX_RETRIES) {
+        LOG_E("Sync session %u not acknowledged, dropped", this->session);
+        this->acked = this->all();
+        return 0;
+    }
+    this->retries++;
+    return this->all() & ~this->acked;
+}
+
+bool SyncSession::active() const{
+    return (this->acked & this->all()) != this->all();
+}
+
+uint8_t SyncSession::all() const{
+    return (uint8_t)((1u << this->count) - 1);
+}
+
+uint16_t SyncSession::id() const{
+    return this->session;
+}
+
+const char *SyncSession::frame(uint8_t seq) const{
+    return (seq < this->count) ? this->frames[seq] : nullptr;
+}
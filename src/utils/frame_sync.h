@@ -0,0 +1,59 @@
+/**
+ * @file frame_sync.h
+ * @brief Sequenced, checksummed frame sets with selective retransmission.
+ *
+ * A session holds a small set of JSON frames that the host must receive
+ * completely (the configuration read-back of "sync"). Each frame is sent once,
+ * tagged with its position and a CRC:
+ *
+ *   {"command":"config",...,"session":7,"seq":0,"total":2}*3F1A
+ *
+ * The "*XXXX" suffix is the CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of
+ * the JSON text before the '*', in upper-case hex. The host acknowledges with
+ * the list of frames it is missing (empty when complete) and only those are
+ * sent again. Without an acknowledgement, due() hands out the unacknowledged
+ * frames again after SYNC_RETRY_TIMEOUT, at most SYNC_MAX_RETRIES times.
+ *
+ * Like the timer wheel, the session never reads a clock: callers pass the
+ * current time.
+ */
+
+#ifndef _FRAME_SYNC_H_
+#define _FRAME_SYNC_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SYNC_FRAMES_MAX         4           // Frames in one session, bits of the masks below
+#define SYNC_FRAME_LEN          640         // Longest frame, including tags and checksum
+#define SYNC_RETRY_TIMEOUT      1000        // Resend unacknowledged frames after this (ms)
+#define SYNC_MAX_RETRIES        5           // Timeout resends before the session is dropped
+
+// CRC-16/CCITT-FALSE of a buffer, pass the previous result as crc to continue it
+uint16_t frame_crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+class SyncSession{
+private:
+    char        frames[SYNC_FRAMES_MAX][SYNC_FRAME_LEN];
+    uint8_t     count;              // Frames added
+    uint8_t     total;              // Frames announced by begin()
+    uint8_t     acked;              // Bit n set = frame n received by the host
+    uint16_t    session;            // Current session id, 0 = none yet
+    uint8_t     retries;            // Timeout resends so far
+    uint32_t    sent_ms;            // Last time frames were handed out
+
+public:
+    SyncSession();
+
+    uint16_t    begin(uint8_t total);               // Start a session of total frames, returns its id
+    bool        add(const char *json);              // Tag and store the next frame
+    void        sent(uint32_t now);                 // Frames were queued for the port
+    bool        ack(uint16_t session, uint8_t missing);
+    uint8_t     due(uint32_t now);                  // Frames to resend after a timeout, 0 = none
+    bool        active() const;                     // Frames still unacknowledged
+    uint8_t     all() const;                        // Mask of every frame added
+    uint16_t    id() const;
+    const char *frame(uint8_t seq) const;           // Tagged frame, nullptr if seq was not added
+};
+
+#endif
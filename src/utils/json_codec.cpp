@@ -0,0 +1,189 @@
+#include "json_codec.h"
+#include "logger.h"
+#include <math.h>
+
+/**
+ * @brief Read one field of src as a float in JSON units
+ *
+ * @param field Field descriptor
+ * @param src   Struct described by the table
+ * @return float Value multiplied by the field scale, 0 for strings
+ */
+float json_codec_value(const json_field_t *field, const void *src){
+    const uint8_t *p = (const uint8_t *)src + field->offset;
+    float v = 0;
+    switch (field->type) {
+        case JSON_FIELD_INT:    v = (float)*(const int *)p;      break;
+        case JSON_FIELD_INT16:  v = (float)*(const int16_t *)p;  break;
+        case JSON_FIELD_UINT16: v = (float)*(const uint16_t *)p; break;
+        case JSON_FIELD_FLOAT:  v = *(const float *)p;           break;
+        case JSON_FIELD_BOOL:   v = *(const bool *)p ? 1 : 0;    break;
+        default:                                                 break;
+    }
+    return v * field->scale;
+}
+
+/**
+ * @brief Fill a struct from a JSON object
+ *
+ * Every non-optional field must be present with the right JSON type and
+ * inside [min, max]. Fields are written as they are checked, so on failure
+ * dst may be partially updated.
+ *
+ * @param root   JSON object holding the fields (and their group objects)
+ * @param fields Field table
+ * @param count  Number of fields
+ * @param dst    Struct described by the table
+ * @return true if every field was accepted
+ */
+bool json_codec_read(JsonObjectConst root, const json_field_t *fields, size_t count, void *dst){
+    for (size_t i = 0; i < count; i++) {
+        const json_field_t *f = &fields[i];
+        JsonVariantConst v = (f->group != nullptr) ? root[f->group][f->name] : root[f->name];
+        uint8_t *p = (uint8_t *)dst + f->offset;
+
+        if (v.isNull()) {
+            if (f->flags & JSON_FIELD_OPTIONAL) {
+                continue;
+            }
+            LOG_E("Missing field '%s%s%s'", f->group ? f->group : "", f->group ? "." : "", f->name);
+            return false;
+        }
+
+        if (f->type == JSON_FIELD_STR) {
+            if (!v.is<const char*>()) {
+                LOG_E("Field '%s' must be a string", f->name);
+                return false;
+            }
+            strlcpy((char *)p, v.as<const char*>(), f->size);
+            continue;
+        }
+        if (f->type == JSON_FIELD_BOOL) {
+            if (!v.is<bool>()) {
+                LOG_E("Field '%s' must be a boolean", f->name);
+                return false;
+            }
+            *(bool *)p = v.as<bool>();
+            continue;
+        }
+
+        if (!v.is<float>()) {
+            LOG_E("Field '%s' must be a number", f->name);
+            return false;
+        }
+        float x = v.as<float>();
+        if (x < f->min || x > f->max) {
+            LOG_E("Field '%s' out of range [%.0f, %.0f]", f->name, f->min, f->max);
+            return false;
+        }
+        float raw = x / f->scale;
+        switch (f->type) {
+            case JSON_FIELD_INT:    *(int *)p      = (int)lroundf(raw);      break;
+            case JSON_FIELD_INT16:  *(int16_t *)p  = (int16_t)lroundf(raw);  break;
+            case JSON_FIELD_UINT16: *(uint16_t *)p = (uint16_t)lroundf(raw); break;
+            case JSON_FIELD_FLOAT:  *(float *)p    = raw;                    break;
+            default:                                                         break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Add the fields of a struct to a JSON object
+ *
+ * @param root   Target JSON object, group objects are created on first use
+ * @param fields Field table
+ * @param count  Number of fields
+ * @param src    Struct described by the table
+ */
+void json_codec_write(JsonObject root, const json_field_t *fields, size_t count, const void *src){
+    for (size_t i = 0; i < count; i++) {
+        const json_field_t *f = &fields[i];
+        if (f->flags & JSON_FIELD_WRITE_ONLY) {
+            continue;
+        }
+        JsonObject obj = root;
+        if (f->group != nullptr) {
+            obj = root[f->group];
+            if (obj.isNull()) {
+                obj = root.createNestedObject(f->group);
+            }
+        }
+        const uint8_t *p = (const uint8_t *)src + f->offset;
+
+        if (f->type == JSON_FIELD_STR) {
+            obj[f->name] = String((const char *)p);     // Copied into the document
+            continue;
+        }
+        if (f->type == JSON_FIELD_BOOL) {
+            obj[f->name] = *(const bool *)p;
+            continue;
+        }
+
+        float v = json_codec_value(f, src);
+        if (f->flags & JSON_FIELD_AS_STRING) {
+            obj[f->name] = (f->decimals > 0) ? String(v, (unsigned char)f->decimals) : String((long)lroundf(v));
+        }
+        else if (f->type == JSON_FIELD_FLOAT || f->scale != 1.0f) {
+            float pow10 = 1.0f;
+            for (uint8_t d = 0; d < f->decimals; d++) {
+                pow10 *= 10.0f;
+            }
+            obj[f->name] = roundf(v * pow10) / pow10;
+        }
+        else {
+            obj[f->name] = (long)lroundf(v);
+        }
+    }
+}
+
+/**
+ * @brief Construct an empty hash, begin() must be called before find()
+ */
+CommandHash::CommandHash(){
+    this->names = nullptr;
+    this->count = 0;
+    this->seed  = 0;
+    memset(this->slots, COMMAND_HASH_EMPTY, sizeof(this->slots));
+}
+
+/**
+ * @brief Build the hash for a fixed list of names
+ *
+ * @param names Command names, must stay valid (usually a constant table)
+ * @param count Number of names, less than COMMAND_HASH_SLOTS
+ * @param seed  command_hash_seed(names, count), checked by a static_assert
+ * @return true if every name got its own slot; false leaves the table empty
+ */
+bool CommandHash::begin(const char *const *names, uint8_t count, uint8_t seed){
+    this->names = names;
+    this->count = count;
+    this->seed  = seed;
+    memset(this->slots, COMMAND_HASH_EMPTY, sizeof(this->slots));
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t h = command_hash_slot(names[i], seed);
+        if (count >= COMMAND_HASH_SLOTS || this->slots[h] != COMMAND_HASH_EMPTY) {
+            LOG_E("Hash seed %u does not fit %u commands", seed, count);
+            memset(this->slots, COMMAND_HASH_EMPTY, sizeof(this->slots));
+            return false;
+        }
+        this->slots[h] = i;
+    }
+    return true;
+}
+
+/**
+ * @brief Look up a command name
+ *
+ * @return int Index of the name in the table given to begin(), -1 if unknown
+ */
+int CommandHash::find(const char *name) const{
+    if (this->names == nullptr || name == nullptr) {
+        return -1;
+    }
+    uint8_t i = this->slots[command_hash_slot(name, this->seed)];
+    if (i == COMMAND_HASH_EMPTY || strcmp(this->names[i], name) != 0) {
+        return -1;
+    }
+    return i;
+}
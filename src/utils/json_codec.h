@@ -0,0 +1,116 @@
+/**
+ * @file json_codec.h
+ * @brief Table-driven JSON <-> C struct codec.
+ *
+ * A struct is described once by a constant json_field_t table (JSON key,
+ * offsetof() into the struct, storage type, scale and accepted range). The
+ * same table drives json_codec_read() and json_codec_write(), so adding a
+ * field to the protocol is a single table line.
+ *
+ * CommandHash maps command names to their table index with one hash and one
+ * string compare, instead of walking a strcmp() chain. Its seed is searched
+ * at build time with command_hash_seed(), so a name list without a
+ * collision-free seed fails to compile instead of rejecting every command.
+ */
+
+#ifndef _JSON_CODEC_H_
+#define _JSON_CODEC_H_
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+
+typedef enum {
+    JSON_FIELD_INT = 0,     // int
+    JSON_FIELD_INT16,       // int16_t
+    JSON_FIELD_UINT16,      // uint16_t
+    JSON_FIELD_FLOAT,       // float
+    JSON_FIELD_BOOL,        // bool
+    JSON_FIELD_STR,         // char[size]
+} json_field_type_t;
+
+#define JSON_FIELD_AS_STRING    0x01        // Serialize a number as a fixed-decimal string
+#define JSON_FIELD_OPTIONAL     0x02        // May be absent when parsing
+#define JSON_FIELD_WRITE_ONLY   0x04        // Parsed from commands, never serialized
+
+typedef struct {
+    const char *group;      // Enclosing object key, nullptr = top level
+    const char *name;       // JSON key
+    uint16_t    offset;     // Offset of the member in the C struct
+    uint8_t     type;       // json_field_type_t
+    uint8_t     size;       // Member size, buffer size for JSON_FIELD_STR
+    uint8_t     decimals;   // Decimals kept when serializing floats
+    uint8_t     flags;      // JSON_FIELD_* flags
+    float       scale;      // JSON value = C value * scale
+    float       min;        // Accepted JSON range when parsing
+    float       max;
+} json_field_t;
+
+/**
+ * @brief Describe one struct member
+ *
+ * JSON_FIELD(group, "key", struct_type, member, JSON_FIELD_xxx, scale, min, max, decimals, flags)
+ */
+#define JSON_FIELD(GROUP, NAME, TYPE, MEMBER, JTYPE, SCALE, MIN, MAX, DECIMALS, FLAGS) \
+    { GROUP, NAME, (uint16_t)offsetof(TYPE, MEMBER), JTYPE, (uint8_t)sizeof(((TYPE *)0)->MEMBER), \
+      DECIMALS, FLAGS, SCALE, MIN, MAX }
+
+#define JSON_FIELD_COUNT(TABLE)     (sizeof(TABLE) / sizeof((TABLE)[0]))
+
+// Fill dst from root, fails on the first missing, mistyped or out-of-range field
+bool json_codec_read(JsonObjectConst root, const json_field_t *fields, size_t count, void *dst);
+// Add every field of src to root, creating group objects as needed
+void json_codec_write(JsonObject root, const json_field_t *fields, size_t count, const void *src);
+// Read one field of src as a float in JSON units
+float json_codec_value(const json_field_t *field, const void *src);
+
+#define COMMAND_HASH_SLOTS      64          // Hash table size, power of two, about 4x the number of commands
+#define COMMAND_HASH_EMPTY      0xFF
+
+// Seeded FNV-1a folded to a slot, the same function at build time and at run time
+constexpr uint32_t command_hash_fnv(const char *s, uint32_t h) {
+    return (*s == '\0') ? h : command_hash_fnv(s + 1, (h ^ (uint8_t)*s) * 16777619u);
+}
+constexpr uint8_t command_hash_fold(uint32_t h) {
+    return (uint8_t)((h ^ (h >> 16)) & (COMMAND_HASH_SLOTS - 1));
+}
+constexpr uint8_t command_hash_slot(const char *name, uint8_t seed) {
+    return command_hash_fold(command_hash_fnv(name, 2166136261u ^ seed));
+}
+
+// names[i] shares its slot with one of names[j..count-1]
+constexpr bool command_hash_clash(const char *const *names, uint8_t count, uint8_t seed, uint8_t i, uint8_t j) {
+    return j < count && (command_hash_slot(names[i], seed) == command_hash_slot(names[j], seed) ||
+                         command_hash_clash(names, count, seed, i, j + 1));
+}
+constexpr bool command_hash_perfect(const char *const *names, uint8_t count, uint8_t seed, uint8_t i = 0) {
+    return i >= count || (!command_hash_clash(names, count, seed, i, i + 1) &&
+                          command_hash_perfect(names, count, seed, i + 1));
+}
+// First seed placing every name in its own slot, -1 if none; use in a static_assert
+constexpr int command_hash_seed(const char *const *names, uint8_t count, int seed = 0) {
+    return (seed > 255 || count >= COMMAND_HASH_SLOTS) ? -1 :
+           command_hash_perfect(names, count, (uint8_t)seed) ? seed : command_hash_seed(names, count, seed + 1);
+}
+
+/**
+ * @brief Perfect hash over a fixed set of command names
+ *
+ * begin() takes the seed found by command_hash_seed(), every name lands in
+ * its own slot, so find() costs one hash and one strcmp() whatever the
+ * number of commands.
+ */
+class CommandHash{
+private:
+    const char *const *names;
+    uint8_t            count;
+    uint8_t            seed;
+    uint8_t            slots[COMMAND_HASH_SLOTS];
+
+public:
+    CommandHash();
+
+    bool begin(const char *const *names, uint8_t count, uint8_t seed);
+    int  find(const char *name) const;  // Index into names, -1 if unknown
+};
+
+#endif
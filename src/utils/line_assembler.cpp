@@ -0,0 +1,132 @@
+#include "line_assembler.h"
+
+// Byte pushed by the producer after an overflow: tells the consumer to drop the
+// partial line it is holding. Never part of a valid JSON command.
+#define LINE_ASM_ABORT          0x00
+
+/**
+ * @brief Construct an empty assembler
+ *
+ * @param terminator Line terminator, '\r' is always ignored
+ */
+LineAssembler::LineAssembler(char terminator){
+    this->head           = 0;
+    this->rx_bytes       = 0;
+    this->overflow_bytes = 0;
+    this->resync         = false;
+    this->tail           = 0;
+    this->len            = 0;
+    this->oversize       = false;
+    this->lines          = 0;
+    this->oversize_lines = 0;
+    this->overflow_lines = 0;
+    this->terminator     = terminator;
+    this->line[0]        = '\0';
+}
+
+bool LineAssembler::put(uint8_t c){
+    uint32_t h = this->head;
+    if ((h - this->tail) >= LINE_ASM_RING_SIZE) {
+        return false;
+    }
+    this->ring[h & (LINE_ASM_RING_SIZE - 1)] = c;
+    __sync_synchronize();           // Publish the byte before the index
+    this->head = h + 1;
+    return true;
+}
+
+/**
+ * @brief Append received bytes to the ring
+ *
+ * When the ring is full the remaining bytes of the current line are discarded
+ * up to its terminator, which is replaced by an abort marker once there is room
+ * again, so the consumer drops the damaged line instead of parsing it.
+ *
+ * @param data Received bytes
+ * @param n    Number of bytes
+ * @return size_t Number of bytes accepted
+ */
+size_t LineAssembler::push(const uint8_t *data, size_t n){
+    size_t accepted = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = data[i];
+        if (this->resync) {
+            if (c == (uint8_t)this->terminator && this->put(LINE_ASM_ABORT)) {
+                this->resync = false;
+            }
+            this->overflow_bytes = this->overflow_bytes + 1;
+            continue;
+        }
+        if (this->put(c)) {
+            accepted++;
+        }
+        else {
+            this->overflow_bytes = this->overflow_bytes + 1;
+            this->resync = (c != (uint8_t)this->terminator) || !this->put(LINE_ASM_ABORT);
+        }
+    }
+    this->rx_bytes = this->rx_bytes + accepted;
+    return accepted;
+}
+
+/**
+ * @brief Assemble buffered bytes and return the next complete line
+ *
+ * @param length Optional output for the line length
+ * @return const char* NUL-terminated line, nullptr if no complete line is buffered
+ */
+const char *LineAssembler::poll(size_t *length){
+    while (this->tail != this->head) {
+        __sync_synchronize();       // Read the index before the byte it publishes
+        uint32_t t = this->tail;
+        uint8_t  c = this->ring[t & (LINE_ASM_RING_SIZE - 1)];
+        this->tail = t + 1;
+
+        if (c == LINE_ASM_ABORT) {
+            this->overflow_lines++;
+            this->len      = 0;
+            this->oversize = false;
+            continue;
+        }
+        if (c == (uint8_t)this->terminator) {
+            bool drop = this->oversize;
+            if (drop) {
+                this->oversize_lines++;
+            }
+            uint16_t n     = this->len;
+            this->len      = 0;
+            this->oversize = false;
+            if (drop || n == 0) {
+                continue;           // Oversize or empty line
+            }
+            this->line[n] = '\0';
+            this->lines++;
+            if (length != nullptr) {
+                *length = n;
+            }
+            return this->line;
+        }
+        if (c == '\r') {
+            continue;
+        }
+        if (this->len < LINE_ASM_MAX_LEN) {
+            this->line[this->len++] = (char)c;
+        }
+        else {
+            this->oversize = true;
+        }
+    }
+    return nullptr;
+}
+
+size_t LineAssembler::available() const{
+    return (size_t)(this->head - this->tail);
+}
+
+void LineAssembler::get_stats(line_stats_t *stats) const{
+    stats->rx_bytes       = this->rx_bytes;
+    stats->overflow_bytes = this->overflow_bytes;
+    stats->lines          = this->lines;
+    stats->oversize_lines = this->oversize_lines;
+    stats->overflow_lines = this->overflow_lines;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file line_assembler.h
+ * @brief Lock-free receive ring and fixed-size line assembler for the command port.
+ *
+ * The producer (UART RX interrupt or USB CDC receive callback) pushes raw bytes
+ * into a single-producer/single-consumer ring. The consumer (main loop) pulls
+ * complete, NUL-terminated lines out of it without touching the heap.
+ *
+ * Lines longer than LINE_ASM_MAX_LEN and lines that lost bytes because the
+ * ring was full are dropped as a whole, so a truncated JSON fragment is never
+ * handed to the command parser. Both cases are counted in line_stats_t.
+ */
+
+#ifndef _LINE_ASSEMBLER_H_
+#define _LINE_ASSEMBLER_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LINE_ASM_RING_SIZE      1024        // Receive ring size in bytes, power of two
+#define LINE_ASM_MAX_LEN        1024        // Longest accepted line, a config + advance batch is ~700 bytes
+
+typedef struct {
+    uint32_t    rx_bytes;           // Bytes accepted into the ring
+    uint32_t    overflow_bytes;     // Bytes lost because the ring was full
+    uint32_t    lines;              // Complete lines delivered
+    uint32_t    oversize_lines;     // Lines dropped for exceeding LINE_ASM_MAX_LEN
+    uint32_t    overflow_lines;     // Lines dropped because some of their bytes were lost
+} line_stats_t;
+
+class LineAssembler{
+private:
+    // Producer side, written only from push()
+    uint8_t           ring[LINE_ASM_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t rx_bytes;
+    volatile uint32_t overflow_bytes;
+    bool              resync;       // Dropping the rest of a line that overflowed
+
+    // Consumer side, written only from poll()
+    volatile uint32_t tail;
+    char              line[LINE_ASM_MAX_LEN + 1];
+    uint16_t          len;
+    bool              oversize;     // Current line exceeded LINE_ASM_MAX_LEN
+    uint32_t          lines;
+    uint32_t          oversize_lines;
+    uint32_t          overflow_lines;
+
+    char              terminator;
+
+    bool put(uint8_t c);
+
+public:
+    LineAssembler(char terminator = '\n');
+
+    // Producer: safe to call from an interrupt or callback, never blocks
+    size_t push(const uint8_t *data, size_t n);
+
+    // Consumer: return the next complete line or nullptr, valid until the next poll()
+    const char *poll(size_t *length = nullptr);
+    size_t available() const;       // Bytes waiting in the ring
+
+    void get_stats(line_stats_t *stats) const;
+};
+
+#endif
@@ -9,7 +9,12 @@
 
 #ifndef _LOGGER_H_
 #define _LOGGER_H_
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stdint.h>                 // Host builds (env:native), no Serial2
+#include <stdio.h>
+#endif
 #include <cstring>
 
 /**
@@ -0,0 +1,38 @@
+#include "sysclock.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+
+uint32_t ArduinoClock::millis(){
+    return ::millis();
+}
+
+uint32_t ArduinoClock::micros(){
+    return ::micros();
+}
+
+void ArduinoClock::delay(uint32_t ms){
+    ::delay(ms);
+}
+
+void ArduinoClock::delay_us(uint32_t us){
+    ::delayMicroseconds(us);
+}
+
+static ArduinoClock default_clock;
+#else
+static VirtualClock default_clock;
+#endif
+
+namespace sysclk{
+
+static Clock *current = &default_clock;
+
+void set(Clock *clock){
+    current = (clock != nullptr) ? clock : &default_clock;
+}
+
+Clock *get(){
+    return current;
+}
+
+} // namespace sysclk
@@ -0,0 +1,71 @@
+/**
+ * @file sysclock.h
+ * @brief Injectable time source for the driver and application code.
+ *
+ * All timing (millis, micros, delay, delayMicroseconds) goes through the clock
+ * installed with sysclk::set(). On target the default is ArduinoClock, which
+ * maps straight to the Arduino calls. Off target the default is VirtualClock,
+ * where delays advance simulated time instantly, so a multi-second DataFlash
+ * sequence completes in microseconds of wall time while still reporting its
+ * simulated latency through millis()/micros().
+ */
+
+#ifndef _SYSCLOCK_H_
+#define _SYSCLOCK_H_
+#include <stdint.h>
+
+class Clock{
+public:
+    virtual ~Clock() {}
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+    virtual void     delay(uint32_t ms) = 0;
+    virtual void     delay_us(uint32_t us) = 0;
+};
+
+#ifdef ARDUINO
+/**
+ * @brief Clock backed by the Arduino core timing functions
+ */
+class ArduinoClock : public Clock{
+public:
+    uint32_t millis() override;
+    uint32_t micros() override;
+    void     delay(uint32_t ms) override;
+    void     delay_us(uint32_t us) override;
+};
+#endif
+
+/**
+ * @brief Simulated clock, delays advance time instantly
+ */
+class VirtualClock : public Clock{
+private:
+    uint64_t now_us;
+public:
+    VirtualClock() : now_us(0) {}
+    uint32_t millis() override { return (uint32_t)(now_us / 1000); }
+    uint32_t micros() override { return (uint32_t)now_us; }
+    void     delay(uint32_t ms) override { now_us += (uint64_t)ms * 1000; }
+    void     delay_us(uint32_t us) override { now_us += us; }
+
+    void     advance_ms(uint32_t ms) { now_us += (uint64_t)ms * 1000; }
+    void     set_ms(uint64_t ms) { now_us = ms * 1000; }
+    uint64_t elapsed_us() const { return now_us; }
+};
+
+namespace sysclk
+{
+    /**
+     * @brief Install the clock used by all timing calls, nullptr restores the default
+     */
+    void   set(Clock *clock);
+    Clock *get();
+
+    inline uint32_t millis()             { return get()->millis(); }
+    inline uint32_t micros()             { return get()->micros(); }
+    inline void     delay(uint32_t ms)   { get()->delay(ms); }
+    inline void     delay_us(uint32_t us){ get()->delay_us(us); }
+}
+
+#endif
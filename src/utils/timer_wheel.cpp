@@ -0,0 +1,161 @@
+#include <stddef.h>
+#include "timer_wheel.h"
+
+#define TICK_MASK   (0xFFFFFFFFu / TIMER_WHEEL_TICK_MS)    // Tick numbers wrap together with millis()
+
+/**
+ * @brief Construct an empty wheel
+ */
+TimerWheel::TimerWheel(){
+    for (uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        this->slots[i] = nullptr;
+    }
+    this->cursor = 0;
+    this->pass   = 0;
+}
+
+/**
+ * @brief Align the wheel cursor with the current time
+ *
+ * @param now_ms Current time in milliseconds
+ */
+void TimerWheel::begin(uint32_t now_ms){
+    this->cursor = now_ms / TIMER_WHEEL_TICK_MS;
+}
+
+void TimerWheel::link(timer_node_t *t){
+    uint32_t tick = t->deadline / TIMER_WHEEL_TICK_MS;
+    if ((int32_t)(t->deadline - this->cursor * TIMER_WHEEL_TICK_MS) < 0) {
+        tick = this->cursor; // Already due, make sure the next sweep sees it
+    }
+    timer_node_t **slot = &this->slots[tick % TIMER_WHEEL_SLOTS];
+    t->next  = *slot;
+    *slot    = t;
+    t->armed = true;
+}
+
+void TimerWheel::unlink(timer_node_t *t){
+    for (uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        for (timer_node_t **pp = &this->slots[i]; *pp != nullptr; pp = &(*pp)->next) {
+            if (*pp == t) {
+                *pp      = t->next;
+                t->next  = nullptr;
+                t->armed = false;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Arm a timer
+ *
+ * Periodic timers reload from their previous deadline, not from the time the
+ * callback ran, so a slow job does not make the schedule drift.
+ *
+ * @param t         Caller-owned timer node, must stay valid while armed
+ * @param now_ms    Current time in milliseconds
+ * @param delay_ms  Delay until the first expiry
+ * @param period_ms Reload period, 0 for a one-shot timer
+ * @param cb        Callback run from run()
+ * @param arg       Callback argument
+ */
+void TimerWheel::start(timer_node_t *t, uint32_t now_ms, uint32_t delay_ms, uint32_t period_ms,
+                       timer_cb_t cb, void *arg){
+    if (t->armed) {
+        this->unlink(t);
+    }
+    t->cb       = cb;
+    t->arg      = arg;
+    t->period   = period_ms;
+    t->deadline = now_ms + delay_ms;
+    this->link(t);
+}
+
+/**
+ * @brief Re-arm a timer with a new first deadline, keeping callback and period
+ */
+void TimerWheel::restart(timer_node_t *t, uint32_t now_ms, uint32_t delay_ms){
+    if (t->armed) {
+        this->unlink(t);
+    }
+    t->deadline = now_ms + delay_ms;
+    this->link(t);
+}
+
+/**
+ * @brief Disarm a timer, no-op if it is not armed
+ */
+void TimerWheel::stop(timer_node_t *t){
+    if (t->armed) {
+        this->unlink(t);
+    }
+}
+
+/**
+ * @brief Fire all expired timers
+ *
+ * Sweeps the slots between the last processed tick and now (at most one full
+ * revolution after a long sleep). Callbacks may start, restart or stop any
+ * timer, including their own. A timer fires at most once per call: one that
+ * is re-armed already due from its own callback stays armed for the next
+ * run() instead of looping here, and next_deadline_in() reports it as due.
+ *
+ * @param now_ms Current time in milliseconds
+ * @return uint32_t Milliseconds until the next deadline, TIMER_WHEEL_IDLE_MS if none
+ */
+uint32_t TimerWheel::run(uint32_t now_ms){
+    uint32_t now_tick = now_ms / TIMER_WHEEL_TICK_MS;
+    uint32_t ticks    = (now_tick - this->cursor) & TICK_MASK;
+    uint32_t sweep    = (ticks >= TIMER_WHEEL_SLOTS) ? TIMER_WHEEL_SLOTS : ticks + 1;
+    uint32_t first    = (ticks >= TIMER_WHEEL_SLOTS) ? 0 : this->cursor;
+    this->cursor = now_tick;
+    this->pass++;
+
+    for (uint32_t n = 0; n < sweep; n++) {
+        timer_node_t **slot = &this->slots[(first + n) % TIMER_WHEEL_SLOTS];
+        timer_node_t **pp   = slot;
+        while (*pp != nullptr) {
+            timer_node_t *t = *pp;
+            if ((int32_t)(t->deadline - now_ms) > 0 || t->pass == this->pass) {
+                pp = &t->next;
+                continue;
+            }
+            // Expired: unlink, reload periodic timers on their own phase, then fire
+            *pp      = t->next;
+            t->next  = nullptr;
+            t->armed = false;
+            t->pass  = this->pass;
+            if (t->period != 0) {
+                uint32_t late = now_ms - t->deadline;
+                t->deadline  += t->period * (late / t->period + 1);
+                this->link(t);
+            }
+            if (t->cb != nullptr) {
+                t->cb(t->arg);
+            }
+            pp = slot; // The callback may have changed this slot, rescan from its head
+        }
+    }
+    return this->next_deadline_in(now_ms);
+}
+
+/**
+ * @brief Milliseconds until the earliest armed deadline
+ *
+ * @param now_ms Current time in milliseconds
+ * @return uint32_t 0 if a timer is already due, TIMER_WHEEL_IDLE_MS if none is armed
+ */
+uint32_t TimerWheel::next_deadline_in(uint32_t now_ms) const{
+    uint32_t best = TIMER_WHEEL_IDLE_MS;
+    for (uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        for (const timer_node_t *t = this->slots[i]; t != nullptr; t = t->next) {
+            int32_t left = (int32_t)(t->deadline - now_ms);
+            uint32_t in  = (left > 0) ? (uint32_t)left : 0;
+            if (in < best) {
+                best = in;
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hashed deadline timer wheel for periodic and one-shot jobs.
+ *
+ * The wheel never reads a clock itself: every call takes the current time in
+ * milliseconds, so the same code runs against millis() on target and against
+ * a virtual clock on host.
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMER_WHEEL_SLOTS       32          // Number of wheel slots, power of two
+#define TIMER_WHEEL_TICK_MS     16          // Slot resolution in milliseconds, power of two
+#define TIMER_WHEEL_IDLE_MS     0xFFFFFFFFu // Returned by run() when no timer is armed
+
+typedef void (*timer_cb_t)(void *arg);
+
+typedef struct timer_node {
+    struct timer_node *next;        // Next node in the same slot
+    uint32_t           deadline;    // Absolute expiry time (ms)
+    uint32_t           period;      // Reload period (ms), 0 = one-shot
+    timer_cb_t         cb;          // Job callback
+    void              *arg;         // Callback argument
+    bool               armed;       // Linked into the wheel
+    uint32_t           pass;        // run() pass that last fired it
+} timer_node_t;
+
+class TimerWheel{
+private:
+    timer_node_t *slots[TIMER_WHEEL_SLOTS];
+    uint32_t      cursor;           // Last processed tick (now / TIMER_WHEEL_TICK_MS)
+    uint32_t      pass;             // Incremented by every run()
+
+    void link(timer_node_t *t);
+    void unlink(timer_node_t *t);
+
+public:
+    TimerWheel();
+
+    void begin(uint32_t now_ms);
+
+    // Arm a timer to fire delay_ms from now, then every period_ms (0 = once)
+    void start(timer_node_t *t, uint32_t now_ms, uint32_t delay_ms, uint32_t period_ms,
+               timer_cb_t cb, void *arg);
+    // Move an armed or idle timer to a new deadline, keeping its callback and period
+    void restart(timer_node_t *t, uint32_t now_ms, uint32_t delay_ms);
+    void stop(timer_node_t *t);
+
+    // Fire every expired timer, return milliseconds until the next deadline
+    uint32_t run(uint32_t now_ms);
+    uint32_t next_deadline_in(uint32_t now_ms) const;
+};
+
+#endif
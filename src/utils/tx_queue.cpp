@@ -0,0 +1,147 @@
+#include "tx_queue.h"
+
+#define TX_EOL          "\r\n"
+#define TX_EOL_LEN      2
+
+/**
+ * @brief Construct an empty queue, begin() must be called before drain()
+ */
+TxQueue::TxQueue(){
+    this->port       = nullptr;
+    this->head       = 0;
+    this->tail       = 0;
+    this->tele_count = 0;
+    this->tele_pos   = 0;
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+/**
+ * @brief Attach the output port
+ *
+ * @param port Serial port, must implement availableForWrite()
+ */
+void TxQueue::begin(Print *port){
+    this->port = port;
+}
+
+void TxQueue::tele_remove(uint8_t index){
+    for (uint8_t i = index; i + 1 < this->tele_count; i++) {
+        memcpy(this->tele[i], this->tele[i + 1], this->tele_len[i + 1]);
+        this->tele_len[i] = this->tele_len[i + 1];
+    }
+    this->tele_count--;
+}
+
+/**
+ * @brief Queue one line for transmission
+ *
+ * @param line NUL-terminated line without line ending
+ * @param cls  Traffic class, see tx_class_t
+ * @return true if queued, false if a response did not fit (retry after drain())
+ *         or a telemetry line was too long
+ */
+bool TxQueue::send(const char *line, tx_class_t cls){
+    size_t n = strlen(line);
+
+    if (cls == TX_TELEMETRY) {
+        if (n + TX_EOL_LEN > TX_TELEMETRY_LEN) {
+            this->stats.telemetry_dropped++;
+            return false;
+        }
+        if (this->tele_count == TX_TELEMETRY_SLOTS) {
+            // Drop the oldest line that is not partially on the wire
+            uint8_t victim = (this->tele_pos != 0) ? 1 : 0;
+            this->stats.telemetry_dropped++;
+            if (victim >= this->tele_count) {
+                return false;               // Single slot busy, the new line is the one dropped
+            }
+            this->tele_remove(victim);
+        }
+        char *slot = this->tele[this->tele_count];
+        memcpy(slot, line, n);
+        memcpy(slot + n, TX_EOL, TX_EOL_LEN);
+        this->tele_len[this->tele_count++] = (uint16_t)(n + TX_EOL_LEN);
+        this->stats.lines++;
+        return true;
+    }
+
+    if (n + TX_EOL_LEN > TX_QUEUE_SIZE - (this->head - this->tail)) {
+        this->stats.backpressure++;
+        return false;
+    }
+    const uint8_t *src = (const uint8_t *)line;
+    for (size_t i = 0; i < n; i++) {
+        this->ring[this->head++ & (TX_QUEUE_SIZE - 1)] = src[i];
+    }
+    this->ring[this->head++ & (TX_QUEUE_SIZE - 1)] = '\r';
+    this->ring[this->head++ & (TX_QUEUE_SIZE - 1)] = '\n';
+    this->stats.lines++;
+    return true;
+}
+
+/**
+ * @brief Move queued bytes to the port without blocking
+ *
+ * A telemetry line already started is finished first, then responses, then
+ * the remaining telemetry.
+ *
+ * @return size_t Bytes still queued
+ */
+size_t TxQueue::drain(){
+    if (this->port == nullptr) {
+        return this->pending();
+    }
+    int room = this->port->availableForWrite();
+
+    while (room > 0) {
+        size_t chunk;
+        if (this->tele_pos == 0 && this->head != this->tail) {
+            uint32_t t = this->tail & (TX_QUEUE_SIZE - 1);
+            chunk = this->head - this->tail;
+            if (chunk > TX_QUEUE_SIZE - t) {
+                chunk = TX_QUEUE_SIZE - t;       // Up to the end of the ring
+            }
+            if (chunk > (size_t)room) {
+                chunk = room;
+            }
+            chunk = this->port->write(&this->ring[t], chunk);
+            this->tail += chunk;
+        }
+        else if (this->tele_count > 0) {
+            chunk = this->tele_len[0] - this->tele_pos;
+            if (chunk > (size_t)room) {
+                chunk = room;
+            }
+            chunk = this->port->write((const uint8_t *)&this->tele[0][this->tele_pos], chunk);
+            this->tele_pos += chunk;
+            if (this->tele_pos == this->tele_len[0]) {
+                this->tele_remove(0);
+                this->tele_pos = 0;
+            }
+        }
+        else {
+            break;
+        }
+        if (chunk == 0) {
+            break;
+        }
+        this->stats.bytes_sent += chunk;
+        room -= chunk;
+    }
+    return this->pending();
+}
+
+/**
+ * @brief Bytes queued and not yet written
+ */
+size_t TxQueue::pending() const{
+    size_t n = this->head - this->tail;
+    for (uint8_t i = 0; i < this->tele_count; i++) {
+        n += this->tele_len[i];
+    }
+    return n - this->tele_pos;
+}
+
+void TxQueue::get_stats(tx_stats_t *stats) const{
+    *stats = this->stats;
+}
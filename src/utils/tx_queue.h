@@ -0,0 +1,71 @@
+/**
+ * @file tx_queue.h
+ * @brief Buffered, non-blocking line transmit queue for the command port.
+ *
+ * Producers queue whole lines and return immediately, drain() later moves as
+ * many bytes as the port accepts without blocking (availableForWrite()).
+ *
+ * Two traffic classes:
+ * - TX_RESPONSE:  command responses and config read-backs, never dropped.
+ *                 send() returns false when the ring is full, the caller keeps
+ *                 the line and retries after draining (backpressure).
+ * - TX_TELEMETRY: periodic status, only the newest TX_TELEMETRY_SLOTS lines are
+ *                 kept, the oldest queued one is dropped when a new one arrives.
+ *
+ * Responses are sent before queued telemetry, lines are never interleaved.
+ * The queue is not thread-safe, callers on several tasks must serialize access.
+ */
+
+#ifndef _TX_QUEUE_H_
+#define _TX_QUEUE_H_
+#include <Arduino.h>
+
+#define TX_QUEUE_SIZE           2048        // Response ring size in bytes, power of two
+#define TX_TELEMETRY_SLOTS      2           // Telemetry lines kept, the oldest is dropped first
+#define TX_TELEMETRY_LEN        512         // Longest telemetry line, including line ending
+
+typedef enum {
+    TX_RESPONSE = 0,
+    TX_TELEMETRY,
+} tx_class_t;
+
+typedef struct {
+    uint32_t    lines;              // Lines accepted
+    uint32_t    bytes_sent;         // Bytes handed to the port
+    uint32_t    telemetry_dropped;  // Telemetry lines replaced by newer ones or too long
+    uint32_t    backpressure;       // Response send() calls refused because the ring was full
+} tx_stats_t;
+
+class TxQueue{
+private:
+    Print    *port;
+
+    uint8_t   ring[TX_QUEUE_SIZE];  // Response bytes, whole lines only
+    uint32_t  head;
+    uint32_t  tail;
+
+    char      tele[TX_TELEMETRY_SLOTS][TX_TELEMETRY_LEN];
+    uint16_t  tele_len[TX_TELEMETRY_SLOTS];
+    uint8_t   tele_count;           // Queued telemetry lines, tele[0] is the oldest
+    uint16_t  tele_pos;             // Bytes of tele[0] already written, non-zero = line in flight
+
+    tx_stats_t stats;
+
+    void tele_remove(uint8_t index);
+
+public:
+    TxQueue();
+    void begin(Print *port);
+
+    // Queue one line, the line ending is added. Never blocks.
+    bool send(const char *line, tx_class_t cls);
+    bool send(const String &line, tx_class_t cls) { return this->send(line.c_str(), cls); }
+
+    // Write what the port accepts right now, return bytes still queued
+    size_t drain();
+    size_t pending() const;
+
+    void get_stats(tx_stats_t *stats) const;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "varint.h"
+
+/**
+ * @brief Append one unsigned value
+ *
+ * @param buf Output position
+ * @param len Room left at buf
+ * @param v   Value
+ * @return size_t Bytes written, 0 if the value does not fit
+ */
+size_t varint_put(uint8_t *buf, size_t len, uint32_t v){
+    size_t n = 0;
+    do {
+        if (n == len) {
+            return 0;
+        }
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        buf[n++] = b | ((v != 0) ? 0x80 : 0);
+    } while (v != 0);
+    return n;
+}
+
+/**
+ * @brief Read one unsigned value
+ *
+ * @param buf Input position
+ * @param len Bytes left at buf
+ * @param v   Receives the value
+ * @return size_t Bytes consumed, 0 if the value is truncated or longer than VARINT_MAX_LEN
+ */
+size_t varint_get(const uint8_t *buf, size_t len, uint32_t *v){
+    uint32_t value = 0;
+    for (size_t n = 0; n < len && n < VARINT_MAX_LEN; n++) {
+        value |= (uint32_t)(buf[n] & 0x7F) << (7 * n);
+        if ((buf[n] & 0x80) == 0) {
+            *v = value;
+            return n + 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file varint.h
+ * @brief LEB128 variable-length integers and zigzag mapping for delta encoding.
+ *
+ * An unsigned value takes 7 bits per byte, low group first, the high bit of
+ * a byte set when another byte follows: 0..127 in one byte, 0..16383 in two.
+ * Signed deltas are zigzag mapped first (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+ * so small changes of either sign stay small.
+ */
+
+#ifndef _VARINT_H_
+#define _VARINT_H_
+#include <stdint.h>
+#include <stddef.h>
+
+#define VARINT_MAX_LEN      5           // Bytes of the largest 32-bit value
+
+// Append v, returns bytes written, 0 if it does not fit in len
+size_t varint_put(uint8_t *buf, size_t len, uint32_t v);
+// Read one value, returns bytes consumed, 0 on a truncated or overlong value
+size_t varint_get(const uint8_t *buf, size_t len, uint32_t *v);
+
+static inline uint32_t zigzag_encode(int32_t v){
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t v){
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * @file test_flash_log.cpp
+ * @brief FlashLog on SimFlash: ring wrap, wear counting, torn records, program failures.
+ *
+ * Run on the host with: pio test -e native -f test_flash_log
+ *
+ * Pages are 512 bytes so a page holds 31 records of 16 bytes and the ring
+ * wraps after a few hundred appends. Every record carries its own index in
+ * the first payload word, a walk checks the indexes come back in order.
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "flash_device.h"
+#include "flash_log.h"
+#include "sysclock.h"
+
+#define TEST_PAGE_SIZE      512
+#define TEST_PAGE_COUNT     4
+#define TEST_REC_TYPE       0x01
+#define TEST_REC_LEN        12
+#define TEST_REC_SIZE       (FLASH_LOG_RECORD_HEADER + TEST_REC_LEN)
+#define TEST_RECS_PER_PAGE  ((TEST_PAGE_SIZE - FLASH_LOG_HEADER_SIZE) / TEST_REC_SIZE)
+
+static const sim_flash_geometry_t test_geometry = {TEST_PAGE_SIZE, TEST_PAGE_COUNT, 85, 41};
+static VirtualClock clk;
+
+void setUp(void){
+    clk.set_ms(0);
+    sysclk::set(&clk);
+}
+
+void tearDown(void){
+    sysclk::set(nullptr);
+}
+
+static void append_record(FlashLog &log, uint32_t id){
+    uint8_t payload[TEST_REC_LEN];
+    memset(payload, (uint8_t)id, sizeof(payload));
+    memcpy(payload, &id, sizeof(id));
+    TEST_ASSERT_TRUE(log.append(TEST_REC_TYPE, payload, sizeof(payload)));
+}
+
+/**
+ * @brief Walk the log, oldest first
+ *
+ * @return Records read, their indexes in ids
+ */
+static uint32_t walk(FlashLog &log, uint32_t *ids, uint32_t max, uint32_t *first_seq = nullptr){
+    flash_log_cursor_t cur;
+    flash_record_t     rec;
+    uint32_t           n = 0;
+    log.rewind(&cur);
+    while (log.next(&cur, &rec)) {
+        TEST_ASSERT_EQUAL_UINT8(TEST_REC_TYPE, rec.type);
+        TEST_ASSERT_EQUAL_UINT8(TEST_REC_LEN, rec.len);
+        if (n == 0 && first_seq != nullptr) {
+            *first_seq = rec.page_seq;
+        }
+        if (n < max) {
+            memcpy(&ids[n], rec.data, sizeof(uint32_t));
+        }
+        n++;
+    }
+    return n;
+}
+
+static uint32_t header_erases(SimFlash &flash, uint32_t page){
+    uint8_t h[4];
+    TEST_ASSERT_TRUE(flash.read(page, 8, h, sizeof(h)));
+    return (uint32_t)h[0] | ((uint32_t)h[1] << 8) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+}
+
+void test_rejects_small_device(void){
+    sim_flash_geometry_t small = {FLASH_LOG_HEADER_SIZE + FLASH_LOG_BUFFER - FLASH_WORD_SIZE, TEST_PAGE_COUNT, 85, 41};
+    SimFlash flash(small);
+    FlashLog log;
+    TEST_ASSERT_FALSE(log.begin(&flash));
+}
+
+void test_read_back_after_reboot(void){
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    TEST_ASSERT_EQUAL_UINT32(0, log.sequence());
+    for (uint32_t i = 0; i < 10; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_EQUAL_UINT16(10 * TEST_REC_SIZE, log.buffered());
+    TEST_ASSERT_TRUE(log.flush());
+    TEST_ASSERT_EQUAL_UINT16(0, log.buffered());
+
+    FlashLog again;
+    TEST_ASSERT_TRUE(again.begin(&flash));
+    TEST_ASSERT_EQUAL_UINT32(1, again.sequence());
+    append_record(again, 10);
+    TEST_ASSERT_TRUE(again.flush());
+    TEST_ASSERT_EQUAL_UINT32(1, again.sequence());     // Appended behind the recovered records
+
+    uint32_t ids[16];
+    TEST_ASSERT_EQUAL_UINT32(11, walk(again, ids, 16));
+    for (uint32_t i = 0; i < 11; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, ids[i]);
+    }
+}
+
+void test_wrap_drops_oldest_page(void){
+    const uint32_t total = 200;
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    for (uint32_t i = 0; i < total; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_TRUE(log.flush());
+
+    // Records never straddle pages, every page but the head is full
+    uint32_t pages = (total + TEST_RECS_PER_PAGE - 1) / TEST_RECS_PER_PAGE;
+    uint32_t kept  = (TEST_PAGE_COUNT - 1) * TEST_RECS_PER_PAGE + (total - (pages - 1) * TEST_RECS_PER_PAGE);
+    TEST_ASSERT_EQUAL_UINT32(pages, log.sequence());
+
+    uint32_t ids[TEST_PAGE_COUNT * TEST_RECS_PER_PAGE];
+    uint32_t first_seq = 0;
+    TEST_ASSERT_EQUAL_UINT32(kept, walk(log, ids, TEST_PAGE_COUNT * TEST_RECS_PER_PAGE, &first_seq));
+    TEST_ASSERT_EQUAL_UINT32(pages - TEST_PAGE_COUNT + 1, first_seq);
+    for (uint32_t i = 0; i < kept; i++) {
+        TEST_ASSERT_EQUAL_UINT32(total - kept + i, ids[i]);
+    }
+
+    // The wrapped ring is recovered from its newest page
+    FlashLog again;
+    TEST_ASSERT_TRUE(again.begin(&flash));
+    TEST_ASSERT_EQUAL_UINT32(pages, again.sequence());
+    TEST_ASSERT_EQUAL_UINT32(kept, walk(again, ids, TEST_PAGE_COUNT * TEST_RECS_PER_PAGE));
+}
+
+void test_erase_counting(void){
+    const uint32_t turns = 3;
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    for (uint32_t i = 0; i < turns * TEST_PAGE_COUNT * TEST_RECS_PER_PAGE; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_TRUE(log.flush());
+
+    // One erase per page opened, spread evenly over the ring
+    sim_flash_stats_t stats;
+    flash.get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(turns * TEST_PAGE_COUNT, log.sequence());
+    TEST_ASSERT_EQUAL_UINT32(log.sequence(), stats.erases);
+    TEST_ASSERT_EQUAL_UINT32(turns, stats.max_page_erases);
+    for (uint32_t p = 0; p < TEST_PAGE_COUNT; p++) {
+        TEST_ASSERT_EQUAL_UINT32(turns, header_erases(flash, p));
+    }
+
+    // The wear count survives a reboot and keeps counting
+    FlashLog again;
+    TEST_ASSERT_TRUE(again.begin(&flash));
+    for (uint32_t i = 0; i < TEST_RECS_PER_PAGE; i++) {
+        append_record(again, i);
+    }
+    TEST_ASSERT_TRUE(again.flush());
+    flash.get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(turns * TEST_PAGE_COUNT + 1, stats.erases);
+    TEST_ASSERT_EQUAL_UINT32(turns + 1, stats.max_page_erases);
+    TEST_ASSERT_EQUAL_UINT32(turns + 1, header_erases(flash, 0));
+
+    // The simulated flash time went to the installed clock
+    TEST_ASSERT_EQUAL_UINT32(stats.busy_us, (uint32_t)clk.elapsed_us());
+}
+
+void test_torn_record_closes_page(void){
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    for (uint32_t i = 0; i < 5; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_TRUE(log.flush());
+
+    // Power lost two words into the next record
+    flash.cut_after(2);
+    for (uint32_t i = 5; i < 8; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_TRUE(log.flush());
+    flash.cut_after(-1);
+
+    FlashLog again;
+    TEST_ASSERT_TRUE(again.begin(&flash));
+    uint32_t ids[16];
+    TEST_ASSERT_EQUAL_UINT32(5, walk(again, ids, 16));
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, ids[i]);
+    }
+
+    // Nothing is written behind the torn record, the next flush opens a page
+    for (uint32_t i = 100; i < 103; i++) {
+        append_record(again, i);
+    }
+    TEST_ASSERT_TRUE(again.flush());
+    TEST_ASSERT_EQUAL_UINT32(2, again.sequence());
+    TEST_ASSERT_EQUAL_UINT32(8, walk(again, ids, 16));
+    TEST_ASSERT_EQUAL_UINT32(4, ids[4]);
+    TEST_ASSERT_EQUAL_UINT32(100, ids[5]);
+    TEST_ASSERT_EQUAL_UINT32(102, ids[7]);
+}
+
+void test_program_failure_keeps_records(void){
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    for (uint32_t i = 0; i < 5; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_TRUE(log.flush());
+
+    flash.fail_after(0);
+    for (uint32_t i = 5; i < 8; i++) {
+        append_record(log, i);
+    }
+    TEST_ASSERT_FALSE(log.flush());
+    TEST_ASSERT_EQUAL_UINT16(3 * TEST_REC_SIZE, log.buffered());
+    uint32_t ids[16];
+    TEST_ASSERT_EQUAL_UINT32(5, walk(log, ids, 16));
+
+    // The failed page is abandoned, the retry lands on a fresh one
+    flash.fail_after(-1);
+    TEST_ASSERT_TRUE(log.flush());
+    TEST_ASSERT_EQUAL_UINT16(0, log.buffered());
+    TEST_ASSERT_EQUAL_UINT32(2, log.sequence());
+    TEST_ASSERT_EQUAL_UINT32(8, walk(log, ids, 16));
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, ids[i]);
+    }
+}
+
+void test_header_failure_retries(void){
+    SimFlash flash(test_geometry);
+    FlashLog log;
+    TEST_ASSERT_TRUE(log.begin(&flash));
+    append_record(log, 0);
+
+    // Formatting the first page fails, the record waits for the next flush
+    flash.fail_after(0);
+    TEST_ASSERT_FALSE(log.flush());
+    TEST_ASSERT_EQUAL_UINT32(0, log.sequence());
+    TEST_ASSERT_EQUAL_UINT16(TEST_REC_SIZE, log.buffered());
+
+    flash.fail_after(-1);
+    TEST_ASSERT_TRUE(log.flush());
+    TEST_ASSERT_EQUAL_UINT32(1, log.sequence());
+    uint32_t ids[4];
+    TEST_ASSERT_EQUAL_UINT32(1, walk(log, ids, 4));
+    TEST_ASSERT_EQUAL_UINT32(0, ids[0]);
+}
+
+int main(int argc, char **argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_small_device);
+    RUN_TEST(test_read_back_after_reboot);
+    RUN_TEST(test_wrap_drops_oldest_page);
+    RUN_TEST(test_erase_counting);
+    RUN_TEST(test_torn_record_closes_page);
+    RUN_TEST(test_program_failure_keeps_records);
+    RUN_TEST(test_header_failure_retries);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_frame_bench.cpp
+ * @brief Packed mesh frame against the JSON status path: round trip, size and encode cost.
+ *
+ * Run on the host with: pio test -e native -f test_frame_bench -v
+ *
+ * The costs are host wall time, only the ratio between the two encoders
+ * carries over to the nRF52840. The printed figures are informative; the
+ * assertions only hold the margins the packed frame exists for.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include "meshsolar_pack.h"
+#include "meshsolar_json.h"
+#include "sysclock.h"
+
+#define BENCH_ROUNDS        2000
+
+static meshsolar_status_t sta;
+static VirtualClock       clk;
+
+/**
+ * @brief A charging 4S LiFePO4 pack with one protection bit latched
+ */
+static void fill_status(meshsolar_status_t *s){
+    memset(s, 0, sizeof(*s));
+    strlcpy(s->command, "status", sizeof(s->command));
+    const float mv[4]   = {3312.0f, 3307.0f, 3318.0f, 3301.0f};
+    const float degc[4] = {24.0f, 25.0f, 23.0f, 26.0f};
+    s->total_voltage = 0;
+    for (int i = 0; i < 4; i++) {
+        s->cells[i].cell_num    = i + 1;
+        s->cells[i].voltage     = mv[i];
+        s->cells[i].temperature = degc[i];
+        s->total_voltage       += mv[i];
+    }
+    s->cell_count          = 4;
+    s->soc_gauge           = 76;
+    s->charge_current      = 1236;
+    s->learned_capacity    = 5984;
+    s->pack_voltage        = (uint16_t)s->total_voltage;
+    s->fet_enable          = true;
+    s->safety_status.bits.otc = 1;              // Latched overtemperature during charge
+}
+
+static double ns_per_round(std::chrono::steady_clock::time_point t0){
+    std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - t0;
+    return d.count() / BENCH_ROUNDS;
+}
+
+void setUp(void){
+    sysclk::set(&clk);
+    fill_status(&sta);
+}
+
+void tearDown(void){
+    sysclk::set(nullptr);
+}
+
+void test_packed_round_trip(void){
+    uint8_t frame[MESHSOLAR_PACKED_LEN];
+    TEST_ASSERT_EQUAL_UINT32(MESHSOLAR_PACKED_LEN, meshsolar_pack_status(&sta, frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL_UINT32(0, meshsolar_pack_status(&sta, frame, sizeof(frame) - 1));
+
+    meshsolar_status_t out;
+    TEST_ASSERT_TRUE(meshsolar_unpack_status(frame, sizeof(frame), &out));
+    TEST_ASSERT_FALSE(meshsolar_unpack_status(frame, sizeof(frame) - 1, &out));
+    TEST_ASSERT_EQUAL_INT(sta.cell_count, out.cell_count);
+    TEST_ASSERT_EQUAL_INT(sta.soc_gauge, out.soc_gauge);
+    TEST_ASSERT_TRUE(out.fet_enable);
+    TEST_ASSERT_FALSE(out.emergency_shutdown);
+    TEST_ASSERT_EQUAL_UINT32(sta.safety_status.bytes, out.safety_status.bytes);
+    for (int i = 0; i < 4; i++) {                       // Back within half a quantization step
+        TEST_ASSERT_TRUE(fabsf(out.cells[i].voltage - sta.cells[i].voltage) <= 1.5f);
+        TEST_ASSERT_TRUE(fabsf(out.cells[i].temperature - sta.cells[i].temperature) <= 0.5f);
+    }
+    TEST_ASSERT_TRUE(abs(out.charge_current - sta.charge_current) <= 2);
+    TEST_ASSERT_TRUE(fabsf(out.learned_capacity - sta.learned_capacity) <= 16.0f);
+}
+
+void test_frame_size_against_json(void){
+    uint8_t frame[MESHSOLAR_PACKED_LEN];
+    String  json;
+    size_t  packed = meshsolar_pack_status(&sta, frame, sizeof(frame));
+    size_t  plain  = meshsolar_status_to_json(&sta, json);
+    size_t  multi  = meshsolar_status_to_json(&sta, json, 2);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "status bytes: packed %u, JSON %u, JSON multi-pack %u (%.1fx)",
+             (unsigned)packed, (unsigned)plain, (unsigned)multi, (double)plain / packed);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(MESHSOLAR_PACKED_LEN, packed);
+    TEST_ASSERT_TRUE(plain > 8 * packed);               // One LoRa payload against several
+    TEST_ASSERT_TRUE(multi > plain);
+}
+
+void test_encode_cost_against_json(void){
+    uint8_t  frame[MESHSOLAR_PACKED_LEN];
+    String   json;
+    uint32_t sink = 0;                                  // Keeps the loops from being optimized out
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        sta.charge_current = (int16_t)(1236 + (i & 7));
+        sink += meshsolar_pack_status(&sta, frame, sizeof(frame)) + frame[i % MESHSOLAR_PACKED_LEN];
+    }
+    double pack_ns = ns_per_round(t0);
+
+    meshsolar_status_t out;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        sink += meshsolar_unpack_status(frame, sizeof(frame), &out) ? 1 : 0;
+    }
+    double unpack_ns = ns_per_round(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        sta.charge_current = (int16_t)(1236 + (i & 7));
+        sink += meshsolar_status_to_json(&sta, json);
+    }
+    double json_ns = ns_per_round(t0);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "encode ns: packed %.0f, unpack %.0f, JSON %.0f (%.1fx) [%u]",
+             pack_ns, unpack_ns, json_ns, json_ns / pack_ns, (unsigned)(sink & 1));
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE(pack_ns < json_ns);
+}
+
+int main(int argc, char **argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_packed_round_trip);
+    RUN_TEST(test_frame_size_against_json);
+    RUN_TEST(test_encode_cost_against_json);
+    return UNITY_END();
+}
@@ -0,0 +1,86 @@
+/**
+ * @file test_soft_wire.cpp
+ * @brief SoftwareWire clock stretching on a VirtualClock: a held SCL times out, a released one resumes.
+ *
+ * Run on the host with: pio test -e native -f test_soft_wire
+ *
+ * The pins are ArduinoFake mocks. SCL reads low while the simulated Slave
+ * stretches it, SDA always reads high, so every byte is NACKed.
+ */
+
+#include <ArduinoFake.h>
+#include <unity.h>
+#include "SoftwareWire.h"
+#include "sysclock.h"
+
+using namespace fakeit;
+
+#define TEST_SDA_PIN        33
+#define TEST_SCL_PIN        32
+
+static VirtualClock clk;
+static uint32_t     scl_low_from_us;        // SCL held low by the Slave in [from, until)
+static uint32_t     scl_low_until_us;
+
+static int bus_read(uint8_t pin){
+    if (pin == TEST_SCL_PIN) {
+        uint32_t now = sysclk::micros();
+        return (now >= scl_low_from_us && now < scl_low_until_us) ? LOW : HIGH;
+    }
+    return HIGH;
+}
+
+void setUp(void){
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), pinMode)).AlwaysReturn();
+    When(Method(ArduinoFake(), digitalWrite)).AlwaysReturn();
+    When(Method(ArduinoFake(), digitalRead)).AlwaysDo(bus_read);
+    clk.set_ms(0);
+    sysclk::set(&clk);
+    scl_low_from_us  = 0;
+    scl_low_until_us = 0;
+}
+
+void tearDown(void){
+    sysclk::set(nullptr);
+}
+
+void test_stuck_scl_times_out(void){
+    SoftwareWire wire(TEST_SDA_PIN, TEST_SCL_PIN);
+    wire.begin();
+    wire.setTimeout(25);
+    scl_low_until_us = 0xFFFFFFFFu;         // Shorted to ground, never released
+
+    uint32_t t0 = sysclk::millis();
+    wire.beginTransmission(0x0B);
+    wire.write(0x0D);
+    TEST_ASSERT_EQUAL_UINT8(SOFTWAREWIRE_OTHER, wire.endTransmission());
+    uint32_t waited = sysclk::millis() - t0;
+    TEST_ASSERT_TRUE(waited >= 25 && waited < 30);  // The STOP waited out the timeout once
+
+    t0 = sysclk::millis();
+    TEST_ASSERT_EQUAL_UINT8(0, wire.requestFrom(0x0B, 2));
+    waited = sysclk::millis() - t0;
+    TEST_ASSERT_TRUE(waited >= 25 && waited < 30);
+}
+
+void test_stretch_ends_when_released(void){
+    SoftwareWire wire(TEST_SDA_PIN, TEST_SCL_PIN);
+    wire.begin();
+    uint32_t t0 = sysclk::micros();
+    scl_low_from_us  = t0 + 100;            // During the address byte
+    scl_low_until_us = t0 + 5100;
+
+    wire.beginTransmission(0x0B);
+    TEST_ASSERT_EQUAL_UINT8(SOFTWAREWIRE_ADDRESS_NACK, wire.endTransmission());
+    uint32_t took = sysclk::micros() - t0;
+    TEST_ASSERT_TRUE(took >= 5100);
+    TEST_ASSERT_TRUE(took < 5100 + 1000);   // Resumed within a poll of the release, far from the 1 s timeout
+}
+
+int main(int argc, char **argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_stuck_scl_times_out);
+    RUN_TEST(test_stretch_ends_when_released);
+    return UNITY_END();
+}
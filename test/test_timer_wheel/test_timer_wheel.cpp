@@ -0,0 +1,214 @@
+/**
+ * @file test_timer_wheel.cpp
+ * @brief TimerWheel on a VirtualClock: slot wrap, re-arming from callbacks, cancel.
+ *
+ * Run on the host with: pio test -e native -f test_timer_wheel
+ *
+ * Time only moves through step(), which advances the virtual clock one
+ * wheel tick at a time and runs the wheel like the example loop does.
+ */
+
+#include <unity.h>
+#include "timer_wheel.h"
+#include "sysclock.h"
+
+#define WHEEL_SPAN_MS       (TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS)   // One revolution
+
+static VirtualClock clk;
+static TimerWheel   wheel;
+
+typedef struct {
+    uint32_t      fired;
+    uint32_t      last_ms;          // sysclk::millis() at the last call
+    uint32_t      rearm_left;       // Re-arms at delay 0 still to do
+    timer_node_t *self;
+    timer_node_t *victim;           // Timer stopped from the callback
+} probe_t;
+
+static void probe_cb(void *arg){
+    probe_t *p = (probe_t *)arg;
+    p->fired++;
+    p->last_ms = sysclk::millis();
+    if (p->rearm_left > 0) {
+        p->rearm_left--;
+        wheel.restart(p->self, sysclk::millis(), 0);
+    }
+    if (p->victim != nullptr) {
+        wheel.stop(p->victim);
+    }
+}
+
+/**
+ * @brief Advance the clock tick by tick up to ms, running the wheel at each tick
+ */
+static void step(uint32_t ms){
+    for (uint32_t done = 0; done < ms; done += TIMER_WHEEL_TICK_MS) {
+        clk.advance_ms(TIMER_WHEEL_TICK_MS);
+        wheel.run(sysclk::millis());
+    }
+}
+
+static void reset_at(uint32_t ms){
+    clk.set_ms(ms);
+    sysclk::set(&clk);
+    wheel = TimerWheel();
+    wheel.begin(sysclk::millis());
+}
+
+void setUp(void){
+    reset_at(0);
+}
+
+void tearDown(void){
+    sysclk::set(nullptr);
+}
+
+void test_one_shot_and_periodic(void){
+    timer_node_t once = {}, every = {};
+    probe_t      po   = {}, pe    = {};
+    wheel.start(&once, sysclk::millis(), 100, 0, probe_cb, &po);
+    wheel.start(&every, sysclk::millis(), 50, 50, probe_cb, &pe);
+    TEST_ASSERT_EQUAL_UINT32(50, wheel.next_deadline_in(sysclk::millis()));
+
+    step(320);
+    TEST_ASSERT_EQUAL_UINT32(1, po.fired);
+    TEST_ASSERT_EQUAL_UINT32(112, po.last_ms);          // First tick at or after 100 ms
+    TEST_ASSERT_FALSE(once.armed);
+    TEST_ASSERT_EQUAL_UINT32(6, pe.fired);
+    TEST_ASSERT_TRUE(every.armed);
+    TEST_ASSERT_EQUAL_UINT32(350, every.deadline);      // Reloaded on its own phase
+
+    // A late run fires a periodic timer once and skips the missed periods
+    clk.advance_ms(500);
+    TEST_ASSERT_EQUAL_UINT32(30, wheel.run(sysclk::millis()));
+    TEST_ASSERT_EQUAL_UINT32(7, pe.fired);
+}
+
+void test_slot_wrap(void){
+    // Both land in the same slot, one revolution apart
+    timer_node_t near = {}, far = {};
+    probe_t      pn   = {}, pf   = {};
+    wheel.start(&near, sysclk::millis(), 3 * TIMER_WHEEL_TICK_MS, 0, probe_cb, &pn);
+    wheel.start(&far, sysclk::millis(), WHEEL_SPAN_MS + 3 * TIMER_WHEEL_TICK_MS, 0, probe_cb, &pf);
+
+    step(3 * TIMER_WHEEL_TICK_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, pn.fired);
+    TEST_ASSERT_EQUAL_UINT32(0, pf.fired);
+    TEST_ASSERT_EQUAL_UINT32(WHEEL_SPAN_MS, wheel.next_deadline_in(sysclk::millis()));
+
+    step(WHEEL_SPAN_MS - TIMER_WHEEL_TICK_MS);
+    TEST_ASSERT_EQUAL_UINT32(0, pf.fired);
+    step(TIMER_WHEEL_TICK_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, pf.fired);
+    TEST_ASSERT_EQUAL_UINT32(WHEEL_SPAN_MS + 3 * TIMER_WHEEL_TICK_MS, pf.last_ms);
+    TEST_ASSERT_EQUAL_UINT32(TIMER_WHEEL_IDLE_MS, wheel.next_deadline_in(sysclk::millis()));
+}
+
+void test_long_sleep_sweeps_every_slot(void){
+    timer_node_t t[4] = {};
+    probe_t      p[4] = {};
+    for (int i = 0; i < 4; i++) {
+        wheel.start(&t[i], sysclk::millis(), 100 + i * 150, 0, probe_cb, &p[i]);
+    }
+    clk.advance_ms(5 * WHEEL_SPAN_MS);
+    TEST_ASSERT_EQUAL_UINT32(TIMER_WHEEL_IDLE_MS, wheel.run(sysclk::millis()));
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_UINT32(1, p[i].fired);
+    }
+}
+
+void test_millis_wrap(void){
+    reset_at(0xFFFFFFFFull - 255);                      // 256 ms before millis() wraps
+    timer_node_t t = {};
+    probe_t      p = {};
+    wheel.start(&t, sysclk::millis(), 576, 0, probe_cb, &p);
+    TEST_ASSERT_EQUAL_UINT32(320, t.deadline);          // Past the wrap
+
+    step(560);
+    TEST_ASSERT_EQUAL_UINT32(0, p.fired);
+    step(TIMER_WHEEL_TICK_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, p.fired);
+    TEST_ASSERT_EQUAL_UINT32(320, p.last_ms);
+}
+
+void test_rearm_at_zero_from_callback(void){
+    // A timer that keeps re-arming itself due fires once per run, never loops in run()
+    timer_node_t t = {};
+    probe_t      p = {};
+    p.self       = &t;
+    p.rearm_left = 3;
+    wheel.start(&t, sysclk::millis(), TIMER_WHEEL_TICK_MS, 0, probe_cb, &p);
+
+    step(TIMER_WHEEL_TICK_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, p.fired);
+    TEST_ASSERT_TRUE(t.armed);
+    TEST_ASSERT_EQUAL_UINT32(0, wheel.next_deadline_in(sysclk::millis()));
+
+    // The loop polls again at once and picks the re-armed timer up without a tick passing
+    TEST_ASSERT_EQUAL_UINT32(0, wheel.run(sysclk::millis()));
+    TEST_ASSERT_EQUAL_UINT32(0, wheel.run(sysclk::millis()));
+    TEST_ASSERT_EQUAL_UINT32(TIMER_WHEEL_IDLE_MS, wheel.run(sysclk::millis()));
+    TEST_ASSERT_EQUAL_UINT32(4, p.fired);
+    TEST_ASSERT_EQUAL_UINT32(TIMER_WHEEL_TICK_MS, p.last_ms);
+    TEST_ASSERT_FALSE(t.armed);
+}
+
+static timer_node_t chained;
+static probe_t      chained_probe;
+
+static void chain_cb(void *arg){
+    (void)arg;
+    wheel.start(&chained, sysclk::millis(), 0, 0, probe_cb, &chained_probe);
+}
+
+void test_start_other_at_zero_fires_same_run(void){
+    // A job handing over to another (status refresh -> telemetry) runs it in the same pass
+    timer_node_t t = {};
+    chained       = timer_node_t();
+    chained_probe = probe_t();
+    wheel.start(&t, sysclk::millis(), 40, 0, chain_cb, nullptr);
+    step(48);
+    TEST_ASSERT_EQUAL_UINT32(1, chained_probe.fired);
+    TEST_ASSERT_EQUAL_UINT32(48, chained_probe.last_ms);
+}
+
+void test_cancel(void){
+    timer_node_t a = {}, b = {}, c = {};
+    probe_t      pa = {}, pb = {}, pc = {};
+    wheel.start(&a, sysclk::millis(), 100, 100, probe_cb, &pa);
+    wheel.start(&b, sysclk::millis(), 40, 0, probe_cb, &pb);
+    wheel.start(&c, sysclk::millis(), 40, 0, probe_cb, &pc);
+
+    // b and c share a slot and expire together, whichever runs first cancels the other
+    pb.victim = &c;
+    pc.victim = &b;
+    step(48);
+    TEST_ASSERT_EQUAL_UINT32(1, pb.fired + pc.fired);
+    TEST_ASSERT_FALSE(b.armed);
+    TEST_ASSERT_FALSE(c.armed);
+
+    wheel.stop(&a);
+    TEST_ASSERT_FALSE(a.armed);
+    wheel.stop(&a);                                     // Stopping an idle timer is a no-op
+    TEST_ASSERT_EQUAL_UINT32(TIMER_WHEEL_IDLE_MS, wheel.next_deadline_in(sysclk::millis()));
+    step(2 * WHEEL_SPAN_MS);
+    TEST_ASSERT_EQUAL_UINT32(0, pa.fired);
+
+    // A cancelled timer can be started again
+    wheel.restart(&a, sysclk::millis(), 0);
+    wheel.run(sysclk::millis());
+    TEST_ASSERT_EQUAL_UINT32(1, pa.fired);
+    TEST_ASSERT_TRUE(a.armed);                          // Still periodic
+}
+
+int main(int argc, char **argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_one_shot_and_periodic);
+    RUN_TEST(test_slot_wrap);
+    RUN_TEST(test_long_sleep_sweeps_every_slot);
+    RUN_TEST(test_millis_wrap);
+    RUN_TEST(test_rearm_at_zero_from_callback);
+    RUN_TEST(test_start_other_at_zero_fires_same_run);
+    RUN_TEST(test_cancel);
+    return UNITY_END();
+}